@@ -77,6 +77,7 @@ int main(
      * Parse certificate.
      */
     Certificate(&cert, (unsigned short)0);      /* constructor */
+    lazy_casn(&cert.self);      /* only the SIA extension is needed */
     ret = get_casn_file(&cert.self, (char *)file, 0);
     if (ret < 0)
     {
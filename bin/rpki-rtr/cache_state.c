@@ -1,8 +1,12 @@
 #include "cache_state.h"
 
+#include <errno.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
 
 #include "util/logging.h"
+#include "config/config.h"
 #include "db/clients/rtr.h"
 
 // NOTE: if this returns false, the contents of state are undefined
@@ -38,6 +42,149 @@ static bool get_cache_state(
     return true;
 }
 
+/**
+   @brief Map the snapshot for the generation's serial number, if there
+       is one.
+
+   Failure to find or open a snapshot is not an error, it just means
+   that Reset Queries for this generation are served from the database.
+*/
+static void open_generation_snapshot(
+    struct cache_generation *generation)
+{
+    const char *snapshot_dir = CONFIG_RPKI_RTR_SNAPSHOT_DIR_get();
+    char path[PATH_MAX];
+
+    generation->has_snapshot = false;
+
+    if (snapshot_dir == NULL || !generation->cache_state.data_available)
+    {
+        return;
+    }
+
+    if (!vrp_file_path(path, sizeof(path), snapshot_dir, VRP_FILE_SNAPSHOT,
+                       generation->cache_state.serial_number) ||
+        access(path, F_OK) != 0 ||
+        !vrp_file_open(&generation->snapshot, path))
+    {
+        LOG(LOG_DEBUG, "no usable snapshot for serial number %" PRISERIAL,
+            generation->cache_state.serial_number);
+        return;
+    }
+
+    if (generation->snapshot.type != VRP_FILE_SNAPSHOT ||
+        generation->snapshot.session != generation->cache_state.session ||
+        generation->snapshot.serial != generation->cache_state.serial_number)
+    {
+        LOG(LOG_WARNING, "%s does not match session %" PRISESSION
+            " and serial number %" PRISERIAL ", ignoring it", path,
+            generation->cache_state.session,
+            generation->cache_state.serial_number);
+        vrp_file_close(&generation->snapshot);
+        return;
+    }
+
+    generation->has_snapshot = true;
+}
+
+static struct cache_generation *new_generation(
+    const struct cache_state *cache_state)
+{
+    struct cache_generation *generation =
+        malloc(sizeof(struct cache_generation));
+
+    if (generation == NULL)
+    {
+        LOG(LOG_ERR, "can't allocate memory for a cache generation");
+        return NULL;
+    }
+
+    generation->cache_state = *cache_state;
+    generation->readers = 0;
+    generation->next_retired = NULL;
+
+    open_generation_snapshot(generation);
+
+    return generation;
+}
+
+static void free_generation(
+    struct cache_generation *generation)
+{
+    if (generation->has_snapshot)
+    {
+        vrp_file_close(&generation->snapshot);
+    }
+
+    free(generation);
+}
+
+/**
+   @brief Free every retired generation that no reader can still see.
+
+   A reader that has incremented #pinning may have loaded any
+   generation that was current at the time, so nothing is freed until
+   #pinning is observed to be zero. After that, a retired generation
+   can only be in use if its own reader count is nonzero, because any
+   new reader will load the current generation.
+*/
+static void reclaim_retired_generations(
+    struct global_cache_state *state)
+{
+    struct cache_generation **prevp;
+    struct cache_generation *generation;
+
+    if (state->retired == NULL ||
+        __atomic_load_n(&state->pinning, __ATOMIC_SEQ_CST) != 0)
+    {
+        return;
+    }
+
+    prevp = &state->retired;
+    while ((generation = *prevp) != NULL)
+    {
+        if (__atomic_load_n(&generation->readers, __ATOMIC_SEQ_CST) == 0)
+        {
+            *prevp = generation->next_retired;
+            free_generation(generation);
+        }
+        else
+        {
+            prevp = &generation->next_retired;
+        }
+    }
+}
+
+/** Wake up every subscriber after a new generation is published. */
+static void broadcast_new_generation(
+    struct global_cache_state *state)
+{
+    Bag_const_iterator it;
+    char errorbuf[ERROR_BUF_SIZE];
+
+    if (!Bag_start_const_iteration(state->subscribers))
+    {
+        LOG(LOG_ERR, "error in Bag_start_const_iteration(subscribers)");
+        return;
+    }
+
+    for (it = Bag_const_begin(state->subscribers);
+         it != Bag_const_end(state->subscribers);
+         it = Bag_const_iterator_next(state->subscribers, it))
+    {
+        if (sem_post((cxn_semaphore_t *)
+                     Bag_const_get(state->subscribers, it)) != 0)
+        {
+            ERR_LOG(errno, errorbuf, "sem_post()");
+        }
+    }
+
+    if (!Bag_stop_const_iteration(state->subscribers))
+    {
+        LOG(LOG_ERR, "error in Bag_stop_const_iteration(subscribers)");
+    }
+}
+
 bool initialize_global_cache_state(
     struct global_cache_state * state,
     dbconn * db)
@@ -48,31 +195,44 @@ bool initialize_global_cache_state(
         return false;
     }
 
-    if (!get_cache_state(&state->cache_state, db))
+    struct cache_state tmp_cache_state;
+    struct cache_generation *generation;
+
+    if (!get_cache_state(&tmp_cache_state, db))
         return false;
 
-    if (state->cache_state.data_available)
+    if (tmp_cache_state.data_available)
     {
         LOG(LOG_INFO,
             "cache data initialized with session %" PRISESSION
-            " and serial number %" PRISERIAL, state->cache_state.session,
-            state->cache_state.serial_number);
+            " and serial number %" PRISERIAL, tmp_cache_state.session,
+            tmp_cache_state.serial_number);
     }
     else
     {
         LOG(LOG_NOTICE, "no cache data available (session = %" PRISESSION ")",
-            state->cache_state.session);
+            tmp_cache_state.session);
     }
 
-    int retval = pthread_rwlock_init(&state->lock, NULL);
-    if (retval != 0)
+    state->subscribers = Bag_new(true);
+    if (state->subscribers == NULL)
     {
-        char errorbuf[ERROR_BUF_SIZE];
-        ERR_LOG(retval, errorbuf,
-                "pthread_rwlock_init() for global cache state");
+        LOG(LOG_ERR, "can't create cache state subscribers");
         return false;
     }
 
+    generation = new_generation(&tmp_cache_state);
+    if (generation == NULL)
+    {
+        Bag_free(state->subscribers);
+        state->subscribers = NULL;
+        return false;
+    }
+
+    state->pinning = 0;
+    state->retired = NULL;
+    __atomic_store_n(&state->current, generation, __ATOMIC_SEQ_CST);
+
     return true;
 }
 
@@ -86,66 +246,71 @@ bool update_global_cache_state(
         return false;
     }
 
-    bool ret;
-    int retval;
-    char errorbuf[ERROR_BUF_SIZE];
+    // Only the main thread publishes generations, so it can read the
+    // current one without pinning it.
+    const struct cache_state *old_cache_state =
+        &__atomic_load_n(&state->current, __ATOMIC_SEQ_CST)->cache_state;
+    struct cache_state tmp_cache_state;
+    struct cache_generation *generation;
+    struct cache_generation *old_generation;
 
-    retval = pthread_rwlock_wrlock(&state->lock);
-    if (retval != 0)
+    reclaim_retired_generations(state);
+
+    if (!get_cache_state(&tmp_cache_state, db))
     {
-        ERR_LOG(retval, errorbuf,
-                "pthread_rwlock_wrlock() for global cache state");
+        LOG(LOG_WARNING,
+            "couldn't update global cache state, leaving cache state unchanged");
         return false;
     }
 
-    struct cache_state tmp_cache_state;
-    ret = get_cache_state(&tmp_cache_state, db);
-    if (ret)
+    if (tmp_cache_state.data_available && !old_cache_state->data_available)
     {
-        if (tmp_cache_state.data_available
-            && !state->cache_state.data_available)
-        {
-            LOG(LOG_NOTICE,
-                "cache data became available (session = %" PRISESSION
-                ", serial = %" PRISERIAL ")", tmp_cache_state.session,
-                tmp_cache_state.serial_number);
-        }
-        else if (!tmp_cache_state.data_available
-                 && state->cache_state.data_available)
-        {
-            LOG(LOG_WARNING,
-                "cache data became no longer available (old session = %"
-                PRISESSION ", old serial = %" PRISERIAL ")",
-                state->cache_state.session, state->cache_state.serial_number);
-        }
-        else if (tmp_cache_state.data_available &&
-                 state->cache_state.data_available &&
-                 tmp_cache_state.serial_number !=
-                 state->cache_state.serial_number)
-        {
-            LOG(LOG_INFO,
-                "cache serial number changed from %" PRISERIAL " to %"
-                PRISERIAL, state->cache_state.serial_number,
-                tmp_cache_state.serial_number);
-        }
-
-        state->cache_state = tmp_cache_state;
+        LOG(LOG_NOTICE,
+            "cache data became available (session = %" PRISESSION
+            ", serial = %" PRISERIAL ")", tmp_cache_state.session,
+            tmp_cache_state.serial_number);
     }
-    else
+    else if (!tmp_cache_state.data_available
+             && old_cache_state->data_available)
     {
         LOG(LOG_WARNING,
-            "couldn't update global cache state, leaving cache state unchanged");
+            "cache data became no longer available (old session = %"
+            PRISESSION ", old serial = %" PRISERIAL ")",
+            old_cache_state->session, old_cache_state->serial_number);
+    }
+    else if (tmp_cache_state.data_available &&
+             old_cache_state->data_available &&
+             tmp_cache_state.serial_number != old_cache_state->serial_number)
+    {
+        LOG(LOG_INFO,
+            "cache serial number changed from %" PRISERIAL " to %"
+            PRISERIAL, old_cache_state->serial_number,
+            tmp_cache_state.serial_number);
+    }
+    else if (tmp_cache_state.session == old_cache_state->session)
+    {
+        // nothing changed, keep serving the current generation
+        return true;
     }
 
-    retval = pthread_rwlock_unlock(&state->lock);
-    if (retval != 0)
+    generation = new_generation(&tmp_cache_state);
+    if (generation == NULL)
     {
-        ERR_LOG(retval, errorbuf,
-                "pthread_rwlock_unlock() for global cache state");
+        LOG(LOG_WARNING,
+            "couldn't update global cache state, leaving cache state unchanged");
         return false;
     }
 
-    return ret;
+    old_generation =
+        __atomic_exchange_n(&state->current, generation, __ATOMIC_SEQ_CST);
+    old_generation->next_retired = state->retired;
+    state->retired = old_generation;
+
+    broadcast_new_generation(state);
+
+    reclaim_retired_generations(state);
+
+    return true;
 }
 
 void close_global_cache_state(
@@ -157,13 +322,86 @@ void close_global_cache_state(
         return;
     }
 
-    int retval;
-    char errorbuf[ERROR_BUF_SIZE];
+    struct cache_generation *generation;
+
+    reclaim_retired_generations(state);
+
+    if (state->retired != NULL)
+    {
+        LOG(LOG_WARNING,
+            "closing global cache state while old generations are still in use");
+    }
+
+    generation = __atomic_exchange_n(&state->current, NULL,
+                                     __ATOMIC_SEQ_CST);
+    if (generation != NULL)
+    {
+        free_generation(generation);
+    }
+
+    if (state->subscribers != NULL)
+    {
+        if (Bag_size(state->subscribers) != 0)
+        {
+            LOG(LOG_WARNING,
+                "closing global cache state while it still has subscribers");
+        }
+        Bag_free(state->subscribers);
+        state->subscribers = NULL;
+    }
+}
+
+struct cache_generation *pin_cache_generation(
+    struct global_cache_state *state)
+{
+    struct cache_generation *generation;
+
+    __atomic_add_fetch(&state->pinning, 1, __ATOMIC_SEQ_CST);
+    generation = __atomic_load_n(&state->current, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&generation->readers, 1, __ATOMIC_SEQ_CST);
+    __atomic_sub_fetch(&state->pinning, 1, __ATOMIC_SEQ_CST);
+
+    return generation;
+}
+
+void unpin_cache_generation(
+    struct cache_generation *generation)
+{
+    __atomic_sub_fetch(&generation->readers, 1, __ATOMIC_SEQ_CST);
+}
+
+bool subscribe_cache_state(
+    struct global_cache_state *state,
+    cxn_semaphore_t *semaphore)
+{
+    return Bag_add(state->subscribers, (void *)semaphore);
+}
+
+void unsubscribe_cache_state(
+    struct global_cache_state *state,
+    cxn_semaphore_t *semaphore)
+{
+    Bag_iterator it;
+
+    if (!Bag_start_iteration(state->subscribers))
+    {
+        LOG(LOG_ERR, "error in Bag_start_iteration(subscribers)");
+        return;
+    }
+
+    for (it = Bag_begin(state->subscribers);
+         it != Bag_end(state->subscribers);
+         it = Bag_iterator_next(state->subscribers, it))
+    {
+        if (Bag_get(state->subscribers, it) == (void *)semaphore)
+        {
+            Bag_erase(state->subscribers, it);
+            break;
+        }
+    }
 
-    retval = pthread_rwlock_destroy(&state->lock);
-    if (retval != 0)
+    if (!Bag_stop_iteration(state->subscribers))
     {
-        ERR_LOG(retval, errorbuf,
-                "pthread_rwlock_destroy() for global cache state");
+        LOG(LOG_ERR, "error in Bag_stop_iteration(subscribers)");
     }
 }
@@ -1,11 +1,13 @@
 #ifndef _RTR_CACHE_STATE_H
 #define _RTR_CACHE_STATE_H
 
-#include <pthread.h>
 #include <stdbool.h>
 
+#include "util/bag.h"
 #include "db/connect.h"
 #include "lib/rpki-rtr/pdu.h"
+#include "rpki-rtr/vrp_file.h"
+#include "semaphores.h"
 
 struct cache_state {
     bool data_available;
@@ -15,16 +17,74 @@ struct cache_state {
     serial_number_t serial_number;
 };
 
-struct global_cache_state {
+/**
+   @brief An immutable version of the state served to routers.
+
+   A generation is never modified after it's published. Readers pin it
+   with pin_cache_generation(), use it for as long as they need to
+   (e.g. for the entire response to a Reset Query), and then release it
+   with unpin_cache_generation(). When a newer generation is published,
+   the old one is retired and freed by the main thread once the last
+   reader has unpinned it.
+*/
+struct cache_generation {
     struct cache_state cache_state;
-    pthread_rwlock_t lock;
+
+    /**
+       @brief Whether #snapshot holds the VRPs for
+           cache_state.serial_number.
+
+       This is only true if a snapshot directory is configured and
+       contains a valid snapshot for the current session and serial
+       number.
+    */
+    bool has_snapshot;
+    struct vrp_file snapshot;
+
+    /** @brief Number of readers that currently have this pinned. */
+    unsigned long readers;
+
+    /** @brief Next generation in the retired list. */
+    struct cache_generation *next_retired;
+};
+
+/**
+   @brief State that's shared between the main thread, which publishes
+       new generations, and all the other threads, which read them.
+
+   Readers never block: all access to #current and #pinning is with
+   atomic operations. Only the main thread may call
+   initialize_global_cache_state(), update_global_cache_state(), and
+   close_global_cache_state().
+*/
+struct global_cache_state {
+    struct cache_generation *current;
+
+    /**
+       @brief Number of readers that are between loading #current and
+           incrementing its reader count.
+    */
+    unsigned long pinning;
+
+    /**
+       @brief Generations that are no longer current but may still be
+           pinned. Only accessed by the main thread.
+    */
+    struct cache_generation *retired;
+
+    /**
+       @brief Semaphores (cxn_semaphore_t *) to post whenever a new
+           generation is published.
+    */
+    Bag *subscribers;
 };
 
 /**
    \brief
        Initialize the global cache state.
 
-   Initialize the lock and get the session and serial number from the database.
+   Get the session and serial number from the database and publish the
+   first generation.
 
    @return
        Whether or not the initialization was successful.
@@ -36,6 +96,10 @@ bool initialize_global_cache_state(
 /**
    Update the global cache state from the database.
 
+   If the cache state changed, a new generation is published and every
+   subscriber is woken up. Either way, retired generations that are no
+   longer pinned are freed.
+
    @return
        Whether or not the update was successful.
 */
@@ -43,8 +107,45 @@ bool update_global_cache_state(
     struct global_cache_state *state,
     dbconn * db);
 
-/** Free up any resources associated with the global cache state. */
+/**
+   Free up any resources associated with the global cache state.
+
+   This must not be called while any other thread might still have a
+   generation pinned.
+*/
 void close_global_cache_state(
     struct global_cache_state *state);
 
+/**
+   @brief Pin the current generation. This never blocks.
+
+   @return The current generation, which remains valid until it's
+       passed to unpin_cache_generation().
+*/
+struct cache_generation *pin_cache_generation(
+    struct global_cache_state *state);
+
+/**
+   @brief Release a generation pinned by pin_cache_generation().
+*/
+void unpin_cache_generation(
+    struct cache_generation *generation);
+
+/**
+   @brief Have @p semaphore posted each time a new generation is
+       published.
+
+   @return Whether or not the subscription was successful.
+*/
+bool subscribe_cache_state(
+    struct global_cache_state *state,
+    cxn_semaphore_t *semaphore);
+
+/**
+   @brief Undo subscribe_cache_state().
+*/
+void unsubscribe_cache_state(
+    struct global_cache_state *state,
+    cxn_semaphore_t *semaphore);
+
 #endif
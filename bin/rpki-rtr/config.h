@@ -10,9 +10,31 @@
 
 #define MAIN_LOOP_INTERVAL 5
 
+// How often to poll the database when notifications from rpki-rtr-update are
+// enabled. This is only a fallback in case a notification is lost.
+#define MAIN_LOOP_NOTIFY_INTERVAL 60
+
+// How often to write the metrics file, if RpkiRtrMetricsFile is set.
+#define METRICS_INTERVAL 15
+
 #define DB_RESPONSE_BUFFER_LENGTH 3
+
+// Maximum number of requests waiting for a db thread. Each connection has at
+// most one request at a time, so this limits the number of connections that
+// can have a request waiting at once.
+#define DB_REQUEST_QUEUE_LENGTH 16384
 #define DB_ROWS_PER_RESPONSE 1024
-#define DB_INITIAL_THREADS 8
+
+// The db thread pool grows from DB_MIN_THREADS up to DB_MAX_THREADS threads
+// while requests are waiting for a thread, and threads above DB_MIN_THREADS
+// exit after being idle for DB_THREAD_IDLE_TIMEOUT seconds.
+#define DB_MIN_THREADS 4
+#define DB_MAX_THREADS 32
+#define DB_THREAD_IDLE_TIMEOUT 60
+
+// Initial number of in-progress requests each db thread has room for. This
+// grows as needed.
+#define DB_DEQUE_INITIAL_CAPACITY 16
 
 /*
  * Quote from draft-ietf-sidr-rpki-rtr-19, Section 6.2: The cache MUST rate
@@ -20,9 +42,11 @@
  */
 #define CXN_NOTIFY_INTERVAL 60
 
-// How often to check the cache state when more than CXN_NOTIFY_INTERVAL
-// has elapsed without sending a Serial Notify.
-#define CXN_CACHE_STATE_INTERVAL 10
+// Connections are woken up whenever the main thread publishes a new cache
+// state, so this is only a fallback: how often to check the cache state when
+// more than CXN_NOTIFY_INTERVAL has elapsed without sending a Serial Notify
+// and without being woken up.
+#define CXN_CACHE_STATE_INTERVAL 300
 
 // The largest PDU should be an error report PDU.
 // The second largest is an IPv6 prefix at 32 bytes.
@@ -38,7 +62,12 @@
 // in many places, so it seems easier to pick a limit than
 // to bother with dynamic storage. It shouldn't be hard to
 // switch to dynamic storage later if needed.
-#define MAX_LISTENING_SOCKETS 64
+#define MAX_LISTENING_SOCKETS 256
+
+// The maximum value of RpkiRtrAcceptorThreads. Each acceptor thread has its
+// own listening socket for each address, so MAX_LISTENING_SOCKETS must be at
+// least this times the number of addresses.
+#define MAX_ACCEPTOR_THREADS 64
 
 // Lengths for strings of hosts and services.
 #define MAX_HOST_LENGTH 256
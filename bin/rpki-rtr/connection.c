@@ -12,6 +12,7 @@
 
 #include "util/macros.h"
 #include "util/logging.h"
+#include "config/config.h"
 
 #include "config.h"
 #include "signals.h"
@@ -36,17 +37,30 @@ struct run_state {
     const char *host;
     const char *serv;
     cxn_semaphore_t *semaphore;
-    Queue *db_request_queue;
-    db_semaphore_t *db_semaphore;
+    struct db_pool *db_pool;
     struct global_cache_state *global_cache_state;
     struct cache_state local_cache_state;
 
+    struct metrics *metrics;
+    struct metrics_session session_metrics;
+    bool session_metrics_started;
+
     enum { READY, RESPONDING } state;
 
+    // The protocol version is set by the first PDU from the router, see
+    // negotiate_version(). Until then, no Serial Notify is sent.
+    bool version_negotiated;
+    uint8_t protocol_version;
+
+    // Timing parameters for version 1 End of Data PDUs.
+    uint32_t refresh_interval;
+    uint32_t retry_interval;
+    uint32_t expire_interval;
+
     char errorbuf[ERROR_BUF_SIZE];
     char pdustrbuf[PDU_SPRINT_BUFSZ];
 
-    Queue *db_response_queue;
+    SpscQueue *db_response_queue;
     Queue *to_process_queue;
 
     uint8_t pdu_recv_buffer[MAX_PDU_SIZE];
@@ -67,8 +81,21 @@ struct run_state {
     uint8_t pdu_request_buffer[MAX_QUERY_PDU_LENGTH];
     size_t pdu_request_buffer_length;
 
+    // when the request was submitted, from CLOCK_MONOTONIC
+    struct timespec request_start;
+
     // tv_nsec MUST be zero
     struct timespec next_cache_state_check_time;
+
+    // Whether a new global cache state was broadcast while RESPONDING, so
+    // the cache state must be checked as soon as the response is done.
+    bool cache_state_check_pending;
+
+    // Serial Notifies are rate limited, see CXN_NOTIFY_INTERVAL.
+    time_t next_notify_time;
+
+    // whether or not semaphore is subscribed to global cache state changes
+    bool subscribed;
 };
 
 
@@ -76,28 +103,25 @@ static void copy_cache_state(
     struct run_state *run_state,
     struct cache_state *cache_state)
 {
-    int retval;
+    struct cache_generation *generation =
+        pin_cache_generation(run_state->global_cache_state);
 
-    retval = pthread_rwlock_rdlock(&run_state->global_cache_state->lock);
+    *cache_state = generation->cache_state;
 
-    if (retval != 0)
-    {
-        CXN_ERR_LOG(run_state, retval, "pthread_rwlock_rdlock()");
-        pthread_exit(NULL);
-    }
-
-    *cache_state = run_state->global_cache_state->cache_state;
+    unpin_cache_generation(generation);
+}
 
-    retval = pthread_rwlock_unlock(&run_state->global_cache_state->lock);
 
-    if (retval != 0)
+/** Release the cache generation pinned for the current request, if any. */
+static void release_request_generation(
+    struct run_state *run_state)
+{
+    if (run_state->request.generation != NULL)
     {
-        CXN_ERR_LOG(run_state, retval, "pthread_rwlock_unlock()");
-        pthread_exit(NULL);
+        unpin_cache_generation((struct cache_generation *)
+                               run_state->request.generation);
+        run_state->request.generation = NULL;
     }
-
-    run_state->next_cache_state_check_time.tv_sec =
-        time(NULL) + CXN_CACHE_STATE_INTERVAL;
 }
 
 
@@ -113,8 +137,8 @@ static void initialize_run_state(
         argsp->host == NULL ||
         argsp->serv == NULL ||
         argsp->semaphore == NULL ||
-        argsp->db_request_queue == NULL ||
-        argsp->db_semaphore == NULL || argsp->global_cache_state == NULL)
+        argsp->db_pool == NULL || argsp->global_cache_state == NULL ||
+        argsp->metrics == NULL)
     {
         LOG(LOG_ERR, "got NULL argument");
         free(args_voidp);
@@ -125,9 +149,10 @@ static void initialize_run_state(
     run_state->host = argsp->host;
     run_state->serv = argsp->serv;
     run_state->semaphore = argsp->semaphore;
-    run_state->db_request_queue = argsp->db_request_queue;
-    run_state->db_semaphore = argsp->db_semaphore;
+    run_state->db_pool = argsp->db_pool;
     run_state->global_cache_state = argsp->global_cache_state;
+    run_state->metrics = argsp->metrics;
+    run_state->session_metrics_started = false;
 
     free(args_voidp);
     args_voidp = NULL;
@@ -136,6 +161,13 @@ static void initialize_run_state(
 
     run_state->state = READY;
 
+    run_state->version_negotiated = false;
+    run_state->protocol_version = RTR_PROTOCOL_VERSION_MAX;
+
+    run_state->refresh_interval = CONFIG_RPKI_RTR_REFRESH_INTERVAL_get();
+    run_state->retry_interval = CONFIG_RPKI_RTR_RETRY_INTERVAL_get();
+    run_state->expire_interval = CONFIG_RPKI_RTR_EXPIRE_INTERVAL_get();
+
     run_state->db_response_queue = NULL;
     run_state->to_process_queue = NULL;
 
@@ -146,9 +178,15 @@ static void initialize_run_state(
 
     run_state->response = NULL;
 
+    run_state->request.generation = NULL;
+
+    run_state->subscribed = false;
+
+    run_state->next_notify_time = time(NULL) + CXN_NOTIFY_INTERVAL;
     run_state->next_cache_state_check_time.tv_sec =
-        time(NULL) + CXN_NOTIFY_INTERVAL;
+        run_state->next_notify_time;
     run_state->next_cache_state_check_time.tv_nsec = 0;
+    run_state->cache_state_check_pending = false;
 
     // The receive buffer is not bounds checked while reading the first
     // PDU_HEADER_LENGTH bytes.
@@ -181,6 +219,15 @@ static void send_pdu(
         run_state->pdu_send_buffer_length = count;
     }
 
+    metrics_add(&run_state->metrics->pdus_sent, 1);
+    metrics_add(&run_state->metrics->bytes_sent, (uint64_t) count);
+    metrics_add(&run_state->session_metrics.pdus_sent, 1);
+    metrics_add(&run_state->session_metrics.bytes_sent, (uint64_t) count);
+    if (pdu->pduType == PDU_ERROR_REPORT)
+    {
+        metrics_add(&run_state->metrics->errors_sent, 1);
+    }
+
     while (count > 0)
     {
         retval = write(run_state->fd,
@@ -200,7 +247,7 @@ static void send_pdu(
 static void send_cache_reset(
     struct run_state *run_state)
 {
-    run_state->send_pdu.protocolVersion = RTR_PROTOCOL_VERSION;
+    run_state->send_pdu.protocolVersion = run_state->protocol_version;
     run_state->send_pdu.pduType = PDU_CACHE_RESET;
     run_state->send_pdu.reserved = 0;
     run_state->send_pdu.length = PDU_HEADER_LENGTH;
@@ -208,6 +255,30 @@ static void send_cache_reset(
     send_pdu(run_state, &run_state->send_pdu);
 }
 
+/**
+    Get the protocol version for an Error Report.
+
+    Before the version is negotiated, this is the version of the PDU
+    being received if it's supported, or the highest supported version
+    otherwise, as required by RFC 8210, Section 7.
+*/
+static uint8_t error_version(
+    const struct run_state *run_state)
+{
+    if (run_state->version_negotiated)
+    {
+        return run_state->protocol_version;
+    }
+
+    if (run_state->pdu_recv_buffer_length > 0 &&
+        run_state->pdu_recv_buffer[0] <= RTR_PROTOCOL_VERSION_MAX)
+    {
+        return run_state->pdu_recv_buffer[0];
+    }
+
+    return RTR_PROTOCOL_VERSION_MAX;
+}
+
 static void send_error(
     struct run_state *run_state,
     error_code_t code,
@@ -232,7 +303,7 @@ static void send_error(
                             error_text_length);
     }
 
-    run_state->send_pdu.protocolVersion = RTR_PROTOCOL_VERSION;
+    run_state->send_pdu.protocolVersion = error_version(run_state);
     run_state->send_pdu.pduType = PDU_ERROR_REPORT;
     run_state->send_pdu.errorCode = code;
     run_state->send_pdu.length =
@@ -348,7 +419,7 @@ static void send_notify(
         pthread_exit(NULL);
     }
 
-    run_state->send_pdu.protocolVersion = RTR_PROTOCOL_VERSION;
+    run_state->send_pdu.protocolVersion = run_state->protocol_version;
     run_state->send_pdu.pduType = PDU_SERIAL_NOTIFY;
     run_state->send_pdu.sessionId = run_state->local_cache_state.session;
     run_state->send_pdu.length = PDU_HEADER_LENGTH + sizeof(serial_number_t);
@@ -357,8 +428,7 @@ static void send_notify(
 
     send_pdu(run_state, &run_state->send_pdu);
 
-    run_state->next_cache_state_check_time.tv_sec =
-        time(NULL) + CXN_NOTIFY_INTERVAL;
+    run_state->next_notify_time = time(NULL) + CXN_NOTIFY_INTERVAL;
 }
 
 
@@ -495,15 +565,6 @@ static int read_and_parse_pdu(
     return retval;
 }
 
-static void increment_db_semaphore(
-    struct run_state *run_state)
-{
-    if (sem_post(run_state->db_semaphore) != 0)
-    {
-        CXN_ERR_LOG(run_state, errno, "sem_post()");
-    }
-}
-
 static void add_db_request(
     struct run_state *run_state,
     PDU * pdu,
@@ -511,7 +572,7 @@ static void add_db_request(
 {
     ssize_t ret;
 
-    if (Queue_size(run_state->db_response_queue) != 0)
+    if (SpscQueue_size(run_state->db_response_queue) != 0)
     {
         CXN_LOG(run_state, LOG_ERR,
                 "add_db_request called with non-empty response queue");
@@ -528,6 +589,10 @@ static void add_db_request(
         break;
     case PDU_RESET_QUERY:
         run_state->request.query.type = RESET_QUERY;
+        // Pin the cache state so that the entire response comes from a
+        // single generation, even if a new one is published meanwhile.
+        run_state->request.generation =
+            pin_cache_generation(run_state->global_cache_state);
         break;
     default:
         CXN_LOG(run_state, LOG_ERR,
@@ -561,7 +626,12 @@ static void add_db_request(
         run_state->pdu_request_buffer_length = (size_t) ret;
     }
 
-    if (!Queue_push(run_state->db_request_queue, (void *)&run_state->request))
+    if (clock_gettime(CLOCK_MONOTONIC, &run_state->request_start) != 0)
+    {
+        CXN_ERR_LOG(run_state, errno, "clock_gettime()");
+    }
+
+    if (!db_pool_submit(run_state->db_pool, &run_state->request))
     {
         CXN_LOG(run_state, LOG_ERR,
                 "couldn't add new request to request queue");
@@ -571,8 +641,6 @@ static void add_db_request(
     }
 
     run_state->state = RESPONDING;
-
-    increment_db_semaphore(run_state);
 }
 
 static void push_to_process_queue(
@@ -665,6 +733,64 @@ static void handle_pdu(
     }
 }
 
+static void count_received_pdu(
+    struct run_state *run_state,
+    const PDU * pdu)
+{
+    metrics_add(&run_state->metrics->pdus_received, 1);
+    metrics_add(&run_state->session_metrics.pdus_received, 1);
+
+    if (pdu->pduType == PDU_SERIAL_QUERY)
+    {
+        metrics_add(&run_state->metrics->queries[METRICS_QUERY_SERIAL], 1);
+        metrics_add(&run_state->session_metrics.queries
+                    [METRICS_QUERY_SERIAL], 1);
+    }
+    else if (pdu->pduType == PDU_RESET_QUERY)
+    {
+        metrics_add(&run_state->metrics->queries[METRICS_QUERY_RESET], 1);
+        metrics_add(&run_state->session_metrics.queries
+                    [METRICS_QUERY_RESET], 1);
+    }
+}
+
+/**
+    Use the version of the first PDU from the router for the rest of the
+    session, and reject any PDU with a different version after that.
+*/
+static void negotiate_version(
+    struct run_state *run_state)
+{
+    uint8_t version = run_state->recv_pdu.protocolVersion;
+
+    if (!run_state->version_negotiated)
+    {
+        run_state->protocol_version = version;
+        run_state->version_negotiated = true;
+        __atomic_store_n(&run_state->session_metrics.protocol_version,
+                         version, __ATOMIC_RELAXED);
+        CXN_LOG(run_state, LOG_INFO, "using protocol version %" PRIu8,
+                version);
+        return;
+    }
+
+    if (version == run_state->protocol_version)
+    {
+        return;
+    }
+
+    CXN_LOG(run_state, LOG_NOTICE,
+            "received PDU with protocol version %" PRIu8
+            " after negotiating version %" PRIu8, version,
+            run_state->protocol_version);
+    send_error(run_state,
+               run_state->protocol_version >= RTR_PROTOCOL_VERSION_1 ?
+               ERR_UNEXPECTED_VERSION : ERR_UNSUPPORTED_VERSION,
+               run_state->pdu_recv_buffer, run_state->pdu_recv_buffer_length,
+               ERROR_TEXT("unexpected protocol version"));
+    pthread_exit(NULL);
+}
+
 static void read_and_handle_pdu(
     struct run_state *run_state)
 {
@@ -676,6 +802,8 @@ static void read_and_handle_pdu(
         CXN_LOG(run_state, LOG_NOTICE,
                 "received a PDU with unsupported feature(s)");
     case PDU_GOOD:
+        count_received_pdu(run_state, &run_state->recv_pdu);
+        negotiate_version(run_state);
         handle_pdu(run_state, &run_state->recv_pdu, true);
         break;
     default:
@@ -709,12 +837,32 @@ static void update_local_cache_state(
         run_state->local_cache_state.serial_number =
             new_cache_state->serial_number;
         run_state->local_cache_state.data_available = true;
-        if (do_notify)
+        if (do_notify && run_state->version_negotiated)
             send_notify(run_state);
     }
 }
 
 
+/**
+    Convert a PDU from a db thread, which is always version 0, to the
+    negotiated version.
+*/
+static void set_response_version(
+    struct run_state *run_state,
+    PDU * pdu)
+{
+    if (pdu->pduType == PDU_END_OF_DATA &&
+        run_state->protocol_version >= RTR_PROTOCOL_VERSION_1)
+    {
+        fill_pdu_end_of_data_v1(pdu, pdu->sessionId, pdu->serialNumber,
+                                run_state->refresh_interval,
+                                run_state->retry_interval,
+                                run_state->expire_interval);
+    }
+
+    pdu->protocolVersion = run_state->protocol_version;
+}
+
 static void handle_response(
     struct run_state *run_state)
 {
@@ -730,7 +878,7 @@ static void handle_response(
 
     if (!run_state->response->is_done)
     {
-        increment_db_semaphore(run_state);
+        db_request_resume(run_state->db_pool, &run_state->request);
     }
 
     for (i = 0; i < run_state->response->num_PDUs; ++i)
@@ -769,6 +917,8 @@ static void handle_response(
             used_pdu_request_buffer = true;
         }
 
+        set_response_version(run_state, &run_state->response->PDUs[i]);
+
         send_pdu(run_state, &run_state->response->PDUs[i]);
 
         if (used_pdu_request_buffer)
@@ -790,7 +940,21 @@ static void handle_response(
 
     if (is_done)
     {
+        metrics_observe(&run_state->metrics->end_of_data
+                        [run_state->request.query.type == SERIAL_QUERY ?
+                         METRICS_QUERY_SERIAL : METRICS_QUERY_RESET],
+                        metrics_elapsed_usec(&run_state->request_start));
+
+        release_request_generation(run_state);
+
         run_state->state = READY;
+        if (run_state->cache_state_check_pending)
+        {
+            // connection_main_loop() checks it as soon as this is READY,
+            // i.e. when this returns or after the response to a queued PDU
+            run_state->cache_state_check_pending = false;
+            run_state->next_cache_state_check_time.tv_sec = time(NULL);
+        }
         while (run_state->state == READY &&
                !stop_after_responding &&
                Queue_trypop(run_state->to_process_queue,
@@ -822,6 +986,18 @@ static void check_global_cache_state(
         pthread_exit(NULL);
     }
 
+    if (time(NULL) < run_state->next_notify_time)
+    {
+        // Too soon to send another Serial Notify, check again as soon as
+        // it's allowed.
+        run_state->next_cache_state_check_time.tv_sec =
+            run_state->next_notify_time;
+        return;
+    }
+
+    run_state->next_cache_state_check_time.tv_sec =
+        time(NULL) + CXN_CACHE_STATE_INTERVAL;
+
     copy_cache_state(run_state, &tmp_cache_state);
 
     update_local_cache_state(run_state, &tmp_cache_state, true);
@@ -889,9 +1065,10 @@ static void cleanup(
 
     if (run_state->state == RESPONDING)
     {
-        run_state->request.cancel_request = true;
+        __atomic_store_n(&run_state->request.cancel_request, true,
+                         __ATOMIC_SEQ_CST);
 
-        increment_db_semaphore(run_state);
+        db_request_resume(run_state->db_pool, &run_state->request);
 
         while (true)
         {
@@ -902,7 +1079,7 @@ static void cleanup(
                 break;
             }
 
-            if (!Queue_trypop
+            if (!SpscQueue_trypop
                 (run_state->db_response_queue, (void **)&run_state->response))
                 continue;
 
@@ -915,6 +1092,9 @@ static void cleanup(
             if (run_state->response->is_done)
             {
                 free((void *)run_state->response);
+
+                // the db thread is done with the request
+                release_request_generation(run_state);
                 break;
             }
 
@@ -922,8 +1102,26 @@ static void cleanup(
         }
         run_state->response = NULL;
     }
+    else
+    {
+        // no db thread has the request
+        release_request_generation(run_state);
+    }
 
-    Queue_free(run_state->db_response_queue);
+    if (run_state->subscribed)
+    {
+        unsubscribe_cache_state(run_state->global_cache_state,
+                                run_state->semaphore);
+        run_state->subscribed = false;
+    }
+
+    if (run_state->session_metrics_started)
+    {
+        metrics_session_end(run_state->metrics, &run_state->session_metrics);
+        run_state->session_metrics_started = false;
+    }
+
+    SpscQueue_free(run_state->db_response_queue);
     run_state->db_response_queue = NULL;
 
     if (run_state->pdup != NULL)
@@ -946,7 +1144,8 @@ static void cleanup(
 static void initialize_data_structures_in_run_state(
     struct run_state *run_state)
 {
-    run_state->db_response_queue = Queue_new(true);
+    run_state->db_response_queue =
+        SpscQueue_new(DB_RESPONSE_BUFFER_LENGTH + 1);
     if (run_state->db_response_queue == NULL)
     {
         CXN_LOG(run_state, LOG_ERR, "can't create db response queue");
@@ -959,11 +1158,31 @@ static void initialize_data_structures_in_run_state(
         CXN_LOG(run_state, LOG_ERR, "can't create to-process queue");
         pthread_exit(NULL);
     }
+
+    if (!subscribe_cache_state(run_state->global_cache_state,
+                               run_state->semaphore))
+    {
+        CXN_LOG(run_state, LOG_ERR,
+                "can't subscribe to global cache state changes");
+        pthread_exit(NULL);
+    }
+    run_state->subscribed = true;
+
+    if (!metrics_session_start(run_state->metrics,
+                               &run_state->session_metrics, run_state->host,
+                               run_state->serv))
+    {
+        CXN_LOG(run_state, LOG_ERR, "can't add session to metrics");
+        pthread_exit(NULL);
+    }
+    run_state->session_metrics_started = true;
 }
 
 static void connection_main_loop(
     struct run_state *run_state)
 {
+    bool woken_for_cache_state = false;
+
     if (!wait_on_semaphore(run_state, true))
         pthread_exit(NULL);
 
@@ -974,14 +1193,27 @@ static void connection_main_loop(
         read_and_handle_pdu(run_state);
     }
     else if (run_state->state == RESPONDING &&
-             Queue_trypop(run_state->db_response_queue,
-                          (void **)&run_state->response))
+             SpscQueue_trypop(run_state->db_response_queue,
+                              (void **)&run_state->response))
     {
         handle_response(run_state);
     }
+    else if (run_state->state == RESPONDING)
+    {
+        // A broadcast of a new global cache state, which can't be acted on
+        // until the response is done. See handle_response().
+        run_state->cache_state_check_pending = true;
+    }
+    else
+    {
+        // Nothing from the router or the db threads, so this is either a
+        // timeout or a broadcast of a new global cache state.
+        woken_for_cache_state = true;
+    }
 
     if (run_state->state == READY &&
-        time(NULL) >= run_state->next_cache_state_check_time.tv_sec)
+        (woken_for_cache_state ||
+         time(NULL) >= run_state->next_cache_state_check_time.tv_sec))
     {
         check_global_cache_state(run_state);
     }
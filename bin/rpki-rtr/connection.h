@@ -8,6 +8,8 @@
 #include "util/queue.h"
 
 #include "cache_state.h"
+#include "db.h"
+#include "metrics.h"
 #include "semaphores.h"
 
 
@@ -19,9 +21,9 @@ struct connection_main_args {
     const char *host;
     const char *serv;
     cxn_semaphore_t *semaphore;
-    Queue *db_request_queue;
-    db_semaphore_t *db_semaphore;
+    struct db_pool *db_pool;
     struct global_cache_state *global_cache_state;
+    struct metrics *metrics;
 };
 void *connection_main(
     void *args_voidp);
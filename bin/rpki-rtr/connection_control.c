@@ -34,10 +34,6 @@ struct connection_info {
 };
 
 
-// this is ok because there's only one connection control thread
-static char errorbuf[ERROR_BUF_SIZE];
-
-
 static void kill_connection(
     struct connection_info *cxn_info)
 {
@@ -48,7 +44,7 @@ static void kill_connection(
     retval1 = pthread_cancel(cxn_info->thread);
     if (retval1 != 0 && retval1 != ESRCH)
     {
-        ERR_LOG(retval1, errorbuf, "pthread_cancel()");
+        ERR_LOG(retval1, NULL, "pthread_cancel()");
     }
 }
 
@@ -63,16 +59,16 @@ static void cleanup_connection(
     {
         retval1 = pthread_join(cxn_info->thread, NULL);
         if (retval1 != 0)
-            ERR_LOG(retval1, errorbuf, "pthread_join()");
+            ERR_LOG(retval1, NULL, "pthread_join()");
     }
 
     retval1 = close(cxn_info->fd);
     if (retval1 != 0)
-        ERR_LOG(errno, errorbuf, "close()");
+        ERR_LOG(errno, NULL, "close()");
 
     retval1 = semcompat_free(cxn_info->semaphore);
     if (retval1 != 0)
-        ERR_LOG(errno, errorbuf, "semcompat_free()");
+        ERR_LOG(errno, NULL, "semcompat_free()");
 
     free((void *)cxn_info);
 }
@@ -144,7 +140,7 @@ void *connection_control_main(
     {
         if (fcntl(argsp->listen_fds[i], F_SETFL, O_NONBLOCK) != 0)
         {
-            ERR_LOG(errno, errorbuf, "fcntl() to make listen_fd nonblocking");
+            ERR_LOG(errno, NULL, "fcntl() to make listen_fd nonblocking");
         }
     }
 
@@ -172,7 +168,7 @@ void *connection_control_main(
     retval = pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &oldstate);
     if (retval != 0)
     {
-        ERR_LOG(retval, errorbuf, "pthread_setcancelstate()");
+        ERR_LOG(retval, NULL, "pthread_setcancelstate()");
     }
 
     while (true)
@@ -223,7 +219,7 @@ void *connection_control_main(
         retval = pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &oldstate);
         if (retval != 0)
         {
-            ERR_LOG(retval, errorbuf, "pthread_setcancelstate()");
+            ERR_LOG(retval, NULL, "pthread_setcancelstate()");
         }
 
         // One the thread has started in the loop, this is the only
@@ -240,12 +236,12 @@ void *connection_control_main(
         retval2 = pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &oldstate);
         if (retval2 != 0)
         {
-            ERR_LOG(retval2, errorbuf, "pthread_setcancelstate()");
+            ERR_LOG(retval2, NULL, "pthread_setcancelstate()");
         }
 
         if (retval < 0)
         {
-            ERR_LOG(errno, errorbuf, "select()");
+            ERR_LOG(errno, NULL, "select()");
             continue;
         }
         else if (retval == 0)
@@ -275,7 +271,7 @@ void *connection_control_main(
             {
                 if (sem_post(cxn_info->semaphore) != 0)
                 {
-                    ERR_LOG(errno, errorbuf, "sem_post()");
+                    ERR_LOG(errno, NULL, "sem_post()");
                     kill_connection(cxn_info);
                     cleanup_connection(cxn_info);
                     connections_it = Bag_erase(connections, connections_it);
@@ -305,7 +301,7 @@ void *connection_control_main(
             cxn_info->semaphore = semcompat_new(0, 0);
             if (cxn_info->semaphore == SEM_FAILED)
             {
-                ERR_LOG(errno, errorbuf, "semcompat_new()");
+                ERR_LOG(errno, NULL, "semcompat_new()");
                 free((void *)cxn_info);
                 continue;
             }
@@ -316,10 +312,10 @@ void *connection_control_main(
                                   &cxn_info->addr_len);
             if (cxn_info->fd < 0)
             {
-                ERR_LOG(errno, errorbuf, "accept()");
+                ERR_LOG(errno, NULL, "accept()");
                 if (semcompat_free(cxn_info->semaphore) != 0)
                 {
-                    ERR_LOG(errno, errorbuf, "semcompat_free()");
+                    ERR_LOG(errno, NULL, "semcompat_free()");
                 }
                 free((void *)cxn_info);
                 continue;
@@ -357,16 +353,16 @@ void *connection_control_main(
             connection_args->host = cxn_info->host;
             connection_args->serv = cxn_info->serv;
             connection_args->semaphore = cxn_info->semaphore;
-            connection_args->db_request_queue = argsp->db_request_queue;
-            connection_args->db_semaphore = argsp->db_semaphore;
+            connection_args->db_pool = argsp->db_pool;
             connection_args->global_cache_state = argsp->global_cache_state;
+            connection_args->metrics = argsp->metrics;
 
             retval =
                 pthread_create(&cxn_info->thread, NULL, connection_main,
                                (void *)connection_args);
             if (retval != 0)
             {
-                ERR_LOG(retval, errorbuf, "pthread_create()");
+                ERR_LOG(retval, NULL, "pthread_create()");
                 free((void *)connection_args);
                 cleanup_connection(cxn_info);
                 continue;
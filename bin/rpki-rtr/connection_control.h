@@ -10,9 +10,9 @@
 struct connection_control_main_args {
     const int *listen_fds;
     size_t num_listen_fds;
-    Queue *db_request_queue;
-    db_semaphore_t *db_semaphore;
+    struct db_pool *db_pool;
     struct global_cache_state *global_cache_state;
+    struct metrics *metrics;
 };
 void *connection_control_main(
     void *args_voidp);
@@ -2,6 +2,10 @@
 
 #include <pthread.h>
 #include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <netinet/in.h>
 
 #include "util/macros.h"
 #include "util/logging.h"
@@ -12,31 +16,123 @@
 #include "signals.h"
 
 
-struct db_request_state {
-    struct db_request *request;
-    void *query_state;
+/*
+ * Reset Queries for a cache generation with a snapshot are answered
+ * directly from the memory-mapped snapshot, without touching the database.
+ */
+
+struct snapshot_query_state {
+    size_t next_record;
+    bool data_sent;
 };
 
-static void initialize_request_state(
-    struct db_request_state *rq,
-    struct db_request *request)
+static int snapshot_query_init(
+    void **query_state)
 {
-    rq->request = request;
-    rq->query_state = NULL;
+    struct snapshot_query_state *state =
+        malloc(sizeof(struct snapshot_query_state));
+
+    if (state == NULL)
+    {
+        LOG(LOG_ERR, "can't allocate memory for snapshot query state");
+        return -1;
+    }
+
+    state->next_record = 0;
+    state->data_sent = false;
+
+    *query_state = (void *)state;
+    return 0;
+}
+
+static ssize_t snapshot_query_get_next(
+    const struct cache_generation *generation,
+    void *query_state,
+    size_t max_rows,
+    PDU ** _pdus,
+    bool * is_done)
+{
+    struct snapshot_query_state *state =
+        (struct snapshot_query_state *)query_state;
+    const struct vrp_file *snapshot = &generation->snapshot;
+    size_t num_records = vrp_file_count(snapshot);
+    size_t num_pdus = 0;
+    PDU *pdus;
+    struct vrp vrp;
+    struct in_addr in_addr;
+    struct in6_addr in6_addr;
+
+    *is_done = true;
+
+    if (max_rows < 2)
+    {
+        LOG(LOG_ERR, "max_rows too small");
+        return -1;
+    }
+
+    pdus = calloc(max_rows, sizeof(PDU));
+    if (pdus == NULL)
+    {
+        LOG(LOG_ERR, "can't allocate memory for array of PDU");
+        return -1;
+    }
+    *_pdus = pdus;
+
+    if (!state->data_sent)
+    {
+        fill_pdu_cache_response(&pdus[num_pdus++],
+                                generation->cache_state.session);
+        state->data_sent = true;
+    }
+
+    while (num_pdus < max_rows && state->next_record < num_records)
+    {
+        vrp_file_get(snapshot, state->next_record++, &vrp, NULL);
+
+        if (vrp.family_length == 4)
+        {
+            memcpy(&in_addr.s_addr, vrp.prefix, vrp.family_length);
+            fill_pdu_ipv4_prefix(&pdus[num_pdus++], FLAG_WITHDRAW_ANNOUNCE,
+                                 vrp.prefix_length, vrp.max_length,
+                                 &in_addr, vrp.asn);
+        }
+        else
+        {
+            memcpy(&in6_addr.s6_addr, vrp.prefix, vrp.family_length);
+            fill_pdu_ipv6_prefix(&pdus[num_pdus++], FLAG_WITHDRAW_ANNOUNCE,
+                                 vrp.prefix_length, vrp.max_length,
+                                 &in6_addr, vrp.asn);
+        }
+    }
+
+    if (num_pdus == max_rows)
+    {
+        *is_done = false;
+        return num_pdus;
+    }
+
+    fill_pdu_end_of_data(&pdus[num_pdus++], generation->cache_state.session,
+                         generation->cache_state.serial_number);
+    return num_pdus;
 }
 
+
 static int start_query(
-    struct db_request_state *rq,
+    struct db_request *request,
     dbconn * db)
 {
-    switch (rq->request->query.type)
+    switch (request->query.type)
     {
     case SERIAL_QUERY:
-        return db_rtr_serial_query_init(db, &rq->query_state,
-                                        rq->request->query.serial_query.
-                                        serial);
+        return db_rtr_serial_query_init(db, &request->query_state,
+                                        request->query.serial_query.serial);
     case RESET_QUERY:
-        return db_rtr_reset_query_init(db, &rq->query_state);
+        if (request->generation != NULL && request->generation->has_snapshot)
+        {
+            request->from_snapshot = true;
+            return snapshot_query_init(&request->query_state);
+        }
+        return db_rtr_reset_query_init(db, &request->query_state);
     default:
         LOG(LOG_ERR, "got unexpected query type");
         return -1;              // TODO: check if this is a good error code
@@ -44,19 +140,25 @@ static int start_query(
 }
 
 static ssize_t query_get_next(
-    struct db_request_state *rq,
+    struct db_request *request,
     dbconn * db,
     size_t num_rows,
     PDU ** pdus,
     bool * is_done)
 {
-    switch (rq->request->query.type)
+    switch (request->query.type)
     {
     case SERIAL_QUERY:
-        return db_rtr_serial_query_get_next(db, rq->query_state,
+        return db_rtr_serial_query_get_next(db, request->query_state,
                                             num_rows, pdus, is_done);
     case RESET_QUERY:
-        return db_rtr_reset_query_get_next(db, rq->query_state,
+        if (request->from_snapshot)
+        {
+            return snapshot_query_get_next(request->generation,
+                                           request->query_state, num_rows,
+                                           pdus, is_done);
+        }
+        return db_rtr_reset_query_get_next(db, request->query_state,
                                            num_rows, pdus, is_done);
     default:
         LOG(LOG_ERR, "got unexpected query type");
@@ -66,38 +168,178 @@ static ssize_t query_get_next(
 }
 
 static void stop_query(
-    struct db_request_state *rq,
+    struct db_request *request,
     dbconn * db)
 {
-    if (rq->query_state != NULL)
+    if (request->query_state != NULL)
     {
-        switch (rq->request->query.type)
+        switch (request->query.type)
         {
         case SERIAL_QUERY:
-            db_rtr_serial_query_close(db, rq->query_state);
+            db_rtr_serial_query_close(db, request->query_state);
             break;
         case RESET_QUERY:
-            db_rtr_reset_query_close(db, rq->query_state);
+            if (request->from_snapshot)
+                free(request->query_state);
+            else
+                db_rtr_reset_query_close(db, request->query_state);
             break;
         default:
             LOG(LOG_ERR, "got unexpected query type");
             break;
         }
-        rq->query_state = NULL;
+        request->query_state = NULL;
+    }
+}
+
+
+struct db_worker {
+    struct db_pool *pool;
+    size_t index;
+
+    // status and thread are protected by pool->mutex
+    enum {
+        WORKER_UNUSED,          // no thread
+        WORKER_RUNNING,         // thread is running
+        WORKER_EXITED,          // thread exited (or is exiting) on its own
+                                // and needs to be joined
+    } status;
+    pthread_t thread;
+
+    // Requests that this worker started servicing, in the order they should
+    // be serviced next. This worker takes from the front, other workers
+    // steal from the back. Unlike the status, the deque outlives the thread:
+    // requests left in it when the thread exits are stolen by other threads.
+    pthread_mutex_t deque_mutex;
+    struct db_request **deque;
+    size_t deque_capacity;
+    size_t deque_head;
+    size_t deque_length;
+};
+
+
+static void lock_mutex(
+    pthread_mutex_t *mutex)
+{
+    int retval = pthread_mutex_lock(mutex);
+    if (retval != 0)
+    {
+        ERR_LOG(retval, NULL, "pthread_mutex_lock()");
+    }
+}
+
+static void unlock_mutex(
+    pthread_mutex_t *mutex)
+{
+    int retval = pthread_mutex_unlock(mutex);
+    if (retval != 0)
+    {
+        ERR_LOG(retval, NULL, "pthread_mutex_unlock()");
+    }
+}
+
+
+static bool deque_push_back(
+    struct db_worker *worker,
+    struct db_request *request)
+{
+    struct db_request **new_deque;
+    size_t new_capacity;
+    size_t i;
+
+    lock_mutex(&worker->deque_mutex);
+
+    if (worker->deque_length == worker->deque_capacity)
+    {
+        new_capacity = (worker->deque_capacity == 0 ?
+                        DB_DEQUE_INITIAL_CAPACITY :
+                        2 * worker->deque_capacity);
+        new_deque = malloc(new_capacity * sizeof(struct db_request *));
+        if (new_deque == NULL)
+        {
+            unlock_mutex(&worker->deque_mutex);
+            LOG(LOG_ERR, "can't allocate memory for db thread's deque");
+            return false;
+        }
+
+        for (i = 0; i < worker->deque_length; ++i)
+        {
+            new_deque[i] = worker->deque[(worker->deque_head + i) %
+                                         worker->deque_capacity];
+        }
+
+        free(worker->deque);
+        worker->deque = new_deque;
+        worker->deque_capacity = new_capacity;
+        worker->deque_head = 0;
+    }
+
+    worker->deque[(worker->deque_head + worker->deque_length) %
+                  worker->deque_capacity] = request;
+    ++worker->deque_length;
+
+    unlock_mutex(&worker->deque_mutex);
+
+    return true;
+}
+
+static struct db_request *deque_pop_front(
+    struct db_worker *worker)
+{
+    struct db_request *request = NULL;
+
+    lock_mutex(&worker->deque_mutex);
+
+    if (worker->deque_length > 0)
+    {
+        request = worker->deque[worker->deque_head];
+        worker->deque_head = (worker->deque_head + 1) % worker->deque_capacity;
+        --worker->deque_length;
+    }
+
+    unlock_mutex(&worker->deque_mutex);
+
+    return request;
+}
+
+static struct db_request *deque_pop_back(
+    struct db_worker *worker)
+{
+    struct db_request *request = NULL;
+
+    lock_mutex(&worker->deque_mutex);
+
+    if (worker->deque_length > 0)
+    {
+        --worker->deque_length;
+        request = worker->deque[(worker->deque_head + worker->deque_length) %
+                                worker->deque_capacity];
+    }
+
+    unlock_mutex(&worker->deque_mutex);
+
+    return request;
+}
+
+
+static void post_semaphore(
+    struct db_pool *pool)
+{
+    if (sem_post(pool->semaphore) != 0)
+    {
+        ERR_LOG(errno, NULL, "sem_post()");
     }
 }
 
 
 struct run_state {
-    db_semaphore_t *semaphore;
-    Queue *db_request_queue;
-    Bag *db_currently_processing;
+    struct db_pool *pool;
+    struct db_worker *worker;
     dbconn *db;
 
     char errorbuf[ERROR_BUF_SIZE];
 
     struct db_request *request;
-    struct db_request_state *request_state;
 
     struct db_response *response;
 };
@@ -106,24 +348,19 @@ static void initialize_run_state(
     struct run_state *run_state,
     void *args_voidp)
 {
-    const struct db_main_args *args = (const struct db_main_args *)args_voidp;
+    struct db_worker *worker = (struct db_worker *)args_voidp;
 
-    if (args == NULL ||
-        args->semaphore == NULL ||
-        args->db_request_queue == NULL ||
-        args->db_currently_processing == NULL)
+    if (worker == NULL || worker->pool == NULL)
     {
         LOG(LOG_ERR, "db thread called with NULL argument");
         pthread_exit(NULL);
     }
 
-    run_state->semaphore = args->semaphore;
-    run_state->db_request_queue = args->db_request_queue;
-    run_state->db_currently_processing = args->db_currently_processing;
+    run_state->pool = worker->pool;
+    run_state->worker = worker;
     run_state->db = NULL;
 
     run_state->request = NULL;
-    run_state->request_state = NULL;
 
     run_state->response = NULL;
 }
@@ -161,17 +398,16 @@ static void allocate_response(
 static void send_response(
     struct run_state *run_state)
 {
-    if (!Queue_push
-        (run_state->request_state->request->response_queue,
-         (void *)run_state->response))
+    if (!SpscQueue_trypush
+        (run_state->request->response_queue, (void *)run_state->response))
     {
-        LOG(LOG_ERR, "can't push response to queue");
+        LOG(LOG_ERR, "can't push response to full queue");
         pthread_exit(NULL);
     }
 
     run_state->response = NULL;
 
-    if (sem_post(run_state->request_state->request->response_semaphore) != 0)
+    if (sem_post(run_state->request->response_semaphore) != 0)
     {
         ERR_LOG(errno, run_state->errorbuf, "sem_post()");
     }
@@ -194,7 +430,8 @@ static void send_error(
 
     run_state->response->is_done = true;
 
-    run_state->response->PDUs[0].protocolVersion = RTR_PROTOCOL_VERSION;
+    // the connection thread sets the negotiated version before sending
+    run_state->response->PDUs[0].protocolVersion = RTR_PROTOCOL_VERSION_0;
     run_state->response->PDUs[0].pduType = PDU_ERROR_REPORT;
     run_state->response->PDUs[0].errorCode = error_code;
     run_state->response->PDUs[0].length =
@@ -208,47 +445,154 @@ static void send_error(
 }
 
 
-static void wait_on_semaphore(
+/**
+	Wait up to DB_THREAD_IDLE_TIMEOUT seconds for a request to be ready.
+
+	@return True if a request is ready, false otherwise.
+*/
+static bool wait_on_semaphore(
     struct run_state *run_state)
 {
-    if (sem_wait(run_state->semaphore) != 0)
+    struct timespec abs_timeout;
+    int retval;
+    int err;
+
+    if (clock_gettime(CLOCK_REALTIME, &abs_timeout) != 0)
+    {
+        ERR_LOG(errno, run_state->errorbuf, "clock_gettime()");
+        pthread_exit(NULL);
+    }
+    abs_timeout.tv_sec += DB_THREAD_IDLE_TIMEOUT;
+
+    __atomic_add_fetch(&run_state->pool->num_idle, 1, __ATOMIC_SEQ_CST);
+    retval = sem_timedwait(run_state->pool->semaphore, &abs_timeout);
+    err = errno;
+    __atomic_sub_fetch(&run_state->pool->num_idle, 1, __ATOMIC_SEQ_CST);
+
+    if (retval == 0)
+    {
+        return true;
+    }
+    else if (err == ETIMEDOUT || err == EINTR)
     {
-        ERR_LOG(errno, run_state->errorbuf, "sem_wait()");
+        return false;
+    }
+    else
+    {
+        ERR_LOG(err, run_state->errorbuf, "sem_timedwait()");
         pthread_exit(NULL);
     }
 }
 
 
+// Returns NULL if there are no requests to service.
+static struct db_request *take_request(
+    struct run_state *run_state)
+{
+    struct db_pool *pool = run_state->pool;
+    struct db_request *request;
+    size_t i;
+
+    // New requests come first, so that a small Serial Query doesn't wait
+    // behind every step of every Reset Query that's already in progress.
+    if (MpmcQueue_trypop(pool->request_queue, (void **)&request))
+    {
+        return request;
+    }
+
+    request = deque_pop_front(run_state->worker);
+    if (request != NULL)
+    {
+        return request;
+    }
+
+    for (i = 1; i < pool->max_threads; ++i)
+    {
+        request = deque_pop_back(&pool->workers[(run_state->worker->index + i)
+                                                % pool->max_threads]);
+        if (request != NULL)
+        {
+            return request;
+        }
+    }
+
+    return NULL;
+}
+
+
+static bool response_queue_has_room(
+    struct db_request *request)
+{
+    return __atomic_load_n(&request->cancel_request, __ATOMIC_SEQ_CST) ||
+        SpscQueue_size(request->response_queue) < DB_RESPONSE_BUFFER_LENGTH;
+}
+
+/**
+	Put run_state->request at the back of this thread's deque, or park it
+	if its response queue is full.
+*/
+static void requeue_request(
+    struct run_state *run_state)
+{
+    struct db_request *request = run_state->request;
+
+    if (!response_queue_has_room(request))
+    {
+        __atomic_store_n(&request->parked, true, __ATOMIC_SEQ_CST);
+
+        /*
+         * The cxn thread might have made room after the check above but
+         * before it could see that the request is parked, so check again.
+         * If there's room now, whichever of this thread or the cxn thread
+         * unparks the request first is responsible for requeueing it.
+         */
+        if (!response_queue_has_room(request) ||
+            !__atomic_exchange_n(&request->parked, false, __ATOMIC_SEQ_CST))
+        {
+            return;
+        }
+    }
+
+    if (!deque_push_back(run_state->worker, request))
+    {
+        stop_query(request, run_state->db);
+        send_error(run_state, ERR_INTERNAL_ERROR);
+        return;
+    }
+
+    post_semaphore(run_state->pool);
+}
+
+
 /**
-	Service run_state->request_state for exactly one step.
+	Service run_state->request for exactly one step.
 
-	If the request can't be finished, request_state gets put (back) in db_currently_processing.
+	If the request can't be finished, it gets requeued with
+	requeue_request().
 */
 static void service_request(
-    struct run_state *run_state,
-    bool is_new_request)
+    struct run_state *run_state)
 {
-    if (run_state->request_state->request->cancel_request)
+    struct db_request *request = run_state->request;
+
+    if (__atomic_load_n(&request->cancel_request, __ATOMIC_SEQ_CST))
     {
-        stop_query(run_state->request_state, run_state->db);
+        stop_query(request, run_state->db);
 
         send_empty_response(run_state);
-
-        free(run_state->request_state);
-        run_state->request_state = NULL;
         return;
     }
 
-    if (is_new_request)
+    if (!request->started)
     {
-        int retval = start_query(run_state->request_state, run_state->db);
+        request->started = true;
+
+        int retval = start_query(request, run_state->db);
         // TODO: check for specific error codes
         if (retval != 0)
         {
             LOG(LOG_ERR, "error in start_query (error code %d)", retval);
             send_error(run_state, ERR_INTERNAL_ERROR);
-            free(run_state->request_state);
-            run_state->request_state = NULL;
             return;
         }
     }
@@ -256,11 +600,24 @@ static void service_request(
     allocate_response(run_state, 0);    // 0 because query_get_next() will
                                         // allocate the PDUs
 
+    struct timespec step_start;
+    if (clock_gettime(CLOCK_MONOTONIC, &step_start) != 0)
+    {
+        ERR_LOG(errno, run_state->errorbuf, "clock_gettime()");
+    }
+
     bool is_done;
-    ssize_t retval = query_get_next(run_state->request_state, run_state->db,
+    ssize_t retval = query_get_next(request, run_state->db,
                                     DB_ROWS_PER_RESPONSE,
                                     &run_state->response->PDUs, &is_done);
 
+    metrics_observe(&run_state->pool->metrics->db_step
+                    [request->query.type == SERIAL_QUERY ?
+                     METRICS_QUERY_SERIAL : METRICS_QUERY_RESET]
+                    [request->from_snapshot ?
+                     METRICS_SOURCE_SNAPSHOT : METRICS_SOURCE_DATABASE],
+                    metrics_elapsed_usec(&step_start));
+
     if (retval < 0)
     {
         is_done = true;         // TODO: handle non-fatal errors?
@@ -275,7 +632,7 @@ static void service_request(
 
     if (is_done || retval < 0)
     {
-        stop_query(run_state->request_state, run_state->db);
+        stop_query(request, run_state->db);
     }
 
     if (retval < 0)
@@ -283,165 +640,17 @@ static void service_request(
         // TODO: check for specific error codes
         LOG(LOG_ERR, "error in query_get_next (error code %zd)", retval);
         send_error(run_state, ERR_INTERNAL_ERROR);
-        free(run_state->request_state);
-        run_state->request_state = NULL;
         return;
     }
 
+    // NOTE: once a response that is done is sent, the cxn thread may reuse
+    // or free the request, so it must not be accessed after this.
     send_response(run_state);
 
-    if (is_done)
-    {
-        free(run_state->request_state);
-        run_state->request_state = NULL;
-    }
-    else
-    {
-        if (!Bag_add
-            (run_state->db_currently_processing,
-             (void *)run_state->request_state))
-        {
-            LOG(LOG_ERR,
-                "can't add a request state to the currently processing bag");
-            stop_query(run_state->request_state, run_state->db);
-            send_error(run_state, ERR_INTERNAL_ERROR);
-            free(run_state->request_state);
-            run_state->request_state = NULL;
-            return;
-        }
-
-        run_state->request_state = NULL;
-
-        /*
-         * NOTE: after putting the request back in db_currently_processing
-         * db_semaphore should be incremented to prevent problems in the below
-         * case:
-         *
-         * 1. DB Thread 1: take CXN Thread 1's request out of
-         * db_currently_processing and start servicing it 2. CXN Thread 1:
-         * take a previous response out if its response queue and increment
-         * db_semaphore 3. DB Thread 2: decrement db_semaphore, do nothing
-         * because it can't see CXN Thread 1's request because DB Thread 1 has
-         * it 4. DB Thread 1: finish servicing CXN Thread 1's request and put
-         * it back in db_currently_processing
-         */
-
-        if (sem_post(run_state->semaphore) != 0)
-        {
-            ERR_LOG(errno, run_state->errorbuf, "sem_post()");
-        }
-    }
-}
-
-
-// Postcondition: run_state->request_state is non-NULL iff there is a request
-// to service
-static void find_existing_request_to_service(
-    struct run_state *run_state)
-{
-    Bag_iterator it;
-    bool did_erase;
-
-    if (!Bag_start_iteration(run_state->db_currently_processing))
-    {
-        LOG(LOG_ERR,
-            "error in Bag_start_iteration(run_state->db_currently_processing)");
-        pthread_exit(NULL);
-    }
-    for (it = Bag_begin(run_state->db_currently_processing);
-         it != Bag_end(run_state->db_currently_processing);
-         (void)(did_erase
-                || (it =
-                    Bag_iterator_next(run_state->db_currently_processing,
-                                      it))))
-    {
-        did_erase = false;
-
-        run_state->request_state =
-            (struct db_request_state *)Bag_get(run_state->
-                                               db_currently_processing, it);
-
-        if (run_state->request_state == NULL)
-        {
-            LOG(LOG_ERR, "got NULL request state");
-            it = Bag_erase(run_state->db_currently_processing, it);
-            did_erase = true;
-            continue;
-        }
-
-        if (run_state->request_state->request->cancel_request ||
-            Queue_size(run_state->request_state->request->response_queue) <
-            DB_RESPONSE_BUFFER_LENGTH)
-        {
-            it = Bag_erase(run_state->db_currently_processing, it);
-            did_erase = true;
-            if (!Bag_stop_iteration(run_state->db_currently_processing))
-            {
-                LOG(LOG_ERR,
-                    "error in Bag_stop_iteration(run_state->db_currently_processing)");
-                pthread_exit(NULL);
-            }
-            return;
-        }
-    }
-    if (!Bag_stop_iteration(run_state->db_currently_processing))
+    if (!is_done)
     {
-        LOG(LOG_ERR,
-            "error in Bag_stop_iteration(run_state->db_currently_processing)");
-        pthread_exit(NULL);
+        requeue_request(run_state);
     }
-
-    // if control reaches here, there are no existing requests to service
-    run_state->request_state = NULL;
-}
-
-static bool try_service_existing_request(
-    struct run_state *run_state)
-{
-    find_existing_request_to_service(run_state);
-
-    if (run_state->request_state == NULL)
-    {
-        return false;
-    }
-    else
-    {
-        service_request(run_state, false);
-        return true;
-    }
-}
-
-
-static bool try_service_new_request(
-    struct run_state *run_state)
-{
-    if (!Queue_trypop
-        (run_state->db_request_queue, (void **)&run_state->request))
-        return false;
-
-    run_state->request_state = malloc(sizeof(struct db_request_state));
-    if (run_state->request_state == NULL)
-    {
-        LOG(LOG_ERR, "can't allocate memory for request state");
-        pthread_exit(NULL);
-    }
-
-    initialize_request_state(run_state->request_state, run_state->request);
-    run_state->request = NULL;
-
-    service_request(run_state, true);
-
-    return true;
-}
-
-
-static void try_service_request(
-    struct run_state *run_state)
-{
-    if (try_service_existing_request(run_state))
-        return;
-    if (try_service_new_request(run_state))
-        return;
 }
 
 
@@ -450,11 +659,11 @@ static void db_main_loop(
 {
     int retval,
         oldstate;
+    bool have_request;
 
-    wait_on_semaphore(run_state);
+    have_request = wait_on_semaphore(run_state);
 
-    if (run_state->request != NULL ||
-        run_state->request_state != NULL || run_state->response != NULL)
+    if (run_state->request != NULL || run_state->response != NULL)
     {
         LOG(LOG_ERR, "got non-NULL state variable that should be NULL");
         pthread_exit(NULL);
@@ -466,7 +675,46 @@ static void db_main_loop(
         ERR_LOG(retval, run_state->errorbuf, "pthread_setcancelstate()");
     }
 
-    try_service_request(run_state);
+    if (have_request)
+    {
+        run_state->request = take_request(run_state);
+        if (run_state->request == NULL)
+        {
+            /*
+             * The semaphore is only posted after a request is pushed, but
+             * MpmcQueue_trypop() can miss a request if another push that
+             * started earlier hasn't finished yet. Put the post back so the
+             * request isn't stranded, and let the push finish.
+             */
+            post_semaphore(run_state->pool);
+            sched_yield();
+        }
+        else
+        {
+            service_request(run_state);
+            run_state->request = NULL;
+        }
+    }
+    else
+    {
+        struct db_pool *pool = run_state->pool;
+        bool retire = false;
+
+        lock_mutex(&pool->mutex);
+        if (!pool->stopping && pool->num_threads > pool->min_threads)
+        {
+            run_state->worker->status = WORKER_EXITED;
+            --pool->num_threads;
+            retire = true;
+        }
+        unlock_mutex(&pool->mutex);
+
+        if (retire)
+        {
+            LOG(LOG_DEBUG, "stopping idle db thread");
+            pthread_exit(NULL);
+        }
+    }
 
     retval = pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &oldstate);
     if (retval != 0)
@@ -476,7 +724,6 @@ static void db_main_loop(
 }
 
 
-
 static void cleanup(
     void *run_state_voidp)
 {
@@ -490,15 +737,15 @@ static void cleanup(
     }
 
     /*
-     * Unfortunately there doesn't seem to be a better option for request,
-     * request_state, and response than letting their memory be potentially
-     * lost. This is mitigated by making the thread not cancelable when their
-     * values are non-null.
+     * Unfortunately there doesn't seem to be a better option for request
+     * and response than letting their memory be potentially lost. This is
+     * mitigated by making the thread not cancelable when their values are
+     * non-null.
      */
 }
 
 
-void *db_main(
+static void *db_main(
     void *args_voidp)
 {
     block_signals();
@@ -545,3 +792,321 @@ void *db_main(
 
     pthread_cleanup_pop(1);
 }
+
+
+// must be called with pool->mutex held
+static bool start_worker(
+    struct db_pool *pool,
+    struct db_worker *worker)
+{
+    int retval;
+
+    if (worker->status == WORKER_EXITED)
+    {
+        retval = pthread_join(worker->thread, NULL);
+        if (retval != 0)
+        {
+            ERR_LOG(retval, NULL, "pthread_join() for idle db thread");
+        }
+        worker->status = WORKER_UNUSED;
+    }
+
+    retval = pthread_create(&worker->thread, NULL, db_main, worker);
+    if (retval != 0)
+    {
+        ERR_LOG(retval, NULL, "pthread_create() for db thread");
+        return false;
+    }
+
+    worker->status = WORKER_RUNNING;
+    ++pool->num_threads;
+
+    return true;
+}
+
+// Start another thread if there are more requests waiting than idle threads.
+static void maybe_add_thread(
+    struct db_pool *pool)
+{
+    size_t i;
+    int retval,
+        oldstate;
+
+    if (MpmcQueue_size(pool->request_queue) <=
+        __atomic_load_n(&pool->num_idle, __ATOMIC_SEQ_CST))
+    {
+        return;
+    }
+
+    retval = pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &oldstate);
+    if (retval != 0)
+    {
+        ERR_LOG(retval, NULL, "pthread_setcancelstate()");
+    }
+
+    lock_mutex(&pool->mutex);
+
+    if (!pool->stopping && pool->num_threads < pool->max_threads)
+    {
+        for (i = 0; i < pool->max_threads; ++i)
+        {
+            if (pool->workers[i].status != WORKER_RUNNING)
+            {
+                if (start_worker(pool, &pool->workers[i]))
+                {
+                    LOG(LOG_DEBUG, "started db thread (%zu running)",
+                        pool->num_threads);
+                }
+                break;
+            }
+        }
+    }
+
+    unlock_mutex(&pool->mutex);
+
+    retval = pthread_setcancelstate(oldstate, &oldstate);
+    if (retval != 0)
+    {
+        ERR_LOG(retval, NULL, "pthread_setcancelstate()");
+    }
+}
+
+
+bool db_pool_init(
+    struct db_pool *pool,
+    size_t min_threads,
+    size_t max_threads,
+    struct metrics *metrics)
+{
+    size_t i;
+    int retval;
+
+    if (min_threads < 1 || max_threads < min_threads)
+    {
+        LOG(LOG_ERR, "invalid number of db threads: min %zu, max %zu",
+            min_threads, max_threads);
+        return false;
+    }
+
+    pool->min_threads = min_threads;
+    pool->max_threads = max_threads;
+    pool->num_threads = 0;
+    pool->stopping = false;
+    pool->num_idle = 0;
+    pool->metrics = metrics;
+
+    pool->semaphore = semcompat_new(0, 0);
+    if (pool->semaphore == SEM_FAILED)
+    {
+        ERR_LOG(errno, NULL, "semcompat_new() for db semaphore");
+        return false;
+    }
+
+    pool->request_queue = MpmcQueue_new(DB_REQUEST_QUEUE_LENGTH);
+    if (pool->request_queue == NULL)
+    {
+        LOG(LOG_ERR, "can't create db request queue");
+        semcompat_free(pool->semaphore);
+        return false;
+    }
+
+    retval = pthread_mutex_init(&pool->mutex, NULL);
+    if (retval != 0)
+    {
+        ERR_LOG(retval, NULL, "pthread_mutex_init()");
+        MpmcQueue_free(pool->request_queue);
+        semcompat_free(pool->semaphore);
+        return false;
+    }
+
+    pool->workers = calloc(max_threads, sizeof(struct db_worker));
+    if (pool->workers == NULL)
+    {
+        LOG(LOG_ERR, "can't allocate memory for db workers");
+        pthread_mutex_destroy(&pool->mutex);
+        MpmcQueue_free(pool->request_queue);
+        semcompat_free(pool->semaphore);
+        return false;
+    }
+
+    for (i = 0; i < max_threads; ++i)
+    {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        pool->workers[i].status = WORKER_UNUSED;
+        pool->workers[i].deque = NULL;
+        pool->workers[i].deque_capacity = 0;
+        pool->workers[i].deque_head = 0;
+        pool->workers[i].deque_length = 0;
+
+        retval = pthread_mutex_init(&pool->workers[i].deque_mutex, NULL);
+        if (retval != 0)
+        {
+            ERR_LOG(retval, NULL, "pthread_mutex_init()");
+            while (i-- > 0)
+            {
+                pthread_mutex_destroy(&pool->workers[i].deque_mutex);
+            }
+            free(pool->workers);
+            pthread_mutex_destroy(&pool->mutex);
+            MpmcQueue_free(pool->request_queue);
+            semcompat_free(pool->semaphore);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool db_pool_start(
+    struct db_pool *pool)
+{
+    size_t i;
+    bool ret = true;
+
+    lock_mutex(&pool->mutex);
+
+    for (i = 0; i < pool->min_threads; ++i)
+    {
+        if (!start_worker(pool, &pool->workers[i]))
+        {
+            ret = false;
+            break;
+        }
+    }
+
+    unlock_mutex(&pool->mutex);
+
+    return ret;
+}
+
+
+void db_pool_stop(
+    struct db_pool *pool)
+{
+    size_t i;
+    int retval;
+
+    lock_mutex(&pool->mutex);
+
+    pool->stopping = true;
+
+    for (i = 0; i < pool->max_threads; ++i)
+    {
+        if (pool->workers[i].status == WORKER_RUNNING)
+        {
+            retval = pthread_cancel(pool->workers[i].thread);
+            if (retval != 0)
+            {
+                ERR_LOG(retval, NULL, "pthread_cancel()");
+            }
+        }
+    }
+
+    unlock_mutex(&pool->mutex);
+
+    // Threads may need pool->mutex to exit, so join them without holding it.
+    // Nothing else changes the status once stopping is set.
+    for (i = 0; i < pool->max_threads; ++i)
+    {
+        if (pool->workers[i].status != WORKER_UNUSED)
+        {
+            retval = pthread_join(pool->workers[i].thread, NULL);
+            if (retval != 0)
+            {
+                ERR_LOG(retval, NULL, "pthread_join()");
+            }
+            pool->workers[i].status = WORKER_UNUSED;
+        }
+    }
+
+    pool->num_threads = 0;
+}
+
+
+void db_pool_close(
+    struct db_pool *pool)
+{
+    size_t i;
+
+    for (i = 0; i < pool->max_threads; ++i)
+    {
+        free(pool->workers[i].deque);
+        pthread_mutex_destroy(&pool->workers[i].deque_mutex);
+    }
+    free(pool->workers);
+    pool->workers = NULL;
+
+    pthread_mutex_destroy(&pool->mutex);
+
+    MpmcQueue_free(pool->request_queue);
+    pool->request_queue = NULL;
+
+    if (semcompat_free(pool->semaphore) != 0)
+    {
+        ERR_LOG(errno, NULL, "semcompat_free()");
+    }
+    pool->semaphore = SEM_FAILED;
+}
+
+
+bool db_pool_submit(
+    struct db_pool *pool,
+    struct db_request *request)
+{
+    request->started = false;
+    request->query_state = NULL;
+    request->from_snapshot = false;
+    request->parked = false;
+
+    if (!MpmcQueue_trypush(pool->request_queue, (void *)request))
+    {
+        LOG(LOG_ERR, "db request queue is full");
+        return false;
+    }
+
+    post_semaphore(pool);
+
+    maybe_add_thread(pool);
+
+    return true;
+}
+
+
+void db_request_resume(
+    struct db_pool *pool,
+    struct db_request *request)
+{
+    if (!__atomic_exchange_n(&request->parked, false, __ATOMIC_SEQ_CST))
+    {
+        // the request isn't parked, so a db thread will get to it
+        return;
+    }
+
+    // The request queue has room for at least one request per cxn thread
+    // in practice, and db threads keep emptying it, so this doesn't spin.
+    // Giving up would leave the request parked forever.
+    while (!MpmcQueue_trypush(pool->request_queue, (void *)request))
+    {
+        sched_yield();
+    }
+
+    post_semaphore(pool);
+
+    maybe_add_thread(pool);
+}
+
+
+void db_pool_get_gauges(
+    struct db_pool *pool,
+    struct metrics_gauges *gauges)
+{
+    gauges->db_request_queue_length = MpmcQueue_size(pool->request_queue);
+    gauges->db_threads_idle = __atomic_load_n(&pool->num_idle,
+                                              __ATOMIC_SEQ_CST);
+
+    lock_mutex(&pool->mutex);
+    gauges->db_threads = pool->num_threads;
+    unlock_mutex(&pool->mutex);
+}
@@ -2,14 +2,19 @@
 #define _RTR_DB_H
 
 // Declarations related to db (database) threads.
-// Currently: main entry point and related arguments, as well as
-// database request/response data structures.
+// Currently: the db thread pool, as well as database request/response data
+// structures.
 
-#include "util/queue.h"
-#include "util/bag.h"
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "util/mpmc_queue.h"
+#include "util/spsc_queue.h"
 
 #include "rpki-rtr/pdu.h"
 #include "semaphores.h"
+#include "cache_state.h"
+#include "metrics.h"
 
 struct db_query {
     enum { SERIAL_QUERY, RESET_QUERY } type;
@@ -25,10 +30,27 @@ struct db_query {
 // memory is handled entirely by cxn threads, db threads must not free() these
 struct db_request {
     struct db_query query;
-    Queue *response_queue;
+
+    // db threads push, the cxn thread pops. This must have room for
+    // DB_RESPONSE_BUFFER_LENGTH + 1 responses: a cancelled request gets one
+    // more (empty) response even if the queue is otherwise full.
+    SpscQueue *response_queue;
     cxn_semaphore_t *response_semaphore;
     volatile bool cancel_request;       // the cxn thread can set this to true
                                         // to cancel a request
+
+    // For Reset Queries, the cache generation pinned by the cxn thread for
+    // the duration of the request. If it has a snapshot, the response is
+    // served from the snapshot instead of the database. NULL for other
+    // queries.
+    const struct cache_generation *generation;
+
+    // The below members are initialized by db_pool_submit() and are only
+    // used by db threads, except for parked (see db_request_resume()).
+    bool started;
+    void *query_state;
+    bool from_snapshot;         // true iff query_state is from a snapshot
+    bool parked;                // accessed atomically
 };
 
 // memory is allocated by db threads and free()ed by cxn threads
@@ -38,14 +60,112 @@ struct db_response {
     bool is_done;
 };
 
-// memory is handled entirely by the main thread, db threads must not free()
-// these
-struct db_main_args {
+
+struct db_worker;
+
+/**
+   @brief An elastic pool of db threads.
+
+   New requests go into a shared queue. Each db thread also has its own
+   deque of requests that it's in the middle of servicing: after each
+   step of a request, the thread puts the request at the back of its
+   deque, so that a long Reset Query is interleaved with other requests
+   instead of holding up the thread until it's done. Threads with
+   nothing to do steal from the back of other threads' deques.
+
+   A request whose response queue is full is parked instead of being put
+   back in a deque, and is resumed by its cxn thread with
+   db_request_resume() once there's room again.
+
+   The pool starts with min_threads threads, adds threads (up to
+   max_threads) when requests are waiting and no thread is idle, and
+   removes threads (down to min_threads) that have been idle for
+   DB_THREAD_IDLE_TIMEOUT seconds.
+*/
+struct db_pool {
+    // posted once for each request that's ready to be serviced
     db_semaphore_t *semaphore;
-    Queue *db_request_queue;
-    Bag *db_currently_processing;
+
+    // new and resumed requests (struct db_request *)
+    MpmcQueue *request_queue;
+
+    size_t min_threads;
+    size_t max_threads;
+
+    // protects num_threads, stopping, and the status of each worker
+    pthread_mutex_t mutex;
+    size_t num_threads;
+    bool stopping;
+
+    // number of threads waiting on semaphore, accessed atomically
+    size_t num_idle;
+
+    // array of max_threads workers
+    struct db_worker *workers;
+
+    struct metrics *metrics;
 };
-void *db_main(
-    void *args_voidp);
+
+/**
+   @brief Initialize @p pool without starting any threads.
+
+   @return Whether or not the initialization was successful.
+*/
+bool db_pool_init(
+    struct db_pool *pool,
+    size_t min_threads,
+    size_t max_threads,
+    struct metrics *metrics);
+
+/**
+   @brief Start the pool's initial threads.
+
+   @return Whether or not all the initial threads were started.
+*/
+bool db_pool_start(
+    struct db_pool *pool);
+
+/**
+   @brief Cancel and join all of the pool's threads.
+
+   This must not be called while any cxn thread might still use the pool.
+*/
+void db_pool_stop(
+    struct db_pool *pool);
+
+/**
+   @brief Free any resources associated with a pool initialized by
+       db_pool_init(). The pool must be stopped first.
+*/
+void db_pool_close(
+    struct db_pool *pool);
+
+/**
+   @brief Submit a new request to be serviced.
+
+   @return Whether or not the request was submitted. This fails if
+       DB_REQUEST_QUEUE_LENGTH requests are already waiting.
+*/
+bool db_pool_submit(
+    struct db_pool *pool,
+    struct db_request *request);
+
+/**
+   @brief Resume @p request if it was parked because its response queue
+       was full.
+
+   The cxn thread must call this after taking a response that isn't done
+   out of the response queue, and after cancelling the request.
+*/
+void db_request_resume(
+    struct db_pool *pool,
+    struct db_request *request);
+
+/**
+   @brief Fill in the db thread and request queue members of @p gauges.
+*/
+void db_pool_get_gauges(
+    struct db_pool *pool,
+    struct metrics_gauges *gauges);
 
 #endif
@@ -0,0 +1,532 @@
+/************************
+ * Net changes between two serial numbers
+ *
+ * Prints the announcements and withdrawals that take a router from the
+ * VRPs of one retained serial number to those of another, in
+ * vrp_compare() order. If rtr_full has both serials, the two sets are
+ * diffed directly. Otherwise the rtr_incremental data of every serial
+ * in between is squashed into a single delta, so a VRP that was
+ * announced and later withdrawn again doesn't show up at all.
+ ***********************/
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "util/logging.h"
+#include "db/connect.h"
+#include "db/clients/rtr.h"
+#include "config/config.h"
+#include "rpki-rtr/vrp.h"
+
+
+/**
+   @brief Upper bound on the length of a chain of incremental updates,
+       to stop on a corrupt rtr_update that has a cycle.
+*/
+#define MAX_CHAIN_LENGTH (1 << 20)
+
+
+static void usage(
+    const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <from serial> [<to serial>]\n"
+            "\n"
+            "Print the changes from the VRPs of one serial number to\n"
+            "those of another (by default, the latest one), one per\n"
+            "line:\n"
+            "\n"
+            "    announce AS64496 192.0.2.0/24 24\n"
+            "    withdraw AS64497 2001:db8::/32 48\n"
+            "\n"
+            "The from serial may be newer than the to serial. A summary\n"
+            "is printed to standard error.\n"
+            "\n"
+            "Options:\n"
+            "    -q             only print the summary\n"
+            "    -h             print this help text\n",
+            argv0);
+}
+
+
+struct print_state {
+    bool quiet;
+    size_t announcements;
+    size_t withdrawals;
+};
+
+/**
+   @brief vrp_diff_callback that prints a change and counts it in the
+       struct print_state @p arg.
+*/
+static bool print_change(
+    const struct vrp *vrp,
+    bool is_announce,
+    void *arg)
+{
+    struct print_state *state = arg;
+    char prefix[INET6_ADDRSTRLEN];
+
+    if (is_announce)
+    {
+        ++state->announcements;
+    }
+    else
+    {
+        ++state->withdrawals;
+    }
+
+    if (state->quiet)
+    {
+        return true;
+    }
+
+    if (inet_ntop(vrp->family_length == 4 ? AF_INET : AF_INET6,
+                  vrp->prefix, prefix, sizeof(prefix)) == NULL)
+    {
+        snprintf(prefix, sizeof(prefix), "?");
+    }
+
+    if (printf("%s AS%" PRIu32 " %s/%u %u\n",
+               is_announce ? "announce" : "withdraw", vrp->asn, prefix,
+               (unsigned)vrp->prefix_length,
+               (unsigned)vrp->max_length) < 0)
+    {
+        ERR_LOG(errno, NULL, "can't write to standard output");
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+   @brief Diff the rtr_full data of two serials.
+
+   @return True on success, false on failure.
+*/
+static bool diff_full(
+    dbconn *db,
+    serial_number_t from,
+    serial_number_t to,
+    struct print_state *state)
+{
+    struct vrp_set from_vrps;
+    struct vrp_set to_vrps;
+    bool ret = false;
+
+    vrp_set_init(&from_vrps);
+    vrp_set_init(&to_vrps);
+
+    if (!db_rtr_get_full_vrps(db, from, &from_vrps) ||
+        !db_rtr_get_full_vrps(db, to, &to_vrps))
+    {
+        LOG(LOG_ERR, "Could not read VRPs from rtr_full.");
+        goto done;
+    }
+    vrp_set_sort(&from_vrps);
+    vrp_set_sort(&to_vrps);
+
+    ret = vrp_diff(from_vrps.vrps, from_vrps.len, to_vrps.vrps,
+                   to_vrps.len, print_change, state);
+
+done:
+    vrp_set_free(&from_vrps);
+    vrp_set_free(&to_vrps);
+
+    return ret;
+}
+
+/**
+   @brief Find the serials whose incremental updates take a router from
+       @p from to the later serial @p to.
+
+   @param[out] chain Set to a malloc()ed array of the serials after
+       @p from, up to and including @p to, oldest first.
+   @param[out] chain_len Set to the length of @p chain.
+   @return GET_SERNUM_SUCCESS, GET_SERNUM_NONE if @p to can't be
+       reached from @p from, or GET_SERNUM_ERR on error.
+*/
+static int find_chain(
+    dbconn *db,
+    serial_number_t from,
+    serial_number_t to,
+    serial_number_t **chain,
+    size_t *chain_len)
+{
+    serial_number_t serial = to;
+    serial_number_t previous;
+    serial_number_t *new_chain;
+    size_t capacity = 0;
+    bool has_previous;
+    bool has_full;
+    size_t i;
+    int ret;
+
+    *chain = NULL;
+    *chain_len = 0;
+
+    while (serial != from)
+    {
+        if (*chain_len == MAX_CHAIN_LENGTH)
+        {
+            LOG(LOG_ERR, "rtr_update has a chain of more than %d "
+                "serials, it may be corrupt.", MAX_CHAIN_LENGTH);
+            ret = GET_SERNUM_ERR;
+            goto fail;
+        }
+
+        ret = db_rtr_get_update(db, serial, &has_previous, &previous,
+                                &has_full);
+        if (ret == GET_SERNUM_SUCCESS && !has_previous)
+        {
+            ret = GET_SERNUM_NONE;
+        }
+        if (ret != GET_SERNUM_SUCCESS)
+        {
+            goto fail;
+        }
+
+        if (*chain_len == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            new_chain = realloc(*chain, capacity * sizeof(**chain));
+            if (new_chain == NULL)
+            {
+                LOG(LOG_ERR, "out of memory");
+                ret = GET_SERNUM_ERR;
+                goto fail;
+            }
+            *chain = new_chain;
+        }
+
+        (*chain)[(*chain_len)++] = serial;
+        serial = previous;
+    }
+
+    // reverse, so the oldest update is first
+    for (i = 0; i < *chain_len / 2; ++i)
+    {
+        serial = (*chain)[i];
+        (*chain)[i] = (*chain)[*chain_len - 1 - i];
+        (*chain)[*chain_len - 1 - i] = serial;
+    }
+
+    return GET_SERNUM_SUCCESS;
+
+fail:
+    free(*chain);
+    *chain = NULL;
+    *chain_len = 0;
+    return ret;
+}
+
+/**
+   @brief Squash the rtr_incremental data of every serial in @p chain
+       into @p net.
+
+   @return True on success, false on failure.
+*/
+static bool squash_chain(
+    dbconn *db,
+    const serial_number_t *chain,
+    size_t chain_len,
+    struct vrp_delta *net)
+{
+    struct vrp_delta step;
+    struct vrp_delta squashed;
+    size_t i;
+    bool ret = false;
+
+    vrp_delta_init(&step);
+    vrp_delta_init(&squashed);
+
+    for (i = 0; i < chain_len; ++i)
+    {
+        vrp_delta_free(&step);
+        if (!db_rtr_get_incremental_vrps(db, chain[i], &step))
+        {
+            LOG(LOG_ERR, "Could not read changes for serial %" PRISERIAL
+                " from rtr_incremental.", chain[i]);
+            goto done;
+        }
+
+        if (!vrp_delta_squash(net, &step, &squashed))
+        {
+            LOG(LOG_ERR, "out of memory");
+            goto done;
+        }
+
+        vrp_delta_free(net);
+        *net = squashed;
+        vrp_delta_init(&squashed);
+    }
+
+    ret = true;
+
+done:
+    vrp_delta_free(&step);
+    vrp_delta_free(&squashed);
+
+    return ret;
+}
+
+/**
+   @brief Squash the incremental updates between two serials, in
+       whichever direction they're chained.
+
+   @param[out] steps Set to the number of incremental updates squashed.
+   @return True on success, false on failure.
+*/
+static bool diff_incremental(
+    dbconn *db,
+    serial_number_t from,
+    serial_number_t to,
+    struct print_state *state,
+    size_t *steps)
+{
+    serial_number_t *chain = NULL;
+    size_t chain_len = 0;
+    bool reversed = false;
+    struct vrp_delta net;
+    bool ret = false;
+    int found;
+
+    vrp_delta_init(&net);
+
+    found = find_chain(db, from, to, &chain, &chain_len);
+    if (found == GET_SERNUM_NONE)
+    {
+        // Serial numbers wrap around, so the only way to tell which
+        // one is older is to look for a chain in the other direction.
+        reversed = true;
+        found = find_chain(db, to, from, &chain, &chain_len);
+    }
+    if (found == GET_SERNUM_NONE)
+    {
+        LOG(LOG_ERR, "rtr_incremental doesn't have the changes between "
+            "serials %" PRISERIAL " and %" PRISERIAL ".", from, to);
+        goto done;
+    }
+    else if (found != GET_SERNUM_SUCCESS)
+    {
+        LOG(LOG_ERR, "Error reading rtr_update.");
+        goto done;
+    }
+
+    if (!squash_chain(db, chain, chain_len, &net))
+    {
+        goto done;
+    }
+
+    if (reversed)
+    {
+        vrp_delta_invert(&net);
+    }
+
+    *steps = chain_len;
+    ret = vrp_delta_for_each(&net, print_change, state);
+
+done:
+    free(chain);
+    vrp_delta_free(&net);
+
+    return ret;
+}
+
+/**
+   @brief Connect to the database and print the changes from @p from to
+       @p to, or the latest serial if @p to_latest.
+
+   @return True on success, false on failure.
+*/
+static bool run_diff(
+    serial_number_t from,
+    bool to_latest,
+    serial_number_t to,
+    bool quiet)
+{
+    bool ret = false;
+    bool done_db_init = false;
+    bool done_db_thread_init = false;
+    dbconn *db = NULL;
+    struct print_state state = {quiet, 0, 0};
+    bool from_has_full;
+    bool to_has_full;
+    bool has_previous;
+    serial_number_t previous;
+    size_t steps = 0;
+
+    if (!db_init())
+    {
+        LOG(LOG_ERR, "Could not initialize database program.");
+        goto done;
+    }
+    done_db_init = true;
+
+    if (!db_thread_init())
+    {
+        LOG(LOG_ERR, "Could not initialize database thread.");
+        goto done;
+    }
+    done_db_thread_init = true;
+
+    db = db_connect_default(DB_CLIENT_RTR);
+    if (db == NULL)
+    {
+        LOG(LOG_ERR,
+            "Could not connect to the database, check your config "
+            "file.");
+        goto done;
+    }
+
+    if (to_latest)
+    {
+        switch (db_rtr_get_latest_sernum(db, &to))
+        {
+            case GET_SERNUM_SUCCESS:
+                break;
+            case GET_SERNUM_NONE:
+                LOG(LOG_ERR, "No data available, run rpki-rtr-update "
+                    "first.");
+                goto done;
+            default:
+                LOG(LOG_ERR, "Error finding latest serial number.");
+                goto done;
+        }
+    }
+
+    switch (db_rtr_get_update(db, from, &has_previous, &previous,
+                              &from_has_full))
+    {
+        case GET_SERNUM_SUCCESS:
+            break;
+        case GET_SERNUM_NONE:
+            LOG(LOG_ERR, "Serial %" PRISERIAL " is not retained.", from);
+            goto done;
+        default:
+            LOG(LOG_ERR, "Error reading rtr_update.");
+            goto done;
+    }
+
+    switch (db_rtr_get_update(db, to, &has_previous, &previous,
+                              &to_has_full))
+    {
+        case GET_SERNUM_SUCCESS:
+            break;
+        case GET_SERNUM_NONE:
+            LOG(LOG_ERR, "Serial %" PRISERIAL " is not retained.", to);
+            goto done;
+        default:
+            LOG(LOG_ERR, "Error reading rtr_update.");
+            goto done;
+    }
+
+    if (from == to)
+    {
+        ret = true;
+    }
+    else if (from_has_full && to_has_full)
+    {
+        ret = diff_full(db, from, to, &state);
+    }
+    else
+    {
+        ret = diff_incremental(db, from, to, &state, &steps);
+    }
+
+    if (ret && fflush(stdout) != 0)
+    {
+        ERR_LOG(errno, NULL, "can't write to standard output");
+        ret = false;
+    }
+
+    if (ret)
+    {
+        fprintf(stderr, "%zu announcements and %zu withdrawals from "
+                "serial %" PRISERIAL " to %" PRISERIAL, state.announcements,
+                state.withdrawals, from, to);
+        if (steps > 0)
+        {
+            fprintf(stderr, " (%zu incremental updates)", steps);
+        }
+        fprintf(stderr, "\n");
+    }
+
+done:
+    if (db != NULL)
+    {
+        db_disconnect(db);
+    }
+
+    if (done_db_thread_init)
+    {
+        db_thread_close();
+    }
+
+    if (done_db_init)
+    {
+        db_close();
+    }
+
+    return ret;
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    serial_number_t from;
+    serial_number_t to = 0;
+    bool to_latest = true;
+    bool quiet = false;
+    bool ok;
+    int c;
+
+    while ((c = getopt(argc, argv, "qh")) != -1)
+    {
+        switch (c)
+        {
+        case 'q':
+            quiet = true;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc - optind < 1 || argc - optind > 2 ||
+        !parse_serial_number(argv[optind], &from) ||
+        (argc - optind == 2 && !parse_serial_number(argv[optind + 1], &to)))
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    to_latest = argc - optind == 1;
+
+    OPEN_LOG("rpki-rtr-diff", LOG_USER);
+
+    if (!my_config_load())
+    {
+        LOG(LOG_ERR, "can't load configuration");
+        CLOSE_LOG();
+        return EXIT_FAILURE;
+    }
+
+    ok = run_diff(from, to_latest, to, quiet);
+
+    config_unload();
+    CLOSE_LOG();
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,606 @@
+/************************
+ * Export of the VRPs served by rpki-rtr-daemon
+ *
+ * Streams the VRPs for the latest serial number (or a given one) out of
+ * rtr_full through a server-side cursor and writes them as CSV, JSON,
+ * or a snapshot in the compact binary format of
+ * lib/rpki-rtr/vrp_file.h. Memory use doesn't depend on the number of
+ * VRPs.
+ *
+ * The output is written to a temporary file in the same directory and
+ * renamed over the destination once it's complete, so readers never
+ * see a partial export.
+ ***********************/
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include "util/logging.h"
+#include "util/timeutils.h"
+#include "db/connect.h"
+#include "db/clients/rtr.h"
+#include "config/config.h"
+#include "rpki-rtr/vrp.h"
+#include "rpki-rtr/vrp_file.h"
+
+
+/** @brief Size of the stdio buffer for text output. */
+#define TEXT_BUFFER_SIZE (1024 * 1024)
+
+
+enum export_format {
+    FORMAT_CSV,
+    FORMAT_JSON,
+    FORMAT_BINARY,
+};
+
+struct export_state {
+    enum export_format format;
+
+    /** @brief Text output, NULL for FORMAT_BINARY. */
+    FILE *fp;
+
+    /** @brief Destination for write errors in text output. */
+    const char *fp_path;
+
+    /** @brief Binary output. */
+    struct vrp_file_writer writer;
+
+    size_t count;
+};
+
+
+static void usage(
+    const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <output file>\n"
+            "\n"
+            "Write the VRPs for the latest serial number to a file. The\n"
+            "file is replaced atomically once the export is complete. If\n"
+            "the output file is \"-\", CSV and JSON are written to\n"
+            "standard output instead.\n"
+            "\n"
+            "Options:\n"
+            "    -f <format>    csv (the default), json, or binary (the\n"
+            "                   snapshot format written by\n"
+            "                   rpki-rtr-update)\n"
+            "    -s <serial>    export the VRPs for this serial number\n"
+            "                   instead of the latest one; only the\n"
+            "                   two latest have a full snapshot\n"
+            "    -h             print this help text\n",
+            argv0);
+}
+
+static bool parse_format(
+    const char *str,
+    enum export_format *format)
+{
+    if (strcmp(str, "csv") == 0)
+    {
+        *format = FORMAT_CSV;
+    }
+    else if (strcmp(str, "json") == 0)
+    {
+        *format = FORMAT_JSON;
+    }
+    else if (strcmp(str, "binary") == 0)
+    {
+        *format = FORMAT_BINARY;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+
+/*****
+ * Text output
+ *****/
+
+/**
+   @brief Create a temporary file next to @p path for text output.
+
+   @param[out] tmp_path Set to the malloc()ed path of the temporary
+       file.
+   @return The open file, or NULL on failure.
+*/
+static FILE *text_open(
+    const char *path,
+    char **tmp_path)
+{
+    static char buffer[TEXT_BUFFER_SIZE];
+    int fd;
+    FILE *fp;
+
+    *tmp_path = malloc(strlen(path) + sizeof(".XXXXXX"));
+    if (*tmp_path == NULL)
+    {
+        LOG(LOG_ERR, "out of memory");
+        return NULL;
+    }
+    strcpy(*tmp_path, path);
+    strcat(*tmp_path, ".XXXXXX");
+
+    fd = mkstemp(*tmp_path);
+    if (fd < 0)
+    {
+        ERR_LOG(errno, NULL, "can't create temporary file for %s", path);
+        free(*tmp_path);
+        *tmp_path = NULL;
+        return NULL;
+    }
+
+    // mkstemp() uses mode 0600, but the export is meant to be read by
+    // other programs.
+    if (fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) != 0)
+    {
+        ERR_LOG(errno, NULL, "can't set permissions on %s", *tmp_path);
+    }
+
+    fp = fdopen(fd, "w");
+    if (fp == NULL)
+    {
+        ERR_LOG(errno, NULL, "can't open %s", *tmp_path);
+        close(fd);
+        unlink(*tmp_path);
+        free(*tmp_path);
+        *tmp_path = NULL;
+        return NULL;
+    }
+
+    setvbuf(fp, buffer, _IOFBF, sizeof(buffer));
+
+    return fp;
+}
+
+/**
+   @brief Flush and close text output opened by text_open(), then
+       rename it to @p path. If @p success is false, or anything fails,
+       remove it instead.
+*/
+static bool text_close(
+    FILE *fp,
+    char *tmp_path,
+    const char *path,
+    bool success)
+{
+    if (success && (fflush(fp) != 0 || fsync(fileno(fp)) != 0))
+    {
+        ERR_LOG(errno, NULL, "can't write to %s", tmp_path);
+        success = false;
+    }
+
+    if (fclose(fp) != 0 && success)
+    {
+        ERR_LOG(errno, NULL, "can't close %s", tmp_path);
+        success = false;
+    }
+
+    if (success && rename(tmp_path, path) != 0)
+    {
+        ERR_LOG(errno, NULL, "can't rename %s to %s", tmp_path, path);
+        success = false;
+    }
+
+    if (!success)
+    {
+        unlink(tmp_path);
+    }
+
+    free(tmp_path);
+
+    return success;
+}
+
+/**
+   @brief Format @p vrp's prefix, e.g. "192.0.2.0/24".
+*/
+static void prefix_sprint(
+    const struct vrp *vrp,
+    char *buffer,
+    size_t buffer_length)
+{
+    size_t len;
+
+    if (inet_ntop(vrp->family_length == 4 ? AF_INET : AF_INET6,
+                  vrp->prefix, buffer, buffer_length) == NULL)
+    {
+        snprintf(buffer, buffer_length, "?");
+    }
+
+    len = strlen(buffer);
+    snprintf(buffer + len, buffer_length - len, "/%u",
+             (unsigned)vrp->prefix_length);
+}
+
+static bool text_begin(
+    struct export_state *state,
+    serial_number_t serial)
+{
+    int ret;
+
+    if (state->format == FORMAT_CSV)
+    {
+        ret = fprintf(state->fp, "ASN,IP Prefix,Max Length\n");
+    }
+    else
+    {
+        ret = fprintf(state->fp,
+                      "{\n"
+                      "  \"metadata\": {\n"
+                      "    \"serial\": %" PRISERIAL "\n"
+                      "  },\n"
+                      "  \"roas\": [", serial);
+    }
+
+    if (ret < 0)
+    {
+        ERR_LOG(errno, NULL, "can't write to %s", state->fp_path);
+        return false;
+    }
+
+    return true;
+}
+
+static bool text_vrp(
+    struct export_state *state,
+    const struct vrp *vrp)
+{
+    char prefix[INET6_ADDRSTRLEN + sizeof("/128")];
+    int ret;
+
+    prefix_sprint(vrp, prefix, sizeof(prefix));
+
+    if (state->format == FORMAT_CSV)
+    {
+        ret = fprintf(state->fp, "AS%" PRIu32 ",%s,%u\n", vrp->asn, prefix,
+                      (unsigned)vrp->max_length);
+    }
+    else
+    {
+        ret = fprintf(state->fp,
+                      "%s\n    { \"asn\": \"AS%" PRIu32 "\", "
+                      "\"prefix\": \"%s\", \"maxLength\": %u }",
+                      state->count == 0 ? "" : ",", vrp->asn, prefix,
+                      (unsigned)vrp->max_length);
+    }
+
+    if (ret < 0)
+    {
+        ERR_LOG(errno, NULL, "can't write to %s", state->fp_path);
+        return false;
+    }
+
+    return true;
+}
+
+static bool text_end(
+    struct export_state *state)
+{
+    if (state->format == FORMAT_JSON &&
+        fprintf(state->fp, "%s]\n}\n", state->count == 0 ? "" : "\n  ") < 0)
+    {
+        ERR_LOG(errno, NULL, "can't write to %s", state->fp_path);
+        return false;
+    }
+
+    return true;
+}
+
+
+/*****
+ * Export
+ *****/
+
+/**
+   @brief db_rtr_vrp_callback that writes one VRP to the struct
+       export_state @p arg.
+*/
+static bool export_vrp(
+    const struct vrp *vrp,
+    void *arg)
+{
+    struct export_state *state = arg;
+    bool ret;
+
+    if (state->format == FORMAT_BINARY)
+    {
+        ret = vrp_file_stream_add(&state->writer, vrp);
+    }
+    else
+    {
+        ret = text_vrp(state, vrp);
+    }
+
+    if (ret)
+    {
+        ++state->count;
+    }
+
+    return ret;
+}
+
+/**
+   @brief Write the VRPs for @p serial to @p path.
+
+   @param[out] count Set to the number of VRPs written.
+   @return True on success, false on failure.
+*/
+static bool export_vrps(
+    dbconn *db,
+    serial_number_t serial,
+    enum export_format format,
+    const char *path,
+    size_t *count)
+{
+    struct export_state state;
+    char *tmp_path = NULL;
+    session_id_t session;
+    bool to_stdout = strcmp(path, "-") == 0;
+    bool ret;
+
+    memset(&state, 0, sizeof(state));
+    state.format = format;
+
+    if (format == FORMAT_BINARY)
+    {
+        if (db_rtr_get_session_id(db, &session))
+        {
+            LOG(LOG_ERR, "Could not get session id.");
+            return false;
+        }
+
+        if (!vrp_file_stream_open(&state.writer, path, session, serial))
+        {
+            return false;
+        }
+
+        ret = db_rtr_for_each_full_vrp(db, serial, export_vrp, &state);
+        *count = state.count;
+
+        return vrp_file_stream_close(&state.writer, ret) && ret;
+    }
+
+    if (to_stdout)
+    {
+        state.fp = stdout;
+        state.fp_path = "standard output";
+    }
+    else
+    {
+        state.fp = text_open(path, &tmp_path);
+        if (state.fp == NULL)
+        {
+            return false;
+        }
+        state.fp_path = tmp_path;
+    }
+
+    ret = text_begin(&state, serial) &&
+        db_rtr_for_each_full_vrp(db, serial, export_vrp, &state) &&
+        text_end(&state);
+    *count = state.count;
+
+    if (to_stdout)
+    {
+        if (fflush(stdout) != 0 && ret)
+        {
+            ERR_LOG(errno, NULL, "can't write to standard output");
+            ret = false;
+        }
+        return ret;
+    }
+
+    return text_close(state.fp, tmp_path, path, ret) && ret;
+}
+
+/**
+   @brief Connect to the database and export the VRPs for @p serial, or
+       the latest serial if @p use_latest.
+
+   @return True on success, false on failure.
+*/
+static bool run_export(
+    bool use_latest,
+    serial_number_t serial,
+    enum export_format format,
+    const char *path)
+{
+    bool ret = false;
+    bool done_db_init = false;
+    bool done_db_thread_init = false;
+    bool in_read = false;
+    dbconn *db = NULL;
+    bool has_previous;
+    serial_number_t previous;
+    bool has_full;
+    size_t count;
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (!db_init())
+    {
+        LOG(LOG_ERR, "Could not initialize database program.");
+        goto done;
+    }
+    done_db_init = true;
+
+    if (!db_thread_init())
+    {
+        LOG(LOG_ERR, "Could not initialize database thread.");
+        goto done;
+    }
+    done_db_thread_init = true;
+
+    db = db_connect_default(DB_CLIENT_RTR);
+    if (db == NULL)
+    {
+        LOG(LOG_ERR,
+            "Could not connect to the database, check your config "
+            "file.");
+        goto done;
+    }
+
+    // Check the serial and read both address families from the same
+    // snapshot, so rpki-rtr-update can't delete it halfway through.
+    if (!db_rtr_begin_consistent_read(db))
+    {
+        LOG(LOG_ERR, "Could not start a database transaction.");
+        goto done;
+    }
+    in_read = true;
+
+    if (use_latest)
+    {
+        switch (db_rtr_get_latest_sernum(db, &serial))
+        {
+            case GET_SERNUM_SUCCESS:
+                break;
+            case GET_SERNUM_NONE:
+                LOG(LOG_ERR, "No data available, run rpki-rtr-update "
+                    "first.");
+                goto done;
+            default:
+                LOG(LOG_ERR, "Error finding latest serial number.");
+                goto done;
+        }
+    }
+
+    switch (db_rtr_get_update(db, serial, &has_previous, &previous,
+                              &has_full))
+    {
+        case GET_SERNUM_SUCCESS:
+            break;
+        case GET_SERNUM_NONE:
+            LOG(LOG_ERR, "Serial %" PRISERIAL " is not retained.", serial);
+            goto done;
+        default:
+            LOG(LOG_ERR, "Error reading rtr_update.");
+            goto done;
+    }
+
+    if (!has_full)
+    {
+        LOG(LOG_ERR, "Serial %" PRISERIAL " has no full snapshot in "
+            "rtr_full, only the two latest serials do.", serial);
+        goto done;
+    }
+
+    if (!export_vrps(db, serial, format, path, &count))
+    {
+        LOG(LOG_ERR, "Could not export VRPs for serial %" PRISERIAL ".",
+            serial);
+        goto done;
+    }
+
+    LOG(LOG_INFO, "Exported %zu VRPs for serial %" PRISERIAL " in %.2f s.",
+        count, serial, seconds_since(&start));
+
+    ret = true;
+
+done:
+    if (in_read)
+    {
+        db_rtr_end_consistent_read(db);
+    }
+
+    if (db != NULL)
+    {
+        db_disconnect(db);
+    }
+
+    if (done_db_thread_init)
+    {
+        db_thread_close();
+    }
+
+    if (done_db_init)
+    {
+        db_close();
+    }
+
+    return ret;
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    bool use_latest = true;
+    serial_number_t serial = 0;
+    enum export_format format = FORMAT_CSV;
+    const char *path;
+    bool ok;
+    int c;
+
+    while ((c = getopt(argc, argv, "f:s:h")) != -1)
+    {
+        switch (c)
+        {
+        case 'f':
+            if (!parse_format(optarg, &format))
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 's':
+            if (!parse_serial_number(optarg, &serial))
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            use_latest = false;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc - optind != 1)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    path = argv[optind];
+
+    if (format == FORMAT_BINARY && strcmp(path, "-") == 0)
+    {
+        fprintf(stderr, "The binary format can't be written to standard "
+                "output.\n");
+        return EXIT_FAILURE;
+    }
+
+    OPEN_LOG("rpki-rtr-export", LOG_USER);
+
+    if (!my_config_load())
+    {
+        LOG(LOG_ERR, "can't load configuration");
+        CLOSE_LOG();
+        return EXIT_FAILURE;
+    }
+
+    ok = run_export(use_latest, serial, format, path);
+
+    config_unload();
+    CLOSE_LOG();
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
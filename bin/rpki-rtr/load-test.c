@@ -0,0 +1,964 @@
+/************************
+ * Load generator for rpki-rtr-daemon
+ *
+ * Simulates many routers, each with its own connection, issuing a mix of
+ * Reset Queries and Serial Queries. Every response is checked for protocol
+ * violations, and the time from sending a query to receiving its End of
+ * Data is recorded. At the end, throughput and latency percentiles are
+ * printed.
+ ***********************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include "util/logging.h"
+
+#include "rpki-rtr/pdu.h"
+
+
+// Per-router receive buffer. This must be larger than any PDU the server
+// sends, see MAX_PDU_SIZE in config.h.
+#define RECV_BUFFER_SIZE 4096
+
+#define DEFAULT_NUM_ROUTERS 100
+#define DEFAULT_NUM_THREADS 4
+#define DEFAULT_NUM_QUERIES 10
+#define DEFAULT_RESET_PERCENT 10
+
+
+struct options {
+    const char *host;
+    const char *port;
+    size_t num_routers;
+    size_t num_threads;
+    size_t num_queries;         // per router
+    unsigned int reset_percent;
+    unsigned int interval_ms;   // between queries on one router
+    bool verbose;
+};
+
+
+struct stats {
+    uint64_t reset_queries;
+    uint64_t serial_queries;
+    uint64_t responses;
+    uint64_t cache_resets;
+    uint64_t error_reports;
+    uint64_t serial_notifies;
+    uint64_t prefixes;
+    uint64_t bytes;
+    uint64_t invalid;           // routers dropped for protocol violations
+    uint64_t failed;            // routers dropped for I/O errors
+
+    // time from query to End of Data, in microseconds
+    uint64_t *latencies;
+    size_t num_latencies;
+    size_t latencies_capacity;
+};
+
+
+struct router {
+    size_t id;
+    int fd;
+
+    enum {
+        ROUTER_THINKING,        // waiting until next_query_time
+        ROUTER_WAITING,         // query sent, nothing received yet
+        ROUTER_RECEIVING,       // got Cache Response, waiting for End of Data
+        ROUTER_DONE,
+    } state;
+
+    bool have_data;
+    session_id_t session;
+    serial_number_t serial;
+
+    size_t queries_left;
+    bool query_is_reset;
+    uint64_t query_time;        // microseconds
+    uint64_t next_query_time;   // microseconds
+
+    unsigned int rand_state;
+
+    uint8_t buffer[RECV_BUFFER_SIZE];
+    size_t buffer_length;
+};
+
+
+struct worker {
+    pthread_t thread;
+    const struct options *options;
+    const struct addrinfo *addr;
+    struct router *routers;
+    size_t num_routers;
+    struct stats stats;
+};
+
+
+static uint64_t now_usec(
+    void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    {
+        return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+    }
+#endif
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+}
+
+
+static bool record_latency(
+    struct stats *stats,
+    uint64_t latency)
+{
+    if (stats->num_latencies == stats->latencies_capacity)
+    {
+        size_t new_capacity = stats->latencies_capacity ?
+            stats->latencies_capacity * 2 : 1024;
+        uint64_t *new_latencies = realloc(stats->latencies,
+                                          new_capacity * sizeof(uint64_t));
+
+        if (new_latencies == NULL)
+        {
+            LOG(LOG_ERR, "out of memory");
+            return false;
+        }
+
+        stats->latencies = new_latencies;
+        stats->latencies_capacity = new_capacity;
+    }
+
+    stats->latencies[stats->num_latencies++] = latency;
+
+    return true;
+}
+
+
+static void router_close(
+    struct router *router)
+{
+    if (router->fd >= 0 && close(router->fd) != 0)
+    {
+        LOG(LOG_WARNING, "close(): %s", strerror(errno));
+    }
+    router->fd = -1;
+    router->state = ROUTER_DONE;
+}
+
+
+/** Drop a router that violated the protocol. */
+static void router_invalid(
+    struct worker *worker,
+    struct router *router,
+    const PDU *pdu,
+    const char *reason)
+{
+    char sprint_buffer[PDU_SPRINT_BUFSZ];
+
+    if (pdu != NULL)
+    {
+        pdu_sprint(pdu, sprint_buffer);
+        LOG(LOG_ERR, "router %zu: %s: %s", router->id, reason,
+            sprint_buffer);
+    }
+    else
+    {
+        LOG(LOG_ERR, "router %zu: %s", router->id, reason);
+    }
+
+    ++worker->stats.invalid;
+    router_close(router);
+}
+
+
+static bool router_connect(
+    struct worker *worker,
+    struct router *router)
+{
+    const struct addrinfo *addrp;
+    int fd = -1;
+
+    for (addrp = worker->addr; addrp != NULL; addrp = addrp->ai_next)
+    {
+        fd = socket(addrp->ai_family, addrp->ai_socktype, addrp->ai_protocol);
+        if (fd == -1)
+        {
+            continue;
+        }
+
+        if (connect(fd, addrp->ai_addr, addrp->ai_addrlen) == 0)
+        {
+            break;
+        }
+
+        close(fd);
+        fd = -1;
+    }
+
+    if (fd == -1)
+    {
+        LOG(LOG_ERR, "router %zu: can't connect to [%s]:%s: %s", router->id,
+            worker->options->host, worker->options->port, strerror(errno));
+        return false;
+    }
+
+    if (fcntl(fd, F_SETFL, O_NONBLOCK) != 0)
+    {
+        LOG(LOG_ERR, "fcntl(): %s", strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    router->fd = fd;
+    return true;
+}
+
+
+static void router_send_query(
+    struct worker *worker,
+    struct router *router)
+{
+    uint8_t buffer[MAX_QUERY_PDU_LENGTH];
+    PDU pdu;
+    ssize_t length;
+    ssize_t offset = 0;
+    ssize_t retval;
+
+    router->query_is_reset = !router->have_data ||
+        (unsigned int)(rand_r(&router->rand_state) % 100) <
+        worker->options->reset_percent;
+
+    if (router->query_is_reset)
+    {
+        fill_pdu_reset_query(&pdu);
+        ++worker->stats.reset_queries;
+    }
+    else
+    {
+        fill_pdu_serial_query(&pdu, router->session, router->serial);
+        ++worker->stats.serial_queries;
+    }
+
+    length = dump_pdu(buffer, sizeof(buffer), &pdu);
+    if (length < 0)
+    {
+        LOG(LOG_ERR, "dump_pdu() failed");
+        ++worker->stats.failed;
+        router_close(router);
+        return;
+    }
+
+    router->query_time = now_usec();
+
+    // Queries are tiny, so the socket buffer should always have room.
+    while (offset < length)
+    {
+        retval = write(router->fd, buffer + offset, (size_t)(length - offset));
+        if (retval < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+            errno != EINTR)
+        {
+            LOG(LOG_ERR, "router %zu: write(): %s", router->id,
+                strerror(errno));
+            ++worker->stats.failed;
+            router_close(router);
+            return;
+        }
+        else if (retval > 0)
+        {
+            offset += retval;
+        }
+    }
+
+    router->state = ROUTER_WAITING;
+}
+
+
+/** Handle the end of a response, successful or not. */
+static void router_response_done(
+    struct worker *worker,
+    struct router *router)
+{
+    ++worker->stats.responses;
+
+    if (--router->queries_left == 0)
+    {
+        router_close(router);
+        return;
+    }
+
+    router->state = ROUTER_THINKING;
+    router->next_query_time =
+        now_usec() + (uint64_t)worker->options->interval_ms * 1000;
+}
+
+
+/**
+   Process one PDU from the server.
+
+   @return False if the router was dropped.
+*/
+static bool router_handle_pdu(
+    struct worker *worker,
+    struct router *router,
+    const PDU *pdu)
+{
+    switch (pdu->pduType)
+    {
+    case PDU_SERIAL_NOTIFY:
+        ++worker->stats.serial_notifies;
+        if (router->have_data && pdu->sessionId != router->session)
+        {
+            router_invalid(worker, router, pdu, "wrong session id");
+            return false;
+        }
+        return true;
+
+    case PDU_CACHE_RESPONSE:
+        if (router->state != ROUTER_WAITING)
+        {
+            router_invalid(worker, router, pdu, "unexpected PDU");
+            return false;
+        }
+        if (router->have_data && pdu->sessionId != router->session)
+        {
+            router_invalid(worker, router, pdu, "wrong session id");
+            return false;
+        }
+        router->session = pdu->sessionId;
+        router->state = ROUTER_RECEIVING;
+        return true;
+
+    case PDU_IPV4_PREFIX:
+    case PDU_IPV6_PREFIX:
+        if (router->state != ROUTER_RECEIVING)
+        {
+            router_invalid(worker, router, pdu, "unexpected PDU");
+            return false;
+        }
+        if (router->query_is_reset &&
+            !((pdu->pduType == PDU_IPV4_PREFIX ?
+               pdu->ip4PrefixData.flags : pdu->ip6PrefixData.flags) &
+              FLAG_WITHDRAW_ANNOUNCE))
+        {
+            router_invalid(worker, router, pdu,
+                           "withdrawal in response to a Reset Query");
+            return false;
+        }
+        ++worker->stats.prefixes;
+        return true;
+
+    case PDU_END_OF_DATA:
+        if (router->state != ROUTER_RECEIVING)
+        {
+            router_invalid(worker, router, pdu, "unexpected PDU");
+            return false;
+        }
+        if (pdu->sessionId != router->session)
+        {
+            router_invalid(worker, router, pdu, "wrong session id");
+            return false;
+        }
+        if (router->have_data && !router->query_is_reset &&
+            serial_number_greater(router->serial, pdu->serialNumber))
+        {
+            router_invalid(worker, router, pdu, "serial number went backwards");
+            return false;
+        }
+        if (!record_latency(&worker->stats, now_usec() - router->query_time))
+        {
+            ++worker->stats.failed;
+            router_close(router);
+            return false;
+        }
+        router->have_data = true;
+        router->serial = pdu->serialNumber;
+        router_response_done(worker, router);
+        return router->state != ROUTER_DONE;
+
+    case PDU_CACHE_RESET:
+        if (router->state != ROUTER_WAITING || router->query_is_reset)
+        {
+            router_invalid(worker, router, pdu, "unexpected PDU");
+            return false;
+        }
+        ++worker->stats.cache_resets;
+        router->have_data = false;
+        router_response_done(worker, router);
+        return router->state != ROUTER_DONE;
+
+    case PDU_ERROR_REPORT:
+        ++worker->stats.error_reports;
+        if (pdu->errorCode == ERR_NO_DATA && router->state == ROUTER_WAITING)
+        {
+            if (worker->options->verbose)
+            {
+                LOG(LOG_INFO, "router %zu: server has no data yet",
+                    router->id);
+            }
+            router_response_done(worker, router);
+            return router->state != ROUTER_DONE;
+        }
+        router_invalid(worker, router, pdu, "received error");
+        return false;
+
+    default:
+        router_invalid(worker, router, pdu, "unexpected PDU");
+        return false;
+    }
+}
+
+
+static void router_read(
+    struct worker *worker,
+    struct router *router)
+{
+    PDU pdu;
+    ssize_t retval;
+    size_t offset = 0;
+    int parse_retval;
+
+    retval = read(router->fd, router->buffer + router->buffer_length,
+                  sizeof(router->buffer) - router->buffer_length);
+    if (retval < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        {
+            return;
+        }
+        LOG(LOG_ERR, "router %zu: read(): %s", router->id, strerror(errno));
+        ++worker->stats.failed;
+        router_close(router);
+        return;
+    }
+    else if (retval == 0)
+    {
+        LOG(LOG_ERR, "router %zu: server closed the connection", router->id);
+        ++worker->stats.failed;
+        router_close(router);
+        return;
+    }
+
+    worker->stats.bytes += retval;
+    router->buffer_length += retval;
+
+    while (router->state != ROUTER_DONE)
+    {
+        parse_retval = parse_pdu(router->buffer + offset,
+                                 router->buffer_length - offset, &pdu);
+        if (parse_retval == PDU_TRUNCATED)
+        {
+            if (PDU_HEADER_LENGTH <= router->buffer_length - offset &&
+                pdu.length > sizeof(router->buffer))
+            {
+                router_invalid(worker, router, NULL, "PDU too large");
+            }
+            break;
+        }
+        else if (parse_retval != PDU_GOOD)
+        {
+            router_invalid(worker, router, NULL,
+                           parse_retval == PDU_WARNING ?
+                           "PDU with warnings" : "invalid PDU");
+            break;
+        }
+
+        offset += pdu.length;
+
+        if (!router_handle_pdu(worker, router, &pdu))
+        {
+            break;
+        }
+    }
+
+    if (router->state != ROUTER_DONE)
+    {
+        memmove(router->buffer, router->buffer + offset,
+                router->buffer_length - offset);
+        router->buffer_length -= offset;
+    }
+}
+
+
+static void *worker_main(
+    void *worker_voidp)
+{
+    struct worker *worker = (struct worker *)worker_voidp;
+    struct pollfd *pollfds;
+    struct router **polled;
+    size_t num_active;
+    size_t num_polled;
+    size_t i;
+    uint64_t now;
+    uint64_t next_wakeup;
+    int timeout;
+    int retval;
+
+    pollfds = calloc(worker->num_routers, sizeof(struct pollfd));
+    polled = calloc(worker->num_routers, sizeof(struct router *));
+    if (pollfds == NULL || polled == NULL)
+    {
+        LOG(LOG_ERR, "out of memory");
+        free(pollfds);
+        free(polled);
+        return NULL;
+    }
+
+    for (i = 0; i < worker->num_routers; ++i)
+    {
+        if (!router_connect(worker, &worker->routers[i]))
+        {
+            ++worker->stats.failed;
+            worker->routers[i].state = ROUTER_DONE;
+        }
+    }
+
+    while (true)
+    {
+        now = now_usec();
+        next_wakeup = UINT64_MAX;
+        num_active = 0;
+        num_polled = 0;
+
+        for (i = 0; i < worker->num_routers; ++i)
+        {
+            struct router *router = &worker->routers[i];
+
+            if (router->state == ROUTER_THINKING &&
+                router->next_query_time <= now)
+            {
+                router_send_query(worker, router);
+            }
+
+            if (router->state == ROUTER_DONE)
+            {
+                continue;
+            }
+
+            ++num_active;
+
+            if (router->state == ROUTER_THINKING &&
+                router->next_query_time < next_wakeup)
+            {
+                next_wakeup = router->next_query_time;
+            }
+
+            // Always poll, to pick up Serial Notifies while thinking.
+            pollfds[num_polled].fd = router->fd;
+            pollfds[num_polled].events = POLLIN;
+            pollfds[num_polled].revents = 0;
+            polled[num_polled] = router;
+            ++num_polled;
+        }
+
+        if (num_active == 0)
+        {
+            break;
+        }
+
+        if (next_wakeup == UINT64_MAX)
+        {
+            timeout = -1;
+        }
+        else
+        {
+            now = now_usec();
+            timeout = next_wakeup <= now ? 0 :
+                (int)((next_wakeup - now + 999) / 1000);
+        }
+
+        retval = poll(pollfds, num_polled, timeout);
+        if (retval < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            LOG(LOG_ERR, "poll(): %s", strerror(errno));
+            break;
+        }
+
+        for (i = 0; i < num_polled && retval > 0; ++i)
+        {
+            if (pollfds[i].revents == 0)
+            {
+                continue;
+            }
+            --retval;
+
+            router_read(worker, polled[i]);
+        }
+    }
+
+    for (i = 0; i < worker->num_routers; ++i)
+    {
+        if (worker->routers[i].state != ROUTER_DONE)
+        {
+            ++worker->stats.failed;
+            router_close(&worker->routers[i]);
+        }
+    }
+
+    free(pollfds);
+    free(polled);
+
+    return NULL;
+}
+
+
+static int compare_uint64(
+    const void *a,
+    const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/** @return The @p per_mille'th quantile of sorted @p values. */
+static uint64_t quantile(
+    const uint64_t *values,
+    size_t len,
+    unsigned int per_mille)
+{
+    size_t index;
+
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    index = (size_t)(((double)len * per_mille + 999) / 1000);
+    if (index > 0)
+    {
+        --index;
+    }
+
+    return values[index < len ? index : len - 1];
+}
+
+static bool merge_stats(
+    struct stats *total,
+    const struct stats *stats)
+{
+    size_t i;
+
+    total->reset_queries += stats->reset_queries;
+    total->serial_queries += stats->serial_queries;
+    total->responses += stats->responses;
+    total->cache_resets += stats->cache_resets;
+    total->error_reports += stats->error_reports;
+    total->serial_notifies += stats->serial_notifies;
+    total->prefixes += stats->prefixes;
+    total->bytes += stats->bytes;
+    total->invalid += stats->invalid;
+    total->failed += stats->failed;
+
+    for (i = 0; i < stats->num_latencies; ++i)
+    {
+        if (!record_latency(total, stats->latencies[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void print_report(
+    const struct options *options,
+    struct stats *total,
+    uint64_t elapsed)
+{
+    double seconds = elapsed / 1e6;
+
+    qsort(total->latencies, total->num_latencies, sizeof(uint64_t),
+          compare_uint64);
+
+    printf("routers:          %zu (%zu threads)\n", options->num_routers,
+           options->num_threads);
+    printf("elapsed:          %.3f s\n", seconds);
+    printf("queries:          %" PRIu64 " reset, %" PRIu64 " serial\n",
+           total->reset_queries, total->serial_queries);
+    printf("responses:        %" PRIu64 " (%.1f/s)\n", total->responses,
+           total->responses / seconds);
+    printf("cache resets:     %" PRIu64 "\n", total->cache_resets);
+    printf("error reports:    %" PRIu64 "\n", total->error_reports);
+    printf("serial notifies:  %" PRIu64 "\n", total->serial_notifies);
+    printf("prefixes:         %" PRIu64 " (%.1f/s)\n", total->prefixes,
+           total->prefixes / seconds);
+    printf("received:         %" PRIu64 " bytes (%.1f MB/s)\n", total->bytes,
+           total->bytes / seconds / 1e6);
+    printf("invalid routers:  %" PRIu64 "\n", total->invalid);
+    printf("failed routers:   %" PRIu64 "\n", total->failed);
+    printf("time to End of Data (ms):\n");
+    printf("    min  %10.3f\n",
+           total->num_latencies ? total->latencies[0] / 1e3 : 0.0);
+    printf("    p50  %10.3f\n",
+           quantile(total->latencies, total->num_latencies, 500) / 1e3);
+    printf("    p99  %10.3f\n",
+           quantile(total->latencies, total->num_latencies, 990) / 1e3);
+    printf("    p999 %10.3f\n",
+           quantile(total->latencies, total->num_latencies, 999) / 1e3);
+    printf("    max  %10.3f\n",
+           total->num_latencies ?
+           total->latencies[total->num_latencies - 1] / 1e3 : 0.0);
+}
+
+
+static void usage(
+    const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <host> <port>\n"
+            "\n"
+            "Simulate many routers querying rpki-rtr-daemon and report\n"
+            "throughput and latency.\n"
+            "\n"
+            "Options:\n"
+            "    -c <routers>   number of simultaneous routers (default %d)\n"
+            "    -t <threads>   number of threads (default %d)\n"
+            "    -n <queries>   queries per router (default %d)\n"
+            "    -r <percent>   percentage of queries after the first that\n"
+            "                   are Reset Queries instead of Serial Queries\n"
+            "                   (default %d)\n"
+            "    -i <ms>        delay between queries on each router\n"
+            "                   (default 0)\n"
+            "    -v             log more\n"
+            "    -h             print this help text\n",
+            argv0, DEFAULT_NUM_ROUTERS, DEFAULT_NUM_THREADS,
+            DEFAULT_NUM_QUERIES, DEFAULT_RESET_PERCENT);
+}
+
+static bool parse_size(
+    const char *str,
+    size_t *value)
+{
+    char *end;
+    unsigned long long v;
+
+    errno = 0;
+    v = strtoull(str, &end, 10);
+    if (errno != 0 || end == str || *end != '\0' || v > SIZE_MAX)
+    {
+        return false;
+    }
+
+    *value = (size_t)v;
+    return true;
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    struct options options = {
+        .host = NULL,
+        .port = NULL,
+        .num_routers = DEFAULT_NUM_ROUTERS,
+        .num_threads = DEFAULT_NUM_THREADS,
+        .num_queries = DEFAULT_NUM_QUERIES,
+        .reset_percent = DEFAULT_RESET_PERCENT,
+        .interval_ms = 0,
+        .verbose = false,
+    };
+    struct addrinfo hints;
+    struct addrinfo *addr = NULL;
+    struct worker *workers = NULL;
+    struct router *routers = NULL;
+    struct stats total;
+    size_t value;
+    size_t i;
+    size_t first;
+    uint64_t start;
+    uint64_t elapsed;
+    int ret = EXIT_FAILURE;
+    int retval;
+    int c;
+
+    memset(&total, 0, sizeof(total));
+
+    while ((c = getopt(argc, argv, "c:t:n:r:i:vh")) != -1)
+    {
+        switch (c)
+        {
+        case 'c':
+            if (!parse_size(optarg, &options.num_routers) ||
+                options.num_routers == 0)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 't':
+            if (!parse_size(optarg, &options.num_threads) ||
+                options.num_threads == 0)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'n':
+            if (!parse_size(optarg, &options.num_queries) ||
+                options.num_queries == 0)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'r':
+            if (!parse_size(optarg, &value) || value > 100)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            options.reset_percent = (unsigned int)value;
+            break;
+        case 'i':
+            if (!parse_size(optarg, &value) || value > 3600000)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            options.interval_ms = (unsigned int)value;
+            break;
+        case 'v':
+            options.verbose = true;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc - optind != 2)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    options.host = argv[optind];
+    options.port = argv[optind + 1];
+
+    if (options.num_threads > options.num_routers)
+    {
+        options.num_threads = options.num_routers;
+    }
+
+    OPEN_LOG("rpki-rtr-load-test", LOG_USER);
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    retval = getaddrinfo(options.host, options.port, &hints, &addr);
+    if (retval != 0)
+    {
+        LOG(LOG_ERR, "getaddrinfo(): %s", gai_strerror(retval));
+        goto done;
+    }
+
+    routers = calloc(options.num_routers, sizeof(struct router));
+    workers = calloc(options.num_threads, sizeof(struct worker));
+    if (routers == NULL || workers == NULL)
+    {
+        LOG(LOG_ERR, "out of memory");
+        goto done;
+    }
+
+    for (i = 0; i < options.num_routers; ++i)
+    {
+        routers[i].id = i;
+        routers[i].fd = -1;
+        routers[i].state = ROUTER_THINKING;
+        routers[i].have_data = false;
+        routers[i].queries_left = options.num_queries;
+        routers[i].next_query_time = 0;
+        routers[i].rand_state = (unsigned int)i;
+        routers[i].buffer_length = 0;
+    }
+
+    start = now_usec();
+
+    for (i = 0, first = 0; i < options.num_threads; ++i)
+    {
+        workers[i].options = &options;
+        workers[i].addr = addr;
+        workers[i].routers = &routers[first];
+        workers[i].num_routers = options.num_routers / options.num_threads +
+            (i < options.num_routers % options.num_threads ? 1 : 0);
+        first += workers[i].num_routers;
+
+        retval = pthread_create(&workers[i].thread, NULL, worker_main,
+                                &workers[i]);
+        if (retval != 0)
+        {
+            LOG(LOG_ERR, "pthread_create(): %s", strerror(retval));
+            options.num_threads = i;
+            break;
+        }
+    }
+
+    for (i = 0; i < options.num_threads; ++i)
+    {
+        retval = pthread_join(workers[i].thread, NULL);
+        if (retval != 0)
+        {
+            LOG(LOG_ERR, "pthread_join(): %s", strerror(retval));
+        }
+    }
+
+    elapsed = now_usec() - start;
+
+    for (i = 0; i < options.num_threads; ++i)
+    {
+        if (!merge_stats(&total, &workers[i].stats))
+        {
+            goto done;
+        }
+    }
+
+    print_report(&options, &total, elapsed);
+
+    ret = (total.invalid == 0 && total.failed == 0) ?
+        EXIT_SUCCESS : EXIT_FAILURE;
+
+done:
+    if (workers != NULL)
+    {
+        for (i = 0; i < options.num_threads; ++i)
+        {
+            free(workers[i].stats.latencies);
+        }
+    }
+    free(workers);
+    free(routers);
+    free(total.latencies);
+    if (addr != NULL)
+    {
+        freeaddrinfo(addr);
+    }
+
+    CLOSE_LOG();
+
+    return ret;
+}
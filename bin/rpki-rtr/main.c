@@ -11,12 +11,12 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <netdb.h>
+#include <time.h>
 
-#include "util/bag.h"
-#include "util/queue.h"
 #include "util/logging.h"
 #include "config/config.h"
 #include "db/connect.h"
+#include "rpki-rtr/notify.h"
 
 #include "cache_state.h"
 #include "config.h"
@@ -24,6 +24,7 @@
 
 #include "db.h"
 #include "connection_control.h"
+#include "metrics.h"
 
 
 // this is ok because there's only one main thread
@@ -48,31 +49,36 @@ struct run_state {
 
     bool config_loaded;
 
+    // number of connection control (acceptor) threads
+    size_t num_acceptors;
+
+    // number of addresses to listen on, each with one socket per acceptor
+    size_t num_listen_addrs;
+
     size_t listen_fds_initialized;
     int listen_fds[MAX_LISTENING_SOCKETS];
 
-    Queue *db_request_queue;
-    Bag *db_currently_processing;
-
-    db_semaphore_t * db_semaphore;
+    bool db_pool_initialized;
+    struct db_pool db_pool;
 
     void *db;
 
     bool global_cache_state_initialized;
     struct global_cache_state global_cache_state;
 
-    bool db_thread_initialized;
-    pthread_t *db_thread;
+    // socket for notifications from rpki-rtr-update, or -1 if not enabled
+    int notify_fd;
 
-    Bag *db_threads;
+    bool metrics_initialized;
+    struct metrics metrics;
 
-    bool connection_control_thread_initialized;
-    pthread_t connection_control_thread;
+    size_t connection_control_threads_initialized;
+    pthread_t connection_control_threads[MAX_ACCEPTOR_THREADS];
 
     // the below members are initialized by startup() and are not involved in
     // cleanup
-    struct db_main_args db_main_args;
-    struct connection_control_main_args connection_control_main_args;
+    struct connection_control_main_args
+        connection_control_main_args[MAX_ACCEPTOR_THREADS];
 };
 
 
@@ -81,26 +87,133 @@ static void initialize_run_state(
 {
     run_state->log_opened = false;
 
-    run_state->listen_fds_initialized = 0;
+    run_state->num_acceptors = 1;
+    run_state->num_listen_addrs = 0;
 
-    run_state->db_request_queue = NULL;
-    run_state->db_currently_processing = NULL;
+    run_state->listen_fds_initialized = 0;
 
-    run_state->db_semaphore = SEM_FAILED;
+    run_state->db_pool_initialized = false;
 
     run_state->db = NULL;
 
     run_state->global_cache_state_initialized = false;
 
-    run_state->db_thread_initialized = false;
-    run_state->db_thread = NULL;
+    run_state->notify_fd = -1;
+
+    run_state->metrics_initialized = false;
+
+    run_state->connection_control_threads_initialized = 0;
+}
+
+
+/**
+    Create, bind, and listen on a socket for one address.
+
+    @param reuseport Whether to set SO_REUSEPORT, so that other sockets
+        (one per acceptor thread) can listen on the same address.
+*/
+static void make_listen_socket(
+    struct run_state *run_state,
+    const struct addrinfo *resp,
+    bool reuseport)
+{
+    int retval;
+    int fd;
+    char listen_host[MAX_HOST_LENGTH];
+    char listen_serv[MAX_SERVICE_LENGTH];
+
+    if (run_state->listen_fds_initialized >= MAX_LISTENING_SOCKETS)
+    {
+        LOG(LOG_ERR, "can't listen on more than %d sockets, "
+            "increase the limit in rtr/config.h if needed",
+            MAX_LISTENING_SOCKETS);
+        exit_code = EXIT_FAILURE;
+        pthread_exit(NULL);
+    }
+
+    fd = socket(resp->ai_family, resp->ai_socktype, resp->ai_protocol);
+    if (fd == -1)
+    {
+        ERR_LOG(errno, errorbuf, "socket()");
+        exit_code = EXIT_FAILURE;
+        pthread_exit(NULL);
+    }
+    run_state->listen_fds[run_state->listen_fds_initialized] = fd;
+    ++run_state->listen_fds_initialized;
+
+    if (resp->ai_family == AF_INET6)
+    {
+        // prevent AF_INET6 sockets from contending with AF_INET sockets
+        int optval = true;
+        if (setsockopt
+            (fd, IPPROTO_IPV6, IPV6_V6ONLY, &optval, sizeof(optval)) != 0)
+        {
+            ERR_LOG(errno, errorbuf, "setsockopt()");
+        }
+    }
+
+    if (reuseport)
+    {
+#ifdef SO_REUSEPORT
+        int optval = true;
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval))
+            != 0)
+        {
+            ERR_LOG(errno, errorbuf, "setsockopt(SO_REUSEPORT)");
+            exit_code = EXIT_FAILURE;
+            pthread_exit(NULL);
+        }
+#else
+        LOG(LOG_ERR, "SO_REUSEPORT is not supported on this system, "
+            "set RpkiRtrAcceptorThreads to 1");
+        exit_code = EXIT_FAILURE;
+        pthread_exit(NULL);
+#endif
+    }
+
+    retval = getnameinfo(resp->ai_addr, resp->ai_addrlen,
+                         listen_host, sizeof(listen_host),
+                         listen_serv, sizeof(listen_serv),
+                         NI_NUMERICHOST | NI_NUMERICSERV);
+    if (retval != 0)
+    {
+        LOG(LOG_ERR, "getnameinfo(): %s", gai_strerror(retval));
+        exit_code = EXIT_FAILURE;
+        pthread_exit(NULL);
+    }
+
+    if (bind(fd, resp->ai_addr, resp->ai_addrlen) != 0)
+    {
+        ERR_LOG(errno, errorbuf, "bind([%s]:%s)", listen_host, listen_serv);
+        exit_code = EXIT_FAILURE;
+        pthread_exit(NULL);
+    }
+
+    if (listen(fd, INT_MAX) != 0)
+    {
+        ERR_LOG(errno, errorbuf, "listen([%s]:%s)", listen_host,
+                listen_serv);
+        exit_code = EXIT_FAILURE;
+        pthread_exit(NULL);
+    }
 
-    run_state->db_threads = NULL;
+    LOG(LOG_INFO, "listening on [%s]:%s", listen_host, listen_serv);
+}
 
-    run_state->connection_control_thread_initialized = false;
+static void free_addrinfo(
+    void *res)
+{
+    freeaddrinfo((struct addrinfo *)res);
 }
 
+/**
+    Make listening sockets for each acceptor thread.
 
+    The sockets for acceptor i are listen_fds[i * num_listen_addrs]
+    through listen_fds[(i + 1) * num_listen_addrs - 1]. With more than
+    one acceptor, every socket for the same address has SO_REUSEPORT
+    set, and the kernel spreads new connections across them.
+*/
 static void make_listen_sockets(
     struct run_state *run_state,
     const char *node,
@@ -110,8 +223,7 @@ static void make_listen_sockets(
     struct addrinfo hints,
        *res,
        *resp;
-    char listen_host[MAX_HOST_LENGTH];
-    char listen_serv[MAX_SERVICE_LENGTH];
+    size_t acceptor;
 
     hints.ai_flags = AI_PASSIVE;
     hints.ai_family = AF_UNSPEC;
@@ -133,204 +245,92 @@ static void make_listen_sockets(
         pthread_exit(NULL);
     }
 
+    // Free res if make_listen_socket() exits.
+    pthread_cleanup_push(free_addrinfo, res);
+
+    run_state->num_listen_addrs = 0;
     for (resp = res; resp != NULL; resp = resp->ai_next)
     {
-        if (run_state->listen_fds_initialized >= MAX_LISTENING_SOCKETS)
-        {
-            LOG(LOG_ERR, "can't listen on more than %d sockets, "
-                "increase the limit in rtr/config.h if needed",
-                MAX_LISTENING_SOCKETS);
-            freeaddrinfo(res);
-            exit_code = EXIT_FAILURE;
-            pthread_exit(NULL);
-        }
-
-        run_state->listen_fds[run_state->listen_fds_initialized] =
-            socket(resp->ai_family, resp->ai_socktype, resp->ai_protocol);
-        if (run_state->listen_fds[run_state->listen_fds_initialized] == -1)
-        {
-            ERR_LOG(errno, errorbuf, "socket()");
-            freeaddrinfo(res);
-            exit_code = EXIT_FAILURE;
-            pthread_exit(NULL);
-        }
-        ++run_state->listen_fds_initialized;
-
-        if (resp->ai_family == AF_INET6)
-        {
-            // prevent AF_INET6 sockets from contending with AF_INET sockets
-            int optval = true;
-            if (setsockopt
-                (run_state->listen_fds[run_state->listen_fds_initialized - 1],
-                 IPPROTO_IPV6, IPV6_V6ONLY, &optval, sizeof(optval)) != 0)
-            {
-                ERR_LOG(errno, errorbuf, "setsockopt()");
-            }
-        }
-
-        retval = getnameinfo(resp->ai_addr, resp->ai_addrlen,
-                             listen_host, sizeof(listen_host),
-                             listen_serv, sizeof(listen_serv),
-                             NI_NUMERICHOST | NI_NUMERICSERV);
-        if (retval != 0)
-        {
-            LOG(LOG_ERR, "getnameinfo(): %s", gai_strerror(retval));
-            freeaddrinfo(res);
-            exit_code = EXIT_FAILURE;
-            pthread_exit(NULL);
-        }
-
-        if (bind(run_state->listen_fds[run_state->listen_fds_initialized - 1],
-                 resp->ai_addr, resp->ai_addrlen) != 0)
-        {
-            ERR_LOG(errno, errorbuf, "bind([%s]:%s)", listen_host,
-                    listen_serv);
-            freeaddrinfo(res);
-            exit_code = EXIT_FAILURE;
-            pthread_exit(NULL);
-        }
+        ++run_state->num_listen_addrs;
+    }
 
-        if (listen
-            (run_state->listen_fds[run_state->listen_fds_initialized - 1],
-             INT_MAX) != 0)
+    for (acceptor = 0; acceptor < run_state->num_acceptors; ++acceptor)
+    {
+        for (resp = res; resp != NULL; resp = resp->ai_next)
         {
-            ERR_LOG(errno, errorbuf, "listen([%s]:%s)", listen_host,
-                    listen_serv);
-            freeaddrinfo(res);
-            exit_code = EXIT_FAILURE;
-            pthread_exit(NULL);
+            make_listen_socket(run_state, resp, run_state->num_acceptors > 1);
         }
-
-        LOG(LOG_INFO, "listening on [%s]:%s", listen_host, listen_serv);
     }
 
-    freeaddrinfo(res);
+    pthread_cleanup_pop(1);
 
     unblock_signals();
 }
 
 
-static bool create_db_thread(
-    struct run_state *run_state)
+/**
+    Check the timing parameters sent to version 1 routers against the
+    ranges allowed by RFC 8210, Section 6.
+*/
+static bool check_timing_config(
+    void)
 {
-    int retval;
+    size_t refresh = CONFIG_RPKI_RTR_REFRESH_INTERVAL_get();
+    size_t retry = CONFIG_RPKI_RTR_RETRY_INTERVAL_get();
+    size_t expire = CONFIG_RPKI_RTR_EXPIRE_INTERVAL_get();
 
-    block_signals();
-    run_state->db_thread_initialized = false;
-    run_state->db_thread = malloc(sizeof(pthread_t));
-    unblock_signals();
-    if (run_state->db_thread == NULL)
+    if (refresh < RTR_REFRESH_INTERVAL_MIN ||
+        refresh > RTR_REFRESH_INTERVAL_MAX)
     {
-        LOG(LOG_ERR, "can't allocate memory for db thread id");
+        LOG(LOG_ERR, "RpkiRtrRefreshInterval must be between %d and %d",
+            RTR_REFRESH_INTERVAL_MIN, RTR_REFRESH_INTERVAL_MAX);
         return false;
     }
 
-    block_signals();
-    retval =
-        pthread_create(run_state->db_thread, NULL, db_main,
-                       &run_state->db_main_args);
-    run_state->db_thread_initialized = (retval == 0);
-    if (retval != 0)
+    if (retry < RTR_RETRY_INTERVAL_MIN || retry > RTR_RETRY_INTERVAL_MAX)
     {
-        ERR_LOG(retval, errorbuf, "pthread_create()");
-        free(run_state->db_thread);
-        run_state->db_thread = NULL;
-        unblock_signals();
+        LOG(LOG_ERR, "RpkiRtrRetryInterval must be between %d and %d",
+            RTR_RETRY_INTERVAL_MIN, RTR_RETRY_INTERVAL_MAX);
         return false;
     }
-    unblock_signals();
 
-    block_signals();
-    if (!Bag_add(run_state->db_threads, run_state->db_thread))
+    if (expire < RTR_EXPIRE_INTERVAL_MIN || expire > RTR_EXPIRE_INTERVAL_MAX)
     {
-        LOG(LOG_ERR, "can't add db thread id to bag");
-
-        retval = pthread_cancel(*run_state->db_thread);
-        if (retval != 0)
-        {
-            ERR_LOG(retval, errorbuf, "pthread_cancel()");
-        }
-
-        retval = pthread_join(*run_state->db_thread, NULL);
-        if (retval != 0)
-        {
-            ERR_LOG(retval, errorbuf, "pthread_join()");
-        }
-
-        run_state->db_thread_initialized = false;
-
-        // Commented out because free and pointer assignment should be pretty
-        // fast,
-        // so testing for signals is unnecessary here.
-        // unblock_signals();
-        // block_signals();
-
-        free(run_state->db_thread);
-        run_state->db_thread = NULL;
-
-        unblock_signals();
-
+        LOG(LOG_ERR, "RpkiRtrExpireInterval must be between %d and %d",
+            RTR_EXPIRE_INTERVAL_MIN, RTR_EXPIRE_INTERVAL_MAX);
         return false;
     }
 
-    run_state->db_thread = NULL;
-    run_state->db_thread_initialized = false;
-
-    unblock_signals();
+    if (expire <= refresh || expire <= retry)
+    {
+        LOG(LOG_ERR,
+            "RpkiRtrExpireInterval must be larger than RpkiRtrRefreshInterval and RpkiRtrRetryInterval");
+        return false;
+    }
 
     return true;
 }
 
-// NOTE: this does not do signal handling, so it can only be called when
-// signals
-// are already blocked, e.g. in cleanup().
-static void cancel_all_db_threads(
-    Bag * db_threads)
+
+static void write_metrics(
+    struct run_state *run_state,
+    const char *path)
 {
-    Bag_iterator it;
-    int retval;
-    pthread_t *thread;
+    struct metrics_gauges gauges;
+    struct cache_generation *generation;
 
-    if (!Bag_start_iteration(db_threads))
-    {
-        LOG(LOG_ERR, "error in Bag_start_iteration(db_threads)");
-        return;
-    }
-    for (it = Bag_begin(db_threads);
-         it != Bag_end(db_threads); it = Bag_iterator_next(db_threads, it))
-    {
-        thread = Bag_get(db_threads, it);
+    generation = pin_cache_generation(&run_state->global_cache_state);
+    gauges.data_available = generation->cache_state.data_available;
+    gauges.session = generation->cache_state.session;
+    gauges.serial_number = generation->cache_state.serial_number;
+    unpin_cache_generation(generation);
 
-        if (thread == NULL)
-        {
-            LOG(LOG_ERR, "got NULL thread id pointer");
-            continue;
-        }
+    db_pool_get_gauges(&run_state->db_pool, &gauges);
 
-        retval = pthread_cancel(*thread);
-        if (retval != 0)
-        {
-            ERR_LOG(retval, errorbuf, "pthread_cancel()");
-        }
-    }
-    for (it = Bag_begin(db_threads);
-         it != Bag_end(db_threads); it = Bag_erase(db_threads, it))
+    if (!metrics_write(&run_state->metrics, &gauges, path))
     {
-        thread = Bag_get(db_threads, it);
-
-        if (thread == NULL)
-            continue;
-
-        retval = pthread_join(*thread, NULL);
-        if (retval != 0)
-        {
-            ERR_LOG(retval, errorbuf, "pthread_join()");
-        }
-
-        free((void *)thread);
+        LOG(LOG_NOTICE, "error writing metrics to %s", path);
     }
-    Bag_stop_iteration(db_threads);     // return value doesn't really matter
-                                        // here
 }
 
 
@@ -339,64 +339,45 @@ static void cleanup(
 {
     struct run_state *run_state = (struct run_state *)run_state_voidp;
     int retval;
+    size_t i;
 
-    if (run_state->connection_control_thread_initialized)
+    if (run_state->connection_control_threads_initialized > 0)
     {
-        LOG(LOG_NOTICE, "Stopping connection control thread...");
+        LOG(LOG_NOTICE, "Stopping connection control threads...");
 
-        retval = pthread_cancel(run_state->connection_control_thread);
-        if (retval != 0)
+        for (i = 0; i < run_state->connection_control_threads_initialized; ++i)
         {
-            ERR_LOG(retval, errorbuf, "pthread_cancel(connection_control)");
+            retval =
+                pthread_cancel(run_state->connection_control_threads[i]);
+            if (retval != 0)
+            {
+                ERR_LOG(retval, errorbuf,
+                        "pthread_cancel(connection_control)");
+            }
         }
 
-        retval = pthread_join(run_state->connection_control_thread, NULL);
-        if (retval != 0)
+        for (i = 0; i < run_state->connection_control_threads_initialized; ++i)
         {
-            ERR_LOG(retval, errorbuf, "pthread_join(connection_control)");
+            retval =
+                pthread_join(run_state->connection_control_threads[i], NULL);
+            if (retval != 0)
+            {
+                ERR_LOG(retval, errorbuf, "pthread_join(connection_control)");
+            }
         }
 
-        run_state->connection_control_thread_initialized = false;
-
-        LOG(LOG_NOTICE, "... done stopping connection control thread");
-    }
-
-    if (run_state->db_threads != NULL)
-    {
-        LOG(LOG_NOTICE, "Stopping active db threads...");
-
-        cancel_all_db_threads(run_state->db_threads);
-        Bag_free(run_state->db_threads);
-        run_state->db_threads = NULL;
+        run_state->connection_control_threads_initialized = 0;
 
-        LOG(LOG_NOTICE, "... done stopping active db threads");
+        LOG(LOG_NOTICE, "... done stopping connection control threads");
     }
 
-    if (run_state->db_thread != NULL)
+    if (run_state->db_pool_initialized)
     {
-        if (run_state->db_thread_initialized)
-        {
-            LOG(LOG_NOTICE, "Stopping inactive db thread...");
-
-            retval = pthread_cancel(*run_state->db_thread);
-            if (retval != 0)
-            {
-                ERR_LOG(retval, errorbuf, "pthread_cancel(db_thread)");
-            }
+        LOG(LOG_NOTICE, "Stopping db threads...");
 
-            retval = pthread_join(*run_state->db_thread, NULL);
-            if (retval != 0)
-            {
-                ERR_LOG(retval, errorbuf, "pthread_join(db_thread)");
-            }
-
-            run_state->db_thread_initialized = false;
+        db_pool_stop(&run_state->db_pool);
 
-            LOG(LOG_NOTICE, "... done stopping inactive db thread");
-        }
-
-        free(run_state->db_thread);
-        run_state->db_thread = NULL;
+        LOG(LOG_NOTICE, "... done stopping db threads");
     }
 
     if (run_state->global_cache_state_initialized)
@@ -413,23 +394,23 @@ static void cleanup(
         db_close();
     }
 
-    if (run_state->db_semaphore != SEM_FAILED)
+    if (run_state->db_pool_initialized)
     {
-        if (semcompat_free(run_state->db_semaphore) != 0)
-            ERR_LOG(errno, errorbuf, "semcompat_free()");
-        run_state->db_semaphore = SEM_FAILED;
+        db_pool_close(&run_state->db_pool);
+        run_state->db_pool_initialized = false;
     }
 
-    if (run_state->db_currently_processing != NULL)
+    if (run_state->notify_fd >= 0)
     {
-        Bag_free(run_state->db_currently_processing);
-        run_state->db_currently_processing = NULL;
+        rtr_notify_close(run_state->notify_fd,
+                         CONFIG_RPKI_RTR_NOTIFY_SOCKET_get());
+        run_state->notify_fd = -1;
     }
 
-    if (run_state->db_request_queue != NULL)
+    if (run_state->metrics_initialized)
     {
-        Queue_free(run_state->db_request_queue);
-        run_state->db_request_queue = NULL;
+        metrics_close(&run_state->metrics);
+        run_state->metrics_initialized = false;
     }
 
     for (; run_state->listen_fds_initialized > 0;
@@ -462,8 +443,8 @@ static void cleanup(
 static void startup(
     struct run_state *run_state)
 {
-    int retval,
-        i;
+    int retval;
+    size_t i;
 
     block_signals();
     OPEN_LOG(RTR_LOG_IDENT, RTR_LOG_FACILITY);
@@ -480,45 +461,33 @@ static void startup(
     }
     unblock_signals();
 
-    make_listen_sockets(run_state, NULL, LISTEN_PORT);
-
-    if (run_state->listen_fds_initialized <= 0)
+    run_state->num_acceptors = CONFIG_RPKI_RTR_ACCEPTOR_THREADS_get();
+    if (run_state->num_acceptors < 1 ||
+        run_state->num_acceptors > MAX_ACCEPTOR_THREADS)
     {
-        LOG(LOG_ERR, "no sockets to listen on");
+        LOG(LOG_ERR, "RpkiRtrAcceptorThreads must be between 1 and %d",
+            MAX_ACCEPTOR_THREADS);
         block_signals();
         exit_code = EXIT_FAILURE;
         pthread_exit(NULL);
     }
 
-    block_signals();
-    run_state->db_request_queue = Queue_new(true);
-    if (run_state->db_request_queue == NULL)
+    if (!check_timing_config())
     {
-        LOG(LOG_ERR, "can't create db_request_queue");
+        block_signals();
         exit_code = EXIT_FAILURE;
         pthread_exit(NULL);
     }
-    unblock_signals();
 
-    block_signals();
-    run_state->db_currently_processing = Bag_new(true);
-    if (run_state->db_currently_processing == NULL)
-    {
-        LOG(LOG_ERR, "can't create db_currently_processing");
-        exit_code = EXIT_FAILURE;
-        pthread_exit(NULL);
-    }
-    unblock_signals();
+    make_listen_sockets(run_state, NULL, LISTEN_PORT);
 
-    block_signals();
-    run_state->db_semaphore = semcompat_new(0, 0);
-    if (run_state->db_semaphore == SEM_FAILED)
+    if (run_state->listen_fds_initialized <= 0)
     {
-        ERR_LOG(errno, errorbuf, "semcompat_new() for db_semaphore");
+        LOG(LOG_ERR, "no sockets to listen on");
+        block_signals();
         exit_code = EXIT_FAILURE;
         pthread_exit(NULL);
     }
-    unblock_signals();
 
     block_signals();
     if (!db_init())
@@ -556,55 +525,73 @@ static void startup(
     run_state->global_cache_state_initialized = true;
     unblock_signals();
 
-    block_signals();
-    run_state->db_threads = Bag_new(false);
-    if (run_state->db_threads == NULL)
-    {
-        LOG(LOG_ERR, "can't create db_threads");
-        exit_code = EXIT_FAILURE;
-        pthread_exit(NULL);
-    }
-    unblock_signals();
-
-    run_state->db_main_args.semaphore = run_state->db_semaphore;
-    run_state->db_main_args.db_request_queue = run_state->db_request_queue;
-    run_state->db_main_args.db_currently_processing =
-        run_state->db_currently_processing;
-
-    for (i = 0; i < DB_INITIAL_THREADS; ++i)
+    if (CONFIG_RPKI_RTR_NOTIFY_SOCKET_get() != NULL)
     {
-        if (!create_db_thread(run_state))
+        block_signals();
+        run_state->notify_fd =
+            rtr_notify_listen(CONFIG_RPKI_RTR_NOTIFY_SOCKET_get());
+        if (run_state->notify_fd < 0)
         {
-            LOG(LOG_ERR, "error creating db thread");
-            block_signals();
+            LOG(LOG_ERR, "can't listen for notifications on %s",
+                CONFIG_RPKI_RTR_NOTIFY_SOCKET_get());
             exit_code = EXIT_FAILURE;
             pthread_exit(NULL);
         }
+        unblock_signals();
     }
 
-    run_state->connection_control_main_args.listen_fds = run_state->listen_fds;
-    run_state->connection_control_main_args.num_listen_fds =
-        run_state->listen_fds_initialized;
-    run_state->connection_control_main_args.db_request_queue =
-        run_state->db_request_queue;
-    run_state->connection_control_main_args.db_semaphore =
-        run_state->db_semaphore;
-    run_state->connection_control_main_args.global_cache_state =
-        &run_state->global_cache_state;
+    block_signals();
+    if (!metrics_init(&run_state->metrics))
+    {
+        LOG(LOG_ERR, "can't initialize metrics");
+        exit_code = EXIT_FAILURE;
+        pthread_exit(NULL);
+    }
+    run_state->metrics_initialized = true;
+    unblock_signals();
 
     block_signals();
-    retval = pthread_create(&run_state->connection_control_thread, NULL,
-                            connection_control_main,
-                            &run_state->connection_control_main_args);
-    if (retval != 0)
+    if (!db_pool_init(&run_state->db_pool, DB_MIN_THREADS, DB_MAX_THREADS,
+                      &run_state->metrics))
     {
-        ERR_LOG(retval, errorbuf,
-                "pthread_create() for connection control thread");
+        LOG(LOG_ERR, "can't initialize db thread pool");
+        exit_code = EXIT_FAILURE;
+        pthread_exit(NULL);
+    }
+    run_state->db_pool_initialized = true;
+    if (!db_pool_start(&run_state->db_pool))
+    {
+        LOG(LOG_ERR, "error creating db threads");
         exit_code = EXIT_FAILURE;
         pthread_exit(NULL);
     }
-    run_state->connection_control_thread_initialized = true;
     unblock_signals();
+
+    for (i = 0; i < run_state->num_acceptors; ++i)
+    {
+        struct connection_control_main_args *args =
+            &run_state->connection_control_main_args[i];
+
+        args->listen_fds =
+            &run_state->listen_fds[i * run_state->num_listen_addrs];
+        args->num_listen_fds = run_state->num_listen_addrs;
+        args->db_pool = &run_state->db_pool;
+        args->global_cache_state = &run_state->global_cache_state;
+        args->metrics = &run_state->metrics;
+
+        block_signals();
+        retval = pthread_create(&run_state->connection_control_threads[i],
+                                NULL, connection_control_main, args);
+        if (retval != 0)
+        {
+            ERR_LOG(retval, errorbuf,
+                    "pthread_create() for connection control thread");
+            exit_code = EXIT_FAILURE;
+            pthread_exit(NULL);
+        }
+        ++run_state->connection_control_threads_initialized;
+        unblock_signals();
+    }
 }
 
 
@@ -624,12 +611,38 @@ int main(
 
     startup(&run_state);
 
+    const char *metrics_file = CONFIG_RPKI_RTR_METRICS_FILE_get();
+    time_t next_update_time = 0;
+    time_t next_metrics_time = 0;
+
     while (true)
     {
-        sleep(MAIN_LOOP_INTERVAL);
+        if (metrics_file != NULL && time(NULL) >= next_metrics_time)
+        {
+            block_signals();
+            write_metrics(&run_state, metrics_file);
+            unblock_signals();
+            next_metrics_time = time(NULL) + METRICS_INTERVAL;
+        }
 
-        // TODO: Check the load on the database threads, adding or removing
-        // threads as needed.
+        if (run_state.notify_fd >= 0)
+        {
+            // Wake up as soon as rpki-rtr-update has a new serial number,
+            // or in time to write the metrics file.
+            if (!rtr_notify_wait(run_state.notify_fd,
+                                 metrics_file != NULL ?
+                                 METRICS_INTERVAL :
+                                 MAIN_LOOP_NOTIFY_INTERVAL) &&
+                time(NULL) < next_update_time)
+            {
+                continue;
+            }
+            next_update_time = time(NULL) + MAIN_LOOP_NOTIFY_INTERVAL;
+        }
+        else
+        {
+            sleep(MAIN_LOOP_INTERVAL);
+        }
 
         block_signals();
         if (!update_global_cache_state
@@ -0,0 +1,507 @@
+#include "metrics.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util/logging.h"
+
+
+static const uint64_t histogram_bounds[METRICS_NUM_BUCKETS - 1] = {
+    METRICS_HISTOGRAM_BOUNDS
+};
+
+static const char *const query_type_names[METRICS_NUM_QUERY_TYPES] = {
+    "serial",
+    "reset",
+};
+
+static const char *const query_source_names[METRICS_NUM_QUERY_SOURCES] = {
+    "database",
+    "snapshot",
+};
+
+
+static uint64_t load(
+    const uint64_t *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+
+bool metrics_init(
+    struct metrics *metrics)
+{
+    int retval;
+
+    memset(metrics, 0, sizeof(*metrics));
+
+    retval = pthread_mutex_init(&metrics->sessions_mutex, NULL);
+    if (retval != 0)
+    {
+        ERR_LOG(retval, NULL, "pthread_mutex_init()");
+        return false;
+    }
+
+    metrics->sessions = NULL;
+
+    return true;
+}
+
+
+void metrics_close(
+    struct metrics *metrics)
+{
+    int retval = pthread_mutex_destroy(&metrics->sessions_mutex);
+    if (retval != 0)
+    {
+        ERR_LOG(retval, NULL, "pthread_mutex_destroy()");
+    }
+}
+
+
+bool metrics_session_start(
+    struct metrics *metrics,
+    struct metrics_session *session,
+    const char *host,
+    const char *serv)
+{
+    int retval;
+
+    memset(session, 0, sizeof(*session));
+    snprintf(session->host, sizeof(session->host), "%s", host);
+    snprintf(session->serv, sizeof(session->serv), "%s", serv);
+    session->connected = time(NULL);
+    session->protocol_version = RTR_PROTOCOL_VERSION_MAX + 1;
+
+    retval = pthread_mutex_lock(&metrics->sessions_mutex);
+    if (retval != 0)
+    {
+        ERR_LOG(retval, NULL, "pthread_mutex_lock()");
+        return false;
+    }
+
+    session->prev = NULL;
+    session->next = metrics->sessions;
+    if (metrics->sessions != NULL)
+    {
+        metrics->sessions->prev = session;
+    }
+    metrics->sessions = session;
+    ++metrics->sessions_active;
+    ++metrics->sessions_total;
+
+    retval = pthread_mutex_unlock(&metrics->sessions_mutex);
+    if (retval != 0)
+    {
+        ERR_LOG(retval, NULL, "pthread_mutex_unlock()");
+    }
+
+    return true;
+}
+
+
+void metrics_session_end(
+    struct metrics *metrics,
+    struct metrics_session *session)
+{
+    int retval;
+
+    retval = pthread_mutex_lock(&metrics->sessions_mutex);
+    if (retval != 0)
+    {
+        ERR_LOG(retval, NULL, "pthread_mutex_lock()");
+        return;
+    }
+
+    if (session->prev != NULL)
+    {
+        session->prev->next = session->next;
+    }
+    else
+    {
+        metrics->sessions = session->next;
+    }
+    if (session->next != NULL)
+    {
+        session->next->prev = session->prev;
+    }
+    --metrics->sessions_active;
+
+    retval = pthread_mutex_unlock(&metrics->sessions_mutex);
+    if (retval != 0)
+    {
+        ERR_LOG(retval, NULL, "pthread_mutex_unlock()");
+    }
+}
+
+
+uint64_t metrics_elapsed_usec(
+    const struct timespec *start)
+{
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+    {
+        return 0;
+    }
+
+    return (uint64_t)(now.tv_sec - start->tv_sec) * 1000000 +
+        (uint64_t)(now.tv_nsec / 1000) - (uint64_t)(start->tv_nsec / 1000);
+}
+
+
+void metrics_observe(
+    struct metrics_histogram *histogram,
+    uint64_t usec)
+{
+    size_t i;
+
+    for (i = 0; i < METRICS_NUM_BUCKETS - 1; ++i)
+    {
+        if (usec <= histogram_bounds[i])
+        {
+            break;
+        }
+    }
+
+    metrics_add(&histogram->buckets[i], 1);
+    metrics_add(&histogram->sum_usec, usec);
+    metrics_add(&histogram->count, 1);
+}
+
+
+/** Print a label value with the escaping required by the text format. */
+static void print_label_value(
+    FILE * out,
+    const char *value)
+{
+    for (; *value != '\0'; ++value)
+    {
+        switch (*value)
+        {
+        case '\\':
+            fputs("\\\\", out);
+            break;
+        case '"':
+            fputs("\\\"", out);
+            break;
+        case '\n':
+            fputs("\\n", out);
+            break;
+        default:
+            fputc(*value, out);
+            break;
+        }
+    }
+}
+
+/**
+   Print one histogram. @p labels is either empty or a comma-separated
+   list of labels, without braces.
+*/
+static void print_histogram(
+    FILE * out,
+    const char *name,
+    const char *labels,
+    const struct metrics_histogram *histogram)
+{
+    uint64_t cumulative = 0;
+    size_t i;
+    const char *sep = labels[0] == '\0' ? "" : ",";
+
+    for (i = 0; i < METRICS_NUM_BUCKETS - 1; ++i)
+    {
+        cumulative += load(&histogram->buckets[i]);
+        fprintf(out, "%s_bucket{%s%sle=\"%g\"} %" PRIu64 "\n", name, labels,
+                sep, histogram_bounds[i] / 1e6, cumulative);
+    }
+    cumulative += load(&histogram->buckets[i]);
+    fprintf(out, "%s_bucket{%s%sle=\"+Inf\"} %" PRIu64 "\n", name, labels,
+            sep, cumulative);
+
+    if (labels[0] == '\0')
+    {
+        fprintf(out, "%s_sum %.6f\n", name,
+                load(&histogram->sum_usec) / 1e6);
+        fprintf(out, "%s_count %" PRIu64 "\n", name,
+                load(&histogram->count));
+    }
+    else
+    {
+        fprintf(out, "%s_sum{%s} %.6f\n", name, labels,
+                load(&histogram->sum_usec) / 1e6);
+        fprintf(out, "%s_count{%s} %" PRIu64 "\n", name, labels,
+                load(&histogram->count));
+    }
+}
+
+static void print_header(
+    FILE * out,
+    const char *name,
+    const char *type,
+    const char *help)
+{
+    fprintf(out, "# HELP %s %s\n", name, help);
+    fprintf(out, "# TYPE %s %s\n", name, type);
+}
+
+static void print_sessions(
+    FILE * out,
+    struct metrics *metrics)
+{
+    struct metrics_session *session;
+    size_t i;
+
+#define SESSION_LABELS(session)                                         \
+    do {                                                                \
+        fputs("{host=\"", out);                                         \
+        print_label_value(out, (session)->host);                        \
+        fputs("\",port=\"", out);                                       \
+        print_label_value(out, (session)->serv);                        \
+        fputs("\"", out);                                               \
+    } while (false)
+
+    print_header(out, "rpki_rtr_session_start_time_seconds", "gauge",
+                 "Time each current session started, in seconds since the epoch.");
+    for (session = metrics->sessions; session != NULL;
+         session = session->next)
+    {
+        fputs("rpki_rtr_session_start_time_seconds", out);
+        SESSION_LABELS(session);
+        fprintf(out, "} %jd\n", (intmax_t)session->connected);
+    }
+
+    print_header(out, "rpki_rtr_session_protocol_version", "gauge",
+                 "Protocol version negotiated by each current session.");
+    for (session = metrics->sessions; session != NULL;
+         session = session->next)
+    {
+        uint8_t version = __atomic_load_n(&session->protocol_version,
+                                          __ATOMIC_RELAXED);
+        if (version > RTR_PROTOCOL_VERSION_MAX)
+        {
+            continue;
+        }
+        fputs("rpki_rtr_session_protocol_version", out);
+        SESSION_LABELS(session);
+        fprintf(out, "} %" PRIu8 "\n", version);
+    }
+
+    print_header(out, "rpki_rtr_session_pdus_received_total", "counter",
+                 "PDUs received by each current session.");
+    for (session = metrics->sessions; session != NULL;
+         session = session->next)
+    {
+        fputs("rpki_rtr_session_pdus_received_total", out);
+        SESSION_LABELS(session);
+        fprintf(out, "} %" PRIu64 "\n", load(&session->pdus_received));
+    }
+
+    print_header(out, "rpki_rtr_session_pdus_sent_total", "counter",
+                 "PDUs sent by each current session.");
+    for (session = metrics->sessions; session != NULL;
+         session = session->next)
+    {
+        fputs("rpki_rtr_session_pdus_sent_total", out);
+        SESSION_LABELS(session);
+        fprintf(out, "} %" PRIu64 "\n", load(&session->pdus_sent));
+    }
+
+    print_header(out, "rpki_rtr_session_bytes_sent_total", "counter",
+                 "Bytes sent by each current session.");
+    for (session = metrics->sessions; session != NULL;
+         session = session->next)
+    {
+        fputs("rpki_rtr_session_bytes_sent_total", out);
+        SESSION_LABELS(session);
+        fprintf(out, "} %" PRIu64 "\n", load(&session->bytes_sent));
+    }
+
+    print_header(out, "rpki_rtr_session_queries_total", "counter",
+                 "Queries received by each current session.");
+    for (session = metrics->sessions; session != NULL;
+         session = session->next)
+    {
+        for (i = 0; i < METRICS_NUM_QUERY_TYPES; ++i)
+        {
+            fputs("rpki_rtr_session_queries_total", out);
+            SESSION_LABELS(session);
+            fprintf(out, ",query=\"%s\"} %" PRIu64 "\n",
+                    query_type_names[i], load(&session->queries[i]));
+        }
+    }
+
+#undef SESSION_LABELS
+}
+
+static void print_metrics(
+    FILE * out,
+    struct metrics *metrics,
+    const struct metrics_gauges *gauges)
+{
+    char labels[64];
+    size_t i,
+        j;
+
+    print_header(out, "rpki_rtr_data_available", "gauge",
+                 "Whether the cache has data to serve.");
+    fprintf(out, "rpki_rtr_data_available %d\n",
+            gauges->data_available ? 1 : 0);
+
+    if (gauges->data_available)
+    {
+        print_header(out, "rpki_rtr_serial_number", "gauge",
+                     "Serial number of the data being served.");
+        fprintf(out, "rpki_rtr_serial_number{session_id=\"%" PRISESSION
+                "\"} %" PRISERIAL "\n", gauges->session,
+                gauges->serial_number);
+    }
+
+    print_header(out, "rpki_rtr_sessions", "gauge",
+                 "Number of connections from routers.");
+    fprintf(out, "rpki_rtr_sessions %zu\n", metrics->sessions_active);
+
+    print_header(out, "rpki_rtr_sessions_total", "counter",
+                 "Number of connections from routers since startup.");
+    fprintf(out, "rpki_rtr_sessions_total %" PRIu64 "\n",
+            metrics->sessions_total);
+
+    print_header(out, "rpki_rtr_pdus_received_total", "counter",
+                 "PDUs received from routers.");
+    fprintf(out, "rpki_rtr_pdus_received_total %" PRIu64 "\n",
+            load(&metrics->pdus_received));
+
+    print_header(out, "rpki_rtr_pdus_sent_total", "counter",
+                 "PDUs sent to routers.");
+    fprintf(out, "rpki_rtr_pdus_sent_total %" PRIu64 "\n",
+            load(&metrics->pdus_sent));
+
+    print_header(out, "rpki_rtr_bytes_sent_total", "counter",
+                 "Bytes of PDUs sent to routers.");
+    fprintf(out, "rpki_rtr_bytes_sent_total %" PRIu64 "\n",
+            load(&metrics->bytes_sent));
+
+    print_header(out, "rpki_rtr_error_reports_sent_total", "counter",
+                 "Error Report PDUs sent to routers.");
+    fprintf(out, "rpki_rtr_error_reports_sent_total %" PRIu64 "\n",
+            load(&metrics->errors_sent));
+
+    print_header(out, "rpki_rtr_queries_total", "counter",
+                 "Queries received from routers.");
+    for (i = 0; i < METRICS_NUM_QUERY_TYPES; ++i)
+    {
+        fprintf(out, "rpki_rtr_queries_total{query=\"%s\"} %" PRIu64 "\n",
+                query_type_names[i], load(&metrics->queries[i]));
+    }
+
+    print_header(out, "rpki_rtr_db_request_queue_length", "gauge",
+                 "Queries waiting for a db thread.");
+    fprintf(out, "rpki_rtr_db_request_queue_length %zu\n",
+            gauges->db_request_queue_length);
+
+    print_header(out, "rpki_rtr_db_threads", "gauge",
+                 "Number of db threads.");
+    fprintf(out, "rpki_rtr_db_threads %zu\n", gauges->db_threads);
+
+    print_header(out, "rpki_rtr_db_threads_idle", "gauge",
+                 "Number of db threads waiting for a query.");
+    fprintf(out, "rpki_rtr_db_threads_idle %zu\n", gauges->db_threads_idle);
+
+    print_header(out, "rpki_rtr_db_step_seconds", "histogram",
+                 "Time for a db thread to produce one batch of PDUs for a query.");
+    for (i = 0; i < METRICS_NUM_QUERY_TYPES; ++i)
+    {
+        for (j = 0; j < METRICS_NUM_QUERY_SOURCES; ++j)
+        {
+            snprintf(labels, sizeof(labels), "query=\"%s\",source=\"%s\"",
+                     query_type_names[i], query_source_names[j]);
+            print_histogram(out, "rpki_rtr_db_step_seconds", labels,
+                            &metrics->db_step[i][j]);
+        }
+    }
+
+    print_header(out, "rpki_rtr_end_of_data_seconds", "histogram",
+                 "Time from starting a query to sending the end of the "
+                 "response.");
+    for (i = 0; i < METRICS_NUM_QUERY_TYPES; ++i)
+    {
+        snprintf(labels, sizeof(labels), "query=\"%s\"",
+                 query_type_names[i]);
+        print_histogram(out, "rpki_rtr_end_of_data_seconds", labels,
+                        &metrics->end_of_data[i]);
+    }
+
+    print_sessions(out, metrics);
+}
+
+
+bool metrics_write(
+    struct metrics *metrics,
+    const struct metrics_gauges *gauges,
+    const char *path)
+{
+    char tmp_path[4096];
+    FILE *out;
+    int retval;
+    bool ret = true;
+
+    if ((size_t)snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >=
+        sizeof(tmp_path))
+    {
+        LOG(LOG_ERR, "metrics file path too long: %s", path);
+        return false;
+    }
+
+    out = fopen(tmp_path, "w");
+    if (out == NULL)
+    {
+        ERR_LOG(errno, NULL, "can't open %s", tmp_path);
+        return false;
+    }
+
+    retval = pthread_mutex_lock(&metrics->sessions_mutex);
+    if (retval != 0)
+    {
+        ERR_LOG(retval, NULL, "pthread_mutex_lock()");
+        fclose(out);
+        unlink(tmp_path);
+        return false;
+    }
+
+    print_metrics(out, metrics, gauges);
+
+    retval = pthread_mutex_unlock(&metrics->sessions_mutex);
+    if (retval != 0)
+    {
+        ERR_LOG(retval, NULL, "pthread_mutex_unlock()");
+    }
+
+    if (ferror(out))
+    {
+        LOG(LOG_ERR, "error writing %s", tmp_path);
+        ret = false;
+    }
+
+    if (fclose(out) != 0)
+    {
+        ERR_LOG(errno, NULL, "can't close %s", tmp_path);
+        ret = false;
+    }
+
+    if (ret && rename(tmp_path, path) != 0)
+    {
+        ERR_LOG(errno, NULL, "can't rename %s to %s", tmp_path, path);
+        ret = false;
+    }
+
+    if (!ret)
+    {
+        unlink(tmp_path);
+    }
+
+    return ret;
+}
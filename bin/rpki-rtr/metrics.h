@@ -0,0 +1,180 @@
+#ifndef _RTR_METRICS_H
+#define _RTR_METRICS_H
+
+// Declarations related to metrics.
+// Currently: counters and histograms updated by cxn and db threads, and
+// the Prometheus text file written by the main thread.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "rpki-rtr/pdu.h"
+#include "config.h"
+
+
+enum metrics_query_type {
+    METRICS_QUERY_SERIAL,
+    METRICS_QUERY_RESET,
+    METRICS_NUM_QUERY_TYPES
+};
+
+enum metrics_query_source {
+    METRICS_SOURCE_DATABASE,
+    METRICS_SOURCE_SNAPSHOT,
+    METRICS_NUM_QUERY_SOURCES
+};
+
+// Upper bounds of the histogram buckets, in microseconds. The last bucket
+// is +Inf.
+#define METRICS_HISTOGRAM_BOUNDS \
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, \
+    250000, 500000, 1000000, 2500000, 5000000, 10000000
+#define METRICS_NUM_BUCKETS 17
+
+/**
+   @brief A latency histogram. All members are accessed atomically.
+
+   Unlike in the Prometheus format, buckets are not cumulative: each
+   observation is only counted in the first bucket whose bound it
+   doesn't exceed.
+*/
+struct metrics_histogram {
+    uint64_t buckets[METRICS_NUM_BUCKETS];
+    uint64_t count;
+    uint64_t sum_usec;
+};
+
+/**
+   @brief Metrics for one connection.
+
+   This is owned by the cxn thread, which is the only one to update the
+   counters. They're accessed atomically so the main thread can read
+   them while writing the metrics file.
+*/
+struct metrics_session {
+    char host[MAX_HOST_LENGTH];
+    char serv[MAX_SERVICE_LENGTH];
+    time_t connected;
+
+    uint8_t protocol_version;   // RTR_PROTOCOL_VERSION_MAX + 1 if unknown
+    uint64_t pdus_received;
+    uint64_t pdus_sent;
+    uint64_t bytes_sent;
+    uint64_t queries[METRICS_NUM_QUERY_TYPES];
+
+    // list of registered sessions, protected by metrics.sessions_mutex
+    struct metrics_session *prev;
+    struct metrics_session *next;
+};
+
+/**
+   @brief Metrics for the whole daemon.
+
+   Counters and histograms are accessed atomically, so updating them
+   never blocks. The session list is protected by a mutex, which is
+   only taken when a connection starts or ends and while writing the
+   metrics file.
+*/
+struct metrics {
+    uint64_t sessions_total;
+    uint64_t pdus_received;
+    uint64_t pdus_sent;
+    uint64_t bytes_sent;
+    uint64_t queries[METRICS_NUM_QUERY_TYPES];
+    uint64_t errors_sent;
+
+    // Time for a db thread to produce one response for a query, i.e. up to
+    // DB_ROWS_PER_RESPONSE PDUs.
+    struct metrics_histogram db_step[METRICS_NUM_QUERY_TYPES]
+        [METRICS_NUM_QUERY_SOURCES];
+
+    // Time from a cxn thread handing a query to the db threads to sending
+    // the last PDU of the response.
+    struct metrics_histogram end_of_data[METRICS_NUM_QUERY_TYPES];
+
+    pthread_mutex_t sessions_mutex;
+    size_t sessions_active;
+    struct metrics_session *sessions;
+};
+
+/**
+   @brief Values that are sampled by the main thread when writing the
+       metrics file, instead of being counted as they change.
+*/
+struct metrics_gauges {
+    bool data_available;
+    session_id_t session;
+    serial_number_t serial_number;
+
+    size_t db_request_queue_length;
+    size_t db_threads;
+    size_t db_threads_idle;
+};
+
+/**
+   @return Whether or not the initialization was successful.
+*/
+bool metrics_init(
+    struct metrics *metrics);
+
+void metrics_close(
+    struct metrics *metrics);
+
+/**
+   @brief Add @p session to the list of sessions in the metrics file.
+
+   @return Whether or not the session was added.
+*/
+bool metrics_session_start(
+    struct metrics *metrics,
+    struct metrics_session *session,
+    const char *host,
+    const char *serv);
+
+/**
+   @brief Remove a session added by metrics_session_start().
+*/
+void metrics_session_end(
+    struct metrics *metrics,
+    struct metrics_session *session);
+
+/**
+   @brief Add a value to a counter that's accessed atomically.
+*/
+static inline void metrics_add(
+    uint64_t *counter,
+    uint64_t value)
+{
+    __atomic_add_fetch(counter, value, __ATOMIC_RELAXED);
+}
+
+/**
+   @brief Get the number of microseconds elapsed since @p start, which
+       is from clock_gettime(CLOCK_MONOTONIC).
+*/
+uint64_t metrics_elapsed_usec(
+    const struct timespec *start);
+
+/**
+   @brief Record one observation of @p usec microseconds.
+*/
+void metrics_observe(
+    struct metrics_histogram *histogram,
+    uint64_t usec);
+
+/**
+   @brief Write all metrics to @p path in the Prometheus text format.
+
+   The file is written to a temporary file next to @p path and then
+   renamed, so readers never see a partial file.
+
+   @return Whether or not the file was written.
+*/
+bool metrics_write(
+    struct metrics *metrics,
+    const struct metrics_gauges *gauges,
+    const char *path);
+
+#endif
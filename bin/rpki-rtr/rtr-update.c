@@ -6,6 +6,10 @@
 #include "db/connect.h"
 #include "db/clients/rtr.h"
 #include "config/config.h"
+#include "rpki-rtr/vrp.h"
+#include "rpki-rtr/vrp_file.h"
+#include "rpki-rtr/notify.h"
+#include "util/file.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
@@ -13,7 +17,229 @@
 #include <limits.h>
 #include <inttypes.h>
 #include <time.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+/**
+    @brief Changes from the previous serial to the current one.
+*/
+struct changes {
+    struct vrp_set announcements;
+    struct vrp_set withdrawals;
+};
+
+static bool collect_change(
+    const struct vrp *vrp,
+    bool is_announce,
+    void *arg)
+{
+    struct changes *changes = (struct changes *)arg;
+
+    return vrp_set_add(
+        is_announce ? &changes->announcements : &changes->withdrawals,
+        vrp);
+}
+
+
+/**
+    @brief Load the snapshot file for @p serial, if there is one.
+
+    @return True if @p vrps was filled in from the snapshot file, false
+        if the caller should fall back to the database.
+*/
+static bool load_snapshot(
+    const char *snapshot_dir,
+    serial_number_t serial,
+    struct vrp_set *vrps)
+{
+    char path[PATH_MAX];
+    struct vrp_file file;
+    bool ret;
+
+    if (!vrp_file_path(path, sizeof(path), snapshot_dir, VRP_FILE_SNAPSHOT,
+                       serial) ||
+        access(path, F_OK) != 0 ||
+        !vrp_file_open(&file, path))
+    {
+        return false;
+    }
+
+    if (file.type != VRP_FILE_SNAPSHOT || file.serial != serial)
+    {
+        LOG(LOG_WARNING, "%s does not contain serial %" PRISERIAL
+            ", ignoring it", path, serial);
+        vrp_file_close(&file);
+        return false;
+    }
+
+    ret = vrp_file_append_to_set(&file, vrps);
+    vrp_file_close(&file);
+    if (!ret)
+    {
+        vrp_set_free(vrps);
+    }
+
+    return ret;
+}
+
+/**
+    @brief Write the snapshot and delta files for the current serial.
+
+    @return True on success, false on failure.
+*/
+static bool write_snapshot_files(
+    const char *snapshot_dir,
+    session_id_t session,
+    serial_number_t current_serial,
+    serial_number_t previous_serial,
+    bool first_time,
+    const struct vrp_set *current_vrps,
+    const struct changes *changes)
+{
+    char path[PATH_MAX];
+
+    if (!first_time)
+    {
+        if (!vrp_file_path(path, sizeof(path), snapshot_dir,
+                           VRP_FILE_DELTA, current_serial) ||
+            !vrp_file_write_delta(path, session, current_serial,
+                                  previous_serial,
+                                  changes->announcements.vrps,
+                                  changes->announcements.len,
+                                  changes->withdrawals.vrps,
+                                  changes->withdrawals.len))
+        {
+            return false;
+        }
+    }
+
+    if (!vrp_file_path(path, sizeof(path), snapshot_dir,
+                       VRP_FILE_SNAPSHOT, current_serial) ||
+        !vrp_file_write_snapshot(path, session, current_serial,
+                                 current_vrps->vrps, current_vrps->len))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+    @brief Remove files that are no longer needed from the snapshot
+        directory.
+
+    Like rtr_full, only the snapshots for the two most recent serials
+    are kept. Deltas are kept for RpkiRtrRetentionHours, like
+    rtr_incremental. Leftover temporary files are always removed.
+*/
+static void prune_snapshot_dir(
+    const char *snapshot_dir,
+    serial_number_t current_serial,
+    serial_number_t previous_serial)
+{
+    DIR *dir;
+    struct dirent *entry;
+    char path[PATH_MAX];
+    struct stat st;
+    serial_number_t serial;
+    int suffix_offset;
+    int path_len;
+    const char *suffix;
+    bool should_remove;
+    time_t cutoff = time(NULL) -
+        (time_t)CONFIG_RPKI_RTR_RETENTION_HOURS_get() * 60 * 60;
+
+    dir = opendir(snapshot_dir);
+    if (dir == NULL)
+    {
+        ERR_LOG(errno, NULL, "can't open %s", snapshot_dir);
+        return;
+    }
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (sscanf(entry->d_name, "%" SCNSERIAL "%n", &serial,
+                   &suffix_offset) != 1)
+        {
+            continue;
+        }
+        suffix = entry->d_name + suffix_offset;
+
+        path_len = snprintf(path, sizeof(path), "%s/%s", snapshot_dir,
+                            entry->d_name);
+        if (path_len < 0 || (size_t)path_len >= sizeof(path))
+        {
+            continue;
+        }
+
+        if (strcmp(suffix, VRP_FILE_SUFFIX_SNAPSHOT) == 0)
+        {
+            should_remove = serial != current_serial &&
+                serial != previous_serial;
+        }
+        else if (strcmp(suffix, VRP_FILE_SUFFIX_DELTA) == 0)
+        {
+            should_remove = serial != current_serial &&
+                stat(path, &st) == 0 && st.st_mtime < cutoff;
+        }
+        else if (strncmp(suffix, VRP_FILE_SUFFIX_SNAPSHOT ".",
+                         strlen(VRP_FILE_SUFFIX_SNAPSHOT ".")) == 0 ||
+                 strncmp(suffix, VRP_FILE_SUFFIX_DELTA ".",
+                         strlen(VRP_FILE_SUFFIX_DELTA ".")) == 0)
+        {
+            // temporary file left behind by an earlier run
+            should_remove = true;
+        }
+        else
+        {
+            should_remove = false;
+        }
+
+        if (should_remove && unlink(path) != 0)
+        {
+            ERR_LOG(errno, NULL, "can't remove %s", path);
+        }
+    }
+
+    closedir(dir);
+}
+
 
+/**
+    @brief Remove VRPs that are implied by others in @p vrps, and log
+        what that saves.
+
+    The savings are per Reset Query or full snapshot, i.e. what every
+    router that loads the full set no longer receives or stores.
+*/
+static void minimize_vrps(
+    struct vrp_set *vrps)
+{
+    struct vrp_minimize_stats stats;
+    size_t original_len = vrps->len;
+    size_t removed;
+    size_t bytes_saved;
+
+    vrp_set_minimize(vrps, &stats);
+
+    removed = stats.removed_ipv4 + stats.removed_ipv6;
+    bytes_saved =
+        stats.removed_ipv4 * (PDU_HEADER_LENGTH + sizeof(IP4PrefixData)) +
+        stats.removed_ipv6 * (PDU_HEADER_LENGTH + sizeof(IP6PrefixData));
+
+    LOG(LOG_INFO,
+        "Minimized %zu VRPs to %zu: removed %zu IPv4 and %zu IPv6 VRPs "
+        "implied by others with the same origin AS.",
+        original_len, vrps->len, stats.removed_ipv4, stats.removed_ipv6);
+    LOG(LOG_INFO,
+        "Each full load is %zu fewer PDUs (%zu fewer bytes) and %zu fewer "
+        "VRP table entries on each router (%.1f%%).",
+        removed, bytes_saved, removed,
+        original_len == 0 ? 0.0 : 100.0 * removed / original_len);
+}
 
 int main(
     int argc,
@@ -30,6 +256,19 @@ int main(
     serial_number_t previous_serial;
     serial_number_t current_serial;
 
+    const char *snapshot_dir;
+    const char *notify_socket;
+    session_id_t session;
+
+    struct vrp_set current_vrps;
+    struct vrp_set previous_vrps;
+    struct changes changes;
+
+    vrp_set_init(&current_vrps);
+    vrp_set_init(&previous_vrps);
+    vrp_set_init(&changes.announcements);
+    vrp_set_init(&changes.withdrawals);
+
     if (argc < 1 || argc > 2)
     {
         fprintf(stderr,
@@ -49,6 +288,9 @@ int main(
         return EXIT_FAILURE;
     }
 
+    snapshot_dir = CONFIG_RPKI_RTR_SNAPSHOT_DIR_get();
+    notify_socket = CONFIG_RPKI_RTR_NOTIFY_SOCKET_get();
+
     // initialize the database connection
     if (!db_init())
     {
@@ -82,6 +324,21 @@ int main(
         return EXIT_FAILURE;
     }
 
+    if (db_rtr_get_session_id(db, &session))
+    {
+        LOG(LOG_ERR, "Could not get session id.");
+        ret = EXIT_FAILURE;
+        goto done;
+    }
+
+    if (snapshot_dir != NULL && !mkdir_recursive(snapshot_dir, 0755))
+    {
+        ERR_LOG(errno, NULL, "Could not create snapshot directory %s",
+                snapshot_dir);
+        ret = EXIT_FAILURE;
+        goto done;
+    }
+
     // Get the previous serial number.
     switch (db_rtr_get_latest_sernum(db, &previous_serial))
     {
@@ -152,19 +409,19 @@ int main(
         goto done;
     }
 
-    if (!db_rtr_insert_full(db, current_serial))
+    // Compute the changes in memory: sort the current state of the
+    // RPKI cache and merge it against the previous serial's data.
+    if (!db_rtr_get_current_vrps(db, &current_vrps))
     {
-        LOG(LOG_ERR, "Could not copy current RPKI state.");
+        LOG(LOG_ERR, "Could not read current RPKI state.");
         ret = EXIT_FAILURE;
         goto done;
     }
+    vrp_set_sort(&current_vrps);
 
-    if (!first_time &&
-        !db_rtr_insert_incremental(db, previous_serial, current_serial))
+    if (CONFIG_RPKI_RTR_MINIMIZE_VRPS_get())
     {
-        LOG(LOG_ERR, "Could not compute incremental changes.");
-        ret = EXIT_FAILURE;
-        goto done;
+        minimize_vrps(&current_vrps);
     }
 
     if (first_time)
@@ -173,27 +430,75 @@ int main(
     }
     else
     {
-        switch (db_rtr_has_incremental_changes(db, current_serial))
+        if ((snapshot_dir == NULL ||
+             !load_snapshot(snapshot_dir, previous_serial,
+                            &previous_vrps)) &&
+            !db_rtr_get_full_vrps(db, previous_serial, &previous_vrps))
+        {
+            LOG(LOG_ERR, "Could not read previous RPKI state.");
+            ret = EXIT_FAILURE;
+            goto done;
+        }
+        vrp_set_sort(&previous_vrps);
+
+        if (!vrp_diff(previous_vrps.vrps, previous_vrps.len,
+                      current_vrps.vrps, current_vrps.len,
+                      collect_change, &changes))
         {
-            case 1:
-                update_had_changes = true;
-                break;
-
-            case 0:
-                update_had_changes = false;
-                break;
-
-            case -1:
-            default:
-                LOG(LOG_ERR,
-                    "Error determining if there were any changes.");
-                ret = EXIT_FAILURE;
-                goto done;
+            LOG(LOG_ERR, "Could not compute incremental changes.");
+            ret = EXIT_FAILURE;
+            goto done;
         }
+
+        // The previous state is no longer needed, so don't hold onto
+        // the memory while writing to the database.
+        vrp_set_free(&previous_vrps);
+
+        update_had_changes = changes.announcements.len > 0 ||
+            changes.withdrawals.len > 0;
     }
 
+    LOG(LOG_INFO,
+        "%zu VRPs, %zu announcements and %zu withdrawals since the "
+        "previous update.", current_vrps.len, changes.announcements.len,
+        changes.withdrawals.len);
+
     if (update_had_changes || force_update)
     {
+        if (!first_time &&
+            (!db_rtr_insert_incremental_vrps(db, current_serial, true,
+                                             changes.announcements.vrps,
+                                             changes.announcements.len) ||
+             !db_rtr_insert_incremental_vrps(db, current_serial, false,
+                                             changes.withdrawals.vrps,
+                                             changes.withdrawals.len)))
+        {
+            LOG(LOG_ERR, "Could not store incremental changes.");
+            ret = EXIT_FAILURE;
+            goto done;
+        }
+
+        if (!db_rtr_insert_full_vrps(db, current_serial,
+                                     current_vrps.vrps, current_vrps.len))
+        {
+            LOG(LOG_ERR, "Could not copy current RPKI state.");
+            ret = EXIT_FAILURE;
+            goto done;
+        }
+
+        // The files must be in place before the new serial number is
+        // made available, so that anything that sees the serial number
+        // can also find its files.
+        if (snapshot_dir != NULL &&
+            !write_snapshot_files(snapshot_dir, session, current_serial,
+                                  previous_serial, first_time,
+                                  &current_vrps, &changes))
+        {
+            LOG(LOG_ERR, "Could not write snapshot files.");
+            ret = EXIT_FAILURE;
+            goto done;
+        }
+
         // Make the new serial number available for use.
         if (
             !db_rtr_insert_update(db, current_serial, previous_serial,
@@ -203,6 +508,13 @@ int main(
             ret = EXIT_FAILURE;
             goto done;
         }
+
+        // Let rpki-rtr-daemon know about the new serial number. Failure
+        // isn't fatal, the daemon will notice it eventually anyway.
+        if (notify_socket != NULL)
+        {
+            rtr_notify_send(notify_socket, current_serial);
+        }
     }
     else
     {
@@ -210,15 +522,7 @@ int main(
             "Data had no changes since the last update, so no update "
             "was made.");
 
-        // The new data in rtr_full is useless, so delete it.
-        if (!db_rtr_delete_full(db, current_serial))
-        {
-            LOG(LOG_ERR, "Error deleting duplicate data in rtr_full.");
-            ret = EXIT_FAILURE;
-            goto done;
-        }
-
-        // there's nothing to delete from rtr_incremental
+        // nothing was written to rtr_full or rtr_incremental
     }
 
     // clean up all the data no longer needed
@@ -244,9 +548,19 @@ int main(
         goto done;
     }
 
+    if (snapshot_dir != NULL)
+    {
+        prune_snapshot_dir(snapshot_dir, current_serial, previous_serial);
+    }
+
 
 done:
 
+    vrp_set_free(&current_vrps);
+    vrp_set_free(&previous_vrps);
+    vrp_set_free(&changes.announcements);
+    vrp_set_free(&changes.withdrawals);
+
     if (db != NULL)
     {
         db_disconnect(db);
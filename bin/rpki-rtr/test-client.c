@@ -34,6 +34,8 @@ enum command_argument {
     ARG_IPv6,
     ARG_AS_NUMBER,
     ARG_ERROR_CODE,
+    ARG_VERSION,
+    ARG_INTERVAL,
     ARG_END                     // special argument to indicate the end of the
                                 // argument list
 };
@@ -61,6 +63,10 @@ static const char *arg_name(
         return "AS number";
     case ARG_ERROR_CODE:
         return "error code";
+    case ARG_VERSION:
+        return "protocol version";
+    case ARG_INTERVAL:
+        return "interval";
     default:
         return NULL;
     }
@@ -96,6 +102,12 @@ static void cmd_cache_reset(
 static void cmd_error_report(
     const struct command *command,
     char const *const *args);
+static void cmd_end_of_data_v1(
+    const struct command *command,
+    char const *const *args);
+static void cmd_version(
+    const struct command *command,
+    char const *const *args);
 
 #define MAX_NUM_ARGS 10
 struct command {
@@ -119,8 +131,12 @@ static const struct command commands[] = {
      {ARG_PREFIX_FLAGS, ARG_PREFIX_LENGTH, ARG_PREFIX_MAX_LENGTH, ARG_IPv6,
       ARG_AS_NUMBER, ARG_END}},
     {"end_of_data", cmd_end_of_data, {ARG_SESSION, ARG_SERIAL, ARG_END}},
+    {"end_of_data_v1", cmd_end_of_data_v1,
+     {ARG_SESSION, ARG_SERIAL, ARG_INTERVAL, ARG_INTERVAL, ARG_INTERVAL,
+      ARG_END}},
     {"cache_reset", cmd_cache_reset, {ARG_END}},
     {"error_report", cmd_error_report, {ARG_ERROR_CODE, ARG_END}},
+    {"version", cmd_version, {ARG_VERSION, ARG_END}},
     {NULL, NULL, {ARG_END}}
 };
 
@@ -178,6 +194,10 @@ static void do_help(
     {
         command_print_usage_signature(stderr, &commands[i], "    ", "\n");
     }
+    fprintf(stderr, "\n");
+    fprintf(stderr,
+            "The version command sets the protocol version field of every PDU sent\n"
+            "after it. The default is %d.\n", RTR_PROTOCOL_VERSION_0);
 }
 
 static inline bool _command_get_arg_sscanf(
@@ -241,6 +261,14 @@ static bool command_get_arg(
         ret = _command_get_arg_sscanf(arg_string, "%" SCNu16, arg_value);
         goto done;
 
+    case ARG_VERSION:
+        ret = _command_get_arg_sscanf(arg_string, "%" SCNu8, arg_value);
+        goto done;
+
+    case ARG_INTERVAL:
+        ret = _command_get_arg_sscanf(arg_string, "%" SCNu32, arg_value);
+        goto done;
+
     default:
         ret = false;
         goto done;
@@ -256,12 +284,20 @@ static bool command_get_arg(
 }
 
 
+// protocol version of PDUs to send, see cmd_version()
+static uint8_t protocol_version = RTR_PROTOCOL_VERSION_0;
+
 static void send_pdu(
     const PDU * pdu)
 {
     uint8_t buffer[MAX_PDU_SIZE];
     ssize_t length = dump_pdu(buffer, MAX_PDU_SIZE, pdu);
 
+    if (length > 0)
+    {
+        buffer[0] = protocol_version;
+    }
+
     if (length < 0)
     {
         fprintf(stderr, "error in pdu to send");
@@ -421,6 +457,34 @@ static void cmd_end_of_data(
     send_pdu(&pdu);
 }
 
+static void cmd_end_of_data_v1(
+    const struct command *command,
+    char const *const *args)
+{
+    session_id_t session;
+    serial_number_t serial;
+    uint32_t refresh_interval;
+    uint32_t retry_interval;
+    uint32_t expire_interval;
+
+    if (!command_get_arg(command, args, 0, &session))
+        return;
+    if (!command_get_arg(command, args, 1, &serial))
+        return;
+    if (!command_get_arg(command, args, 2, &refresh_interval))
+        return;
+    if (!command_get_arg(command, args, 3, &retry_interval))
+        return;
+    if (!command_get_arg(command, args, 4, &expire_interval))
+        return;
+
+    PDU pdu;
+    fill_pdu_end_of_data_v1(&pdu, session, serial, refresh_interval,
+                            retry_interval, expire_interval);
+
+    send_pdu(&pdu);
+}
+
 static void cmd_cache_reset(
     const struct command *command,
     char const *const *args)
@@ -440,7 +504,7 @@ static void cmd_error_report(
 {
     PDU pdu;
 
-    pdu.protocolVersion = RTR_PROTOCOL_VERSION;
+    pdu.protocolVersion = RTR_PROTOCOL_VERSION_0;
     if (!command_get_arg(command, args, 0, &pdu.errorCode))
         return;
     pdu.pduType = PDU_ERROR_REPORT;
@@ -453,6 +517,14 @@ static void cmd_error_report(
     send_pdu(&pdu);
 }
 
+static void cmd_version(
+    const struct command *command,
+    char const *const *args)
+{
+    if (!command_get_arg(command, args, 0, &protocol_version))
+        return;
+}
+
 static int do_write(
     )
 {
@@ -0,0 +1,823 @@
+/************************
+ * Route origin validation against the VRPs served by rpki-rtr-daemon
+ *
+ * Loads the VRPs for the latest serial number (or a given one) from the
+ * database into an in-memory trie, then answers queries of the form
+ * "<prefix> <origin AS>" with the RFC 6811 validation state. Queries
+ * are taken from the command line or, if there are none, read one per
+ * line from standard input.
+ *
+ * With -r, every route in a RIB dump (text or MRT, see
+ * lib/rpki-rtr/rib_dump.h) is classified instead, using several threads.
+ * Only the invalid routes are printed, followed by a summary on
+ * standard error.
+ ***********************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include "util/logging.h"
+#include "util/timeutils.h"
+#include "db/connect.h"
+#include "db/clients/rtr.h"
+#include "config/config.h"
+#include "rpki-rtr/rib_dump.h"
+#include "rpki-rtr/rov.h"
+#include "rpki-rtr/vrp.h"
+
+
+static void usage(
+    const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [options] [<prefix> <origin AS>]...\n"
+            "       %s [options] -r <dump file>\n"
+            "\n"
+            "Print the RFC 6811 validation state (valid, invalid, or\n"
+            "not-found) of each route. If no routes are given, they're\n"
+            "read from standard input, one \"<prefix> <origin AS>\" per\n"
+            "line.\n"
+            "\n"
+            "With -r, classify every route in a RIB dump, either text\n"
+            "(\"<prefix> <origin AS>\" or \"bgpdump -m\" lines) or MRT\n"
+            "TABLE_DUMP_V2. The invalid routes are printed, followed by a\n"
+            "summary on standard error.\n"
+            "\n"
+            "Options:\n"
+            "    -s <serial>    use the VRPs for this serial number\n"
+            "                   instead of the latest one\n"
+            "    -r <file>      classify the routes in this RIB dump\n"
+            "    -t <threads>   number of threads for -r (default: one\n"
+            "                   per CPU)\n"
+            "    -h             print this help text\n",
+            argv0, argv0);
+}
+
+static bool parse_uint32(
+    const char *str,
+    uint32_t *value)
+{
+    char *end;
+    unsigned long long v;
+
+    if (*str < '0' || *str > '9')
+    {
+        return false;
+    }
+
+    errno = 0;
+    v = strtoull(str, &end, 10);
+    if (errno != 0 || *end != '\0' || v > UINT32_MAX)
+    {
+        return false;
+    }
+
+    *value = (uint32_t)v;
+    return true;
+}
+
+/**
+   @brief Parse an origin AS, either as a plain number or with an "AS"
+       prefix.
+*/
+static bool parse_origin(
+    const char *str,
+    as_number_t *origin)
+{
+    if (strncasecmp(str, "AS", 2) == 0)
+    {
+        str += 2;
+    }
+
+    return parse_uint32(str, origin);
+}
+
+/**
+   @brief Load the VRPs for @p serial, or the latest serial if
+       @p use_latest, and build @p table from them.
+
+   @return True on success, false on failure.
+*/
+static bool load_table(
+    struct rov_table *table,
+    bool use_latest,
+    serial_number_t serial)
+{
+    bool ret = false;
+    bool done_db_init = false;
+    bool done_db_thread_init = false;
+    dbconn *db = NULL;
+    struct vrp_set vrps;
+
+    vrp_set_init(&vrps);
+
+    if (!db_init())
+    {
+        LOG(LOG_ERR, "Could not initialize database program.");
+        goto done;
+    }
+    done_db_init = true;
+
+    if (!db_thread_init())
+    {
+        LOG(LOG_ERR, "Could not initialize database thread.");
+        goto done;
+    }
+    done_db_thread_init = true;
+
+    db = db_connect_default(DB_CLIENT_RTR);
+    if (db == NULL)
+    {
+        LOG(LOG_ERR,
+            "Could not connect to the database, check your config "
+            "file.");
+        goto done;
+    }
+
+    if (use_latest)
+    {
+        switch (db_rtr_get_latest_sernum(db, &serial))
+        {
+            case GET_SERNUM_SUCCESS:
+                break;
+            case GET_SERNUM_NONE:
+                LOG(LOG_ERR, "No data available, run rpki-rtr-update "
+                    "first.");
+                goto done;
+            default:
+                LOG(LOG_ERR, "Error finding latest serial number.");
+                goto done;
+        }
+    }
+
+    if (!db_rtr_get_full_vrps(db, serial, &vrps))
+    {
+        LOG(LOG_ERR, "Could not read VRPs for serial %" PRISERIAL ".",
+            serial);
+        goto done;
+    }
+
+    if (!rov_table_init(table, vrps.vrps, vrps.len))
+    {
+        LOG(LOG_ERR, "Could not build the validation table.");
+        goto done;
+    }
+
+    LOG(LOG_INFO, "Loaded %zu VRPs for serial %" PRISERIAL ".",
+        rov_table_count(table), serial);
+
+    ret = true;
+
+done:
+    vrp_set_free(&vrps);
+
+    if (db != NULL)
+    {
+        db_disconnect(db);
+    }
+
+    if (done_db_thread_init)
+    {
+        db_thread_close();
+    }
+
+    if (done_db_init)
+    {
+        db_close();
+    }
+
+    return ret;
+}
+
+/**
+   @brief Validate one route and print the result.
+
+   @return True on success, false if the route couldn't be parsed.
+*/
+static bool validate_route(
+    const struct rov_table *table,
+    const char *prefix_str,
+    const char *origin_str)
+{
+    uint8_t prefix[16];
+    size_t family_length;
+    uint8_t prefix_length;
+    as_number_t origin;
+
+    if (!rov_parse_prefix(prefix_str, prefix, &family_length,
+                          &prefix_length) ||
+        !parse_origin(origin_str, &origin))
+    {
+        fprintf(stderr, "invalid route: %s %s\n", prefix_str, origin_str);
+        return false;
+    }
+
+    printf("%s %" PRIu32 " %s\n", prefix_str, origin,
+           rov_state_name(rov_validate(table, prefix, family_length,
+                                       prefix_length, origin)));
+
+    return true;
+}
+
+/**
+   @brief Format a route's origin AS, or "none" if it has none.
+*/
+static void origin_sprint(
+    const struct rib_route *route,
+    char *buffer,
+    size_t buffer_length)
+{
+    if (route->has_origin)
+    {
+        snprintf(buffer, buffer_length, "%" PRIu32, route->origin);
+    }
+    else
+    {
+        snprintf(buffer, buffer_length, "none");
+    }
+}
+
+static void print_route(
+    const struct rib_route *route,
+    enum rov_state state)
+{
+    char prefix[INET6_ADDRSTRLEN + sizeof("/128")];
+    char origin[sizeof("4294967295")];
+
+    if (!rib_route_prefix_sprint(route, prefix, sizeof(prefix)))
+    {
+        snprintf(prefix, sizeof(prefix), "?");
+    }
+    origin_sprint(route, origin, sizeof(origin));
+
+    printf("%s %s %s\n", prefix, origin, rov_state_name(state));
+}
+
+static enum rov_state validate_rib_route(
+    const struct rov_table *table,
+    const struct rib_route *route)
+{
+    // Origin AS 0 never matches a VRP, which is the right result for a
+    // route without an origin.
+    return rov_validate(table, route->prefix, route->family_length,
+                        route->prefix_length,
+                        route->has_origin ? route->origin : 0);
+}
+
+/**
+   @brief Validate every route in @p input.
+
+   See rib_parse_line() for the format.
+
+   @return True if every line was a valid route, false otherwise.
+*/
+static bool validate_stream(
+    const struct rov_table *table,
+    FILE *input)
+{
+    char line[1024];
+    size_t length;
+    size_t line_number = 0;
+    struct rib_route route;
+    bool ret = true;
+
+    while (fgets(line, sizeof(line), input) != NULL)
+    {
+        ++line_number;
+        length = strcspn(line, "\n");
+
+        switch (rib_parse_line(line, length, &route))
+        {
+            case 1:
+                print_route(&route, validate_rib_route(table, &route));
+                break;
+            case 0:
+                break;
+            default:
+                fprintf(stderr, "line %zu: invalid route\n", line_number);
+                ret = false;
+                break;
+        }
+    }
+
+    if (ferror(input))
+    {
+        LOG(LOG_ERR, "error reading standard input");
+        ret = false;
+    }
+
+    return ret;
+}
+
+
+/**
+   @brief Results of one thread of validate_dump().
+*/
+struct bulk_result {
+    uint64_t counts[3];         // indexed by enum rov_state
+    uint64_t unparseable;
+
+    struct rib_route *invalid;
+    size_t num_invalid;
+    size_t invalid_capacity;
+
+    bool out_of_memory;
+};
+
+/**
+   @brief One thread of validate_dump(), which handles a contiguous
+       part of the dump so that results stay in the dump's order.
+*/
+struct bulk_worker {
+    pthread_t thread;
+    const struct rov_table *table;
+    const uint8_t *data;
+
+    /**
+       @brief For text dumps, the range of bytes to handle, which starts
+           and ends at line boundaries. For MRT dumps, the range of
+           indices into #records.
+    */
+    size_t begin;
+    size_t end;
+
+    /**
+       @brief Offsets of the MRT records, with the length of the dump
+           at the end. NULL for text dumps.
+    */
+    const size_t *records;
+
+    struct bulk_result result;
+};
+
+static bool bulk_classify(
+    const struct rib_route *route,
+    void *arg)
+{
+    struct bulk_worker *worker = arg;
+    struct bulk_result *result = &worker->result;
+    enum rov_state state = validate_rib_route(worker->table, route);
+    struct rib_route *new_invalid;
+    size_t new_capacity;
+
+    ++result->counts[state];
+
+    if (state != ROV_INVALID)
+    {
+        return true;
+    }
+
+    if (result->num_invalid == result->invalid_capacity)
+    {
+        new_capacity = result->invalid_capacity == 0 ? 1024 :
+            2 * result->invalid_capacity;
+        new_invalid = realloc(result->invalid,
+                              new_capacity * sizeof(*new_invalid));
+        if (new_invalid == NULL)
+        {
+            result->out_of_memory = true;
+            return false;
+        }
+        result->invalid = new_invalid;
+        result->invalid_capacity = new_capacity;
+    }
+
+    result->invalid[result->num_invalid++] = *route;
+
+    return true;
+}
+
+/**
+   @brief Handle a range of lines of a text dump.
+
+   The same route from different peers is only counted once, as in an
+   MRT dump, regardless of how the dump is split into ranges.
+*/
+static void bulk_text(
+    struct bulk_worker *worker)
+{
+    rib_parse_lines((const char *)worker->data, worker->begin, worker->end,
+                    bulk_classify, worker, &worker->result.unparseable);
+}
+
+/**
+   @brief Handle a range of records of an MRT dump.
+*/
+static void bulk_mrt(
+    struct bulk_worker *worker)
+{
+    size_t i;
+
+    for (i = worker->begin; i < worker->end; ++i)
+    {
+        if (rib_mrt_parse_record(worker->data + worker->records[i],
+                                 worker->records[i + 1] -
+                                 worker->records[i],
+                                 bulk_classify, worker) < 0)
+        {
+            if (worker->result.out_of_memory)
+            {
+                return;
+            }
+            ++worker->result.unparseable;
+        }
+    }
+}
+
+static void *bulk_worker_main(
+    void *arg)
+{
+    struct bulk_worker *worker = arg;
+
+    if (worker->records != NULL)
+    {
+        bulk_mrt(worker);
+    }
+    else
+    {
+        bulk_text(worker);
+    }
+
+    return NULL;
+}
+
+/**
+   @brief Find the offset of every record in an MRT dump.
+
+   @param records Set to a newly allocated array of the offsets, with
+       @p length at the end.
+   @param num_records Set to the number of records.
+   @return True on success, false on failure.
+*/
+static bool index_mrt_records(
+    const uint8_t *data,
+    size_t length,
+    size_t **records,
+    size_t *num_records)
+{
+    size_t capacity = 1024;
+    size_t *new_records;
+    size_t offset = 0;
+    ssize_t record_length;
+
+    *num_records = 0;
+    *records = malloc(capacity * sizeof(**records));
+    if (*records == NULL)
+    {
+        LOG(LOG_ERR, "out of memory");
+        return false;
+    }
+
+    while (offset < length)
+    {
+        record_length = rib_mrt_record_length(data + offset,
+                                              length - offset);
+        if (record_length < 0)
+        {
+            LOG(LOG_WARNING, "ignoring truncated MRT record at offset "
+                "%zu", offset);
+            length = offset;
+            break;
+        }
+
+        if (*num_records + 1 == capacity)
+        {
+            capacity *= 2;
+            new_records = realloc(*records, capacity * sizeof(**records));
+            if (new_records == NULL)
+            {
+                LOG(LOG_ERR, "out of memory");
+                free(*records);
+                *records = NULL;
+                return false;
+            }
+            *records = new_records;
+        }
+
+        (*records)[(*num_records)++] = offset;
+        offset += record_length;
+    }
+
+    (*records)[*num_records] = length;
+
+    return true;
+}
+
+/**
+   @brief Advance @p offset to the start of the next line, unless it's
+       already at the start of a line.
+*/
+static size_t next_line_start(
+    const uint8_t *data,
+    size_t length,
+    size_t offset)
+{
+    const uint8_t *newline;
+
+    if (offset == 0 || offset >= length || data[offset - 1] == '\n')
+    {
+        return offset < length ? offset : length;
+    }
+
+    newline = memchr(data + offset, '\n', length - offset);
+    return newline == NULL ? length : (size_t)(newline - data) + 1;
+}
+
+static void print_summary(
+    const struct bulk_result *total,
+    double seconds)
+{
+    uint64_t routes = total->counts[ROV_VALID] +
+        total->counts[ROV_INVALID] + total->counts[ROV_NOT_FOUND];
+    double percent = routes == 0 ? 0.0 : 100.0 / routes;
+
+    fprintf(stderr, "routes:      %" PRIu64 "\n", routes);
+    fprintf(stderr, "valid:       %" PRIu64 " (%.2f%%)\n",
+            total->counts[ROV_VALID], total->counts[ROV_VALID] * percent);
+    fprintf(stderr, "invalid:     %" PRIu64 " (%.2f%%)\n",
+            total->counts[ROV_INVALID],
+            total->counts[ROV_INVALID] * percent);
+    fprintf(stderr, "not-found:   %" PRIu64 " (%.2f%%)\n",
+            total->counts[ROV_NOT_FOUND],
+            total->counts[ROV_NOT_FOUND] * percent);
+    fprintf(stderr, "unparseable: %" PRIu64 "\n", total->unparseable);
+    fprintf(stderr, "time:        %.3f s (%.0f routes/s)\n", seconds,
+            seconds > 0 ? routes / seconds : 0.0);
+}
+
+/**
+   @brief Classify every route in the RIB dump at @p path, print the
+       invalid ones, and print a summary.
+
+   @return True on success, false on failure.
+*/
+static bool validate_dump(
+    const struct rov_table *table,
+    const char *path,
+    size_t num_threads)
+{
+    bool ret = false;
+    int fd;
+    struct stat st;
+    const uint8_t *data = NULL;
+    size_t length = 0;
+    size_t *records = NULL;
+    size_t num_records = 0;
+    size_t num_units;
+    struct bulk_worker *workers = NULL;
+    size_t num_started = 0;
+    struct bulk_result total;
+    struct timespec start;
+    size_t i;
+    size_t j;
+    int retval;
+
+    memset(&total, 0, sizeof(total));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        ERR_LOG(errno, NULL, "can't open %s", path);
+        return false;
+    }
+
+    if (fstat(fd, &st) != 0)
+    {
+        ERR_LOG(errno, NULL, "can't stat %s", path);
+        close(fd);
+        return false;
+    }
+
+    length = st.st_size;
+    if (length > 0)
+    {
+        data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            ERR_LOG(errno, NULL, "can't mmap %s", path);
+            close(fd);
+            return false;
+        }
+        madvise((void *)data, length, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    if (rib_is_mrt(data, length))
+    {
+        if (!index_mrt_records(data, length, &records, &num_records))
+        {
+            goto done;
+        }
+        num_units = num_records;
+    }
+    else
+    {
+        num_units = length;
+    }
+
+    if (num_threads > num_units)
+    {
+        num_threads = num_units > 0 ? num_units : 1;
+    }
+
+    workers = calloc(num_threads, sizeof(*workers));
+    if (workers == NULL)
+    {
+        LOG(LOG_ERR, "out of memory");
+        goto done;
+    }
+
+    for (i = 0; i < num_threads; ++i)
+    {
+        workers[i].table = table;
+        workers[i].data = data;
+        workers[i].records = records;
+        workers[i].begin = num_units / num_threads * i +
+            (i < num_units % num_threads ? i : num_units % num_threads);
+        workers[i].end = workers[i].begin + num_units / num_threads +
+            (i < num_units % num_threads ? 1 : 0);
+
+        if (records == NULL)
+        {
+            workers[i].begin = next_line_start(data, length,
+                                               workers[i].begin);
+            workers[i].end = next_line_start(data, length, workers[i].end);
+        }
+    }
+
+    for (i = 0; i < num_threads; ++i)
+    {
+        retval = pthread_create(&workers[i].thread, NULL, bulk_worker_main,
+                                &workers[i]);
+        if (retval != 0)
+        {
+            LOG(LOG_ERR, "pthread_create(): %s", strerror(retval));
+            break;
+        }
+        ++num_started;
+    }
+
+    for (i = 0; i < num_started; ++i)
+    {
+        retval = pthread_join(workers[i].thread, NULL);
+        if (retval != 0)
+        {
+            LOG(LOG_ERR, "pthread_join(): %s", strerror(retval));
+        }
+    }
+
+    if (num_started != num_threads)
+    {
+        goto done;
+    }
+
+    for (i = 0; i < num_threads; ++i)
+    {
+        if (workers[i].result.out_of_memory)
+        {
+            LOG(LOG_ERR, "out of memory");
+            goto done;
+        }
+
+        for (j = 0; j < 3; ++j)
+        {
+            total.counts[j] += workers[i].result.counts[j];
+        }
+        total.unparseable += workers[i].result.unparseable;
+
+        for (j = 0; j < workers[i].result.num_invalid; ++j)
+        {
+            print_route(&workers[i].result.invalid[j], ROV_INVALID);
+        }
+    }
+
+    fflush(stdout);
+    print_summary(&total, seconds_since(&start));
+
+    ret = true;
+
+done:
+    if (workers != NULL)
+    {
+        for (i = 0; i < num_threads; ++i)
+        {
+            free(workers[i].result.invalid);
+        }
+    }
+    free(workers);
+    free(records);
+    if (data != NULL)
+    {
+        munmap((void *)data, length);
+    }
+
+    return ret;
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    struct rov_table table;
+    bool use_latest = true;
+    serial_number_t serial = 0;
+    const char *dump_path = NULL;
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t num_threads = num_cpus > 0 ? (size_t)num_cpus : 1;
+    uint32_t value;
+    bool ok = true;
+    int c;
+    int i;
+
+    while ((c = getopt(argc, argv, "s:r:t:h")) != -1)
+    {
+        switch (c)
+        {
+        case 's':
+            if (!parse_uint32(optarg, &serial))
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            use_latest = false;
+            break;
+        case 'r':
+            dump_path = optarg;
+            break;
+        case 't':
+            if (!parse_uint32(optarg, &value) || value == 0)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            num_threads = value;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((argc - optind) % 2 != 0 || (dump_path != NULL && optind != argc))
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    OPEN_LOG("rpki-rtr-validate", LOG_USER);
+
+    if (!my_config_load())
+    {
+        LOG(LOG_ERR, "can't load configuration");
+        CLOSE_LOG();
+        return EXIT_FAILURE;
+    }
+
+    if (!load_table(&table, use_latest, serial))
+    {
+        config_unload();
+        CLOSE_LOG();
+        return EXIT_FAILURE;
+    }
+
+    if (dump_path != NULL)
+    {
+        ok = validate_dump(&table, dump_path, num_threads);
+    }
+    else if (optind == argc)
+    {
+        ok = validate_stream(&table, stdin);
+    }
+    else
+    {
+        for (i = optind; i < argc; i += 2)
+        {
+            if (!validate_route(&table, argv[i], argv[i + 1]))
+            {
+                ok = false;
+            }
+        }
+    }
+
+    rov_table_free(&table);
+    config_unload();
+    CLOSE_LOG();
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
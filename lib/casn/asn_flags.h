@@ -20,6 +20,7 @@ Remarks:
 /*
  * #define ASN_CHOICE_FLAG 0x10
  */
+#define ASN_LAZY_FLAG   0x10    /* used only in casn */
 #define ASN_FALSE_FLAG  0x20    /* used only in asn_gen */
 #define ASN_SUB_INDEF_FLAG 0x20 /* used only in C++ */
 #define ASN_TABLE_FLAG  0x40
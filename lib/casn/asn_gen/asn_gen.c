@@ -11,10 +11,12 @@ Remarks:
 *****************************************************************************/
 
 #include "asn_gen.h"
+#include "casn/casn.h"
 
 #ifdef WIN32
 #include <io.h>
 #endif
+#include <limits.h>
 #include <stdarg.h>
 
 static void
@@ -26,11 +28,17 @@ print_if_include(
     FILE *,
     char *);
 
+static void
+print_objid_der(
+    FILE *,
+    struct id_table *);
+
 int array;
 int classcount;
 int modflag;
 int genflag;
 int dosflag;
+int directflag;
 int did_tables;
 int explicit1 = 3;
 int flags;
@@ -295,6 +303,8 @@ int main(
     char *argv[])
 {
     FILE *tmpstr;
+    FILE *constrstr;
+    FILE *cstr;
     char *b;
     char *c;
     char **p;
@@ -328,6 +338,7 @@ int main(
     {
         if (*(c = *p) == '-')
         {
+            c++;
             if (*c == 'd')
                 dosflag = 1;
             else if (*c == 'g')
@@ -358,6 +369,8 @@ int main(
             }
             else if (*c == 'o')
                 modflag = 1;
+            else if (*c == 's')
+                directflag = 1;
             else if (*c == 't')
                 tflag = 1;
             else if (*c == 'u')
@@ -541,7 +554,19 @@ int main(
         print_if_include(outstr, fname);
         fprintf(outstr, "\n");
         fseek(streams.str, 0L, 0);
-        cconstruct();
+        if (!directflag)
+            cconstruct();
+        else
+        {                       // cdecoder() copies the constructors over
+            cstr = outstr;
+            if (!(outstr = tmpfile()))
+                done(true, MSG_OPEN, "temporary file");
+            cconstruct();
+            constrstr = outstr;
+            outstr = cstr;
+            cdecoder(constrstr);
+            fclose(constrstr);
+        }
         if (*fname)
             fclose(outstr);
         clear_globals();
@@ -584,7 +609,10 @@ int main(
         }
         for (idp = (struct id_table *)id_area.area, eidp =
              &idp[id_area.next], idp += BUILT_IN_IDS; idp < eidp; idp++)
+        {
             fprintf(outstr, "#define %s \"%s\"\n", idp->name, idp->val);
+            print_objid_der(outstr, idp);
+        }
         for (ubp = (struct ub_table *)ub_area.area, eubp =
              &ubp[ub_area.next]; ubp < eubp; ubp++)
         {
@@ -1434,6 +1462,71 @@ static void print_if_include(
     fprintf(outstr, if_include, locbuf, name);
 }
 
+static void print_objid_der(
+    FILE * outstr,
+    struct id_table *idp)
+{
+/**
+Function: Prints the contents octets of the OID in idp as a string
+constant named <name>_der, for diff_objid_der().  Nothing is printed if
+the value isn't a plain dotted OID that objid_to_der() accepts.
+**/
+    char *c = idp->val;
+    uchar der[ASN_OBJID_DER_MAX];
+    ulong val,
+        tmp,
+        first = 0;
+    int arc,
+        siz,
+        i,
+        lth = 0;
+
+    for (arc = 0; *c; arc++)
+    {
+        if (*c < '0' || *c > '9')
+            return;
+        for (val = 0; *c >= '0' && *c <= '9'; c++)
+        {
+            if (val > (ULONG_MAX - 9) / 10)
+                return;
+            val = (val * 10) + *c - '0';
+        }
+        if (*c == '.')
+        {
+            if (!*++c)
+                return;
+        }
+        else if (*c)
+            return;
+        if (!arc)
+        {
+            if (val > 2)
+                return;
+            first = val;
+            continue;
+        }
+        if (arc == 1)
+        {
+            if ((first < 2 && val >= 40) || val > ULONG_MAX - 80)
+                return;
+            val += first * 40;
+        }
+        for (tmp = val >> 7, siz = 1; tmp; siz++)
+            tmp >>= 7;
+        if (lth + siz > (int)sizeof(der))
+            return;
+        for (i = siz - 1; i >= 0; i--, val >>= 7)
+            der[lth + i] = (uchar)(val & 0x7F) | ((i < siz - 1) ? 0x80 : 0);
+        lth += siz;
+    }
+    if (arc < 2)
+        return;
+    fprintf(outstr, "#define %s_der \"", idp->name);
+    for (i = 0; i < lth; i++)
+        fprintf(outstr, "\\x%02x", der[i]);
+    fprintf(outstr, "\"\n");
+}
+
 void print_tables(
     )
 {
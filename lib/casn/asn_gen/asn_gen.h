@@ -366,6 +366,7 @@ extern int option;
 extern int pre_proc_pass;
 extern int state;
 extern int explicit1;
+extern int directflag;
 
 /**
 Function: Adds 'name' to object name table with 'parent', path defined by
@@ -566,6 +567,10 @@ void
 cconstruct(
     void);
 
+void
+cdecoder(
+    FILE *);
+
 void
 cdo_hdr(
     );
@@ -0,0 +1,445 @@
+/*****************************************************************************
+File:     casn_decoder.c
+Contents: Functions to generate direct decoders as part of ASN_CGEN program.
+System:   ASN development.
+Created:
+Author:
+
+Remarks:
+    With the -s switch, cconstruct() writes its constructors to a temporary
+    file, and cdecoder() copies them to the .c file and reads them back to
+    see what each type is made of.  For every constructor 'Xxx' it then
+    writes
+
+        int XxxDirect(struct casn_direct *dp, struct Xxx *mine, long tag)
+        int XxxDecode(struct Xxx *mine, uchar *from, int lth)
+
+    XxxDecode() does what decode_casn_lth() does.  If Xxx is a SEQUENCE,
+    SET OF or SEQUENCE OF, XxxDirect() checks the tag and length of each of
+    its members in turn and decodes them directly, calling the members'
+    own Direct functions for those of other types, and XxxDecode() starts
+    there.  Anything else, and any pointer member, is decoded by
+    _direct_casn(), which uses _match_casn(), and XxxDecode() just calls
+    decode_casn_lth().  A constructor line that isn't understood here makes
+    its type be decoded that way.  The tag is the one the parent gives the
+    item, or -1 if it's the type's own.
+
+*****************************************************************************/
+
+#include "asn_gen.h"
+
+#define DIRECT_GENERIC 0
+#define DIRECT_SEQUENCE 1
+#define DIRECT_OF 2
+
+struct member {
+    struct member *next;
+    char name[ASN_BSIZE];
+    char type[ASN_BSIZE];       // empty if it's primitive
+    char tag[ASN_BSIZE];        // empty if the type's own
+    int generic;
+};
+
+struct decoder {
+    struct decoder *next;
+    char name[ASN_BSIZE];
+    char tag[ASN_BSIZE];
+    int kind;
+    int is_casn;                // constructor takes a struct casn
+    struct member *members;
+};
+
+static char direct_opener[] = "\
+int %sDirect(struct casn_direct *dp, struct %s *mine, long tag)\n\
+    {\n",
+    direct_generic[] = "\
+    (void)tag;\n\
+    return _direct_casn(dp, (struct casn *)mine);\n\
+    }\n\n",
+    direct_enter[] = "\
+    struct casn_direct d;\n\
+%s\
+    int ansr;\n\n\
+    if ((ansr = _direct_enter(&d, dp, (struct casn *)mine,\n\
+                              (tag < 0) ? %s : tag)) <= 0)\n\
+        return ansr;\n",
+    direct_of_decl[] = "    struct casn *casnp;\n    int num;\n",
+    direct_of_loop[] = "\
+    for (num = 0; d.c < d.e; num++)\n\
+        {\n\
+        if (!(casnp = inject_casn((struct casn *)mine, num)) ||\n\
+            ",
+    direct_of_end[] = " <= 0)\n\
+            return -1;\n\
+        }\n",
+    direct_leave[] = "\
+    return _direct_leave(&d, dp);\n\
+    }\n\n",
+    direct_prim[] = "_direct_prim(&d, %s, %s)",
+    direct_casn[] = "_direct_casn(&d, (struct casn *)%s)",
+    direct_named[] = "%sDirect(&d, %s, %s)",
+    decode_func[] = "\
+int %sDecode(struct %s *mine, uchar *from, int lth)\n\
+    {\n\
+    struct casn_direct d;\n\n\
+    _direct_begin(&d, (struct casn *)mine, from, lth);\n\
+    return _direct_end(&d, %sDirect(&d, mine, -1));\n\
+    }\n\n",
+    decode_generic[] = "\
+int %sDecode(struct %s *mine, uchar *from, int lth)\n\
+    {\n\
+    return decode_casn_lth((struct casn *)mine, from, lth);\n\
+    }\n\n";
+
+static char *generic_types[] = { "ASN_ANY", "ASN_CHOICE", "ASN_NONE",
+    "ASN_FUNCTION", "ASN_NOTASN1", "ASN_NOTYPE", "ASN_SEQUENCE", "ASN_SET",
+    (char *)0
+};
+
+static int starts(
+    char **cp,
+    char *s)
+{
+    size_t lth = strlen(s);
+    if (strncmp(*cp, s, lth))
+        return 0;
+    *cp += lth;
+    return 1;
+}
+
+static char *get_word(
+    char *c,
+    char *to)
+{
+    char *e = &to[ASN_BSIZE - 1];
+    for (; (*c >= '0' && *c <= '9') || (*c >= 'A' && *c <= 'Z') ||
+         (*c >= 'a' && *c <= 'z') || *c == '_'; c++)
+    {
+        if (to < e)
+            *to++ = *c;
+    }
+    *to = 0;
+    return c;
+}
+
+static struct member *find_member(
+    struct decoder *decp,
+    char *name)
+{
+    struct member *memp;
+    for (memp = decp->members; memp && strcmp(memp->name, name);
+         memp = memp->next);
+    return memp;
+}
+
+static struct member *add_member(
+    struct decoder *decp,
+    char *name)
+{
+    struct member **mempp;
+    for (mempp = &decp->members; *mempp; mempp = &(*mempp)->next);
+    if (!(*mempp = (struct member *)calloc(1, sizeof(struct member))))
+        done(true, MSG_MEM);
+    cat((*mempp)->name, name);
+    return *mempp;
+}
+
+static int is_generic_type(
+    char *type)
+{
+    char **pp;
+    for (pp = generic_types; *pp && strcmp(*pp, type); pp++);
+    return (*pp != (char *)0);
+}
+
+static void read_line(
+    struct decoder *decp,
+    char *c)
+{
+/**
+Function: Notes what a line of decp's constructor says about decp
+Procedure:
+1. IF it constructs self, note its type or tag
+   ELSE IF it constructs a primitive member, add that with its tag
+   ELSE IF it calls another constructor for a member, add that
+2. ELSE IF it sets self's flags
+        IF they're anything but OF, make decp generic
+        ELSE note it's an OF
+   ELSE IF it sets a member's tag, note that
+   ELSE IF it sets a member's flags
+        IF they include pointer, decode the member generically
+3. ELSE IF it's not one of the lines that doesn't matter to decoding, make
+        decp generic
+**/
+    char name[ASN_BSIZE],
+        type[ASN_BSIZE],
+        tag[ASN_BSIZE],
+       *b;
+    struct member *memp;
+    int tagged;
+
+    while (*c == ' ')
+        c++;
+    for (b = c; *b && *b != '\n'; b++);
+    *b = 0;
+    *tag = 0;
+    // step 1
+    if (starts(&c, "simple_constructor(&mine->") ||
+        (tagged = 0, starts(&c, "tagged_constructor(&mine->") && (tagged = 1)))
+    {
+        c = get_word(c, name);
+        if (starts(&c, ", level++, "))
+        {
+            c = get_word(c, type);
+            if (tagged && starts(&c, ", "))
+                c = get_word(c, tag);
+            cat(decp->tag, (*tag) ? tag : type);
+            if (!strcmp(type, "ASN_SEQUENCE") && !decp->kind)
+                decp->kind = DIRECT_SEQUENCE;
+            else if (!strcmp(type, "ASN_SET"))
+                decp->kind = -DIRECT_OF;        // only as an OF
+            else
+                decp->kind = -1;
+        }
+        else if (starts(&c, ", level, "))
+        {
+            c = get_word(c, type);
+            if (tagged && starts(&c, ", "))
+                c = get_word(c, tag);
+            memp = add_member(decp, name);
+            cat(memp->tag, (*tag) ? tag : type);
+            memp->generic = is_generic_type(type);
+        }
+        else
+            decp->kind = -1;
+        if (strcmp(c, ");"))
+            decp->kind = -1;
+        return;
+    }
+    if (strncmp(c, "mine->", 6) && strncmp(c, "_write_", 7))
+    {
+        c = get_word(c, type);
+        if (starts(&c, "(&mine->"))
+        {
+            c = get_word(c, name);
+            if (!strcmp(c, ", level);") && !find_member(decp, name))
+            {
+                memp = add_member(decp, name);
+                cat(memp->type, type);
+                return;
+            }
+        }
+        decp->kind = -1;
+        return;
+    }
+    // step 2
+    if (starts(&c, "mine->self.flags |= "))
+    {
+        if (strcmp(c, "ASN_OF_FLAG;"))
+            decp->kind = -1;
+        else if (decp->kind == DIRECT_SEQUENCE || decp->kind == -DIRECT_OF)
+            decp->kind = DIRECT_OF;
+        else
+            decp->kind = -1;
+        return;
+    }
+    if (starts(&c, "mine->"))
+    {
+        c = get_word(c, name);
+        memp = find_member(decp, name);
+        if (starts(&c, ".self.tag = ") && memp)
+        {
+            c = get_word(c, memp->tag);
+            if (!strcmp(c, ";"))
+                return;
+        }
+        else if (memp && (starts(&c, ".self.flags |= ") ||
+                          starts(&c, ".flags |= ")))
+        {
+            if (strstr(c, "ASN_POINTER_FLAG"))
+                memp->generic = 1;
+            return;
+        }
+        // step 3
+        else if (starts(&c, ".self.min = ") || starts(&c, ".self.max = ") ||
+                 starts(&c, ".min = ") || starts(&c, ".max = ") ||
+                 starts(&c, ".ptr = (struct casn *)((long)"))
+            return;
+        else if (*c == '.')
+        {                       // e.g. DEFAULT on a member's member
+            c = get_word(&c[1], type);
+            if (!strcmp(c, ".flags |= ASN_DEFAULT_FLAG;"))
+                return;
+        }
+    }
+    else if (starts(&c, "_write_casn_num(&mine->") ||
+             starts(&c, "_write_objid(&mine->"))
+        return;
+    decp->kind = -1;
+}
+
+static struct decoder *find_decoder(
+    struct decoder *decp,
+    char *name)
+{
+    for (; decp && strcmp(decp->name, name); decp = decp->next);
+    return decp;
+}
+
+static void print_member(
+    struct member *memp,
+    char *ptr)
+{
+    char *tag = (*memp->tag) ? memp->tag : "-1";
+
+    if (memp->generic)
+        fprintf(outstr, direct_casn, ptr);
+    else if (!*memp->type)
+        fprintf(outstr, direct_prim, ptr, memp->tag);
+    else
+        fprintf(outstr, direct_named, memp->type, ptr, tag);
+}
+
+static void print_decoder(
+    struct decoder *decp)
+{
+/**
+Function: Writes decp's Direct and Decode functions
+Procedure:
+1. IF decp is generic, or an OF without exactly one member, or a SEQUENCE
+        with a member whose type is generic
+        Print a Direct function that calls _direct_casn()
+2. ELSE
+        Print the opening of the Direct function
+        IF it's an OF, print a loop that injects each member and decodes it
+        ELSE print a line for each member, with the member's type's tag, if
+            it's a primitive, or its own tag, if it has one
+        Print the finish
+3. Print the Decode function, which just calls decode_casn_lth() if decp is
+        generic
+**/
+    char *structname = (decp->is_casn) ? casn_w : decp->name;
+    char ptr[ASN_BSIZE + 8];
+    struct member *memp;
+
+    fprintf(outstr, direct_opener, decp->name, structname);
+    if (decp->kind == DIRECT_OF &&
+        (!decp->members || decp->members->next))
+        decp->kind = -1;
+    // step 1
+    if (decp->kind <= 0)
+        fprintf(outstr, "%s", direct_generic);
+    // step 2
+    else if (decp->kind == DIRECT_OF)
+    {
+        fprintf(outstr, direct_enter, direct_of_decl, decp->tag);
+        fprintf(outstr, "%s", direct_of_loop);
+        memp = decp->members;
+        print_member(memp, (*memp->type) ? "(void *)casnp" : "casnp");
+        fprintf(outstr, "%s", direct_of_end);
+        fprintf(outstr, "%s", direct_leave);
+    }
+    else
+    {
+        fprintf(outstr, direct_enter, "", decp->tag);
+        for (memp = decp->members; memp; memp = memp->next)
+        {
+            fprintf(outstr, (memp == decp->members) ? "    if (" : "        ");
+            snprintf(ptr, sizeof(ptr), "&mine->%s", memp->name);
+            print_member(memp, ptr);
+            fprintf(outstr, (memp->next) ? " < 0 ||\n" : " < 0)\n");
+        }
+        if (decp->members)
+            fprintf(outstr, "        return -1;\n");
+        fprintf(outstr, "%s", direct_leave);
+    }
+    // step 3
+    if (decp->kind <= 0)
+        fprintf(outstr, decode_generic, decp->name, structname);
+    else
+        fprintf(outstr, decode_func, decp->name, structname, decp->name);
+}
+
+void cdecoder(
+    FILE *constrstr)
+{
+/**
+Function: Copies the constructors in constrstr to outstr and adds a direct
+decoder for each
+Procedure:
+1. FOR each line in constrstr
+        Copy it to outstr
+        IF it opens a constructor, start a new decoder
+        ELSE IF it ends one, finish the current decoder
+        ELSE IF in a constructor's body, note what the line says
+2. FOR each decoder, print it
+**/
+    char line[2048],
+        name[ASN_BSIZE],
+        structname[ASN_BSIZE],
+       *c;
+    struct decoder *decoders = (struct decoder *)0,
+        **decpp = &decoders,
+        *decp = (struct decoder *)0;
+    struct member *memp;
+
+    rewind(constrstr);
+    // step 1
+    while (fgets(line, sizeof(line), constrstr))
+    {
+        fputs(line, outstr);
+        c = line;
+        if (starts(&c, "void "))
+        {
+            c = get_word(c, name);
+            if (starts(&c, "(struct "))
+            {
+                c = get_word(c, structname);
+                if (starts(&c, " *mine, ushort level)") &&
+                    (!strcmp(structname, name) ||
+                     !strcmp(structname, casn_w)))
+                {
+                    if (!(decp = (struct decoder *)calloc(1,
+                                                          sizeof(struct
+                                                                 decoder))))
+                        done(true, MSG_MEM);
+                    cat(decp->name, name);
+                    decp->is_casn = !strcmp(structname, casn_w);
+                    *decpp = decp;
+                    decpp = &decp->next;
+                }
+            }
+        }
+        else if (!decp)
+            continue;
+        else if (!strcmp(line, "    }\n"))
+            decp = (struct decoder *)0;
+        else if (strcmp(line, "    {\n"))
+            read_line(decp, line);
+    }
+    // step 2
+    fprintf(outstr, "\n");
+    for (decp = decoders; decp; decp = decp->next)
+    {
+        // a member's type's own tag is known if it's in this file
+        for (memp = decp->members; memp; memp = memp->next)
+        {
+            struct decoder *typep;
+            if (*memp->type && !*memp->tag &&
+                (typep = find_decoder(decoders, memp->type)) &&
+                typep->kind > 0)
+                cat(memp->tag, typep->tag);
+        }
+    }
+    while ((decp = decoders))
+    {
+        print_decoder(decp);
+        decoders = decp->next;
+        while ((memp = decp->members))
+        {
+            decp->members = memp->next;
+            free(memp);
+        }
+        free(decp);
+    }
+}
@@ -20,6 +20,11 @@ static void
 print_hdr(
     void);
 
+static void
+print_direct(
+    char *,
+    char *);
+
 static void
 print_item(
     char *,
@@ -63,7 +68,12 @@ static const char opener[] = "struct %s\n\
     assign_char[] = "    long operator=(const char *c) { return write(c); }\n",
     name_constrainer[] = "int %sConstraint(struct %s *);\n\n",
     finale[] = "    };\n\n\
-void %s(struct %s *mine, ushort level);\n\n";
+void %s(struct %s *mine, ushort level);\n\n",
+    direct_definition[] = "\
+int %sDecode(struct %s *mine, uchar *from, int lth);\n\
+int %sDirect(struct casn_direct *dp, struct %s *mine, long tag);\n\n",
+    direct_define_line[] = "#define %sDecode %sDecode\n\
+#define %sDirect %sDirect\n\n";
 
 void cdo_hdr(
     )
@@ -156,13 +166,19 @@ Procedure:
                     cat(itemname, casn_w);
                 if (!ntbp->max && !(ntbp->flags & (ASN_CONSTRAINT_FLAG |
                                                    ASN_DEFINED_FLAG)))
+                {
                     fprintf(outstr, define_line, classname,
                             (ntbp->
                              type & ASN_CONSTRUCTED) ? itemname : casn_w);
+                    if (directflag && (ntbp->type & ASN_CONSTRUCTED))
+                        fprintf(outstr, direct_define_line, classname,
+                                itemname, classname, itemname);
+                }
                 else
                 {
                     fprintf(outstr, opener, classname);
                     fprintf(outstr, finale, classname, classname);
+                    print_direct(classname, classname);
                 }
                 continue;
             }
@@ -516,6 +532,7 @@ static int hdr_item(
                     continue;
                 ptbp = &((struct name_table *)name_area.area)[parentp->index];
                 fprintf(outstr, simple_definition, ptbp->name);
+                print_direct(ptbp->name, casn_w);
             }
             strcat(classname, "Defined");
         }
@@ -534,6 +551,7 @@ static void print_end(
     (void)mode;
 
     fprintf(outstr, finale, classname, classname);
+    print_direct(classname, classname);
     if (def_constraintp)
     {
         fprintf(outstr, name_constrainer, classname, classname);
@@ -569,3 +587,13 @@ Procedure:
         c = casn_w;
     fprintf(outstr, any_item, c, itemname);
 }
+
+static void
+print_direct(
+    char *name,
+    char *structname)
+{
+    if (directflag)
+        fprintf(outstr, direct_definition, name, structname, name,
+                structname);
+}
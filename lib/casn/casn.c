@@ -22,7 +22,7 @@ Cambridge, Ma. 02138
 
 #define ASN_READ 1              // modes for encode & read
 
-static struct casn_errors {
+static const struct casn_errors {
     int num;
     char *msg;
 } casn_errors[] = {
@@ -56,7 +56,10 @@ static struct casn_errors {
     {0, "Undefined error"},
 };
 
-struct casn_err_struct casn_err_struct;
+__thread struct casn_err_struct casn_err_struct;
+
+// buffer that _write_casn() may borrow from during decode_casn_buf()
+static __thread struct casn_buf *decode_bufp;
 
 /* char_table masks are:
     numeric       1              ' ' = ia5 only,
@@ -69,7 +72,7 @@ struct casn_err_struct casn_err_struct;
 as agreed by John Lowry and Charlie Gardiner on May 23, 1996! and
 corrected by CWG on May 3, 2001 */
 
-char char_table[] = "\
+const char char_table[] = "\
         ( ( ((((\
          ((( (  \
 =888888<<<8<<<<<\
@@ -98,6 +101,10 @@ _csize(
     uchar *from,
     long lth);
 
+static void
+_delete_casn(
+    struct casn *casnp);
+
 static int
 _encodesize(
     struct casn *casnp,
@@ -122,20 +129,6 @@ _mark_definees(
     uchar *wherep,
     int index);
 
-static int
-_match_casn(
-    struct casn *casnp,
-    uchar *from,
-    int nbytes,
-    ushort ff,
-    ushort level,
-    struct casn *of_casnp,
-    int *had_indedfp);
-
-static int
-_num_casns(
-    struct casn *casnp);
-
 static int
 _set_all_lths(
     uchar *top,
@@ -149,6 +142,12 @@ _set_casn_lth(
     uchar *e,
     int mode);
 
+static int
+_set_startp(
+    struct casn *casnp,
+    uchar *c,
+    int lth);
+
 static void *
 _clear_of(
     struct casn *casnp);
@@ -175,6 +174,8 @@ void
 clear_casn(
     struct casn *casnp)
 {
+    if (_clear_error(casnp) < 0)
+        return;
     _clear_casn(casnp, ~(ASN_FILLED_FLAG | ASN_CHOSEN_FLAG));
 }
 
@@ -217,76 +218,59 @@ decode_casn_lth(
     return ansr;
 }
 
+int
+decode_casn_buf(
+    struct casn *casnp,
+    struct casn_buf *bufp)
+{
+    if (!bufp)
+        return _casn_obj_err(casnp, ASN_NULL_PTR);
+    return _decode_borrowed(casnp, bufp->startp, bufp->lth, bufp);
+}
+
+struct casn_buf *
+casn_buf_new(
+    uchar *startp,
+    ulong lth,
+    void (*release)(uchar *, ulong))
+{
+    struct casn_buf *bufp = calloc(1, sizeof(struct casn_buf));
+
+    if (!bufp)
+        return (struct casn_buf *)0;
+    bufp->startp = startp;
+    bufp->lth = lth;
+    bufp->refcount = 1;
+    bufp->release = release;
+    return bufp;
+}
+
+struct casn_buf *
+casn_buf_ref(
+    struct casn_buf *bufp)
+{
+    bufp->refcount++;
+    return bufp;
+}
+
+void
+casn_buf_unref(
+    struct casn_buf *bufp)
+{
+    if (!bufp || --bufp->refcount)
+        return;
+    if (bufp->release)
+        bufp->release(bufp->startp, bufp->lth);
+    _free_it(bufp);
+}
+
 void
 delete_casn(
     struct casn *casnp)
 {
-/**
-Function: Frees all startps in every member, recursively
-Input: Ptr to starting (top) struct casn
-Output: Cleaned structure(s)
-Procedure:
-1. IF it's an OF with attachments, trim off the attachments
-   IF it's a pointer
-	IF it points to something
-	    Delete what it points to
-            Free the pointed to object
-        Return
-   IF it's constructed OR is a wrapper OR an enum, delete its members
-   ELSE (it's primitive AND NOT (a wrapper OR a choice OR an enum))
-	IF it has a startp, free that
-	IF it's a definer
-            FOR each remaining item after the path variable
-                Free its startp
-**/
-    struct casn *ncasnp,
-       *tcasnp;
-    int num;
-
     if (_clear_error(casnp) < 0)
         return;
-    if ((casnp->flags & ASN_OF_FLAG) && casnp[1].ptr)
-        casnp[1].ptr = _clear_of(casnp[1].ptr);
-    if ((casnp->flags & ASN_POINTER_FLAG))
-    {
-        if (casnp->ptr)
-        {
-            delete_casn(casnp->ptr);
-            casnp->ptr = _free_it(casnp->ptr);
-        }
-        return;
-    }
-    if ((casnp->type & ASN_CONSTRUCTED) ||
-        ((casnp->flags & ASN_ENUM_FLAG) && casnp->type != ASN_BITSTRING))
-    {
-        for (tcasnp = &casnp[1]; tcasnp; tcasnp = ncasnp)
-        {
-            ncasnp = _skip_casn(tcasnp, 1);
-            delete_casn(tcasnp);
-        }
-        if ((casnp->flags & ASN_ENUM_FLAG))     // free main one
-            casnp->startp = _free_it(casnp->startp);
-    }
-    else
-    {
-        casnp->startp = _free_it(casnp->startp);
-        if ((casnp->flags & ASN_TABLE_FLAG))
-        {
-            ncasnp = casnp->ptr;
-            if (!ncasnp)
-            {
-                if (casnp->lth)
-                    _casn_obj_err(casnp, ASN_GEN_ERR);
-                return;
-            }
-            for (num = (ncasnp++)->lth; num--; ncasnp++)
-            {
-                ncasnp->startp = _free_it(ncasnp->startp);
-            }
-            casnp->ptr = _free_it(casnp->ptr);
-        }
-    }
-    casnp->lth = 0;
+    _delete_casn(casnp);
 }
 
 int
@@ -304,6 +288,8 @@ eject_casn(
         return -1;
     if (!(casnp->flags & ASN_OF_FLAG))
         err = ASN_OF_ERR;
+    else if (_expand_kept(casnp) < 0)
+        return -1;
     else
     {
         for (icount = 0, tcasnp = &casnp[1]; tcasnp->ptr; tcasnp = tcasnp->ptr,
@@ -414,6 +400,8 @@ inject_casn(
         return (struct casn *)0;
     if (!(casnp->flags & ASN_OF_FLAG))
         err = ASN_NOT_OF_ERR;
+    else if (_expand_kept(casnp) < 0)
+        return (struct casn *)0;
     else if ((err = _fill_upward(casnp, 0)) != 0)
         err = -err;
     else if (num < 0)
@@ -429,7 +417,7 @@ inject_casn(
         casnp->lastp = fcasnp;
     // how many struct casns in this casnp
     ncount = _num_casns(casnp->lastp);
-    tcasnp = calloc(ncount, sizeof(struct casn));
+    tcasnp = _casn_calloc(casnp, ncount * sizeof(struct casn));
     // set up tags etc. in tcasnp.
     if (!casnp->num_items)
         lcasnp = fcasnp;
@@ -513,6 +501,8 @@ member_casn(
         return (struct casn *)0;
     if (!(casnp->flags & ASN_OF_FLAG))
         err = ASN_NOT_OF_ERR;
+    else if (_expand_kept(casnp) < 0)
+        return (struct casn *)0;
     else if (!casnp[1].ptr)     // it's empty
     {
         if (!index)
@@ -565,6 +555,8 @@ num_items(
         return -1;
     if (!(casnp->type & ASN_CONSTRUCTED) || !(casnp->flags & ASN_OF_FLAG))
         return _casn_obj_err(casnp, ASN_NOT_OF_ERR);
+    if (casnp->startp)          // lazy, so count without decoding
+        return _count_encoded(casnp->startp, casnp->lth);
     for (casnp++, num = 0; casnp->ptr; casnp = casnp->ptr, num++);
     return num;
 }
@@ -720,7 +712,7 @@ _casn_obj_err(
     struct casn *casnp,
     int num)
 {
-    struct casn_errors *errp;
+    const struct casn_errors *errp;
     casn_err_struct.errnum = num;
     casn_err_struct.casnp = casnp;
     casn_err_struct.asn_map_string = _free_it(casn_err_struct.asn_map_string);
@@ -796,8 +788,11 @@ Procedure:
 **/
     struct casn *tcasnp;
 
-    if (_clear_error(casnp) < 0)
+    if (!casnp)
+    {
+        _casn_obj_err(casnp, ASN_NULL_PTR);
         return;
+    }
     if ((casnp->flags & ASN_OF_FLAG) && casnp[1].ptr)
         casnp[1].ptr = _clear_of(casnp[1].ptr);
     if ((casnp->type & ASN_CONSTRUCTED))
@@ -806,10 +801,12 @@ Procedure:
         {
             _clear_casn(tcasnp, mask);
         }
+        if (casnp->startp)      // a lazy item's encoded members
+            _release_startp(casnp);
     }
     else
     {
-        casnp->startp = _free_it(casnp->startp);
+        _release_startp(casnp);
         casnp->lth = 0;
     }
     casnp->num_items = 0;
@@ -827,6 +824,10 @@ _clear_error(
     casn_err_struct.casnp = (struct casn *)0;
     if (!casnp)
         return _casn_obj_err((struct casn *)0, ASN_NULL_PTR);
+    // an empty member of a lazy item may just not be decoded yet
+    if ((casnp->flags & (ASN_LAZY_FLAG | ASN_FILLED_FLAG)) == ASN_LAZY_FLAG
+        && casnp->level && _expand_above(casnp) < 0)
+        return -1;
     return 1;
 }
 
@@ -852,11 +853,11 @@ Procedure
         ncasnp = casnp->ptr;
         casnp->ptr = (struct casn *)0;
         clear_casn(casnp);
-        _free_it(casnp);
+        _casn_free(casnp, casnp);
         casnp = ncasnp;
     }
     clear_casn(casnp);          // clear the last one
-    return _free_it(casnp);
+    return _casn_free(casnp, casnp);
 }
 
 int
@@ -890,14 +891,89 @@ _csize(
     return lth;
 }
 
+static void
+_delete_casn(
+    struct casn *casnp)
+{
+/**
+Function: Frees all startps in every member, recursively
+Input: Ptr to starting (top) struct casn
+Output: Cleaned structure(s)
+Procedure:
+1. IF it's an OF with attachments, trim off the attachments
+   IF it's a pointer
+	IF it points to something
+	    Delete what it points to
+            Free the pointed to object
+        Return
+   IF it's constructed OR is a wrapper OR an enum
+        IF it has a startp, free that
+        Delete its members
+   ELSE (it's primitive AND NOT (a wrapper OR a choice OR an enum))
+	IF it has a startp, free that
+	IF it's a definer
+            FOR each remaining item after the path variable
+                Free its startp
+**/
+    struct casn *ncasnp,
+       *tcasnp;
+    int num;
+
+    if ((casnp->flags & ASN_OF_FLAG) && casnp[1].ptr)
+        casnp[1].ptr = _clear_of(casnp[1].ptr);
+    if ((casnp->flags & ASN_POINTER_FLAG))
+    {
+        if (casnp->ptr)
+        {
+            _delete_casn(casnp->ptr);
+            casnp->ptr = _casn_free(casnp, casnp->ptr);
+        }
+        return;
+    }
+    if ((casnp->type & ASN_CONSTRUCTED) ||
+        ((casnp->flags & ASN_ENUM_FLAG) && casnp->type != ASN_BITSTRING))
+    {
+        // free main one, or a lazy item's encoded members
+        if ((casnp->flags & ASN_ENUM_FLAG) || casnp->startp)
+            _release_startp(casnp);
+        for (tcasnp = &casnp[1]; tcasnp; tcasnp = ncasnp)
+        {
+            ncasnp = _skip_casn(tcasnp, 1);
+            _delete_casn(tcasnp);
+        }
+    }
+    else
+    {
+        _release_startp(casnp);
+        if ((casnp->flags & ASN_TABLE_FLAG))
+        {
+            ncasnp = casnp->ptr;
+            if (!ncasnp)
+            {
+                if (casnp->lth)
+                    _casn_obj_err(casnp, ASN_GEN_ERR);
+                return;
+            }
+            for (num = (ncasnp++)->lth; num--; ncasnp++)
+            {
+                _release_startp(ncasnp);
+            }
+            casnp->ptr = _free_it(casnp->ptr);
+        }
+    }
+    casnp->lth = 0;
+}
+
 struct casn *
 _dup_casn(
     struct casn *casnp)
 {
     int err = 0;
-    _free_it(casnp->ptr);
-    casnp->ptr = calloc(1, casnp->min);
+    _casn_free(casnp, casnp->ptr);
+    casnp->ptr = _casn_calloc(casnp, casnp->min);
     ((void (*)(void *, ushort))casnp->startp)(casnp->ptr, 0);
+    if (casnp->arenap)
+        _bind_arena(casnp->ptr, casnp->arenap);
     // assumes duped object will be filled. writing pointed-to won't
     // go up through pointer
     if ((err = _fill_upward(casnp, ASN_FILLED_FLAG)) < 0)
@@ -1127,6 +1203,46 @@ _free_it(
     return NULL;
 }
 
+void
+_release_startp(
+    struct casn *casnp)
+{
+/**
+Function: Frees a startp, or drops the reference if it's borrowed from a
+casn_buf.  If it's from an arena, the arena takes care of both.
+**/
+    if (casnp->bufp)
+    {
+        if (!casnp->arenap)
+            casn_buf_unref(casnp->bufp);
+        casnp->bufp = (struct casn_buf *)0;
+        casnp->startp = (uchar *)0;
+    }
+    else
+        casnp->startp = _casn_free(casnp, casnp->startp);
+}
+
+int
+_own_startp(
+    struct casn *casnp)
+{
+/**
+Function: Makes a private copy of a borrowed startp before it is modified
+in place
+Output: 0 if successful, else -1
+**/
+    uchar *c;
+
+    if (!casnp->bufp)
+        return 0;
+    if (!(c = _casn_calloc(casnp, casnp->lth + 1)))
+        return _casn_obj_err(casnp, ASN_MEM_ERR);
+    memcpy(c, casnp->startp, casnp->lth);
+    _release_startp(casnp);
+    casnp->startp = c;
+    return 0;
+}
+
 long
 _count_crumbs_size(
     uchar *fromp)
@@ -1627,10 +1743,22 @@ Procedure:
                         xlth = lth;
                     else
                         xlth = curr_casnp->lth - explicit_extra - num;
+                    // a lazy item keeps its members encoded if they are
+                    // well-formed, else it's decoded to report the error
+                    int count;
+                    if (!ch && !num && (curr_casnp->flags & ASN_LAZY_FLAG) &&
+                        !def_lth && lth != ASN_UNDEFINED_LTH &&
+                        (count = _count_encoded(c, xlth)) >= 0 &&
+                        (!offp || !offp->max || (ulong)count <= offp->max))
+                    {
+                        if ((ansr = _keep_encoded(curr_casnp, c, xlth)) < 0)
+                            return ansr - did;
+                    }
                     // if first OF, casn_obj_err stuffed right on up
-                    if ((ansr = _match_casn(tcasnp, &c[num],
-                                            xlth, send_flag, this_level + 1,
-                                            offp, &has_indef)) < 0)
+                    else if ((ansr = _match_casn(tcasnp, &c[num],
+                                                 xlth, send_flag,
+                                                 this_level + 1, offp,
+                                                 &has_indef)) < 0)
                     {
                         if (of_casnp && num_ofs > 1)
                             _stuff_ofs(of_casnp, num_ofs);
@@ -1825,6 +1953,8 @@ _readsize(
         || !casnp->type || (!(casnp->type & ASN_CONSTRUCTED)
                             && (casnp->flags & ASN_EXPLICIT_FLAG)))
     {
+        struct casn time_casn;  // outlives the else-if below, as tcasnp may
+                                // point to it
         lth = casnp->lth;
         tcasnp = casnp;         // unless changed bu time or real below
         if (casnp->type == ASN_BITSTRING && (casnp->flags & ASN_ENUM_FLAG))
@@ -1837,12 +1967,13 @@ _readsize(
                     break;
             }
             i &= 7;
+            if (*casnp->startp != i && _own_startp(casnp) < 0)
+                return -1;
             *casnp->startp = i;
             lth = 1 + (b - casnp->startp);
         }
         else if (casnp->type == ASN_UTCTIME || casnp->type == ASN_GENTIME)
         {                       // convert to DER
-            struct casn time_casn;
             simple_constructor(&time_casn, (ushort) 0, casnp->type);
             if (read_casn_time(casnp, &secs) > 0 &&
                 (lth = write_casn_time(&time_casn, secs)) > 0)
@@ -1888,6 +2019,12 @@ _readsize(
         if (tcasnp != casnp)
             clear_casn(tcasnp); // free stuff
     }
+    else if ((casnp->type & ASN_CONSTRUCTED) && casnp->startp)
+    {                           // lazy, so already encoded
+        lth = casnp->lth;
+        if ((mode & ASN_READ))
+            memcpy(c, casnp->startp, lth);
+    }
     else if (casnp->type == ASN_SET && (mode & ASN_READ))
     {
         num = 0;
@@ -2323,6 +2460,8 @@ _write_casn(
     {
         if ((casnp->flags & ASN_OF_FLAG) && casnp[1].ptr)
             casnp[1].ptr = _clear_of(casnp[1].ptr);
+        if (casnp->startp)      // a lazy item's encoded members
+            _release_startp(casnp);
         if (!lth)
         {
             if (casnp->min)
@@ -2409,10 +2548,8 @@ _write_casn(
     if (err)
         return _casn_obj_err(casnp, err);
     casnp->flags &= ~(ASN_FILLED_FLAG);
-    if (casnp->startp)
-        casnp->startp = _free_it(casnp->startp);
-    casnp->startp = calloc(1, (casnp->lth = lth));
-    memcpy(casnp->startp, c, casnp->lth);
+    if (_set_startp(casnp, c, lth) < 0)
+        return _casn_obj_err(casnp, ASN_MEM_ERR);
     // fill up to top
     if ((err = _fill_upward(casnp, ASN_FILLED_FLAG)) < 0)
         return _casn_obj_err(casnp, -err);
@@ -2421,6 +2558,144 @@ _write_casn(
     return casnp->lth;
 }
 
+static int
+_set_startp(
+    struct casn *casnp,
+    uchar *c,
+    int lth)
+{
+/**
+Function: Replaces the contents of casnp with a copy of c, or with c itself
+if it's borrowed from the casn_buf being decoded
+Output: 0 if successful, else -1
+**/
+    uchar *b;
+    struct casn_buf *bufp;
+
+    // get the new contents before releasing the old, c may point into them
+    if (decode_bufp && c >= decode_bufp->startp &&
+        &c[lth] <= &decode_bufp->startp[decode_bufp->lth])
+    {                           // borrow it rather than copy it
+        b = c;
+        if (casnp->arenap)
+            bufp = _arena_hold(casnp->arenap, decode_bufp);
+        else
+            bufp = casn_buf_ref(decode_bufp);
+        if (!bufp)
+            return -1;
+    }
+    else
+    {
+        if (!(b = _casn_calloc(casnp, lth)))
+            return -1;
+        memcpy(b, c, lth);
+        bufp = (struct casn_buf *)0;
+    }
+    _release_startp(casnp);
+    casnp->startp = b;
+    casnp->lth = lth;
+    casnp->bufp = bufp;
+    return 0;
+}
+
+int
+_keep_encoded(
+    struct casn *casnp,
+    uchar *c,
+    int lth)
+{
+/**
+Function: Fills in a lazy constructed item with its members' encodings
+instead of decoding them
+Output: lth if successful, else a negative error
+**/
+    int err;
+
+    if (_set_startp(casnp, c, lth) < 0)
+        return _casn_obj_err(casnp, ASN_MEM_ERR);
+    if ((err = _fill_upward(casnp, ASN_FILLED_FLAG)) < 0)
+        return _casn_obj_err(casnp, -err);
+    return lth;
+}
+
+int
+_expand_kept(
+    struct casn *casnp)
+{
+/**
+Function: Decodes the members a lazy constructed item has kept encoded,
+leaving any lazy members of theirs encoded in turn
+Output: 0 if successful or there was nothing to decode, else -1
+Procedure:
+1. IF it isn't a constructed item with encoded members, return 0
+   Take the encoded members from the item
+2. Decode them as _write_casn() does, borrowing from the same casn_buf
+   IF that fails
+        Clear whatever members were decoded
+        Give the encoded members back to the item
+        Return -1
+   Free the encoded members
+**/
+    struct casn_buf *sav_bufp = decode_bufp;
+    struct casn *tcasnp;
+    uchar *c = casnp->startp;
+    int lth = casnp->lth;
+    int ansr = 0;
+    int has_indef = 0;
+    ushort send_flag;
+
+    // step 1
+    if (!(casnp->type & ASN_CONSTRUCTED) || !c)
+        return 0;
+    casnp->startp = (uchar *)0;
+    send_flag = (casnp->flags & ASN_OF_FLAG);
+    if (casnp->type == ASN_SET)
+        send_flag |= ASN_SET_FLAG;
+    // step 2
+    if (lth)
+    {
+        decode_bufp = casnp->bufp;
+        ansr = _match_casn(&casnp[1], c, lth, send_flag, 1,
+                           (send_flag & ASN_OF_FLAG) ? casnp : NULL,
+                           &has_indef);
+        decode_bufp = sav_bufp;
+    }
+    casnp->startp = c;
+    if (ansr < 0)
+    {
+        if ((casnp->flags & ASN_OF_FLAG) && casnp[1].ptr)
+            casnp[1].ptr = _clear_of(casnp[1].ptr);
+        for (tcasnp = &casnp[1]; tcasnp; tcasnp = _skip_casn(tcasnp, 1))
+            _clear_casn(tcasnp, ~(ASN_FILLED_FLAG));
+        casnp->num_items = 0;
+        casnp->lastp = NULL;
+        casnp->lth = lth;
+        return -1;
+    }
+    casnp->flags |= has_indef;
+    _release_startp(casnp);
+    return 0;
+}
+
+int
+_decode_borrowed(
+    struct casn *casnp,
+    uchar *from,
+    int lth,
+    struct casn_buf *bufp)
+{
+/**
+Function: Decodes like decode_casn_lth(), letting primitive items borrow
+from bufp, which may be NULL, if 'from' is in it
+**/
+    int ansr;
+
+    decode_bufp = bufp;
+    ansr = decode_casn_lth(casnp, from, lth);
+    decode_bufp = (struct casn_buf *)0;
+    return ansr;
+}
+
 int
 _write_enum(
     struct casn *casnp)
@@ -2451,7 +2726,7 @@ _write_objid(
     _clear_casn(casnp, ~(ASN_FILLED_FLAG));
     for (e = (uchar *) from, tmp = 0; *e; tmp++, e++);
     // bigger than needed
-    casnp->startp = buf = calloc(1, tmp);
+    casnp->startp = buf = _casn_calloc(casnp, tmp);
     if (casnp->type == ASN_OBJ_ID)
     {
         for (val = 0; c < (char *)e && *c && *c != '.';
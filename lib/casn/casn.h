@@ -19,6 +19,9 @@ Remarks:
 #include "casn/asn_flags.h"
 #include "casn/asn_error.h"
 
+struct casn_arena;
+struct casn_buf;
+
 struct casn {
     long tag;
     uchar *startp;
@@ -31,18 +34,86 @@ struct casn {
     struct casn *ptr;
     ulong num_items;
     struct casn *lastp;
+    struct casn_buf *bufp;      // if startp is borrowed from a casn_buf
+    struct casn_arena *arenap;  // where its memory comes from, if not calloc
 #ifdef CONSTRAINTS
     uchar *constraint;
 #endif
 };
 
+/**
+ * @brief
+ *     reference-counted buffer of encoded ASN.1
+ *
+ * An object decoded with decode_casn_buf() doesn't copy its primitive
+ * members.  Their startps point into the buffer instead, and each of
+ * them holds a reference to it.  The buffer's contents are released
+ * when the last reference goes away, so the caller may drop its own
+ * reference as soon as the decode is done.  A member that is
+ * rewritten gets its own copy first, the buffer is never modified.
+ */
+struct casn_buf {
+    uchar *startp;
+    ulong lth;
+    ulong refcount;
+    /** called with startp and lth when refcount drops to 0, may be NULL */
+    void (*release)(uchar *, ulong);
+};
+
+/**
+ * @brief
+ *     region that the memory of decoded objects can be allocated from
+ *
+ * An object bound to an arena with casn_arena_bind() gets the struct
+ * casns of its OF members and pointed-to items and the contents of
+ * its primitive items from the arena, which hands them out from large
+ * chunks.  Clearing or deleting the object doesn't free them, instead
+ * casn_arena_reset() frees everything at once.  After a reset, objects
+ * bound to the arena must be constructed (and bound) again before they
+ * are used.
+ */
+struct casn_arena {
+    struct casn_arena_chunk *chunkp;
+    size_t chunk_size;
+    struct casn_arena_hold *holdp;
+    /** number of allocations served since the last reset */
+    ulong num_allocs;
+    /** number of chunks obtained from malloc() since casn_arena_init() */
+    ulong num_chunks;
+};
+
+/**
+ * @brief
+ *     position in a SET OF or SEQUENCE OF, for casn_of_iter_next()
+ *
+ * An OF marked with stream_casn_of() or lazy_casn() before it's decoded
+ * keeps its members encoded.  Iterating over it decodes them one at a time into
+ * the same struct, so the memory used doesn't depend on the number of
+ * members.  An OF that was decoded as usual can be iterated over too,
+ * in which case its own members are returned.
+ */
+struct casn_of_iter {
+    struct casn *ofp;
+    struct casn *memberp;       // where encoded members are decoded to
+    uchar *nextp;               // next encoded member
+    uchar *endp;
+    struct casn *casnp;         // next decoded member
+};
+
 struct casn_err_struct {
     int errnum;
     char *asn_map_string;
     struct casn *casnp;
 };
 
-extern struct casn_err_struct casn_err_struct;
+/**
+ * @brief
+ *     details of the last casn error in the calling thread
+ *
+ * Each thread has its own, so objects may be decoded and checked on
+ * many threads at once as long as no object is shared between them.
+ */
+extern __thread struct casn_err_struct casn_err_struct;
 
 /**
  * @brief
@@ -64,15 +135,144 @@ casn_error_callback(
  *     callback executed whenever a casn error is encountered
  *
  * May be NULL, which is equivalent to a no-op function.  Initialized
- * to a function that logs the error.
+ * to a function that logs the error.  This is per-thread: setting it
+ * only affects errors in the calling thread, and every new thread
+ * starts with the logging function.
+ */
+extern __thread casn_error_callback *casn_error;
+
+/**
+ * @brief
+ *     position of a decoder generated by asn_gen -s
+ *
+ * Each constructed item being decoded has one, covering its contents.
+ * The one for the whole encoding also remembers what to decode again
+ * with decode_casn_lth() if the generated code can't finish.
  */
-extern casn_error_callback *casn_error;
+struct casn_direct {
+    uchar *c;                   // next item
+    uchar *e;                   // end of the contents
+    struct casn *casnp;         // the rest are only set by _direct_begin()
+    uchar *from;
+    int lth;
+    casn_error_callback *errorp;        // put back by _direct_end()
+};
 
 struct oidtable {
     char *oid;
     char *label;
 };
 
+/**
+ * @brief
+ *     a UTCTime or GeneralizedTime, as parse_casn_time() gives it
+ */
+struct casn_time {
+    int year;                   // all four digits
+    int mon;                    // 1 to 12
+    int day;                    // 1 to 31
+    int hour;
+    int min;
+    int sec;                    // 0 to 60
+    int64_t secs;               // since 1970-01-01 00:00:00 UTC
+};
+
+    // "YYYY-MM-DD HH:MM:SS" and a null, as format_casn_time() writes it
+#define CASN_TIME_STRING_SIZE 20
+
+/**
+ * @brief
+ *     wrap @p startp in a casn_buf with a refcount of 1
+ *
+ * @param[in] release
+ *     function that frees @p startp when the buffer is no longer
+ *     referenced, or NULL if the caller keeps @p startp alive itself
+ * @return
+ *     the new buffer, or NULL if out of memory
+ */
+struct casn_buf *
+casn_buf_new(
+    uchar *startp,
+    ulong lth,
+    void (*release)(uchar *, ulong));
+
+struct casn_buf *
+casn_buf_ref(
+    struct casn_buf *bufp);
+
+void
+casn_buf_unref(
+    struct casn_buf *bufp);
+
+/**
+ * @brief
+ *     initialize an empty arena
+ *
+ * @param[in] chunk_size
+ *     bytes to get from malloc() at a time, or 0 for the default
+ */
+void
+casn_arena_init(
+    struct casn_arena *arenap,
+    size_t chunk_size);
+
+/**
+ * @brief
+ *     make a freshly constructed object allocate from @p arenap
+ */
+int
+casn_arena_bind(
+    struct casn *casnp,
+    struct casn_arena *arenap);
+
+void
+casn_arena_reset(
+    struct casn_arena *arenap);
+
+void
+casn_arena_free(
+    struct casn_arena *arenap);
+
+/**
+ * @brief
+ *     start iterating over the members of an OF
+ *
+ * @param[out] iterp
+ *     iterator to initialize
+ * @param[in] ofp
+ *     the SET OF or SEQUENCE OF, which must not change while iterating
+ * @param[in] memberp
+ *     a constructed struct of the member type, which encoded members
+ *     are decoded into.  Each call to casn_of_iter_next() replaces its
+ *     contents.  The caller deletes it when done.  If it's NULL, the
+ *     OF's own members are returned, decoding them first if need be.
+ * @return
+ *     0 on success, else a negative error
+ */
+int
+casn_of_iter_init(
+    struct casn_of_iter *iterp,
+    struct casn *ofp,
+    struct casn *memberp);
+
+/**
+ * @brief
+ *     get the next member of an OF
+ *
+ * @param[in,out] iterp
+ *     iterator set up by casn_of_iter_init()
+ * @param[out] casnpp
+ *     set to the member, which is the iterator's memberp if the OF is
+ *     streamed
+ * @return
+ *     1 if there was another member, 0 after the last one, else a
+ *     negative error
+ */
+int
+casn_of_iter_next(
+    struct casn_of_iter *iterp,
+    struct casn **casnpp);
+
 int
 copy_casn(
     struct casn *,
@@ -89,6 +289,17 @@ decode_casn_lth(
     uchar *,
     int);
 
+/**
+ * @brief
+ *     decode all of @p bufp without copying its primitive members
+ *
+ * See struct casn_buf.  Otherwise the same as decode_casn_lth().
+ */
+int
+decode_casn_buf(
+    struct casn *casnp,
+    struct casn_buf *bufp);
+
 int
 diff_casn(
     struct casn *,
@@ -109,6 +320,40 @@ diff_objid(
     struct casn *fr_casnp,
     const char *objidp);
 
+/**
+ * @brief
+ *     compare an OBJECT IDENTIFIER with the contents octets of another
+ *
+ * Unlike diff_objid(), nothing is converted or allocated, so this is
+ * what to use when looking for one OID among many, e.g. in a list of
+ * extensions.  The octets come from the _der form of an OID that
+ * asn_gen writes beside the dotted string, see DIFF_OBJID_DER(), or
+ * from objid_to_der().
+ *
+ * @return
+ *     0 if they are the same, 1 if they differ, negative if casnp is
+ *     empty or not an OID or lth is negative
+ */
+int
+diff_objid_der(
+    struct casn *casnp,
+    const uchar *der,
+    int lth);
+
+/**
+ * @brief
+ *     convert a dotted OID string to its contents octets
+ *
+ * @return
+ *     the number of octets put in to, or -1 if objid is malformed or
+ *     its encoding won't fit in tolen
+ */
+int
+objid_to_der(
+    const char *objid,
+    uchar *to,
+    int tolen);
+
 int
 dump_casn(
     struct casn *,
@@ -133,12 +378,56 @@ encode_casn(
     struct casn *,
     uchar *);
 
+/**
+ * @brief
+ *     decode the named file, or what's left of @p fd if the name is NULL
+ *
+ * A named regular file of 64 KiB or more is mapped with mmap() instead
+ * of being read into a buffer, so it isn't copied before it's decoded.
+ */
 int
 get_casn_file(
     struct casn *casnp,
     const char *,
     int);
 
+/**
+ * @brief
+ *     like get_casn_file(), but decoded with decode_casn_buf() so the
+ *     file's contents are kept instead of copied member by member
+ *
+ * Unlike get_casn_file(), it always reads the file into memory, which
+ * lasts until the object's last member that points into it is
+ * rewritten, cleared or deleted.  A mapping held that long would make
+ * the process SIGBUS if the file were truncated meanwhile.
+ */
+int
+get_casn_file_buf(
+    struct casn *casnp,
+    const char *,
+    int);
+
+/**
+ * @brief
+ *     make the constructed members of an object decode on first access
+ *
+ * Call it after the constructor and before decoding.  Each SEQUENCE,
+ * SET and OF below @p casnp then keeps its members encoded when it's
+ * decoded, and decodes them, one level at a time, the first time one
+ * of them is read, written, cleared, copied, compared or dumped.  So
+ * reading a few fields costs little more than decoding the items on
+ * the way to them.  Encoding, sizing and reading a member that hasn't
+ * been decoded use its encoding as it is.  Errors in a member's
+ * encoding are only found when it's decoded, and are reported by the
+ * call that needed it.
+ *
+ * @return
+ *     0 on success, else a negative error
+ */
+int
+lazy_casn(
+    struct casn *casnp);
+
 int
 num_items(
     struct casn *casnp);
@@ -194,6 +483,39 @@ read_casn_time(
     struct casn *,
     int64_t *);
 
+/**
+ * @brief
+ *     parse the contents of a UTCTime or GeneralizedTime
+ *
+ * The contents must be in one of the forms YYMMDDHHMMZ, YYMMDDHHMMSSZ,
+ * YYYYMMDDHHMMSSZ or YYYYMMDDHHMMSS.fZ, which one being known from @p
+ * lth, and be a valid date and time.  Nothing is copied or allocated.
+ * A UTCTime's year is 19YY if YY is 50 or more, else 20YY.
+ *
+ * @return
+ *     ASN_UTCTIME or ASN_GENTIME, according to the form, or -1 if
+ *     @p from isn't one of them
+ */
+int
+parse_casn_time(
+    const char *from,
+    int lth,
+    struct casn_time *timep);
+
+/**
+ * @brief
+ *     write @p timep as "YYYY-MM-DD HH:MM:SS", e.g. for a SQL DATETIME
+ *
+ * @return
+ *     the length written, not counting the null, or -1 if @p tolen is
+ *     less than CASN_TIME_STRING_SIZE or the year isn't four digits
+ */
+int
+format_casn_time(
+    const struct casn_time *timep,
+    char *to,
+    size_t tolen);
+
 int
 read_objid(
     struct casn *,
@@ -204,6 +526,25 @@ int
 size_casn(
     struct casn *);
 
+/**
+ * @brief
+ *     mark a SET OF or SEQUENCE OF to keep its members encoded when
+ *     it's decoded
+ *
+ * Call it after the constructor and before decoding.  The members are
+ * then read with casn_of_iter_next(), and num_items() counts them.
+ * Encoding, sizing, reading and copying the OF use the encoded members
+ * as they are, while member_casn(), inject_casn() and eject_casn()
+ * decode them all first, as lazy_casn() does.  An OF whose members
+ * aren't all of definite length is decoded as usual.
+ *
+ * @return
+ *     0 on success, else a negative error
+ */
+int
+stream_casn_of(
+    struct casn *casnp);
+
 int
 tag_casn(
     struct casn *);
@@ -294,6 +635,48 @@ void
 clear_casn(
     struct casn *);
 
+/*
+ * For decoders generated by asn_gen -s.  Each of _direct_enter(),
+ * _direct_prim() and _direct_casn() returns 1 if it decoded the next item
+ * into casnp, 0 if casnp is optional and the next item isn't it, or -1 if
+ * the generated code should give up and let _direct_end() decode it all
+ * with decode_casn_lth().
+ */
+void
+_direct_begin(
+    struct casn_direct *dp,
+    struct casn *casnp,
+    uchar *from,
+    int lth);
+
+int
+_direct_end(
+    struct casn_direct *dp,
+    int ansr);
+
+int
+_direct_enter(
+    struct casn_direct *innerp,
+    struct casn_direct *dp,
+    struct casn *casnp,
+    long tag);
+
+int
+_direct_leave(
+    struct casn_direct *innerp,
+    struct casn_direct *dp);
+
+int
+_direct_prim(
+    struct casn_direct *dp,
+    struct casn *casnp,
+    long tag);
+
+int
+_direct_casn(
+    struct casn_direct *dp,
+    struct casn *casnp);
+
 void
 simple_constructor(
     struct casn *,
@@ -307,6 +690,10 @@ tagged_constructor(
     int type,
     int tag);
 
+/**
+ * Replaces the OID labels used by dump_casn().  Not thread-safe: call it
+ * before other threads start dumping.
+ */
 void
 load_oidtable(
     char *name);
@@ -333,6 +720,11 @@ find_label(
     int oidtable_size);
 
 #define ASN_UNDEFINED_LTH 0x7FFFFFFF
+    // enough for the contents of any OID in use
+#define ASN_OBJID_DER_MAX  64
+    // name is an OID #defined by asn_gen, e.g. id_pe_ipAddrBlock
+#define DIFF_OBJID_DER(casnp, name) \
+    diff_objid_der((casnp), (const uchar *)name##_der, sizeof(name##_der) - 1)
     // for reals
 #define ASN_PLUS_INFINITY  0x40
 #define ASN_MINUS_INFINITY 0x41
@@ -0,0 +1,216 @@
+/*****************************************************************************
+File:     casn_arena.c
+Contents: Arena allocation for the memory of decoded ASN.1 objects.
+System:   Compact ASN development.
+Created:
+Author:
+
+Remarks:
+    An object bound to an arena gets its OF members, pointed-to objects
+    and primitive contents from the arena instead of from calloc(), and
+    clearing the object doesn't free them one by one.  Everything is
+    freed at once by casn_arena_reset().
+
+*****************************************************************************/
+
+#include "casn.h"
+#include "casn_private.h"
+
+#include <stddef.h>
+
+#define CASN_ARENA_DEFAULT_CHUNK (64 * 1024)
+
+// every allocation is aligned like malloc()'s
+#define CASN_ARENA_ALIGN (2 * sizeof(void *))
+
+struct casn_arena_chunk {
+    struct casn_arena_chunk *nextp;
+    size_t size;                // bytes after the header
+    size_t used;
+};
+
+// a casn_buf referenced by the arena on behalf of its borrowing members
+struct casn_arena_hold {
+    struct casn_arena_hold *nextp;
+    struct casn_buf *bufp;
+};
+
+#define CHUNK_HEADER \
+    ((sizeof(struct casn_arena_chunk) + CASN_ARENA_ALIGN - 1) & \
+     ~(CASN_ARENA_ALIGN - 1))
+
+static uchar *
+chunk_data(
+    struct casn_arena_chunk *chunkp)
+{
+    return (uchar *)chunkp + CHUNK_HEADER;
+}
+
+void
+casn_arena_init(
+    struct casn_arena *arenap,
+    size_t chunk_size)
+{
+    memset(arenap, 0, sizeof(struct casn_arena));
+    arenap->chunk_size = chunk_size ? chunk_size : CASN_ARENA_DEFAULT_CHUNK;
+}
+
+static void *
+arena_alloc(
+    struct casn_arena *arenap,
+    size_t size)
+{
+/**
+Function: Gets zeroed memory from the current chunk, or from a new one if
+it's full.  Requests bigger than a chunk get a chunk of their own, which
+goes behind the current chunk so that it keeps being used.
+**/
+    struct casn_arena_chunk *chunkp = arenap->chunkp;
+    uchar *c;
+
+    size = (size + CASN_ARENA_ALIGN - 1) & ~(CASN_ARENA_ALIGN - 1);
+    if (!chunkp || chunkp->size - chunkp->used < size)
+    {
+        size_t chunk_size = arenap->chunk_size;
+        if (size > chunk_size)
+            chunk_size = size;
+        if (!(chunkp = malloc(CHUNK_HEADER + chunk_size)))
+            return NULL;
+        chunkp->size = chunk_size;
+        chunkp->used = 0;
+        arenap->num_chunks++;
+        if (chunk_size > arenap->chunk_size && arenap->chunkp)
+        {
+            chunkp->nextp = arenap->chunkp->nextp;
+            arenap->chunkp->nextp = chunkp;
+        }
+        else
+        {
+            chunkp->nextp = arenap->chunkp;
+            arenap->chunkp = chunkp;
+        }
+    }
+    c = &chunk_data(chunkp)[chunkp->used];
+    chunkp->used += size;
+    arenap->num_allocs++;
+    memset(c, 0, size);
+    return c;
+}
+
+void
+casn_arena_reset(
+    struct casn_arena *arenap)
+{
+/**
+Function: Frees everything allocated from the arena, keeping one chunk for
+reuse
+Procedure:
+1. Drop the references to borrowed-from casn_bufs
+2. Free all the chunks but one of the standard size
+**/
+    struct casn_arena_hold *holdp;
+    struct casn_arena_chunk *chunkp;
+    struct casn_arena_chunk *nextp;
+    struct casn_arena_chunk *keepp = NULL;
+
+    // step 1
+    for (holdp = arenap->holdp; holdp; holdp = holdp->nextp)
+        casn_buf_unref(holdp->bufp);
+    arenap->holdp = NULL;
+    // step 2
+    for (chunkp = arenap->chunkp; chunkp; chunkp = nextp)
+    {
+        nextp = chunkp->nextp;
+        if (!keepp && chunkp->size == arenap->chunk_size)
+            keepp = chunkp;
+        else
+            free(chunkp);
+    }
+    if (keepp)
+    {
+        keepp->nextp = NULL;
+        keepp->used = 0;
+    }
+    arenap->chunkp = keepp;
+    arenap->num_allocs = 0;
+}
+
+void
+casn_arena_free(
+    struct casn_arena *arenap)
+{
+    casn_arena_reset(arenap);
+    _free_it(arenap->chunkp);
+    arenap->chunkp = NULL;
+}
+
+void
+_bind_arena(
+    struct casn *casnp,
+    struct casn_arena *arenap)
+{
+/**
+Function: Sets the arena of a struct casn and all its members
+**/
+    int num = 1;
+
+    if (!(casnp->flags & ASN_POINTER_FLAG) &&
+        ((casnp->type & ASN_CONSTRUCTED) || casnp->type >= ASN_CHOICE ||
+         (casnp->flags & ASN_ENUM_FLAG)))
+        num += _num_casns(&casnp[1]);
+    while (num--)
+        (casnp++)->arenap = arenap;
+}
+
+int
+casn_arena_bind(
+    struct casn *casnp,
+    struct casn_arena *arenap)
+{
+    if (_clear_error(casnp) < 0)
+        return -1;
+    _bind_arena(casnp, arenap);
+    return 0;
+}
+
+void *
+_casn_calloc(
+    struct casn *casnp,
+    size_t size)
+{
+    if (casnp->arenap)
+        return arena_alloc(casnp->arenap, size);
+    return calloc(1, size);
+}
+
+void *
+_casn_free(
+    struct casn *casnp,
+    void *itp)
+{
+    if (!casnp->arenap)
+        free(itp);
+    return NULL;
+}
+
+struct casn_buf *
+_arena_hold(
+    struct casn_arena *arenap,
+    struct casn_buf *bufp)
+{
+/**
+Function: Makes sure the arena has a reference to a casn_buf
+Output: bufp, or NULL if out of memory
+**/
+    struct casn_arena_hold *holdp;
+
+    for (holdp = arenap->holdp; holdp && holdp->bufp != bufp;
+         holdp = holdp->nextp);
+    if (!holdp && (holdp = arena_alloc(arenap, sizeof(*holdp))))
+    {
+        holdp->bufp = casn_buf_ref(bufp);
+        holdp->nextp = arenap->holdp;
+        arenap->holdp = holdp;
+    }
+    return holdp ? bufp : NULL;
+}
@@ -20,7 +20,14 @@ extern int _casn_obj_err(
     struct casn *),
     _fill_upward(
     struct casn *casnp,
-    int val);
+    int val),
+    _own_startp(
+    struct casn *casnp);
+extern void *_casn_calloc(
+    struct casn *casnp,
+    size_t size);
+extern void _release_startp(
+    struct casn *casnp);
 
 int read_casn_bit(
     struct casn *casnp)
@@ -64,10 +71,16 @@ Function: Writes enumerated bit to higher BIT STRING
     lth = 2 + (bits >> 3);      // which one wiil we write?
     if ((ulong)lth >= tcasnp->lth)     // beyond what we have now?
     {
-        tcasnp->startp = (uchar *) realloc(tcasnp->startp, lth + 1);
-        memset(&tcasnp->startp[tcasnp->lth], 0, lth - tcasnp->lth);
+        if (!(b = (uchar *) _casn_calloc(tcasnp, lth + 1)))
+            return _casn_obj_err(tcasnp, ASN_MEM_ERR);
+        if (tcasnp->lth)
+            memcpy(b, tcasnp->startp, tcasnp->lth);
+        _release_startp(tcasnp);
+        tcasnp->startp = b;
         tcasnp->lth = lth;
     }
+    else if (_own_startp(tcasnp) < 0)   // don't write into a casn_buf
+        return -1;
     b = &tcasnp->startp[lth - 1];
     bb = 0x80 >> (bits & 7);
     if (val)
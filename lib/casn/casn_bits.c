@@ -21,8 +21,11 @@ extern int _casn_obj_err(
     _fill_upward(
     struct casn *casnp,
     int val);
-extern void *_free_it(
-    void *);
+extern void _release_startp(
+    struct casn *casnp);
+extern void *_casn_calloc(
+    struct casn *casnp,
+    size_t size);
 
 int _readsize_bits(
     struct casn *casnp,
@@ -97,8 +100,9 @@ int write_casn_bits(
         return -1;
     if (casnp->type != ASN_BITSTRING)
         return _casn_obj_err(casnp, ASN_TYPE_ERR);
-    _free_it(casnp->startp);
-    c = casnp->startp = (uchar *) calloc(1, (casnp->lth = lth + 1));
+    _release_startp(casnp);
+    c = casnp->startp =
+        (uchar *) _casn_calloc(casnp, (casnp->lth = lth + 1));
     for (e = &from[lth]; from < e; from++)
     {
         box = (ushort) * from;
@@ -85,6 +85,8 @@ diff_casn(
     }
     else if (!(casnp1->type & ASN_CONSTRUCTED))
         diff = _diff_casn(casnp1, casnp2, 0);
+    else if (_expand_kept(casnp1) < 0 || _expand_kept(casnp2) < 0)
+        return -2;
     else
         for (casnp1++, casnp2++; casnp1 && casnp2;
              casnp1 = _skip_casn(casnp1, 1), casnp2 = _skip_casn(casnp2, 1))
@@ -120,7 +122,11 @@ Procedure:
 3. IF the from member is empty AND has no default
 	IF it's optional, return zero
 	Return mandatory error
-4. IF copying from an OF
+4. IF the from item is still encoded AND the to item isn't lazy or an ANY
+	Decode the from item's members
+   IF the from item is still encoded AND the to item isn't an ANY
+	Copy its encoded members
+   ELSE IF copying from an OF
 	IF it's a present but empty OF, fill the to item
 	ELSE FOR each memeber of the OF
 	    Make a new member on the to side
@@ -195,7 +201,18 @@ Procedure:
         return _casn_obj_err(tcasnp, ASN_MANDATORY_ERR);
     }
     // step 4
-    if ((fr_casnp->flags & ASN_OF_FLAG))
+    if ((fr_casnp->type & ASN_CONSTRUCTED) && fr_casnp->startp &&
+        to_casnp->type != ASN_ANY && !(to_casnp->flags & ASN_LAZY_FLAG) &&
+        _expand_kept(fr_casnp) < 0)
+        return -1 - did;
+    if ((fr_casnp->type & ASN_CONSTRUCTED) && fr_casnp->startp &&
+        to_casnp->type != ASN_ANY)
+    {
+        if ((ansr = _keep_encoded(to_casnp, fr_casnp->startp,
+                                  fr_casnp->lth)) < 0)
+            return ansr - did;
+    }
+    else if ((fr_casnp->flags & ASN_OF_FLAG))
     {
         if ((fr_casnp->flags & ASN_FILLED_FLAG) && !fr_casnp[1].ptr)
         {
@@ -244,7 +261,7 @@ Procedure:
         {
             if ((ansr = vsize_casn(fr_casnp)) < 0)
                 return -1;
-            to_casnp->startp = calloc(1, ansr);
+            to_casnp->startp = _casn_calloc(to_casnp, ansr);
             read_casn(fr_casnp, to_casnp->startp);
             to_casnp->lth = ansr;
             to_casnp->tag = fr_casnp->tag;
@@ -315,6 +332,8 @@ _diff_casn(
         else if (diff < -1)
             diff = -1;
     }
+    else if (_expand_kept(casnp1) < 0 || _expand_kept(casnp2) < 0)
+        return -2;
     else
         for (casnp1++, casnp2++; casnp1 && casnp2;
              casnp1 = _skip_casn(casnp1, 1), casnp2 = _skip_casn(casnp2, 1))
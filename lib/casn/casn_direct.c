@@ -0,0 +1,193 @@
+/*****************************************************************************
+File:     casn_direct.c
+Contents: Functions called by the decoders that asn_gen -s generates.
+System:   Compact ASN development.
+Created:
+Author:
+
+Remarks:
+    A generated decoder knows the order of a SEQUENCE's members and
+    their tags, so it calls these for each member instead of having
+    _match_casn() work out from the struct casns what may come next.
+    Anything it isn't sure of, such as a CHOICE or a DEFINED BY item, is
+    handed to _match_casn() one item at a time.  Anything that
+    doesn't go as expected, including an indefinite length, makes the
+    whole encoding be decoded again by decode_casn_lth(), so errors are
+    reported exactly as they would be without a generated decoder.
+
+*****************************************************************************/
+
+#include "casn.h"
+#include "casn_private.h"
+
+static int
+_find_next(
+    struct casn_direct *dp,
+    struct casn *casnp,
+    long tag,
+    uchar **cp)
+{
+/**
+Function: Finds the next item in dp if it has the tag
+Output: Length of its contents, with *cp set to them, or -2 if it doesn't
+have the tag or there is none and casnp is optional, else -1.  A caller
+returns 0 for the first and -1 for the second.
+**/
+    uchar *c = dp->c;
+
+    if (c < dp->e && _tlv_lth(c, dp->e) < 0)
+        return -1;
+    if (c >= dp->e || _get_tag(&c) != tag)
+        return (casnp->flags & ASN_OPTIONAL_FLAG) ? -2 : -1;
+    *cp = c;
+    return _calc_lth(cp, 0);
+}
+
+void
+_direct_begin(
+    struct casn_direct *dp,
+    struct casn *casnp,
+    uchar *from,
+    int lth)
+{
+    dp->c = dp->e = from;
+    dp->casnp = casnp;
+    dp->from = from;
+    dp->lth = lth;
+    // decode_casn_lth() reports any error again if need be
+    dp->errorp = casn_error;
+    casn_error = NULL;
+    if (_clear_error(casnp) < 0 || lth <= 0 || lth == ASN_UNDEFINED_LTH ||
+        (casnp->flags & (ASN_CHOSEN_FLAG | ASN_DEFINED_FLAG)))
+        return;                 // nothing to decode, so it falls back
+    _clear_casn(casnp, ~(ASN_FILLED_FLAG));
+    dp->e = &from[lth];
+}
+
+int
+_direct_end(
+    struct casn_direct *dp,
+    int ansr)
+{
+    casn_error = dp->errorp;
+    if (ansr > 0 && dp->c == dp->e)
+        return dp->c - dp->from;
+    return decode_casn_lth(dp->casnp, dp->from, dp->lth);
+}
+
+int
+_direct_enter(
+    struct casn_direct *innerp,
+    struct casn_direct *dp,
+    struct casn *casnp,
+    long tag)
+{
+/**
+Function: Starts decoding a SEQUENCE, SET OF or SEQUENCE OF whose members
+the generated code decodes
+Procedure:
+1. IF casnp is lazy or a pointer, give up
+   Find the next item in dp
+   IF it's not there, return what that means
+   Set casnp's length
+2. IF casnp is explicitly tagged
+        IF the explicit tag doesn't hold just one item of casnp's type with
+            something in it, give up
+        Go into that item
+3. Set innerp to cover the contents
+   IF they're empty, casnp is filled, as in _match_casn()
+**/
+    uchar *c;
+    int lth;
+
+    // step 1
+    if ((casnp->flags & (ASN_LAZY_FLAG | ASN_POINTER_FLAG)))
+        return -1;
+    if ((lth = _find_next(dp, casnp, tag, &c)) < 0)
+        return (lth == -2) ? 0 : -1;
+    casnp->lth = lth;
+    // step 2
+    if ((casnp->flags & ASN_EXPLICIT_FLAG))
+    {
+        if (!lth || _tlv_lth(c, &c[lth]) != lth ||
+            _get_tag(&c) != casnp->type || (lth = _calc_lth(&c, 0)) <= 0)
+            return -1;
+    }
+    // step 3
+    innerp->c = c;
+    innerp->e = &c[lth];
+    if (!lth && (casnp->min || _fill_upward(casnp, ASN_FILLED_FLAG) < 0))
+        return -1;
+    return 1;
+}
+
+int
+_direct_leave(
+    struct casn_direct *innerp,
+    struct casn_direct *dp)
+{
+    if (innerp->c != innerp->e)
+        return -1;
+    dp->c = innerp->e;
+    return 1;
+}
+
+int
+_direct_prim(
+    struct casn_direct *dp,
+    struct casn *casnp,
+    long tag)
+{
+    uchar *c;
+    int lth;
+
+    if (casnp->type == ASN_ANY || casnp->type >= ASN_NONE ||
+        (casnp->type & ASN_CONSTRUCTED) ||
+        (casnp->flags & (ASN_POINTER_FLAG | ASN_EXPLICIT_FLAG)))
+        return _direct_casn(dp, casnp);
+    if ((lth = _find_next(dp, casnp, tag, &c)) < 0)
+        return (lth == -2) ? 0 : -1;
+    if (_write_casn(casnp, c, lth) < 0)
+        return -1;
+    dp->c = &c[lth];
+    return 1;
+}
+
+int
+_direct_casn(
+    struct casn_direct *dp,
+    struct casn *casnp)
+{
+/**
+Function: Decodes the next item in dp into casnp with _match_casn()
+Procedure:
+1. IF casnp's tag is known
+        IF the next item doesn't have it, return what that means
+   ELSE IF there is no next item, return what that means
+   ELSE IF casnp is optional and not the last at its level, give up, since
+        it can't be told whether the next item is casnp
+2. Decode the next item and nothing more
+**/
+    int lth;
+    int has_indef = 0;
+    uchar *c;
+
+    // step 1
+    if (casnp->tag < ASN_NONE && casnp->type != ASN_ANY)
+    {
+        if ((lth = _find_next(dp, casnp, casnp->tag, &c)) < 0)
+            return (lth == -2) ? 0 : -1;
+    }
+    else if (dp->c >= dp->e)
+        return (casnp->flags & ASN_OPTIONAL_FLAG) ? 0 : -1;
+    else if ((casnp->flags & (ASN_OPTIONAL_FLAG | ASN_LAST_FLAG)) ==
+             ASN_OPTIONAL_FLAG)
+        return -1;
+    // step 2
+    if ((lth = _tlv_lth(dp->c, dp->e)) < 0 ||
+        _match_casn(casnp, dp->c, lth, 0, 0, (struct casn *)0,
+                    &has_indef) != lth || has_indef)
+        return -1;
+    dp->c += lth;
+    return 1;
+}
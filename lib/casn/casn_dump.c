@@ -14,6 +14,7 @@ Cambridge, Ma. 02138
 *****************************************************************************/
 
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "casn.h"
@@ -43,9 +44,12 @@ _dumpsize(
 struct oidtable *oidtable;
 int oidtable_size;
 
+// loads OIDTABLE the first time any thread dumps something
+static pthread_once_t default_oidtable_once = PTHREAD_ONCE_INIT;
+
 #define ASN_READING 1
 
-static struct typnames typnames[] = {
+static const struct typnames typnames[] = {
     {ASN_BOOLEAN, "boo"},
     {ASN_INTEGER, "int"},
     {ASN_BITSTRING, "bit"},
@@ -77,7 +81,15 @@ static struct typnames typnames[] = {
     {0, "oth"},
 };
 
-extern char char_table[];
+extern const char char_table[];
+
+static void
+load_default_oidtable(
+    void)
+{
+    if (!oidtable && OIDTABLE)
+        load_oidtable(OIDTABLE);
+}
 
 int dump_casn(
     struct casn *casnp,
@@ -87,8 +99,7 @@ int dump_casn(
 
     if (_clear_error(casnp) < 0)
         return -1;
-    if (!oidtable && OIDTABLE)
-        load_oidtable(OIDTABLE);
+    pthread_once(&default_oidtable_once, load_default_oidtable);
 
     if ((ansr = _dumpsize(casnp, to, 0, 1)) >= 0)
         to[ansr++] = '\n';
@@ -103,8 +114,7 @@ int dump_size(
     long ansr;
     if (_clear_error(casnp) < 0)
         return -1;
-    if (!oidtable && OIDTABLE)
-        load_oidtable(OIDTABLE);
+    pthread_once(&default_oidtable_once, load_default_oidtable);
 
     if ((ansr = _dumpsize(casnp, buf, 0, 0)) >= 0)
         ansr++;
@@ -299,6 +309,8 @@ Procedure:
         struct casn *ttcasnp,
            *of_casnp;
         did = 0;
+        if (_expand_kept(tcasnp) < 0)
+            return -1 - ansr;
         of_casnp = &tcasnp[1];
         do
         {
@@ -548,7 +560,7 @@ int _dump_tag(
 {
     char *c = to,
         *indef_lth_w = " /* indefinite length */";
-    struct typnames *tpnp;
+    const struct typnames *tpnp;
     int ansr,
         lth;
     uchar bb;
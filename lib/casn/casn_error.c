@@ -26,4 +26,4 @@ default_casn_error_handler(
     LOG(LOG_ERR, "  casn error details: casnp=%p", casn_err_struct.casnp);
 }
 
-casn_error_callback *casn_error = &default_casn_error_handler;
+__thread casn_error_callback *casn_error = &default_casn_error_handler;
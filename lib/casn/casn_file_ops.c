@@ -15,8 +15,10 @@ Cambridge, Ma. 02138
 
 #include "casn.h"
 #include "casn_private.h"
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 #ifndef _DOS
@@ -25,48 +27,147 @@ Cambridge, Ma. 02138
 #define O_DOS (O_BINARY | S_IWRITE |  S_IREAD)
 #endif
 
-int get_casn_file(
+// files at least this big are mapped instead of read into memory
+#define CASN_MMAP_MIN (64 * 1024)
+// zeros after the contents, in case a length at the end is cut short
+#define CASN_FILE_SLACK 4
+
+static void free_casn_file(
+    uchar *b,
+    ulong lth)
+{
+    (void)lth;
+    free(b);
+}
+
+static void unmap_casn_file(
+    uchar *b,
+    ulong lth)
+{
+    munmap(b, lth);
+}
+
+/**
+ * Maps the regular file open on fd if it's big enough to be worth it
+ *
+ * The rest of its last page must hold the slack, which the kernel fills
+ * with zeros.
+ *
+ * return the address, or NULL if it should be read instead
+ */
+static uchar *map_casn_file(
+    int fd,
+    long siz)
+{
+    long pagesize = sysconf(_SC_PAGESIZE);
+    void *b;
+
+    if (siz < CASN_MMAP_MIN || pagesize <= 0 ||
+        pagesize - (siz % pagesize) < CASN_FILE_SLACK ||
+        siz % pagesize == 0)
+        return (uchar *) 0;
+    if ((b = mmap(NULL, siz, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+        return (uchar *) 0;
+    (void)posix_madvise(b, siz, POSIX_MADV_SEQUENTIAL);
+    return (uchar *) b;
+}
+
+/**
+ * Reads fd to the end, starting with room for hint bytes
+ *
+ * return the number of bytes read, or -1 if read() fails or there's no
+ * more memory
+ */
+static long read_all(
+    int fd,
+    long hint,
+    uchar **bp)
+{
+    long siz = 0;
+    long room = hint + 1;       // to see the end without growing
+    ssize_t tmp;
+    uchar *b,
+       *c;
+
+    if (!(b = (uchar *) calloc(1, room + CASN_FILE_SLACK)))
+        return -1;
+    for (;;)
+    {
+        if (siz == room)
+        {
+            if (!(c = (uchar *) realloc(b, 2 * room + CASN_FILE_SLACK)))
+            {
+                free(b);
+                return -1;
+            }
+            b = c;
+            memset(&b[room], 0, room + CASN_FILE_SLACK);
+            room *= 2;
+        }
+        if ((tmp = read(fd, &b[siz], room - siz)) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            free(b);
+            return -1;
+        }
+        if (tmp == 0)
+            break;
+        siz += tmp;
+    }
+    *bp = b;
+    return siz;
+}
+
+/**
+ * Gets the contents of the named file, or of fd if name is NULL
+ *
+ * Big regular files are mapped if may_map is nonzero.  *releasep is set to
+ * what frees *bp.
+ *
+ * return the length, or a negative error
+ */
+static long read_casn_file(
     struct casn *casnp,
     const char *name,
-    int fd)
+    int fd,
+    int may_map,
+    uchar **bp,
+    void (**releasep)(uchar *, ulong))
 {
+    struct stat statbuf;
     long siz;
     long tmp;
-    uchar *b;
+    uchar *b = (uchar *) 0;
     uchar *c;
 
     // if name is NULL, we were passed an active file descriptor
-    if (name)
+    if (name && (fd = open(name, (O_RDONLY | O_DOS))) < 0)
+        return _casn_obj_err(casnp, ASN_FILE_ERR);
+    if (fstat(fd, &statbuf) < 0 || !S_ISREG(statbuf.st_mode))
+        siz = 2048;
+    else if (!name)
     {
-        struct stat statbuf;
-        if (stat(name, &statbuf) < 0 ||
-            !(b = (uchar *) calloc(1, statbuf.st_size + 4)) ||
-            (fd = open(name, (O_RDONLY | O_DOS))) < 0 ||
-            (siz = read(fd, b, statbuf.st_size + 1)) < 0)
-            return _casn_obj_err(casnp, ASN_FILE_ERR);
-        close(fd);
+        // what's left after the current offset, which mmap can't start at
+        siz = statbuf.st_size - lseek(fd, 0, SEEK_CUR);
+        if (siz < 0)
+            siz = 2048;
     }
     else
     {
-        for (siz = 2048, b = c = (uchar *) calloc(1, siz); 1;)
-        {
-            if ((tmp = read(fd, c, 2048)) == 2048)
-            {
-                b = (uchar *) realloc(b, siz + 2048);
-                c = &b[siz];
-                siz += 2048;
-            }
-            else if (tmp < 0)
-            {
-                if (name)
-                    close(fd);  // if we opened it
-                return _casn_obj_err(casnp, ASN_FILE_ERR);
-            }
-            else
-                break;
-        }
-        siz = (siz - 1024 + tmp);
+        siz = statbuf.st_size;
+        if (may_map && (b = map_casn_file(fd, siz)))
+            *releasep = unmap_casn_file;
     }
+    if (!b)
+    {
+        *releasep = free_casn_file;
+        siz = read_all(fd, siz, &b);
+    }
+    if (name)
+        close(fd);              // if we opened it
+    if (siz < 0)
+        return _casn_obj_err(casnp, ASN_FILE_ERR);
     // defend against a truncated file
     c = b;
     tmp = _get_tag(&c);
@@ -76,13 +177,55 @@ int get_casn_file(
         tmp += (c - b);
         if (tmp != siz)
         {
-            free(b);
+            (*releasep)(b, siz);
             return _casn_obj_err(casnp, ASN_FILE_SIZE_ERR);
         }
     }
-    tmp = decode_casn_lth(casnp, b, siz);
-    free(b);
-    return tmp;
+    *bp = b;
+    return siz;
+}
+
+int get_casn_file(
+    struct casn *casnp,
+    const char *name,
+    int fd)
+{
+    long siz;
+    int ansr;
+    uchar *b;
+    void (*release)(uchar *, ulong);
+
+    if ((siz = read_casn_file(casnp, name, fd, 1, &b, &release)) < 0)
+        return siz;
+    ansr = decode_casn_lth(casnp, b, siz);
+    release(b, siz);
+    return ansr;
+}
+
+int get_casn_file_buf(
+    struct casn *casnp,
+    const char *name,
+    int fd)
+{
+    long siz;
+    int ansr;
+    uchar *b;
+    void (*release)(uchar *, ulong);
+    struct casn_buf *bufp;
+
+    // not mapped, because the object may outlive the file's contents:
+    // truncating a mapped file makes reading past its new end SIGBUS
+    if ((siz = read_casn_file(casnp, name, fd, 0, &b, &release)) < 0)
+        return siz;
+    if (!(bufp = casn_buf_new(b, siz, release)))
+    {
+        release(b, siz);
+        return _casn_obj_err(casnp, ASN_MEM_ERR);
+    }
+    // the decoded members keep the buffer alive after this
+    ansr = decode_casn_buf(casnp, bufp);
+    casn_buf_unref(bufp);
+    return ansr;
 }
 
 int put_casn_file(
@@ -90,8 +233,11 @@ int put_casn_file(
     char *name,
     int fd)
 {
-    uchar *b;
+    uchar *b = (uchar *) 0;
     int siz;
+    int did;
+    int err = 0;
+    ssize_t tmp;
 
     // the semantics of using O_CREAT with O_EXCL will cause the
     // file open to fail if it already exists, so we must unlink it
@@ -102,18 +248,36 @@ int put_casn_file(
                            (O_WRONLY | O_CREAT | O_TRUNC | O_DOS | O_EXCL),
                            0644)) < 0)
         return _casn_obj_err(casnp, ASN_FILE_ERR);
+    // sized once, encoded once into exactly that much, written at once
     if ((siz = size_casn(casnp)) < 0)
+        err = siz;
+    else if (!(b = (uchar *) malloc(siz)))
+        err = _casn_obj_err(casnp, ASN_MEM_ERR);
+    else if ((did = encode_casn(casnp, b)) != siz)
+        err = (did < 0) ? did : _casn_obj_err(casnp, ASN_LENGTH_ERR);
+    if (err < 0)
     {
         if (name)
             close(fd);
-        return siz;
+        free(b);
+        return err;
+    }
+    for (did = 0; did < siz; did += tmp)
+    {
+        if ((tmp = write(fd, &b[did], siz - did)) < 0)
+        {
+            if (errno == EINTR)
+            {
+                tmp = 0;
+                continue;
+            }
+            break;
+        }
     }
-    b = (uchar *) calloc(1, siz);
-    encode_casn(casnp, b);
-    if (write(fd, b, siz) != siz)
-        abort();
     free(b);
     if (name)
         close(fd);
+    if (did < siz)
+        return _casn_obj_err(casnp, ASN_FILE_ERR);
     return siz;
 }
@@ -0,0 +1,77 @@
+/*****************************************************************************
+File:     casn_lazy.c
+Contents: Decoding constructed items on first access.
+System:   Compact ASN development.
+Created:
+Author:
+
+Remarks:
+    A lazy SEQUENCE, SET or OF is filled in with its members' encodings,
+    as a streamed OF is, and its members are left empty.  Since a filled
+    item never has a lazy ancestor that is still encoded, only empty
+    items marked lazy need to look up the tree, which _clear_error()
+    does for every function that takes a struct casn.
+
+*****************************************************************************/
+
+#include "casn.h"
+#include "casn_private.h"
+
+static void
+_set_lazy(
+    struct casn *casnp)
+{
+    struct casn *tcasnp;
+
+    for (tcasnp = &casnp[1]; tcasnp; tcasnp = _skip_casn(tcasnp, 1))
+    {
+        tcasnp->flags |= ASN_LAZY_FLAG;
+        if ((tcasnp->type & ASN_CONSTRUCTED) &&
+            !(tcasnp->flags & ASN_POINTER_FLAG))
+            _set_lazy(tcasnp);
+    }
+}
+
+int
+lazy_casn(
+    struct casn *casnp)
+{
+    if (_clear_error(casnp) < 0)
+        return -1;
+    if (!(casnp->type & ASN_CONSTRUCTED))
+        return _casn_obj_err(casnp, ASN_TYPE_ERR);
+    _set_lazy(casnp);
+    return 0;
+}
+
+int
+_expand_above(
+    struct casn *casnp)
+{
+/**
+Function: Decodes whatever lazy items above casnp are still encoded, so that
+casnp can be used
+Output: 0 if successful, else -1
+Procedure:
+1. DO
+        Find the highest item above casnp that is still encoded
+        IF there is one, decode its members
+   WHILE there was one
+**/
+    struct casn *tcasnp;
+    struct casn *keptp;
+
+    do
+    {
+        for (keptp = (struct casn *)0, tcasnp = _go_up(casnp); tcasnp;
+             tcasnp = _go_up(tcasnp))
+        {
+            if ((tcasnp->type & ASN_CONSTRUCTED) && tcasnp->startp)
+                keptp = tcasnp;
+        }
+        if (keptp && _expand_kept(keptp) < 0)
+            return -1;
+    }
+    while (keptp);
+    return 0;
+}
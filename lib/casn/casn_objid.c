@@ -13,6 +13,8 @@ Cambridge, Ma. 02138
 617-873-3000
 *****************************************************************************/
 
+#include <limits.h>
+
 #include "casn.h"
 #include "casn_private.h"
 #include "util/stringutils.h"
@@ -81,6 +83,84 @@ int diff_objid(
     return ansr;
 }
 
+int diff_objid_der(
+    struct casn *casnp,
+    const uchar *der,
+    int lth)
+{
+    if (_clear_error(casnp) < 0)
+        return -1;
+    if (casnp->type != ASN_OBJ_ID && casnp->type != ASN_RELATIVE_OID)
+        return _casn_obj_err(casnp, ASN_TYPE_ERR);
+    if (lth < 0)
+        return _casn_obj_err(casnp, ASN_LENGTH_ERR);
+    if (casnp->tag == ASN_NOTYPE && _check_enum(&casnp) <= 0)
+        return -2;
+    // as in diff_objid(), an empty OID matches nothing
+    if (!casnp->lth)
+        return -2;
+    if (casnp->lth != (ulong)lth || memcmp(casnp->startp, der, lth))
+        return 1;
+    return 0;
+}
+
+int objid_to_der(
+    const char *objid,
+    uchar *to,
+    int tolen)
+{
+    const char *c = objid;
+    ulong val;
+    ulong tmp;
+    ulong first = 0;
+    int arc;
+    int siz;
+    int i;
+    int lth = 0;
+
+    for (arc = 0; *c; arc++)
+    {
+        if (*c < '0' || *c > '9')
+            return -1;
+        for (val = 0; *c >= '0' && *c <= '9'; c++)
+        {
+            if (val > (ULONG_MAX - 9) / 10)
+                return -1;
+            val = (val * 10) + *c - '0';
+        }
+        if (*c == '.')
+        {
+            if (!*++c)
+                return -1;
+        }
+        else if (*c)
+            return -1;
+        // the first two arcs make one subidentifier
+        if (arc == 0)
+        {
+            if (val > 2)
+                return -1;
+            first = val;
+            continue;
+        }
+        if (arc == 1)
+        {
+            if ((first < 2 && val >= 40) || val > ULONG_MAX - 80)
+                return -1;
+            val += first * 40;
+        }
+        for (tmp = val >> 7, siz = 1; tmp; siz++)
+            tmp >>= 7;
+        if (lth + siz > tolen)
+            return -1;
+        // base 128, high bit set on all but the last octet
+        for (i = siz - 1; i >= 0; i--, val >>= 7)
+            to[lth + i] = (uchar)(val & 0x7F) | ((i < siz - 1) ? 0x80 : 0);
+        lth += siz;
+    }
+    return (arc < 2) ? -1 : lth;
+}
+
 int read_objid(
     struct casn *casnp,
     char *to,
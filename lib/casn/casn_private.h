@@ -5,6 +5,8 @@
 #include <stdint.h>
 
 struct casn;
+struct casn_arena;
+struct casn_buf;
 
 void
 _clear_casn(
@@ -42,6 +44,10 @@ _skip_casn(
     struct casn *casnp,
     int num);
 
+int
+_num_casns(
+    struct casn *casnp);
+
 int
 _casn_obj_err(
     struct casn *,
@@ -113,6 +119,47 @@ int
 _write_enum(
     struct casn *casnp);
 
+int
+_keep_encoded(
+    struct casn *casnp,
+    unsigned char *c,
+    int lth);
+
+int
+_tlv_lth(
+    unsigned char *c,
+    unsigned char *e);
+
+int
+_count_encoded(
+    unsigned char *c,
+    int lth);
+
+int
+_match_casn(
+    struct casn *casnp,
+    unsigned char *from,
+    int nbytes,
+    unsigned short pflags,
+    unsigned short this_level,
+    struct casn *of_casnp,
+    int *had_indefp);
+
+int
+_decode_borrowed(
+    struct casn *casnp,
+    unsigned char *from,
+    int lth,
+    struct casn_buf *bufp);
+
+int
+_expand_kept(
+    struct casn *casnp);
+
+int
+_expand_above(
+    struct casn *casnp);
+
 int
 _write_objid(
     struct casn *casnp,
@@ -126,6 +173,34 @@ void *
 _free_it(
     void *);
 
+void
+_release_startp(
+    struct casn *casnp);
+
+int
+_own_startp(
+    struct casn *casnp);
+
+void *
+_casn_calloc(
+    struct casn *casnp,
+    size_t size);
+
+void *
+_casn_free(
+    struct casn *casnp,
+    void *itp);
+
+void
+_bind_arena(
+    struct casn *casnp,
+    struct casn_arena *arenap);
+
+struct casn_buf *
+_arena_hold(
+    struct casn_arena *arenap,
+    struct casn_buf *bufp);
+
 int
 set_asn_lth(
     unsigned char *,
@@ -16,7 +16,9 @@ Remarks:
 
 extern int _casn_obj_err(
     struct casn *,
-    int);
+    int),
+    _clear_error(
+    struct casn *);
 extern struct casn *_go_up(
     struct casn *);
 #if (sparc || SPARC || INTEL || PA_RISC)
@@ -113,6 +115,8 @@ int read_casn_double(
     /*
      * step 1
      */
+    if (_clear_error(casnp) < 0)
+        return -1;
     bigend.short_val = 1;
     i = 0;
     if (casnp->level > 0 && (_go_up(casnp)->flags & ASN_OF_FLAG) &&
@@ -0,0 +1,158 @@
+/*****************************************************************************
+File:     casn_stream.c
+Contents: Iteration over the members of a SET OF or SEQUENCE OF.
+System:   Compact ASN development.
+Created:
+Author:
+
+Remarks:
+    A streamed OF is filled in with its members' encodings, like a
+    primitive item, instead of with a struct casn for each member.  The
+    iterator decodes one member at a time, so walking a manifest's
+    fileList or a CRL's revokedCertificates needs the same memory for
+    ten entries as for a million.
+
+*****************************************************************************/
+
+#include "casn.h"
+#include "casn_private.h"
+
+int
+_tlv_lth(
+    uchar *c,
+    uchar *e)
+{
+/**
+Function: Finds the size of the definite-length encoding at c, which must
+end by e
+Output: Number of bytes in the tag, length and contents, or -1
+**/
+    uchar *b = c;
+    int lth;
+    int num;
+
+    if (c >= e)
+        return -1;
+    if ((*c++ & 0x1F) == 0x1F)
+    {
+        do
+        {
+            if (c >= e)
+                return -1;
+        }
+        while ((*c++ & 0x80));
+    }
+    if (c >= e)
+        return -1;
+    if (((lth = *c++) & ASN_INDEF_LTH))
+    {                           // indefinite, or too long for an int
+        if (!(num = lth & ~ASN_INDEF_LTH) || num > 4 || e - c < num ||
+            (num == 4 && *c > 0x7F))
+            return -1;
+        for (lth = 0; num--; lth = (lth << 8) + *c++);
+    }
+    if (lth > e - c)
+        return -1;
+    return (c - b) + lth;
+}
+
+int
+_count_encoded(
+    uchar *c,
+    int lth)
+{
+/**
+Function: Counts the encoded members of an OF
+Output: The number of members, or -1 if they don't exactly fill lth bytes
+or one of them has an indefinite length
+**/
+    uchar *e = &c[lth];
+    int num;
+    int tlv_lth;
+
+    for (num = 0; c < e; num++, c += tlv_lth)
+    {
+        if ((tlv_lth = _tlv_lth(c, e)) < 0)
+            return -1;
+    }
+    return num;
+}
+
+int
+stream_casn_of(
+    struct casn *casnp)
+{
+    if (_clear_error(casnp) < 0)
+        return -1;
+    if (!(casnp->flags & ASN_OF_FLAG))
+        return _casn_obj_err(casnp, ASN_NOT_OF_ERR);
+    casnp->flags |= ASN_LAZY_FLAG;
+    return 0;
+}
+
+int
+casn_of_iter_init(
+    struct casn_of_iter *iterp,
+    struct casn *ofp,
+    struct casn *memberp)
+{
+    if (_clear_error(ofp) < 0)
+        return -1;
+    if (!(ofp->flags & ASN_OF_FLAG))
+        return _casn_obj_err(ofp, ASN_NOT_OF_ERR);
+    memset(iterp, 0, sizeof(struct casn_of_iter));
+    iterp->ofp = ofp;
+    iterp->memberp = memberp;
+    if (!memberp && _expand_kept(ofp) < 0)
+        return -1;
+    if (ofp->startp)
+    {
+        iterp->nextp = ofp->startp;
+        iterp->endp = &ofp->startp[ofp->lth];
+    }
+    else
+        iterp->casnp = &ofp[1];
+    return 0;
+}
+
+int
+casn_of_iter_next(
+    struct casn_of_iter *iterp,
+    struct casn **casnpp)
+{
+/**
+Function: Gets the next member of an OF
+Procedure:
+1. IF the OF was decoded as usual
+        IF at the terminating member, return 0
+        Return the current member and move to the next one
+2. IF at the end of the encoded members, return 0
+   Find the next encoded member and decode it into memberp, borrowing from
+   the same casn_buf as the OF if it borrows
+   Return memberp
+**/
+    int ansr;
+    int lth;
+
+    *casnpp = (struct casn *)0;
+    // step 1
+    if (iterp->casnp)
+    {
+        if (!iterp->casnp->ptr)
+            return 0;
+        *casnpp = iterp->casnp;
+        iterp->casnp = iterp->casnp->ptr;
+        return 1;
+    }
+    // step 2
+    if (iterp->nextp >= iterp->endp)
+        return 0;
+    if ((lth = _tlv_lth(iterp->nextp, iterp->endp)) < 0)
+        return _casn_obj_err(iterp->ofp, ASN_LENGTH_ERR);
+    if ((ansr = _decode_borrowed(iterp->memberp, iterp->nextp, lth,
+                                 iterp->ofp->bufp)) < 0)
+        return ansr;
+    iterp->nextp += lth;
+    *casnpp = iterp->memberp;
+    return 1;
+}
@@ -95,13 +95,18 @@ extern int _casn_obj_err(
     int),
     _check_filled(
     struct casn *casnp),
+    _clear_error(
+    struct casn *casnp),
     _fill_upward(
     struct casn *,
     int);
-extern void *_free_it(
-    void *);
+extern void _release_startp(
+    struct casn *casnp);
+extern void *_casn_calloc(
+    struct casn *casnp,
+    size_t size);
 
-static ushort _mos[] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304,
+static const ushort _mos[] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304,
     334, 365, 366
 };                              /* last is for leap year */
 
@@ -281,6 +286,8 @@ int read_casn_time(
      */
     int ansr;
 
+    if (_clear_error(casnp) < 0)
+        return -1;
     if (casnp->type == ASN_CHOICE)
     {
         if (vsize_casn(&casnp[1]))
@@ -296,6 +303,16 @@ int read_casn_time(
     if (!ansr)
         return 0;
     ansr = casnp->lth;
+    // the DER forms need no copying, and anything else is left to the
+    // more lenient conversion below
+    struct casn_time parsed;
+    if ((ansr == UTCSE + UTCSESIZ + 1 || ansr == GENSE + GENSESIZ + 1) &&
+        parse_casn_time((char *)casnp->startp, ansr, &parsed) ==
+        casnp->type && parsed.secs >= 0 && parsed.sec < 60)
+    {
+        *valp = parsed.secs;
+        return ansr;
+    }
     uchar timebuf[32];
     if (casnp->type == ASN_GENTIME)
     {
@@ -334,11 +351,119 @@ static ulong put_num(
     return val;
 }
 
+/**
+ * Converts the two decimal digits at c to a number
+ *
+ * return 0 to 99, or -1 if they aren't digits
+ */
+static int get_2digits(
+    const char *c)
+{
+    if (c[0] < '0' || c[0] > '9' || c[1] < '0' || c[1] > '9')
+        return -1;
+    return (c[0] - '0') * 10 + (c[1] - '0');
+}
+
+int parse_casn_time(
+    const char *from,
+    int lth,
+    struct casn_time *timep)
+{
+    const char *c = from;
+    int type;
+    int hi;
+    int modays;
+    int64_t yr,
+        days;
+
+    switch (lth)
+    {
+    case UTCSE + 1:            // YYMMDDHHMMZ
+    case UTCSE + UTCSESIZ + 1: // YYMMDDHHMMSSZ
+        type = ASN_UTCTIME;
+        if ((timep->year = get_2digits(&c[UTCYR])) < 0)
+            return -1;
+        // rfc5280#section-4.1.2.5.1
+        timep->year += (timep->year < 50) ? 2000 : 1900;
+        c += UTCYRSIZ;
+        break;
+    case GENSE + GENSESIZ + 1: // YYYYMMDDHHMMSSZ
+    case GENSE + GENSESIZ + 3: // YYYYMMDDHHMMSS.fZ
+        type = ASN_GENTIME;
+        if ((hi = get_2digits(&c[GENYR])) < 0 ||
+            (timep->year = get_2digits(&c[GENYR + 2])) < 0)
+            return -1;
+        timep->year += hi * 100;
+        c += GENYRSIZ;
+        break;
+    default:
+        return -1;
+    }
+    // c is now where the month is in either form
+    if (from[lth - 1] != 'Z' ||
+        (timep->mon = get_2digits(&c[UTCMO - UTCYRSIZ])) < 1 ||
+        timep->mon > 12 ||
+        (timep->day = get_2digits(&c[UTCDA - UTCYRSIZ])) < 1 ||
+        (timep->hour = get_2digits(&c[UTCHR - UTCYRSIZ])) < 0 ||
+        timep->hour > 23 ||
+        (timep->min = get_2digits(&c[UTCMI - UTCYRSIZ])) < 0 ||
+        timep->min > 59)
+        return -1;
+    c += UTCSE - UTCYRSIZ;
+    if (lth == UTCSE + 1)
+        timep->sec = 0;
+    else if ((timep->sec = get_2digits(c)) < 0 || timep->sec > 60)
+        return -1;          // 60 for a leap second
+    if (lth == GENSE + GENSESIZ + 3 &&
+        (c[UTCSESIZ] != '.' || c[UTCSESIZ + 1] < '0' ||
+         c[UTCSESIZ + 1] > '9'))
+        return -1;
+    modays = _mos[timep->mon] - _mos[timep->mon - 1];
+    if (timep->mon == 2 && (timep->year % 4) == 0 &&
+        ((timep->year % 100) != 0 || (timep->year % 400) == 0))
+        modays++;
+    if (timep->day > modays)
+        return -1;
+    // days since 1970, counting years from March so that a leap day is
+    // the last day of its year, and from 400 years early so that none
+    // is negative
+    yr = timep->year - (timep->mon < 3) + 400;
+    days = (yr * 365) + (yr / 4) - (yr / 100) + (yr / 400) +
+        (153 * (timep->mon + ((timep->mon < 3) ? 9 : -3)) + 2) / 5 +
+        timep->day - 1 - 719468 - 146097;
+    timep->secs = (((days * 24) + timep->hour) * 60 + timep->min) * 60 +
+        timep->sec;
+    return type;
+}
+
+int format_casn_time(
+    const struct casn_time *timep,
+    char *to,
+    size_t tolen)
+{
+    if (tolen < CASN_TIME_STRING_SIZE || timep->year < 0 ||
+        timep->year > 9999)
+        return -1;
+    put_num(to, (ulong) timep->year, 4);
+    to[4] = '-';
+    put_num(&to[5], (ulong) timep->mon, 2);
+    to[7] = '-';
+    put_num(&to[8], (ulong) timep->day, 2);
+    to[10] = ' ';
+    put_num(&to[11], (ulong) timep->hour, 2);
+    to[13] = ':';
+    put_num(&to[14], (ulong) timep->min, 2);
+    to[16] = ':';
+    put_num(&to[17], (ulong) timep->sec, 2);
+    to[19] = 0;
+    return CASN_TIME_STRING_SIZE - 1;
+}
+
 int write_casn_time(
     struct casn *casnp,
     int64_t time)
 {
-    ushort *mop;
+    const ushort *mop;
     long da,
         min,
         sec,
@@ -347,10 +472,12 @@ int write_casn_time(
        *to;
     int err = 0;
 
+    if (_clear_error(casnp) < 0)
+        return -1;
     if (casnp->type != ASN_UTCTIME && casnp->type != ASN_GENTIME)
         return -1;
-    _free_it(casnp->startp);
-    casnp->startp = (uchar *) calloc(1, 20);
+    _release_startp(casnp);
+    casnp->startp = (uchar *) _casn_calloc(casnp, 20);
     c = to = (char *)casnp->startp;
     if (casnp->type == ASN_GENTIME)
         c += 2;
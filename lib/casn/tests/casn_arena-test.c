@@ -0,0 +1,132 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "casn/casn.h"
+#include "casn/tests/casn_test_util.h"
+#include "test/unittest.h"
+
+
+#define NUM_ENTRIES 1000
+
+static bool check_list(
+    struct List *listp)
+{
+    struct Entry *entryp;
+    uchar name[32];
+    long val;
+
+    TEST(int, "%d", num_items(&listp->self), ==, NUM_ENTRIES);
+    entryp = (struct Entry *)member_casn(&listp->self, 123);
+    TEST(int, "%d", read_casn(&entryp->name, name), ==, 13);
+    TEST_MEMCMP(name, ==, "entry-123.roa", 13);
+    TEST(int, "%d", read_casn_num(&entryp->num, &val), >, 0);
+    TEST(long, "%ld", val, ==, 123000);
+    return true;
+}
+
+static bool test_decode(
+    void)
+{
+    struct casn_arena arena;
+    struct List list;
+    struct List copy;
+    struct Entry *entryp;
+    uchar *encoded;
+    uchar *reencoded;
+    ulong num_allocs;
+    int lth;
+
+    lth = encode_list(NUM_ENTRIES, &encoded);
+    casn_arena_init(&arena, 16 * 1024);
+
+    List(&list, 0);
+    TEST(int, "%d", casn_arena_bind(&list.self, &arena), ==, 0);
+    TEST(int, "%d", decode_casn_lth(&list.self, encoded, lth), ==, lth);
+    if (!check_list(&list))
+        return false;
+    // an entry, its name and its num for each member
+    num_allocs = arena.num_allocs;
+    TEST(ulong, "%lu", num_allocs, >=, 3 * NUM_ENTRIES);
+    TEST(ulong, "%lu", arena.num_chunks, <, num_allocs / 100);
+
+    // rewriting and re-encoding work as usual
+    entryp = (struct Entry *)member_casn(&list.self, 5);
+    TEST(int, "%d", write_casn(&entryp->name, (uchar *)"entry-5.roa", 11),
+         ==, 11);
+    reencoded = calloc(1, lth);
+    TEST(int, "%d", encode_casn(&list.self, reencoded), ==, lth);
+    TEST_MEMCMP(reencoded, ==, encoded, lth);
+
+    // a copy that isn't bound to the arena outlives it
+    List(&copy, 0);
+    TEST(int, "%d", copy_casn(&copy.self, &list.self), >, 0);
+
+    // clearing and decoding again reuse the arena
+    clear_casn(&list.self);
+    TEST(int, "%d", num_items(&list.self), ==, 0);
+    TEST(int, "%d", decode_casn_lth(&list.self, encoded, lth), ==, lth);
+    if (!check_list(&list))
+        return false;
+
+    casn_arena_reset(&arena);
+    TEST(ulong, "%lu", arena.num_allocs, ==, 0);
+    List(&list, 0);
+    TEST(int, "%d", casn_arena_bind(&list.self, &arena), ==, 0);
+    TEST(int, "%d", decode_casn_lth(&list.self, encoded, lth), ==, lth);
+    if (!check_list(&list))
+        return false;
+    TEST(ulong, "%lu", arena.num_allocs, ==, num_allocs);
+    casn_arena_free(&arena);
+
+    if (!check_list(&copy))
+        return false;
+    delete_casn(&copy.self);
+
+    free(encoded);
+    free(reencoded);
+    return true;
+}
+
+static bool test_decode_buf(
+    void)
+{
+    struct casn_arena arena;
+    struct casn_buf *bufp;
+    struct List list;
+    uchar *encoded;
+    int lth;
+
+    lth = encode_list(NUM_ENTRIES, &encoded);
+    casn_arena_init(&arena, 0);
+    num_releases = 0;
+    bufp = casn_buf_new(encoded, lth, count_release);
+
+    List(&list, 0);
+    casn_arena_bind(&list.self, &arena);
+    TEST(int, "%d", decode_casn_buf(&list.self, bufp), ==, lth);
+    // the arena holds one reference for all of the members
+    TEST(ulong, "%lu", bufp->refcount, ==, 2);
+    casn_buf_unref(bufp);
+    if (!check_list(&list))
+        return false;
+
+    casn_arena_reset(&arena);
+    TEST(int, "%d", num_releases, ==, 1);
+    casn_arena_free(&arena);
+
+    free(encoded);
+    return true;
+}
+
+int main(
+    void)
+{
+    if (!test_decode())
+        return -1;
+    if (!test_decode_buf())
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "casn/casn.h"
+#include "casn/tests/casn_test_util.h"
+#include "test/unittest.h"
+
+
+static bool inside(
+    const uchar *p,
+    const struct casn_buf *bufp)
+{
+    return p >= bufp->startp && p < &bufp->startp[bufp->lth];
+}
+
+static bool test_decode(
+    void)
+{
+    struct Numbered rec;
+    struct casn_buf *bufp;
+    uchar *encoded;
+    uchar *expected;
+    uchar *reencoded;
+    uchar *data;
+    uchar name[8];
+    long val;
+    int lth;
+
+    lth = encode_numbered("hello", &encoded);
+    data = malloc(lth);
+    memcpy(data, encoded, lth);
+    num_releases = 0;
+    bufp = casn_buf_new(data, lth, free_release);
+    TEST_BOOL(bufp != NULL, true);
+
+    Numbered(&rec, 0);
+    TEST(int, "%d", decode_casn_buf(&rec.self, bufp), ==, lth);
+    TEST_BOOL(inside(rec.num.startp, bufp), true);
+    TEST_BOOL(inside(rec.name.startp, bufp), true);
+    TEST_BOOL(inside(member_casn(&rec.nums.self, 1)->startp, bufp), true);
+    // one reference for each leaf, plus the caller's
+    TEST(ulong, "%lu", bufp->refcount, ==, 6);
+
+    // the members keep the buffer alive
+    casn_buf_unref(bufp);
+    TEST(int, "%d", num_releases, ==, 0);
+    TEST(int, "%d", read_casn_num(&rec.num, &val), ==, 1);
+    TEST(long, "%ld", val, ==, 5);
+    TEST(int, "%d", read_casn_num(member_casn(&rec.nums.self, 1), &val),
+         ==, 2);
+    TEST(long, "%ld", val, ==, 300);
+    TEST(int, "%d", read_casn(&rec.name, name), ==, 5);
+    TEST_MEMCMP(name, ==, "hello", 5);
+
+    // writing a member copies it, the buffer is left alone
+    TEST(int, "%d", write_casn(&rec.name, (uchar *)"world", 5), ==, 5);
+    TEST_BOOL(inside(rec.name.startp, bufp), false);
+    TEST(ulong, "%lu", bufp->refcount, ==, 4);
+    TEST_MEMCMP(data, ==, encoded, lth);
+    TEST(int, "%d", encode_numbered("world", &expected), ==, lth);
+    reencoded = calloc(1, lth);
+    TEST(int, "%d", encode_casn(&rec.self, reencoded), ==, lth);
+    TEST_MEMCMP(reencoded, ==, expected, lth);
+
+    // so does copying the object
+    struct Numbered copy;
+    Numbered(&copy, 0);
+    TEST(int, "%d", copy_casn(&copy.self, &rec.self), >, 0);
+    TEST_BOOL(inside(copy.num.startp, bufp), false);
+    TEST(ulong, "%lu", bufp->refcount, ==, 4);
+
+    delete_casn(&rec.self);
+    TEST(int, "%d", num_releases, ==, 1);
+    TEST(int, "%d", read_casn_num(&copy.num, &val), ==, 1);
+    TEST(long, "%ld", val, ==, 5);
+    delete_casn(&copy.self);
+
+    free(encoded);
+    free(expected);
+    free(reencoded);
+    return true;
+}
+
+static bool test_decode_error(
+    void)
+{
+    struct Numbered rec;
+    struct casn_buf *bufp;
+    uchar *encoded;
+    int lth;
+
+    lth = encode_numbered("hello", &encoded);
+    num_releases = 0;
+    // truncated in the middle of nums
+    bufp = casn_buf_new(encoded, lth - 2, free_release);
+    Numbered(&rec, 0);
+    TEST(int, "%d", decode_casn_buf(&rec.self, bufp), <, 0);
+    casn_buf_unref(bufp);
+    delete_casn(&rec.self);
+    TEST(int, "%d", num_releases, ==, 1);
+    return true;
+}
+
+static bool test_file(
+    void)
+{
+    struct Numbered rec;
+    char path[] = "/tmp/casn_buf-test.XXXXXX";
+    uchar *encoded;
+    uchar *reencoded;
+    int fd;
+    int lth;
+
+    lth = encode_numbered("hello", &encoded);
+    fd = mkstemp(path);
+    TEST_BOOL(fd >= 0, true);
+    TEST(ssize_t, "%zd", write(fd, encoded, lth), ==, (ssize_t)lth);
+    close(fd);
+
+    Numbered(&rec, 0);
+    TEST(int, "%d", get_casn_file_buf(&rec.self, path, 0), ==, lth);
+    unlink(path);
+    TEST(ulong, "%lu", rec.name.bufp->refcount, ==, 5);
+    reencoded = calloc(1, lth);
+    TEST(int, "%d", encode_casn(&rec.self, reencoded), ==, lth);
+    TEST_MEMCMP(reencoded, ==, encoded, lth);
+    delete_casn(&rec.self);
+
+    free(encoded);
+    free(reencoded);
+    return true;
+}
+
+int main(
+    void)
+{
+    if (!test_decode())
+        return -1;
+    if (!test_decode_error())
+        return -1;
+    if (!test_file())
+        return -1;
+
+    return 0;
+}
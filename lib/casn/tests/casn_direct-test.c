@@ -0,0 +1,132 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "casn/casn.h"
+#include "casn/tests/casn_test_util.h"
+#include "test/unittest.h"
+
+
+/**
+    Decode encoded both ways, and check that they agree and that the
+    result is expected.
+*/
+static bool check_decode(
+    uchar *encoded,
+    int lth,
+    int expected)
+{
+    struct Rec rec;
+    struct Rec direct;
+    uchar *reencoded;
+    uchar *expected_encoding;
+    int ret;
+    int size;
+
+    Rec(&rec, 0);
+    Rec(&direct, 0);
+    TEST(int, "%d", decode_casn_lth(&rec.self, encoded, lth), ==, expected);
+    ret = RecDecode(&direct, encoded, lth);
+    TEST(int, "%d", ret, ==, expected);
+    if (ret > 0)
+    {
+        TEST(int, "%d", diff_casn(&direct.self, &rec.self), ==, 0);
+        TEST(int, "%d", num_items(&direct.exts.self), ==,
+             num_items(&rec.exts.self));
+        TEST(int, "%d", vsize_casn(&direct.label), ==,
+             vsize_casn(&rec.label));
+        // not always the same as encoded, if a change to it was accepted
+        size = size_casn(&rec.self);
+        reencoded = calloc(1, size);
+        expected_encoding = calloc(1, size);
+        TEST(int, "%d", encode_casn(&rec.self, expected_encoding), ==, size);
+        TEST(int, "%d", encode_casn(&direct.self, reencoded), ==, size);
+        TEST_MEMCMP(reencoded, ==, expected_encoding, size);
+        free(reencoded);
+        free(expected_encoding);
+    }
+    delete_casn(&rec.self);
+    delete_casn(&direct.self);
+    return true;
+}
+
+static bool test_decode(
+    void)
+{
+    uchar *encoded;
+    int lth;
+
+    // with every member, without the optional ones, and with an empty OF
+    lth = encode_rec("label", "issuer", 5, &encoded);
+    if (!check_decode(encoded, lth, lth))
+        return false;
+    free(encoded);
+    lth = encode_rec(NULL, "issuer", 0, &encoded);
+    if (!check_decode(encoded, lth, lth))
+        return false;
+    free(encoded);
+    lth = encode_rec("label", "issuer", 1, &encoded);
+    if (!check_decode(encoded, lth, lth))
+        return false;
+    free(encoded);
+    return true;
+}
+
+static bool test_fallback(
+    void)
+{
+    struct Rec rec;
+    uchar *encoded;
+    int lth;
+    int i;
+    int errnum;
+
+    // every change to a byte gives the same result as decode_casn_lth()
+    lth = encode_rec("label", "issuer", 2, &encoded);
+    for (i = 0; i < lth; i++)
+    {
+        encoded[i] ^= 0x01;
+        Rec(&rec, 0);
+        if (!check_decode(encoded, lth,
+                          decode_casn_lth(&rec.self, encoded, lth)))
+            return false;
+        delete_casn(&rec.self);
+        encoded[i] ^= 0x01;
+    }
+
+    // an error is reported as decode_casn_lth() reports it
+    // version is 02 01 02, the label starts at offset 5
+    TEST(int, "%d", encoded[5], ==, ASN_OCTETSTRING);
+    encoded[5] = ASN_BOOLEAN;
+    Rec(&rec, 0);
+    TEST(int, "%d", decode_casn_lth(&rec.self, encoded, lth), <, 0);
+    errnum = casn_err_struct.errnum;
+    delete_casn(&rec.self);
+    memset(&casn_err_struct, 0, sizeof(casn_err_struct));
+    Rec(&rec, 0);
+    TEST(int, "%d", RecDecode(&rec, encoded, lth), <, 0);
+    TEST(int, "%d", casn_err_struct.errnum, ==, errnum);
+    delete_casn(&rec.self);
+    encoded[5] = ASN_OCTETSTRING;
+
+    // as is anything after the end
+    Rec(&rec, 0);
+    if (!check_decode(encoded, lth + 2,
+                      decode_casn_lth(&rec.self, encoded, lth + 2)))
+        return false;
+    delete_casn(&rec.self);
+    free(encoded);
+    return true;
+}
+
+int main(
+    void)
+{
+    if (!test_decode())
+        return -1;
+    if (!test_fallback())
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "casn/casn.h"
+#include "casn/tests/casn_test_util.h"
+#include "test/unittest.h"
+
+
+/**
+    Write a Pair with put_casn_file() and read it back both ways.
+
+    get_casn_file() maps big files, unless they fill their last page, so
+    sizes on both sides of that are tried.
+*/
+static bool check_file(
+    int lth)
+{
+    struct Pair rec;
+    struct Pair got;
+    char path[] = "/tmp/casn_file-test.XXXXXX";
+    int fd;
+    int siz;
+
+    fd = mkstemp(path);
+    TEST_BOOL(fd >= 0, true);
+    close(fd);
+    make_pair(&rec, lth);
+    siz = size_casn(&rec.self);
+    TEST(int, "%d", put_casn_file(&rec.self, path, 0), ==, siz);
+
+    Pair(&got, 0);
+    TEST(int, "%d", get_casn_file(&got.self, path, 0), ==, siz);
+    TEST(int, "%d", diff_casn(&got.self, &rec.self), ==, 0);
+    delete_casn(&got.self);
+
+    Pair(&got, 0);
+    TEST(int, "%d", get_casn_file_buf(&got.self, path, 0), ==, siz);
+    unlink(path);
+    TEST(int, "%d", diff_casn(&got.self, &rec.self), ==, 0);
+    delete_casn(&got.self);
+    delete_casn(&rec.self);
+    return true;
+}
+
+static bool test_sizes(
+    void)
+{
+    static const int totals[] = {100, 8192, 128 * 1024, 128 * 1024 + 1,
+        128 * 1024 + 100, 128 * 1024 - 2, 1024 * 1024 + 4093};
+    struct Pair rec;
+    size_t i;
+    int overhead;
+
+    // the lengths of these are all in 3 or 4 octets
+    make_pair(&rec, 128 * 1024);
+    overhead = size_casn(&rec.self) - 128 * 1024;
+    delete_casn(&rec.self);
+    for (i = 0; i < sizeof(totals) / sizeof(totals[0]); i++)
+    {
+        if (!check_file(totals[i] < 8192 ? totals[i] :
+                        totals[i] - overhead))
+            return false;
+    }
+    return true;
+}
+
+static bool test_fd(
+    void)
+{
+    struct Pair rec;
+    struct Pair got;
+    int fds[2];
+    int lth = 5000;
+    int siz;
+
+    // a pipe can't be mapped or sized, so it's read until it's closed
+    make_pair(&rec, lth);
+    siz = size_casn(&rec.self);
+    TEST(int, "%d", pipe(fds), ==, 0);
+    TEST(int, "%d", put_casn_file(&rec.self, NULL, fds[1]), ==, siz);
+    close(fds[1]);
+    Pair(&got, 0);
+    TEST(int, "%d", get_casn_file(&got.self, NULL, fds[0]), ==, siz);
+    close(fds[0]);
+    TEST(int, "%d", diff_casn(&got.self, &rec.self), ==, 0);
+    delete_casn(&got.self);
+    delete_casn(&rec.self);
+    return true;
+}
+
+static bool test_truncated(
+    void)
+{
+    struct Pair rec;
+    char path[] = "/tmp/casn_file-test.XXXXXX";
+    int fd;
+    int siz;
+
+    fd = mkstemp(path);
+    TEST_BOOL(fd >= 0, true);
+    close(fd);
+    make_pair(&rec, 200 * 1024);
+    siz = size_casn(&rec.self);
+    TEST(int, "%d", put_casn_file(&rec.self, path, 0), ==, siz);
+    delete_casn(&rec.self);
+    TEST(int, "%d", truncate(path, siz - 100), ==, 0);
+    Pair(&rec, 0);
+    TEST(int, "%d", get_casn_file(&rec.self, path, 0), <, 0);
+    delete_casn(&rec.self);
+    Pair(&rec, 0);
+    TEST(int, "%d", get_casn_file_buf(&rec.self, path, 0), <, 0);
+    delete_casn(&rec.self);
+    unlink(path);
+
+    Pair(&rec, 0);
+    TEST(int, "%d", get_casn_file(&rec.self, path, 0), <, 0);
+    delete_casn(&rec.self);
+    return true;
+}
+
+static bool test_truncated_later(
+    void)
+{
+    struct Pair rec;
+    struct Pair got;
+    char path[] = "/tmp/casn_file-test.XXXXXX";
+    int fd;
+    int siz;
+
+    // the members of got point into what was read, which doesn't change
+    // when the file does
+    fd = mkstemp(path);
+    TEST_BOOL(fd >= 0, true);
+    close(fd);
+    make_pair(&rec, 200 * 1024);
+    siz = size_casn(&rec.self);
+    TEST(int, "%d", put_casn_file(&rec.self, path, 0), ==, siz);
+    Pair(&got, 0);
+    TEST(int, "%d", get_casn_file_buf(&got.self, path, 0), ==, siz);
+    TEST(int, "%d", truncate(path, 0), ==, 0);
+    unlink(path);
+    TEST(int, "%d", diff_casn(&got.self, &rec.self), ==, 0);
+    delete_casn(&got.self);
+    delete_casn(&rec.self);
+    return true;
+}
+
+int main(
+    void)
+{
+    if (!test_sizes())
+        return -1;
+    if (!test_fd())
+        return -1;
+    if (!test_truncated())
+        return -1;
+    if (!test_truncated_later())
+        return -1;
+
+    return 0;
+}
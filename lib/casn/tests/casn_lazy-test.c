@@ -0,0 +1,229 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "casn/casn.h"
+#include "casn/tests/casn_test_util.h"
+#include "test/unittest.h"
+
+
+#define NUM_EXTS 5
+
+static bool check_encoding(
+    struct casn *casnp,
+    uchar *encoded,
+    int lth)
+{
+    uchar *reencoded = calloc(1, lth);
+
+    TEST(int, "%d", size_casn(casnp), ==, lth);
+    TEST(int, "%d", encode_casn(casnp, reencoded), ==, lth);
+    TEST_MEMCMP(reencoded, ==, encoded, lth);
+    free(reencoded);
+    return true;
+}
+
+static bool check_ext(
+    struct casn *casnp,
+    int i)
+{
+    struct Ext *extp = (struct Ext *)casnp;
+    char expected[32];
+    uchar value[32];
+    long val;
+
+    snprintf(expected, sizeof(expected), "value-%d", i);
+    TEST(int, "%d", read_casn_num(&extp->id, &val), >, 0);
+    TEST(long, "%ld", val, ==, (long)i);
+    TEST(int, "%d", read_casn(&extp->value, value), ==, (int)strlen(expected));
+    TEST_MEMCMP(value, ==, expected, strlen(expected));
+    return true;
+}
+
+static bool test_read(
+    void)
+{
+    struct casn_arena arena;
+    struct Rec rec;
+    struct casn *casnp;
+    uchar *encoded;
+    uchar issuer[16];
+    long val;
+    int lth;
+    ulong full_allocs;
+
+    lth = encode_rec(NULL, "issuer", NUM_EXTS, &encoded);
+
+    // decoded as usual, for comparison
+    casn_arena_init(&arena, 0);
+    Rec(&rec, 0);
+    casn_arena_bind(&rec.self, &arena);
+    TEST(int, "%d", decode_casn_lth(&rec.self, encoded, lth), ==, lth);
+    full_allocs = arena.num_allocs;
+    casn_arena_reset(&arena);
+
+    // only the top level is decoded
+    Rec(&rec, 0);
+    casn_arena_bind(&rec.self, &arena);
+    TEST(int, "%d", lazy_casn(&rec.self), ==, 0);
+    TEST(int, "%d", decode_casn_lth(&rec.self, encoded, lth), ==, lth);
+    TEST(ulong, "%lu", arena.num_allocs, <, full_allocs / 3);
+    TEST_BOOL(rec.header.self.startp != NULL, true);
+    TEST_BOOL(rec.exts.self.startp != NULL, true);
+    TEST_BOOL(rec.header.serial.startp == NULL, true);
+    TEST(int, "%d", read_casn_num(&rec.version, &val), ==, 1);
+    TEST(long, "%ld", val, ==, 2);
+    if (!check_encoding(&rec.self, encoded, lth))
+        return false;
+
+    // reading a member decodes the item it's in, and no more
+    TEST(int, "%d", read_casn(&rec.header.issuer, issuer), ==, 6);
+    TEST_MEMCMP(issuer, ==, "issuer", 6);
+    TEST_BOOL(rec.header.self.startp == NULL, true);
+    TEST_BOOL(rec.exts.self.startp != NULL, true);
+    TEST(int, "%d", read_casn_num(&rec.header.serial, &val), ==, 2);
+    TEST(long, "%ld", val, ==, 1234);
+
+    // as does asking for an OF's member, whose own members wait in turn
+    TEST(int, "%d", num_items(&rec.exts.self), ==, NUM_EXTS);
+    TEST_BOOL(rec.exts.self.startp != NULL, true);
+    casnp = member_casn(&rec.exts.self, 3);
+    TEST_BOOL(casnp != NULL, true);
+    TEST_BOOL(rec.exts.self.startp == NULL, true);
+    TEST_BOOL(casnp->startp != NULL, true);
+    if (!check_ext(casnp, 3))
+        return false;
+    TEST_BOOL(casnp->startp == NULL, true);
+    casnp = member_casn(&rec.exts.self, 0);
+    TEST_BOOL(casnp->startp != NULL, true);
+    if (!check_encoding(&rec.self, encoded, lth))
+        return false;
+
+    // dumping decodes everything
+    TEST_BOOL(dump_size(&rec.self) > 0, true);
+    TEST_BOOL(casnp->startp == NULL, true);
+    if (!check_ext(casnp, 0))
+        return false;
+
+    casn_arena_free(&arena);
+    free(encoded);
+    return true;
+}
+
+static bool test_write(
+    void)
+{
+    struct Rec rec;
+    struct Rec copy;
+    uchar *encoded;
+    uchar *expected;
+    int lth;
+    int expected_lth;
+
+    lth = encode_rec(NULL, "issuer", NUM_EXTS, &encoded);
+    expected_lth = encode_rec(NULL, "another issuer", NUM_EXTS, &expected);
+
+    // writing a member decodes its siblings first
+    Rec(&rec, 0);
+    lazy_casn(&rec.self);
+    TEST(int, "%d", decode_casn_lth(&rec.self, encoded, lth), ==, lth);
+    TEST(int, "%d", write_casn(&rec.header.issuer,
+                               (uchar *)"another issuer", 14), ==, 14);
+    TEST_BOOL(rec.exts.self.startp != NULL, true);
+    if (!check_encoding(&rec.self, expected, expected_lth))
+        return false;
+
+    // copying to a lazy object keeps what's still encoded
+    Rec(&copy, 0);
+    lazy_casn(&copy.self);
+    TEST(int, "%d", copy_casn(&copy.self, &rec.self), ==, expected_lth);
+    TEST_BOOL(copy.exts.self.startp != NULL, true);
+    TEST_BOOL(copy.header.self.startp == NULL, true);
+    if (!check_encoding(&copy.self, expected, expected_lth))
+        return false;
+    delete_casn(&copy.self);
+
+    // copying to one that isn't lazy decodes it
+    Rec(&copy, 0);
+    TEST(int, "%d", copy_casn(&copy.self, &rec.self), ==, expected_lth);
+    TEST_BOOL(rec.exts.self.startp == NULL, true);
+    TEST_BOOL(copy.exts.self.startp == NULL, true);
+    TEST(int, "%d", num_items(&copy.exts.self), ==, NUM_EXTS);
+    TEST(int, "%d", diff_casn(&copy.self, &rec.self), ==, 0);
+    if (!check_encoding(&copy.self, expected, expected_lth))
+        return false;
+    delete_casn(&copy.self);
+
+    // and comparing does too
+    delete_casn(&rec.self);
+    Rec(&rec, 0);
+    lazy_casn(&rec.self);
+    decode_casn_lth(&rec.self, encoded, lth);
+    Rec(&copy, 0);
+    decode_casn_lth(&copy.self, expected, expected_lth);
+    TEST(int, "%d", diff_casn(&rec.self, &copy.self), !=, 0);
+    TEST_BOOL(rec.header.self.startp == NULL, true);
+    delete_casn(&copy.self);
+
+    // clearing a lazy item leaves the rest encoded
+    TEST_BOOL(rec.exts.self.startp != NULL, true);
+    clear_casn(&rec.exts.self);
+    TEST_BOOL(rec.exts.self.startp == NULL, true);
+    TEST(int, "%d", num_items(&rec.exts.self), ==, 0);
+    TEST_BOOL(rec.header.self.startp == NULL, true);
+    TEST_BOOL(rec.exts.ext.self.startp == NULL, true);
+
+    delete_casn(&rec.self);
+    free(encoded);
+    free(expected);
+    return true;
+}
+
+static bool test_bad_member(
+    void)
+{
+    struct Rec rec;
+    uchar *encoded;
+    long val;
+    int lth;
+
+    // the header's serial is 02 02 04 D2 at offset 7, make it an OCTET
+    // STRING
+    lth = encode_rec(NULL, "issuer", NUM_EXTS, &encoded);
+    TEST(int, "%d", encoded[5], ==, ASN_SEQUENCE);
+    TEST(int, "%d", encoded[7], ==, ASN_INTEGER);
+    encoded[7] = ASN_OCTETSTRING;
+
+    Rec(&rec, 0);
+    TEST(int, "%d", decode_casn_lth(&rec.self, encoded, lth), <, 0);
+    delete_casn(&rec.self);
+
+    // the error is found when the header is needed, and it stays encoded
+    Rec(&rec, 0);
+    lazy_casn(&rec.self);
+    TEST(int, "%d", decode_casn_lth(&rec.self, encoded, lth), ==, lth);
+    TEST(int, "%d", read_casn_num(&rec.header.serial, &val), <, 0);
+    TEST_BOOL(rec.header.self.startp != NULL, true);
+    TEST(int, "%d", read_casn_num(&rec.version, &val), ==, 1);
+    if (!check_encoding(&rec.self, encoded, lth))
+        return false;
+    delete_casn(&rec.self);
+
+    TEST(int, "%d", lazy_casn(&rec.version), <, 0);
+    free(encoded);
+    return true;
+}
+
+int main(
+    void)
+{
+    if (!test_read())
+        return -1;
+    if (!test_write())
+        return -1;
+    if (!test_bad_member())
+        return -1;
+
+    return 0;
+}
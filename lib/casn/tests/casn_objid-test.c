@@ -0,0 +1,176 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "casn/casn.h"
+#include "casn/tests/casn_fixtures.h"
+#include "test/unittest.h"
+
+
+static const char *const objids[] = {
+    "2.5.29.14",
+    "1.3.6.1.5.5.7.1.7",
+    "1.2.840.113549.1.1.11",
+    "2.16.840.1.101.3.4.2.1",
+    "0.9.2342",
+    "1.39.0",
+    "2.999.3",
+    "1.3.6.1.4.1.4294967295",
+};
+
+/**
+    Check that objid_to_der() gives the contents octets that
+    write_objid() does, and that diff_objid_der() agrees with
+    diff_objid().
+*/
+static bool test_same(
+    void)
+{
+    struct casn casn;
+    struct casn other;
+    uchar encoded[ASN_OBJID_DER_MAX + 2];
+    uchar der[ASN_OBJID_DER_MAX];
+    size_t i;
+    int lth;
+
+    for (i = 0; i < sizeof(objids) / sizeof(objids[0]); i++)
+    {
+        simple_constructor(&casn, 0, ASN_OBJ_ID);
+        simple_constructor(&other, 0, ASN_OBJ_ID);
+        TEST(int, "%d", write_objid(&casn, objids[i]), >, 0);
+        // short enough that the length is one octet
+        TEST(int, "%d", size_casn(&casn), <=, (int)sizeof(encoded));
+        encode_casn(&casn, encoded);
+        lth = objid_to_der(objids[i], der, sizeof(der));
+        TEST(int, "%d", lth, ==, encoded[1]);
+        TEST_MEMCMP(der, ==, &encoded[2], lth);
+
+        TEST(int, "%d", diff_objid_der(&casn, der, lth), ==, 0);
+        TEST(int, "%d", diff_objid(&casn, objids[i]), ==, 0);
+        // one octet short, and one too many
+        TEST(int, "%d", diff_objid_der(&casn, der, lth - 1), ==, 1);
+        der[lth] = 0x01;
+        TEST(int, "%d", diff_objid_der(&casn, der, lth + 1), ==, 1);
+        // a different last arc
+        der[lth - 1] ^= 0x01;
+        TEST(int, "%d", diff_objid_der(&casn, der, lth), ==, 1);
+
+        // and as decoded
+        TEST(int, "%d", decode_casn(&other, encoded), ==, encoded[1] + 2);
+        der[lth - 1] ^= 0x01;
+        TEST(int, "%d", diff_objid_der(&other, der, lth), ==, 0);
+        delete_casn(&casn);
+        delete_casn(&other);
+    }
+    return true;
+}
+
+/**
+    Check that the id_xxx_der constants that asn_gen writes for
+    casn_fixtures.asn are what objid_to_der() gives, and that there are
+    none for the OIDs that objid_to_der() rejects.
+*/
+static bool test_generated(
+    void)
+{
+#define GENERATED(name) {name, name##_der, sizeof(name##_der) - 1}
+    static const struct {
+        const char *objid;
+        const char *der;
+        int lth;
+    } generated[] = {
+        GENERATED(id_test),
+        GENERATED(id_test_child),
+        GENERATED(id_test_joint),
+        GENERATED(id_test_ce),
+    };
+#undef GENERATED
+    struct casn casn;
+    uchar der[ASN_OBJID_DER_MAX];
+    size_t i;
+
+    for (i = 0; i < sizeof(generated) / sizeof(generated[0]); i++)
+    {
+        TEST(int, "%d", objid_to_der(generated[i].objid, der, sizeof(der)),
+             ==, generated[i].lth);
+        TEST_MEMCMP(der, ==, generated[i].der, generated[i].lth);
+    }
+
+#if defined(id_test_overflow_der) || defined(id_test_second_arc_der)
+    fprintf(stderr, "asn_gen wrote an id_xxx_der for a rejected OID\n");
+    return false;
+#endif
+    TEST(int, "%d", objid_to_der(id_test_overflow, der, sizeof(der)), ==, -1);
+    TEST(int, "%d", objid_to_der(id_test_second_arc, der, sizeof(der)),
+         ==, -1);
+
+    simple_constructor(&casn, 0, ASN_OBJ_ID);
+    write_objid(&casn, id_test_ce);
+    TEST(int, "%d", DIFF_OBJID_DER(&casn, id_test_ce), ==, 0);
+    write_objid(&casn, "2.5.29.15");
+    TEST(int, "%d", DIFF_OBJID_DER(&casn, id_test_ce), ==, 1);
+    delete_casn(&casn);
+    return true;
+}
+
+static bool test_errors(
+    void)
+{
+    static const char *const bad[] = {
+        "",
+        "1",
+        "3.1",
+        "1.40",
+        "1..2",
+        "1.2.",
+        ".1.2",
+        "1.2a",
+        "a.b",
+        "1.2.-3",
+        "1.2.99999999999999999999999999",
+    };
+    struct casn casn;
+    uchar der[ASN_OBJID_DER_MAX];
+    size_t i;
+
+    for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+    {
+        TEST(int, "%d", objid_to_der(bad[i], der, sizeof(der)), ==, -1);
+    }
+    // too long for the buffer
+    TEST(int, "%d", objid_to_der("1.3.6.1.5.5.7.1.7", der, 7), ==, -1);
+    TEST(int, "%d", objid_to_der("1.3.6.1.5.5.7.1.7", der, 8), ==, 8);
+
+    // empty, and not an OID
+    simple_constructor(&casn, 0, ASN_OBJ_ID);
+    TEST(int, "%d", diff_objid_der(&casn, der, 8), <, 0);
+    delete_casn(&casn);
+    simple_constructor(&casn, 0, ASN_INTEGER);
+    write_casn_num(&casn, 43);
+    TEST(int, "%d", diff_objid_der(&casn, der, 1), <, 0);
+    delete_casn(&casn);
+
+    // negative length
+    simple_constructor(&casn, 0, ASN_OBJ_ID);
+    write_objid(&casn, "1.3.6.1.5.5.7.1.7");
+    TEST(int, "%d", objid_to_der("1.3.6.1.5.5.7.1.7", der, sizeof(der)),
+         ==, 8);
+    TEST(int, "%d", diff_objid_der(&casn, der, 8), ==, 0);
+    TEST(int, "%d", diff_objid_der(&casn, der, -1), <, 0);
+    delete_casn(&casn);
+    return true;
+}
+
+int main(
+    void)
+{
+    if (!test_same())
+        return -1;
+    if (!test_generated())
+        return -1;
+    if (!test_errors())
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,245 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "casn/casn.h"
+#include "casn/tests/casn_test_util.h"
+#include "test/unittest.h"
+
+
+#define NUM_ENTRIES 1000
+
+static bool check_entry(
+    struct casn *casnp,
+    int i)
+{
+    struct Entry *entryp = (struct Entry *)casnp;
+    char expected[32];
+    uchar name[32];
+    long val;
+
+    snprintf(expected, sizeof(expected), "entry-%d.roa", i);
+    TEST(int, "%d", read_casn(&entryp->name, name), ==, (int)strlen(expected));
+    TEST_MEMCMP(name, ==, expected, strlen(expected));
+    TEST(int, "%d", read_casn_num(&entryp->num, &val), >, 0);
+    TEST(long, "%ld", val, ==, (long)i * 1000);
+    return true;
+}
+
+/**
+    Iterate over doc's entries, checking that there are num_entries of
+    them and that if streamed, they are all decoded into entryp.
+*/
+static bool check_entries(
+    struct Doc *docp,
+    struct Entry *entryp,
+    int num_entries,
+    bool streamed)
+{
+    struct casn_of_iter iter;
+    struct casn *casnp;
+    int i;
+    int ret;
+
+    TEST(int, "%d", casn_of_iter_init(&iter, &docp->entries.self,
+                                      &entryp->self), ==, 0);
+    for (i = 0; (ret = casn_of_iter_next(&iter, &casnp)) > 0; i++)
+    {
+        TEST_BOOL(casnp == &entryp->self, streamed);
+        if (!check_entry(casnp, i))
+            return false;
+    }
+    TEST(int, "%d", ret, ==, 0);
+    TEST(int, "%d", i, ==, num_entries);
+    // stays at the end
+    TEST(int, "%d", casn_of_iter_next(&iter, &casnp), ==, 0);
+    TEST_BOOL(casnp == NULL, true);
+    return true;
+}
+
+static bool test_stream(
+    void)
+{
+    struct casn_arena arena;
+    struct Doc doc;
+    struct Doc copy;
+    struct Entry entry;
+    struct casn *casnp;
+    uchar *encoded;
+    uchar *reencoded;
+    uchar trailer[8];
+    long val;
+    int lth;
+
+    lth = encode_doc(NUM_ENTRIES, &encoded);
+
+    // the members aren't materialized, which the arena's count shows
+    casn_arena_init(&arena, 0);
+    Doc(&doc, 0);
+    casn_arena_bind(&doc.self, &arena);
+    TEST(int, "%d", stream_casn_of(&doc.entries.self), ==, 0);
+    TEST(int, "%d", decode_casn_lth(&doc.self, encoded, lth), ==, lth);
+    TEST(ulong, "%lu", arena.num_allocs, <, 10);
+    TEST(int, "%d", read_casn_num(&doc.version, &val), ==, 1);
+    TEST(long, "%ld", val, ==, 2);
+    TEST(int, "%d", read_casn(&doc.trailer, trailer), ==, 3);
+    TEST_MEMCMP(trailer, ==, "end", 3);
+    TEST(int, "%d", num_items(&doc.entries.self), ==, NUM_ENTRIES);
+
+    Entry(&entry, 0);
+    if (!check_entries(&doc, &entry, NUM_ENTRIES, true))
+        return false;
+
+    // the encoded members are used as they are
+    reencoded = calloc(1, lth);
+    TEST(int, "%d", size_casn(&doc.self), ==, lth);
+    TEST(int, "%d", encode_casn(&doc.self, reencoded), ==, lth);
+    TEST_MEMCMP(reencoded, ==, encoded, lth);
+
+    // copying keeps them encoded
+    Doc(&copy, 0);
+    stream_casn_of(&copy.entries.self);
+    TEST(int, "%d", copy_casn(&copy.self, &doc.self), ==, lth);
+    casn_arena_free(&arena);
+    if (!check_entries(&copy, &entry, NUM_ENTRIES, true))
+        return false;
+    memset(reencoded, 0, lth);
+    TEST(int, "%d", encode_casn(&copy.self, reencoded), ==, lth);
+    TEST_MEMCMP(reencoded, ==, encoded, lth);
+
+    // the flag survives clearing, and decoding again reuses it
+    clear_casn(&copy.self);
+    TEST(int, "%d", decode_casn_lth(&copy.self, encoded, lth), ==, lth);
+    if (!check_entries(&copy, &entry, NUM_ENTRIES, true))
+        return false;
+
+    // asking for one of them decodes them all
+    casnp = member_casn(&copy.entries.self, 1);
+    TEST_BOOL(casnp != NULL, true);
+    if (!check_entry(casnp, 1))
+        return false;
+    TEST_BOOL(copy.entries.self.startp == NULL, true);
+    TEST(int, "%d", num_items(&copy.entries.self), ==, NUM_ENTRIES);
+    if (!check_entries(&copy, &entry, NUM_ENTRIES, false))
+        return false;
+    memset(reencoded, 0, lth);
+    TEST(int, "%d", encode_casn(&copy.self, reencoded), ==, lth);
+    TEST_MEMCMP(reencoded, ==, encoded, lth);
+
+    delete_casn(&copy.self);
+    delete_casn(&entry.self);
+    free(encoded);
+    free(reencoded);
+    return true;
+}
+
+static bool test_not_streamed(
+    void)
+{
+    struct Doc doc;
+    struct Entry entry;
+    uchar *encoded;
+    int lth;
+
+    // without stream_casn_of(), the OF's own members are returned
+    lth = encode_doc(20, &encoded);
+    Doc(&doc, 0);
+    Entry(&entry, 0);
+    TEST(int, "%d", decode_casn_lth(&doc.self, encoded, lth), ==, lth);
+    if (!check_entries(&doc, &entry, 20, false))
+        return false;
+    delete_casn(&doc.self);
+    free(encoded);
+
+    // nor are there any in an empty OF, streamed or not
+    lth = encode_doc(0, &encoded);
+    Doc(&doc, 0);
+    TEST(int, "%d", decode_casn_lth(&doc.self, encoded, lth), ==, lth);
+    if (!check_entries(&doc, &entry, 0, false))
+        return false;
+    delete_casn(&doc.self);
+    Doc(&doc, 0);
+    stream_casn_of(&doc.entries.self);
+    TEST(int, "%d", decode_casn_lth(&doc.self, encoded, lth), ==, lth);
+    TEST(int, "%d", num_items(&doc.entries.self), ==, 0);
+    if (!check_entries(&doc, &entry, 0, false))
+        return false;
+    delete_casn(&doc.self);
+    free(encoded);
+
+    TEST(int, "%d", stream_casn_of(&doc.version), <, 0);
+    TEST(int, "%d", casn_err_struct.errnum, ==, ASN_NOT_OF_ERR);
+    return true;
+}
+
+static bool test_buf(
+    void)
+{
+    struct casn_buf *bufp;
+    struct casn_of_iter iter;
+    struct casn *casnp;
+    struct Doc doc;
+    struct Entry entry;
+    uchar *encoded;
+    int lth;
+
+    // members decoded from a streamed OF borrow from the same buffer
+    lth = encode_doc(10, &encoded);
+    bufp = casn_buf_new(encoded, lth, NULL);
+    Doc(&doc, 0);
+    stream_casn_of(&doc.entries.self);
+    TEST(int, "%d", decode_casn_buf(&doc.self, bufp), ==, lth);
+    TEST_BOOL(doc.entries.self.bufp == bufp, true);
+    casn_buf_unref(bufp);
+
+    Entry(&entry, 0);
+    casn_of_iter_init(&iter, &doc.entries.self, &entry.self);
+    TEST(int, "%d", casn_of_iter_next(&iter, &casnp), ==, 1);
+    TEST_BOOL(entry.name.bufp == bufp, true);
+    TEST_BOOL(entry.name.startp > encoded &&
+              entry.name.startp < &encoded[lth], true);
+
+    delete_casn(&doc.self);
+    delete_casn(&entry.self);
+    free(encoded);
+    return true;
+}
+
+static bool test_bad_member(
+    void)
+{
+    struct Doc doc;
+    uchar *encoded;
+    int lth;
+
+    // an entry's length runs past the OF, so it's decoded as usual and
+    // the error is found
+    lth = encode_doc(3, &encoded);
+    // version is 02 01 02, the OF starts at offset 5
+    TEST(int, "%d", encoded[5], ==, ASN_SEQUENCE);
+    TEST(int, "%d", encoded[7], ==, ASN_SEQUENCE);
+    encoded[8] += 1;
+    Doc(&doc, 0);
+    stream_casn_of(&doc.entries.self);
+    TEST(int, "%d", decode_casn_lth(&doc.self, encoded, lth), <, 0);
+    TEST_BOOL(doc.entries.self.startp == NULL, true);
+    delete_casn(&doc.self);
+    free(encoded);
+    return true;
+}
+
+int main(
+    void)
+{
+    if (!test_stream())
+        return -1;
+    if (!test_not_streamed())
+        return -1;
+    if (!test_buf())
+        return -1;
+    if (!test_bad_member())
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include "casn_test_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// room after an encoding for tests that decode past its end
+#define ENCODE_SLACK 8
+
+
+int num_releases;
+
+void free_release(
+    uchar *startp,
+    ulong lth)
+{
+    (void)lth;
+    free(startp);
+    num_releases++;
+}
+
+void count_release(
+    uchar *startp,
+    ulong lth)
+{
+    (void)startp;
+    (void)lth;
+    num_releases++;
+}
+
+int encode_new(
+    struct casn *casnp,
+    uchar **encodedp)
+{
+    int lth = size_casn(casnp);
+
+    *encodedp = calloc(1, lth + ENCODE_SLACK);
+    encode_casn(casnp, *encodedp);
+    return lth;
+}
+
+int encode_pair(
+    long num,
+    const char *name,
+    uchar **encodedp)
+{
+    struct Pair pair;
+    int lth;
+
+    Pair(&pair, 0);
+    write_casn_num(&pair.num, num);
+    write_casn(&pair.name, (uchar *)name, strlen(name));
+    lth = encode_new(&pair.self, encodedp);
+    delete_casn(&pair.self);
+    return lth;
+}
+
+void make_pair(
+    struct Pair *pairp,
+    int name_lth)
+{
+    uchar *name = malloc(name_lth);
+    int i;
+
+    for (i = 0; i < name_lth; i++)
+        name[i] = (uchar)i;
+    Pair(pairp, 0);
+    write_casn_num(&pairp->num, name_lth);
+    write_casn(&pairp->name, name, name_lth);
+    free(name);
+}
+
+int encode_numbered(
+    const char *name,
+    uchar **encodedp)
+{
+    struct Numbered numbered;
+    static const long nums[] = {1, 300, -2};
+    size_t i;
+    int lth;
+
+    Numbered(&numbered, 0);
+    write_casn_num(&numbered.num, 5);
+    write_casn(&numbered.name, (uchar *)name, strlen(name));
+    for (i = 0; i < sizeof(nums) / sizeof(nums[0]); i++)
+    {
+        write_casn_num(inject_casn(&numbered.nums.self, i), nums[i]);
+    }
+    lth = encode_new(&numbered.self, encodedp);
+    delete_casn(&numbered.self);
+    return lth;
+}
+
+/**
+    Add num_entries Entries to the SEQUENCE OF Entry at ofp.
+*/
+static void fill_entries(
+    struct casn *ofp,
+    int num_entries)
+{
+    struct Entry *entryp;
+    char name[32];
+    int i;
+
+    for (i = 0; i < num_entries; i++)
+    {
+        entryp = (struct Entry *)inject_casn(ofp, i);
+        snprintf(name, sizeof(name), "entry-%d.roa", i);
+        write_casn(&entryp->name, (uchar *)name, strlen(name));
+        write_casn_num(&entryp->num, i * 1000);
+    }
+}
+
+int encode_list(
+    int num_entries,
+    uchar **encodedp)
+{
+    struct List list;
+    int lth;
+
+    List(&list, 0);
+    fill_entries(&list.self, num_entries);
+    lth = encode_new(&list.self, encodedp);
+    delete_casn(&list.self);
+    return lth;
+}
+
+int encode_doc(
+    int num_entries,
+    uchar **encodedp)
+{
+    struct Doc doc;
+    int lth;
+
+    Doc(&doc, 0);
+    write_casn_num(&doc.version, 2);
+    fill_entries(&doc.entries.self, num_entries);
+    if (!num_entries)
+        write_casn(&doc.entries.self, (uchar *)"", 0);
+    write_casn(&doc.trailer, (uchar *)"end", 3);
+    lth = encode_new(&doc.self, encodedp);
+    delete_casn(&doc.self);
+    return lth;
+}
+
+int encode_rec(
+    const char *label,
+    const char *issuer,
+    int num_exts,
+    uchar **encodedp)
+{
+    struct Rec rec;
+    struct Ext *extp;
+    char value[32];
+    int i;
+    int lth;
+
+    Rec(&rec, 0);
+    write_casn_num(&rec.version, 2);
+    if (label)
+        write_casn(&rec.label, (uchar *)label, strlen(label));
+    write_casn_num(&rec.header.serial, 1234);
+    write_casn(&rec.header.issuer, (uchar *)issuer, strlen(issuer));
+    for (i = 0; i < num_exts; i++)
+    {
+        extp = (struct Ext *)inject_casn(&rec.exts.self, i);
+        snprintf(value, sizeof(value), "value-%d", i);
+        write_casn_num(&extp->id, i);
+        write_casn(&extp->value, (uchar *)value, strlen(value));
+    }
+    write_casn(&rec.trailer, (uchar *)"end", 3);
+    lth = encode_new(&rec.self, encodedp);
+    delete_casn(&rec.self);
+    return lth;
+}
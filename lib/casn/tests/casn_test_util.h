@@ -0,0 +1,92 @@
+/*
+ * Helpers shared by the libcasn unit tests in this directory, for
+ * making encodings of the types in casn_fixtures.asn.
+ */
+
+#ifndef LIB_CASN_TESTS_CASN_TEST_UTIL_H
+#define LIB_CASN_TESTS_CASN_TEST_UTIL_H
+
+#include "casn/casn.h"
+#include "casn/tests/casn_fixtures.h"
+
+/*
+ * Calls to free_release() or count_release() so far.
+ */
+extern int num_releases;
+
+/*
+ * casn_buf release callback that frees the data and counts the call.
+ */
+void free_release(
+    uchar *startp,
+    ulong lth);
+
+/*
+ * casn_buf release callback that only counts the call.
+ */
+void count_release(
+    uchar *startp,
+    ulong lth);
+
+/*
+ * Encode casnp into a new buffer in *encodedp, which the caller frees.
+ * The buffer has a few zero bytes after the encoding, so that a test can
+ * decode past its end.
+ *
+ * Returns the length of the encoding.
+ */
+int encode_new(
+    struct casn *casnp,
+    uchar **encodedp);
+
+/*
+ * Encode a Pair with the given num and name.
+ */
+int encode_pair(
+    long num,
+    const char *name,
+    uchar **encodedp);
+
+/*
+ * Construct a Pair whose name is name_lth bytes counting up from 0, and
+ * whose num is name_lth.  The caller deletes it.
+ */
+void make_pair(
+    struct Pair *pairp,
+    int name_lth);
+
+/*
+ * Encode a Numbered with the given name, num 5 and nums {1, 300, -2}.
+ */
+int encode_numbered(
+    const char *name,
+    uchar **encodedp);
+
+/*
+ * Encode a List of num_entries Entries, the i-th of which has the name
+ * "entry-<i>.roa" and num i * 1000.
+ */
+int encode_list(
+    int num_entries,
+    uchar **encodedp);
+
+/*
+ * Encode a Doc with version 2, entries as for encode_list(), and the
+ * trailer "end".
+ */
+int encode_doc(
+    int num_entries,
+    uchar **encodedp);
+
+/*
+ * Encode a Rec with version 2, the given label unless it's NULL, a Header
+ * with serial 1234 and the given issuer, num_exts Exts, the i-th of which
+ * has id i and value "value-<i>", and the trailer "end".
+ */
+int encode_rec(
+    const char *label,
+    const char *issuer,
+    int num_exts,
+    uchar **encodedp);
+
+#endif
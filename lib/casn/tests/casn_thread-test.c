@@ -0,0 +1,153 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "casn/casn.h"
+#include "casn/tests/casn_test_util.h"
+#include "test/unittest.h"
+
+#define NUM_THREADS 8
+#define ITERATIONS 2000
+
+
+struct thread_args {
+    int id;
+    bool ok;
+};
+
+/*
+   What the calling thread's error callback has seen.  Each thread must
+   only ever see its own errors.
+*/
+static __thread struct {
+    int calls;
+    int num;
+    struct casn *casnp;
+} errors_seen;
+
+static void error_callback(
+    int num,
+    const char *msg)
+{
+    (void)msg;
+    errors_seen.calls++;
+    errors_seen.num = num;
+    errors_seen.casnp = casn_err_struct.casnp;
+}
+
+static bool check_rec(
+    struct Pair *recp,
+    long num,
+    const char *name)
+{
+    uchar buf[32];
+    long val;
+
+    TEST(int, "%d", read_casn_num(&recp->num, &val), >, 0);
+    TEST(long, "%ld", val, ==, num);
+    TEST(int, "%d", read_casn(&recp->name, buf), ==, (int)strlen(name));
+    TEST_MEMCMP(buf, ==, name, strlen(name));
+    return true;
+}
+
+static bool run_thread(
+    int id)
+{
+    struct Pair rec;
+    struct casn_buf *bufp;
+    char name[32];
+    uchar *encoded;
+    int lth;
+    int i;
+    int calls;
+
+    // every thread starts with the default callback
+    TEST_BOOL(casn_error != NULL, true);
+    casn_error = error_callback;
+
+    snprintf(name, sizeof(name), "thread-%d", id);
+    lth = encode_pair(id, name, &encoded);
+    bufp = casn_buf_new(encoded, lth, NULL);
+    TEST_BOOL(bufp != NULL, true);
+
+    Pair(&rec, 0);
+    for (i = 0; i < ITERATIONS; i++)
+    {
+        // copying decode
+        TEST(int, "%d", decode_casn_lth(&rec.self, encoded, lth), ==, lth);
+        if (!check_rec(&rec, id, name))
+            return false;
+
+        // zero-copy decode borrows from this thread's buffer only
+        TEST(int, "%d", decode_casn_buf(&rec.self, bufp), ==, lth);
+        TEST_BOOL(rec.name.startp >= encoded &&
+                  rec.name.startp < &encoded[lth], true);
+        if (!check_rec(&rec, id, name))
+            return false;
+
+        // the first call on any thread loads the OID table
+        TEST(int, "%d", dump_size(&rec.self), >, 0);
+
+        // truncated, so it fails and reports an error in this thread
+        calls = errors_seen.calls;
+        TEST(int, "%d", decode_casn_lth(&rec.self, encoded, lth - 1), <, 0);
+        TEST(int, "%d", errors_seen.calls, >, calls);
+        TEST(int, "%d", casn_err_struct.errnum, ==, errors_seen.num);
+        TEST_BOOL(errors_seen.casnp >= &rec.self &&
+                  errors_seen.casnp <= &rec.name, true);
+    }
+    delete_casn(&rec.self);
+    casn_buf_unref(bufp);
+    free(encoded);
+    return true;
+}
+
+static void *thread_main(
+    void *args_voidp)
+{
+    struct thread_args *args = (struct thread_args *)args_voidp;
+
+    args->ok = run_thread(args->id);
+    return NULL;
+}
+
+int main(
+    void)
+{
+    pthread_t threads[NUM_THREADS];
+    struct thread_args args[NUM_THREADS];
+    int i;
+    bool ok = true;
+
+    // only affects this thread
+    casn_error = NULL;
+
+    for (i = 0; i < NUM_THREADS; i++)
+    {
+        args[i].id = i;
+        args[i].ok = false;
+        if (pthread_create(&threads[i], NULL, thread_main, &args[i]) != 0)
+        {
+            fprintf(stderr, "pthread_create() failed\n");
+            return -1;
+        }
+    }
+    for (i = 0; i < NUM_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+        ok = ok && args[i].ok;
+    }
+    if (!ok)
+        return -1;
+
+    // none of the threads' errors leaked into this one
+    if (casn_err_struct.errnum != 0 || casn_error != NULL)
+    {
+        fprintf(stderr, "error state shared between threads\n");
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "casn/casn.h"
+#include "test/unittest.h"
+
+
+static const struct {
+    const char *in;
+    int type;
+    const char *dbtime;
+    int64_t secs;
+} goods[] = {
+    {"700101000000Z", ASN_UTCTIME, "1970-01-01 00:00:00", 0},
+    {"4912312359Z", ASN_UTCTIME, "2049-12-31 23:59:00", 2524607940LL},
+    {"500101000000Z", ASN_UTCTIME, "1950-01-01 00:00:00", -631152000LL},
+    {"20160229120000Z", ASN_GENTIME, "2016-02-29 12:00:00", 1456747200LL},
+    {"20000229000000Z", ASN_GENTIME, "2000-02-29 00:00:00", 951782400LL},
+    {"20500101000000Z", ASN_GENTIME, "2050-01-01 00:00:00", 2524608000LL},
+    {"20161231235960Z", ASN_GENTIME, "2016-12-31 23:59:60", 1483228800LL},
+    {"20160701000001.5Z", ASN_GENTIME, "2016-07-01 00:00:01", 1467331201LL},
+    {"00010101000000Z", ASN_GENTIME, "0001-01-01 00:00:00",
+     -62135596800LL},
+};
+
+static const char *const bads[] = {
+    "",
+    "7001010000Z0",
+    "700101000000",
+    "700101000000+0000",
+    "7001010000000Z",
+    "701301000000Z",
+    "700001000000Z",
+    "700100000000Z",
+    "700229000000Z",
+    "700431000000Z",
+    "700101240000Z",
+    "700101006000Z",
+    "700101000061Z",
+    "7O0101000000Z",
+    "19000229000000Z",
+    "20160701000000.Z",
+    "20160701000000,5Z",
+    "2016070100000.5Z",
+};
+
+static bool test_parse(
+    void)
+{
+    struct casn_time parsed;
+    char dbtime[CASN_TIME_STRING_SIZE];
+    size_t i;
+
+    for (i = 0; i < sizeof(goods) / sizeof(goods[0]); i++)
+    {
+        TEST(int, "%d", parse_casn_time(goods[i].in, strlen(goods[i].in),
+                                        &parsed), ==, goods[i].type);
+        TEST(long long, "%lld", (long long)parsed.secs, ==,
+             (long long)goods[i].secs);
+        TEST(int, "%d", format_casn_time(&parsed, dbtime, sizeof(dbtime)),
+             ==, CASN_TIME_STRING_SIZE - 1);
+        TEST_STR(dbtime, ==, goods[i].dbtime);
+    }
+    for (i = 0; i < sizeof(bads) / sizeof(bads[0]); i++)
+    {
+        TEST(int, "%d", parse_casn_time(bads[i], strlen(bads[i]), &parsed),
+             ==, -1);
+    }
+    // too small a buffer
+    parse_casn_time(goods[0].in, strlen(goods[0].in), &parsed);
+    TEST(int, "%d", format_casn_time(&parsed, dbtime, sizeof(dbtime) - 1),
+         ==, -1);
+    return true;
+}
+
+static bool test_read(
+    void)
+{
+    struct casn casn;
+    int64_t val;
+    size_t i;
+
+    // read_casn_time() agrees for the DER forms, which it reads with
+    // parse_casn_time() unless they're out of its range
+    for (i = 0; i < sizeof(goods) / sizeof(goods[0]); i++)
+    {
+        if (strlen(goods[i].in) != 13 && strlen(goods[i].in) != 15)
+            continue;
+        if (goods[i].secs < 0 || strcmp(&goods[i].dbtime[17], "60") == 0)
+            continue;
+        simple_constructor(&casn, 0, goods[i].type);
+        TEST(int, "%d", write_casn(&casn, (uchar *)goods[i].in,
+                                   strlen(goods[i].in)), >, 0);
+        TEST(int, "%d", read_casn_time(&casn, &val), >, 0);
+        TEST(long long, "%lld", (long long)val, ==,
+             (long long)goods[i].secs);
+        delete_casn(&casn);
+    }
+    return true;
+}
+
+int main(
+    void)
+{
+    if (!test_parse())
+        return -1;
+    if (!test_read())
+        return -1;
+
+    return 0;
+}
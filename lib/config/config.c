@@ -108,6 +108,86 @@ static const struct config_option config_options[] = {
      NULL, NULL,
      "96"},
 
+    // CONFIG_RPKI_RTR_SNAPSHOT_DIR
+    {
+     "RpkiRtrSnapshotDir",
+     false,
+     config_type_string_converter, &config_type_string_arg_optional,
+     NULL, NULL,
+     free,
+     NULL, NULL,
+     ""},
+
+    // CONFIG_RPKI_RTR_NOTIFY_SOCKET
+    {
+     "RpkiRtrNotifySocket",
+     false,
+     config_type_string_converter, &config_type_string_arg_optional,
+     NULL, NULL,
+     free,
+     NULL, NULL,
+     ""},
+
+    // CONFIG_RPKI_RTR_ACCEPTOR_THREADS
+    {
+     "RpkiRtrAcceptorThreads",
+     false,
+     config_type_sscanf_converter, &config_type_sscanf_arg_size_t,
+     NULL, NULL,
+     free,
+     NULL, NULL,
+     "1"},
+
+    // CONFIG_RPKI_RTR_REFRESH_INTERVAL
+    {
+     "RpkiRtrRefreshInterval",
+     false,
+     config_type_sscanf_converter, &config_type_sscanf_arg_size_t,
+     NULL, NULL,
+     free,
+     NULL, NULL,
+     "3600"},
+
+    // CONFIG_RPKI_RTR_RETRY_INTERVAL
+    {
+     "RpkiRtrRetryInterval",
+     false,
+     config_type_sscanf_converter, &config_type_sscanf_arg_size_t,
+     NULL, NULL,
+     free,
+     NULL, NULL,
+     "600"},
+
+    // CONFIG_RPKI_RTR_EXPIRE_INTERVAL
+    {
+     "RpkiRtrExpireInterval",
+     false,
+     config_type_sscanf_converter, &config_type_sscanf_arg_size_t,
+     NULL, NULL,
+     free,
+     NULL, NULL,
+     "7200"},
+
+    // CONFIG_RPKI_RTR_METRICS_FILE
+    {
+     "RpkiRtrMetricsFile",
+     false,
+     config_type_string_converter, &config_type_string_arg_optional,
+     NULL, NULL,
+     free,
+     NULL, NULL,
+     ""},
+
+    // CONFIG_RPKI_RTR_MINIMIZE_VRPS
+    {
+     "RpkiRtrMinimizeVrps",
+     false,
+     config_type_bool_converter, NULL,
+     NULL, NULL,
+     free,
+     NULL, NULL,
+     "no"},
+
     // CONFIG_RPKI_ALLOW_STALE_VALIDATION_CHAIN
     {
      "RPKIAllowStaleValidationChain",
@@ -69,6 +69,14 @@ enum config_key {
     CONFIG_LOG_LEVEL,
     CONFIG_DOWNLOAD_CONCURRENCY,
     CONFIG_RPKI_RTR_RETENTION_HOURS,
+    CONFIG_RPKI_RTR_SNAPSHOT_DIR,
+    CONFIG_RPKI_RTR_NOTIFY_SOCKET,
+    CONFIG_RPKI_RTR_ACCEPTOR_THREADS,
+    CONFIG_RPKI_RTR_REFRESH_INTERVAL,
+    CONFIG_RPKI_RTR_RETRY_INTERVAL,
+    CONFIG_RPKI_RTR_EXPIRE_INTERVAL,
+    CONFIG_RPKI_RTR_METRICS_FILE,
+    CONFIG_RPKI_RTR_MINIMIZE_VRPS,
     CONFIG_RPKI_ALLOW_STALE_VALIDATION_CHAIN,
     CONFIG_RPKI_ALLOW_NO_MANIFEST,
     CONFIG_RPKI_ALLOW_STALE_CRL,
@@ -120,6 +128,14 @@ CONFIG_GET_ARRAY_HELPER(CONFIG_TRUST_ANCHOR_LOCATORS, char)
 CONFIG_GET_HELPER_DEREFERENCE(CONFIG_LOG_LEVEL, int)
 CONFIG_GET_HELPER_DEREFERENCE(CONFIG_DOWNLOAD_CONCURRENCY, size_t)
 CONFIG_GET_HELPER_DEREFERENCE(CONFIG_RPKI_RTR_RETENTION_HOURS, size_t)
+CONFIG_GET_HELPER(CONFIG_RPKI_RTR_SNAPSHOT_DIR, char)
+CONFIG_GET_HELPER(CONFIG_RPKI_RTR_NOTIFY_SOCKET, char)
+CONFIG_GET_HELPER_DEREFERENCE(CONFIG_RPKI_RTR_ACCEPTOR_THREADS, size_t)
+CONFIG_GET_HELPER_DEREFERENCE(CONFIG_RPKI_RTR_REFRESH_INTERVAL, size_t)
+CONFIG_GET_HELPER_DEREFERENCE(CONFIG_RPKI_RTR_RETRY_INTERVAL, size_t)
+CONFIG_GET_HELPER_DEREFERENCE(CONFIG_RPKI_RTR_EXPIRE_INTERVAL, size_t)
+CONFIG_GET_HELPER(CONFIG_RPKI_RTR_METRICS_FILE, char)
+CONFIG_GET_HELPER_DEREFERENCE(CONFIG_RPKI_RTR_MINIMIZE_VRPS, bool)
 CONFIG_GET_HELPER_DEREFERENCE(CONFIG_RPKI_ALLOW_NO_MANIFEST, bool)
 CONFIG_GET_HELPER_DEREFERENCE(CONFIG_RPKI_ALLOW_STALE_CRL, bool)
 CONFIG_GET_HELPER_DEREFERENCE(CONFIG_RPKI_ALLOW_STALE_MANIFEST, bool)
@@ -544,6 +544,33 @@ static int readSerNumAsCurrent(
 }
 
 
+int db_rtr_get_update(
+    dbconn * conn,
+    serial_number_t serial,
+    bool *has_previous,
+    serial_number_t * previous,
+    bool *has_full)
+{
+    uint32_t db_previous;
+    int db_previous_was_null;
+    int db_has_full;
+    int ret;
+
+    ret = readSerNumAsCurrent(conn, serial, 1, &db_previous,
+                              &db_previous_was_null, 1, &db_has_full);
+    if (ret != GET_SERNUM_SUCCESS)
+    {
+        return ret;
+    }
+
+    *has_previous = !db_previous_was_null;
+    *previous = db_previous;
+    *has_full = db_has_full != 0;
+
+    return GET_SERNUM_SUCCESS;
+}
+
+
 /**=============================================================================
  * @param[out] pdu PDU to fill in.
  * @param[in] asn AS number.
@@ -1556,91 +1583,148 @@ bool db_rtr_good_serials(
     return !is_inconsistent;
 }
 
-bool db_rtr_insert_full(
-    dbconn * conn,
-    serial_number_t serial)
+/**
+    @brief Fetch every row of an executed statement that selects
+        (asn, prefix, prefix_length, prefix_max_length) and pass it to
+        @p callback.
+
+    The result is not buffered on the client side, so the caller only
+    needs memory for whatever @p callback keeps.
+
+    @param change_callback If not NULL, the statement also selects
+        is_announce after the other columns, and this is called instead
+        of @p callback.
+*/
+static bool fetch_vrps(
+    MYSQL_STMT *stmt,
+    db_rtr_vrp_callback callback,
+    vrp_diff_callback change_callback,
+    void *arg)
 {
-    struct flag_tests flag_tests;
-    flag_tests_default(&flag_tests);
-
-    // Convert serial to a type that MySQL can take.
-    COMPILE_TIME_ASSERT(
-        TYPE_CAN_HOLD_UINT(unsigned, serial_number_t));
-    unsigned serial_uint = serial;
-
-    MYSQL_STMT *stmt =
-        conn->stmts[DB_CLIENT_TYPE_RTR][DB_PSTMT_RTR_INSERT_FULL];
-    MYSQL_BIND bind_in[1 + FLAG_TESTS_PARAMETERS] = {
+    int ret;
+    unsigned db_asn;
+    unsigned long db_prefix_family_length;
+    unsigned char db_prefix[16];
+    unsigned char db_prefix_length;
+    unsigned char db_prefix_max_length;
+    signed char db_is_announce = 0;
+    bool callback_ret;
+    MYSQL_BIND bind_out[] = {
+        // asn output
         {
             .buffer_type = MYSQL_TYPE_LONG,
-            .buffer = &serial_uint,
+            .is_unsigned = 1,
+            .buffer = &db_asn,
+        },
+        // prefix output
+        {
+            .buffer_type = MYSQL_TYPE_BLOB,
+            .buffer_length = sizeof(db_prefix),
+            .length = &db_prefix_family_length,
+            .buffer = &db_prefix,
+        },
+        // prefix_length output
+        {
+            .buffer_type = MYSQL_TYPE_TINY,
             .is_unsigned = (my_bool)1,
-            .is_null = (my_bool *)0,
+            .buffer = &db_prefix_length,
+        },
+        // prefix_max_length output
+        {
+            .buffer_type = MYSQL_TYPE_TINY,
+            .is_unsigned = (my_bool)1,
+            .buffer = &db_prefix_max_length,
+        },
+        // is_announce output, only if change_callback != NULL
+        {
+            .buffer_type = MYSQL_TYPE_TINY,
+            .is_unsigned = (my_bool)0,
+            .buffer = &db_is_announce,
         },
     };
-    flag_tests_bind(bind_in + 1, &flag_tests);
+    struct vrp vrp;
 
-    if (mysql_stmt_bind_param(stmt, bind_in))
+    if (mysql_stmt_bind_result(stmt, bind_out))
     {
-        LOG(LOG_ERR, "mysql_stmt_bind_param() failed");
+        LOG(LOG_ERR, "mysql_stmt_bind_result() failed");
         LOG(LOG_ERR, "    %u: %s\n", mysql_stmt_errno(stmt),
             mysql_stmt_error(stmt));
+        mysql_stmt_free_result(stmt);
         return false;
     }
 
-    if (wrap_mysql_stmt_execute(conn, stmt, NULL))
+    while ((ret = mysql_stmt_fetch(stmt)) == 0)
     {
+        if (!vrp_init(&vrp, db_asn, db_prefix, db_prefix_family_length,
+                      db_prefix_length, db_prefix_max_length))
+        {
+            LOG(LOG_ERR, "invalid VRP in database (AS%u, prefix length "
+                "%u, max length %u)", db_asn, (unsigned)db_prefix_length,
+                (unsigned)db_prefix_max_length);
+            mysql_stmt_free_result(stmt);
+            return false;
+        }
+
+        if (change_callback != NULL)
+        {
+            callback_ret = change_callback(&vrp, db_is_announce != 0, arg);
+        }
+        else
+        {
+            callback_ret = callback(&vrp, arg);
+        }
+
+        if (!callback_ret)
+        {
+            mysql_stmt_free_result(stmt);
+            return false;
+        }
+    }
+    if (ret != MYSQL_NO_DATA)
+    {
+        LOG(LOG_ERR, "error during mysql_stmt_fetch()");
+        if (ret == 1)
+            LOG(LOG_ERR, "    %u: %s\n", mysql_stmt_errno(stmt),
+                mysql_stmt_error(stmt));
+        mysql_stmt_free_result(stmt);
         return false;
     }
 
+    mysql_stmt_free_result(stmt);
+
     return true;
 }
 
-bool db_rtr_insert_incremental(
-    dbconn * conn,
-    serial_number_t previous_serial,
-    serial_number_t current_serial)
+/**
+    @brief db_rtr_vrp_callback that adds each VRP to the struct vrp_set
+        @p arg.
+*/
+static bool add_vrp_to_set(
+    const struct vrp *vrp,
+    void *arg)
 {
-    MYSQL_STMT *stmt =
-        conn->stmts[DB_CLIENT_TYPE_RTR][DB_PSTMT_RTR_INSERT_INCREMENTAL];
+    struct vrp_set *vrps = arg;
 
-    // Convert previous_serial and current_serial to a type that MySQL
-    // can take.
-    COMPILE_TIME_ASSERT(
-        TYPE_CAN_HOLD_UINT(unsigned, serial_number_t));
-    unsigned previous_serial_uint = previous_serial;
-    unsigned current_serial_uint = current_serial;
+    if (!vrp_set_add(vrps, vrp))
+    {
+        LOG(LOG_ERR, "could not alloc for VRPs");
+        return false;
+    }
 
-    unsigned char is_announce;
+    return true;
+}
 
-    // announcements
-    is_announce = 1;
-    MYSQL_BIND bind_in[] = {
-        {
-            .buffer_type = MYSQL_TYPE_LONG,
-            .buffer = &current_serial_uint,
-            .is_unsigned = (my_bool)1,
-            .is_null = (my_bool *)0,
-        },
-        {
-            .buffer_type = MYSQL_TYPE_TINY,
-            .buffer = &is_announce,
-            .is_unsigned = (my_bool)1,
-            .is_null = (my_bool *)0,
-        },
-        {
-            .buffer_type = MYSQL_TYPE_LONG,
-            .buffer = &previous_serial_uint,
-            .is_unsigned = (my_bool)1,
-            .is_null = (my_bool *)0,
-        },
-        {
-            .buffer_type = MYSQL_TYPE_LONG,
-            .buffer = &current_serial_uint,
-            .is_unsigned = (my_bool)1,
-            .is_null = (my_bool *)0,
-        },
-    };
+bool db_rtr_get_current_vrps(
+    dbconn * conn,
+    struct vrp_set *vrps)
+{
+    struct flag_tests flag_tests;
+    flag_tests_default(&flag_tests);
+
+    MYSQL_STMT *stmt =
+        conn->stmts[DB_CLIENT_TYPE_RTR][DB_PSTMT_RTR_GET_CURRENT_VRPS];
+    MYSQL_BIND bind_in[FLAG_TESTS_PARAMETERS];
+    flag_tests_bind(bind_in, &flag_tests);
 
     if (mysql_stmt_bind_param(stmt, bind_in))
     {
@@ -1650,41 +1734,36 @@ bool db_rtr_insert_incremental(
         return false;
     }
 
-    if (wrap_mysql_stmt_execute(conn, stmt, NULL))
+    if (wrap_mysql_stmt_execute(conn, stmt, "could not retrieve VRPs"))
     {
         return false;
     }
 
-    // withdrawals
-    is_announce = 0;
-    MYSQL_BIND bind_in2[] = {
-        {
-            .buffer_type = MYSQL_TYPE_LONG,
-            .buffer = &current_serial_uint,
-            .is_unsigned = (my_bool)1,
-            .is_null = (my_bool *)0,
-        },
-        {
-            .buffer_type = MYSQL_TYPE_TINY,
-            .buffer = &is_announce,
-            .is_unsigned = (my_bool)1,
-            .is_null = (my_bool *)0,
-        },
-        {
-            .buffer_type = MYSQL_TYPE_LONG,
-            .buffer = &current_serial_uint,
-            .is_unsigned = (my_bool)1,
-            .is_null = (my_bool *)0,
-        },
+    return fetch_vrps(stmt, add_vrp_to_set, NULL, vrps);
+}
+
+bool db_rtr_get_full_vrps(
+    dbconn * conn,
+    serial_number_t serial,
+    struct vrp_set *vrps)
+{
+    // Convert serial to a type that MySQL can take.
+    COMPILE_TIME_ASSERT(
+        TYPE_CAN_HOLD_UINT(unsigned, serial_number_t));
+    unsigned serial_uint = serial;
+
+    MYSQL_STMT *stmt =
+        conn->stmts[DB_CLIENT_TYPE_RTR][DB_PSTMT_RTR_GET_FULL_VRPS];
+    MYSQL_BIND bind_in[] = {
         {
             .buffer_type = MYSQL_TYPE_LONG,
-            .buffer = &previous_serial_uint,
+            .buffer = &serial_uint,
             .is_unsigned = (my_bool)1,
             .is_null = (my_bool *)0,
         },
     };
 
-    if (mysql_stmt_bind_param(stmt, bind_in2))
+    if (mysql_stmt_bind_param(stmt, bind_in))
     {
         LOG(LOG_ERR, "mysql_stmt_bind_param() failed");
         LOG(LOG_ERR, "    %u: %s\n", mysql_stmt_errno(stmt),
@@ -1692,27 +1771,48 @@ bool db_rtr_insert_incremental(
         return false;
     }
 
-    if (wrap_mysql_stmt_execute(conn, stmt, NULL))
+    if (wrap_mysql_stmt_execute(conn, stmt,
+                                "could not retrieve data from rtr_full"))
     {
         return false;
     }
 
+    return fetch_vrps(stmt, add_vrp_to_set, NULL, vrps);
+}
+
+/**
+    @brief vrp_diff_callback that adds each change to the struct
+        vrp_delta @p arg.
+*/
+static bool add_change_to_delta(
+    const struct vrp *vrp,
+    bool is_announce,
+    void *arg)
+{
+    struct vrp_delta *delta = arg;
+
+    if (!vrp_set_add(is_announce ? &delta->announcements :
+                     &delta->withdrawals, vrp))
+    {
+        LOG(LOG_ERR, "could not alloc for VRPs");
+        return false;
+    }
+
     return true;
 }
 
-int db_rtr_has_incremental_changes(
+bool db_rtr_get_incremental_vrps(
     dbconn * conn,
-    serial_number_t serial)
+    serial_number_t serial,
+    struct vrp_delta *delta)
 {
-    int ret;
-
     // Convert serial to a type that MySQL can take.
     COMPILE_TIME_ASSERT(
         TYPE_CAN_HOLD_UINT(unsigned, serial_number_t));
     unsigned serial_uint = serial;
 
     MYSQL_STMT *stmt =
-        conn->stmts[DB_CLIENT_TYPE_RTR][DB_PSTMT_RTR_HAS_CHANGES];
+        conn->stmts[DB_CLIENT_TYPE_RTR][DB_PSTMT_RTR_GET_INCREMENTAL_VRPS];
     MYSQL_BIND bind_in[] = {
         {
             .buffer_type = MYSQL_TYPE_LONG,
@@ -1727,53 +1827,252 @@ int db_rtr_has_incremental_changes(
         LOG(LOG_ERR, "mysql_stmt_bind_param() failed");
         LOG(LOG_ERR, "    %u: %s\n", mysql_stmt_errno(stmt),
             mysql_stmt_error(stmt));
-        return -1;
+        return false;
     }
 
-    if (wrap_mysql_stmt_execute(conn, stmt, "mysql_stmt_execute() failed"))
+    if (wrap_mysql_stmt_execute(conn, stmt,
+                                "could not retrieve data from "
+                                "rtr_incremental"))
     {
-        return -1;
+        return false;
     }
 
-    unsigned char has_changes = 0;
-    MYSQL_BIND bind_out[] = {
+    if (!fetch_vrps(stmt, NULL, add_change_to_delta, delta))
+    {
+        return false;
+    }
+
+    vrp_set_sort(&delta->announcements);
+    vrp_set_sort(&delta->withdrawals);
+
+    return true;
+}
+
+bool db_rtr_for_each_full_vrp(
+    dbconn * conn,
+    serial_number_t serial,
+    db_rtr_vrp_callback callback,
+    void *arg)
+{
+    // Convert serial to a type that MySQL can take.
+    COMPILE_TIME_ASSERT(
+        TYPE_CAN_HOLD_UINT(unsigned, serial_number_t));
+    unsigned serial_uint = serial;
+
+    // IPv4 first, to match vrp_compare().
+    static const unsigned family_lengths[] = {4, 16};
+    unsigned family_length;
+    size_t i;
+
+    MYSQL_STMT *stmt =
+        conn->stmts[DB_CLIENT_TYPE_RTR][DB_PSTMT_RTR_EXPORT_FULL_VRPS];
+    MYSQL_BIND bind_in[] = {
         {
-            .buffer_type = MYSQL_TYPE_TINY,
-            .buffer = &has_changes,
+            .buffer_type = MYSQL_TYPE_LONG,
+            .buffer = &serial_uint,
             .is_unsigned = (my_bool)1,
+            .is_null = (my_bool *)0,
+        },
+        {
+            .buffer_type = MYSQL_TYPE_LONG,
+            .buffer = &family_length,
+            .is_unsigned = (my_bool)1,
+            .is_null = (my_bool *)0,
         },
     };
 
-    if (mysql_stmt_bind_result(stmt, bind_out))
+    for (i = 0; i < ELTS(family_lengths); ++i)
     {
-        LOG(LOG_ERR, "mysql_stmt_bind_result() failed");
-        LOG(LOG_ERR, "    %u: %s\n", mysql_stmt_errno(stmt),
-            mysql_stmt_error(stmt));
-        mysql_stmt_free_result(stmt);
-        return -1;
-    }
+        family_length = family_lengths[i];
 
-    ret = mysql_stmt_fetch(stmt);
-    if (ret != 0)
-    {
-        LOG(LOG_ERR, "mysql_stmt_fetch() failed");
-        if (ret == 1)
+        if (mysql_stmt_bind_param(stmt, bind_in))
+        {
+            LOG(LOG_ERR, "mysql_stmt_bind_param() failed");
             LOG(LOG_ERR, "    %u: %s\n", mysql_stmt_errno(stmt),
                 mysql_stmt_error(stmt));
-        mysql_stmt_free_result(stmt);
-        return -1;
+            return false;
+        }
+
+        if (wrap_mysql_stmt_execute(conn, stmt,
+                                    "could not retrieve data from rtr_full"))
+        {
+            return false;
+        }
+
+        if (!fetch_vrps(stmt, callback, NULL, arg))
+        {
+            return false;
+        }
     }
 
-    mysql_stmt_free_result(stmt);
+    return true;
+}
 
-    if (has_changes)
+/**
+    @brief Run a statement that has no parameters and no results.
+*/
+static bool run_query(
+    dbconn * conn,
+    const char *query)
+{
+    if (mysql_real_query(conn->mysql, query, strlen(query)))
     {
-        return 1;
+        LOG(LOG_ERR, "could not run \"%s\"", query);
+        LOG(LOG_ERR, "    %u: %s\n", mysql_errno(conn->mysql),
+            mysql_error(conn->mysql));
+        return false;
     }
-    else
+
+    return true;
+}
+
+bool db_rtr_begin_consistent_read(
+    dbconn * conn)
+{
+    // The isolation level applies to the next transaction only, and
+    // only repeatable read makes the snapshot last past one statement.
+    return run_query(conn,
+                     "set transaction isolation level repeatable read") &&
+        run_query(conn, "start transaction with consistent snapshot");
+}
+
+bool db_rtr_end_consistent_read(
+    dbconn * conn)
+{
+    if (mysql_commit(conn->mysql))
     {
-        return 0;
+        LOG(LOG_ERR, "could not end the read transaction");
+        LOG(LOG_ERR, "    %u: %s\n", mysql_errno(conn->mysql),
+            mysql_error(conn->mysql));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+    @brief Insert VRPs into rtr_full or rtr_incremental, using the
+        multi-row statement for as many rows as possible.
+
+    @param is_announce NULL to insert into rtr_full, otherwise the
+        is_announce value for every row inserted into rtr_incremental.
+*/
+static bool insert_vrps(
+    dbconn * conn,
+    serial_number_t serial,
+    const unsigned char *is_announce,
+    const struct vrp *vrps,
+    size_t len)
+{
+    // Convert serial to a type that MySQL can take.
+    COMPILE_TIME_ASSERT(
+        TYPE_CAN_HOLD_UINT(unsigned, serial_number_t));
+    unsigned serial_uint = serial;
+
+    const size_t params_per_row = (is_announce == NULL) ? 5 : 6;
+    MYSQL_BIND bind_in[DB_PSTMT_RTR_INSERT_BATCH_ROWS * 6];
+    unsigned long prefix_lengths[DB_PSTMT_RTR_INSERT_BATCH_ROWS];
+    MYSQL_STMT *stmt;
+    size_t rows;
+    size_t row;
+    MYSQL_BIND *bind;
+
+    while (len > 0)
+    {
+        if (len >= DB_PSTMT_RTR_INSERT_BATCH_ROWS)
+        {
+            rows = DB_PSTMT_RTR_INSERT_BATCH_ROWS;
+            stmt = conn->stmts[DB_CLIENT_TYPE_RTR][is_announce == NULL ?
+                DB_PSTMT_RTR_INSERT_FULL_BATCH :
+                DB_PSTMT_RTR_INSERT_INCREMENTAL_BATCH];
+        }
+        else
+        {
+            rows = 1;
+            stmt = conn->stmts[DB_CLIENT_TYPE_RTR][is_announce == NULL ?
+                DB_PSTMT_RTR_INSERT_FULL_ROW :
+                DB_PSTMT_RTR_INSERT_INCREMENTAL_ROW];
+        }
+
+        memset(bind_in, 0, rows * params_per_row * sizeof(MYSQL_BIND));
+        for (row = 0, bind = bind_in; row < rows; ++row)
+        {
+            prefix_lengths[row] = vrps[row].family_length;
+
+            bind->buffer_type = MYSQL_TYPE_LONG;
+            bind->buffer = &serial_uint;
+            bind->is_unsigned = (my_bool)1;
+            ++bind;
+
+            if (is_announce != NULL)
+            {
+                bind->buffer_type = MYSQL_TYPE_TINY;
+                bind->buffer = (void *)is_announce;
+                bind->is_unsigned = (my_bool)1;
+                ++bind;
+            }
+
+            bind->buffer_type = MYSQL_TYPE_LONG;
+            bind->buffer = (void *)&vrps[row].asn;
+            bind->is_unsigned = (my_bool)1;
+            ++bind;
+
+            bind->buffer_type = MYSQL_TYPE_BLOB;
+            bind->buffer = (void *)vrps[row].prefix;
+            bind->buffer_length = sizeof(vrps[row].prefix);
+            bind->length = &prefix_lengths[row];
+            ++bind;
+
+            bind->buffer_type = MYSQL_TYPE_TINY;
+            bind->buffer = (void *)&vrps[row].prefix_length;
+            bind->is_unsigned = (my_bool)1;
+            ++bind;
+
+            bind->buffer_type = MYSQL_TYPE_TINY;
+            bind->buffer = (void *)&vrps[row].max_length;
+            bind->is_unsigned = (my_bool)1;
+            ++bind;
+        }
+
+        if (mysql_stmt_bind_param(stmt, bind_in))
+        {
+            LOG(LOG_ERR, "mysql_stmt_bind_param() failed");
+            LOG(LOG_ERR, "    %u: %s\n", mysql_stmt_errno(stmt),
+                mysql_stmt_error(stmt));
+            return false;
+        }
+
+        if (wrap_mysql_stmt_execute(conn, stmt, NULL))
+        {
+            return false;
+        }
+
+        vrps += rows;
+        len -= rows;
     }
+
+    return true;
+}
+
+bool db_rtr_insert_full_vrps(
+    dbconn * conn,
+    serial_number_t serial,
+    const struct vrp *vrps,
+    size_t len)
+{
+    return insert_vrps(conn, serial, NULL, vrps, len);
+}
+
+bool db_rtr_insert_incremental_vrps(
+    dbconn * conn,
+    serial_number_t serial,
+    bool is_announce,
+    const struct vrp *vrps,
+    size_t len)
+{
+    unsigned char is_announce_uchar = is_announce ? 1 : 0;
+
+    return insert_vrps(conn, serial, &is_announce_uchar, vrps, len);
 }
 
 bool db_rtr_insert_update(
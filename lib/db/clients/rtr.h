@@ -9,6 +9,7 @@
 
 #include "db/connect.h"
 #include "rpki-rtr/pdu.h"
+#include "rpki-rtr/vrp.h"
 
 
 int db_rtr_get_session_id(
@@ -24,6 +25,26 @@ int db_rtr_get_latest_sernum(
     serial_number_t * serial);
 
 
+/**
+    @brief Look up @p serial in rtr_update.
+
+    @param[out] has_previous Set to whether rtr_incremental has the
+        changes from @p previous to @p serial.
+    @param[out] previous Set to the previous serial number, if
+        @p has_previous.
+    @param[out] has_full Set to whether rtr_full has the VRPs for
+        @p serial.
+    @return GET_SERNUM_SUCCESS, GET_SERNUM_NONE if @p serial isn't in
+        rtr_update, or GET_SERNUM_ERR on error.
+*/
+int db_rtr_get_update(
+    dbconn * conn,
+    serial_number_t serial,
+    bool *has_previous,
+    serial_number_t * previous,
+    bool *has_full);
+
+
 /**
 	@param query_state A return parameter for an opaque data type that
 		stores the information needed by serialQueryGetNext() to
@@ -120,36 +141,121 @@ bool db_rtr_good_serials(
     serial_number_t current);
 
 /**
-    @brief Copy the current state of the RPKI cache to the rtr_full
-        table, using the given serial number.
+    @brief Add the current state of the RPKI cache to @p vrps.
+
+    Rows are streamed from the database, so only the VRPs themselves
+    are held in memory. The VRPs are not sorted and may contain
+    duplicates, see vrp_set_sort().
 
     @return True on success, false on failure.
 */
-bool db_rtr_insert_full(
+bool db_rtr_get_current_vrps(
     dbconn * conn,
-    serial_number_t serial);
+    struct vrp_set *vrps);
 
 /**
-    @brief Compute the incremental changes from previous_serial to
-        current_serial.
+    @brief Add the rtr_full data for @p serial to @p vrps.
 
     @return True on success, false on failure.
 */
-bool db_rtr_insert_incremental(
+bool db_rtr_get_full_vrps(
     dbconn * conn,
-    serial_number_t previous_serial,
-    serial_number_t current_serial);
+    serial_number_t serial,
+    struct vrp_set *vrps);
 
 /**
-    @brief Determine if the serial number has any changes from the
-        serial before it.
+    @brief Add the rtr_incremental data for @p serial, i.e. the changes
+        from its previous serial number, to @p delta.
+
+    @p delta must be empty, and it is sorted afterwards.
 
-    @return If there are any changes, 1. If there are no changes, 0.
-        If there's an error, -1.
+    @return True on success, false on failure.
 */
-int db_rtr_has_incremental_changes(
+bool db_rtr_get_incremental_vrps(
     dbconn * conn,
-    serial_number_t serial);
+    serial_number_t serial,
+    struct vrp_delta *delta);
+
+/**
+    @brief Callback for functions that stream VRPs from the database.
+
+    @return True to continue, false to stop with an error. The callback
+        is responsible for logging the reason.
+*/
+typedef bool (*db_rtr_vrp_callback)(
+    const struct vrp *vrp,
+    void *arg);
+
+/**
+    @brief Call @p callback for each VRP in the rtr_full data for
+        @p serial, in vrp_compare() order.
+
+    Rows are read through a server-side cursor a batch at a time, so
+    memory use doesn't depend on the number of VRPs. rtr_full has no
+    duplicates, so neither does the sequence of VRPs.
+
+    There is one query per address family. Call this between
+    db_rtr_begin_consistent_read() and db_rtr_end_consistent_read() so
+    that both see the same rows even if rpki-rtr-update deletes
+    @p serial meanwhile.
+
+    @return True on success, false on failure or if @p callback
+        returned false.
+*/
+bool db_rtr_for_each_full_vrp(
+    dbconn * conn,
+    serial_number_t serial,
+    db_rtr_vrp_callback callback,
+    void *arg);
+
+/**
+    @brief Start a transaction in which every read sees the database as
+        it was when the transaction started.
+
+    This only holds while the connection does: if it is lost and
+    re-established, later reads are outside the transaction.
+
+    @return True on success, false on failure.
+*/
+bool db_rtr_begin_consistent_read(
+    dbconn * conn);
+
+/**
+    @brief End a transaction started by db_rtr_begin_consistent_read().
+
+    @return True on success, false on failure.
+*/
+bool db_rtr_end_consistent_read(
+    dbconn * conn);
+
+/**
+    @brief Insert VRPs into the rtr_full table, using the given serial
+        number.
+
+    @p vrps must not contain duplicates.
+
+    @return True on success, false on failure.
+*/
+bool db_rtr_insert_full_vrps(
+    dbconn * conn,
+    serial_number_t serial,
+    const struct vrp *vrps,
+    size_t len);
+
+/**
+    @brief Insert announcements or withdrawals into the
+        rtr_incremental table, using the given serial number.
+
+    @p vrps must not contain duplicates.
+
+    @return True on success, false on failure.
+*/
+bool db_rtr_insert_incremental_vrps(
+    dbconn * conn,
+    serial_number_t serial,
+    bool is_announce,
+    const struct vrp *vrps,
+    size_t len);
 
 /**
     @brief Mark an update as available.
@@ -8,6 +8,19 @@
 #include "util.h"
 
 
+// Value lists for multi-row inserts. The number of repetitions in the
+// *_BATCH statements must match DB_PSTMT_RTR_INSERT_BATCH_ROWS.
+#define REPEAT_2(values) values ", " values
+#define REPEAT_4(values) REPEAT_2(values) ", " REPEAT_2(values)
+#define REPEAT_8(values) REPEAT_4(values) ", " REPEAT_4(values)
+#define REPEAT_16(values) REPEAT_8(values) ", " REPEAT_8(values)
+#define REPEAT_32(values) REPEAT_16(values) ", " REPEAT_16(values)
+#define REPEAT_64(values) REPEAT_32(values) ", " REPEAT_32(values)
+
+#define RTR_FULL_VALUES "(?, ?, ?, ?, ?)"
+#define RTR_INCREMENTAL_VALUES "(?, ?, ?, ?, ?, ?)"
+
+
 // Note: keep in sync with enum client_types and each enum prep_stmts_X
 static const char *_queries_rtr[] = {
     // DB_PSTMT_RTR_GET_SESSION
@@ -67,11 +80,8 @@ static const char *_queries_rtr[] = {
     "    prev_serial_num = ? or "
     "    prev_serial_num = ?",
 
-    // DB_PSTMT_RTR_INSERT_FULL
-    "insert ignore into rtr_full "
-    "(serial_num, asn, prefix, prefix_length, prefix_max_length) "
+    // DB_PSTMT_RTR_GET_CURRENT_VRPS
     "select "
-    "    ?, "
     "    rpki_roa.asn, "
     "    rpki_roa_prefix.prefix, "
     "    rpki_roa_prefix.prefix_length, "
@@ -81,21 +91,45 @@ static const char *_queries_rtr[] = {
     "    rpki_roa_prefix.roa_local_id = rpki_roa.local_id "
     "where " FLAG_TESTS_EXPRESSION("rpki_roa.flags"),
 
-    // DB_PSTMT_RTR_INSERT_INCREMENTAL
+    // DB_PSTMT_RTR_GET_FULL_VRPS
+    "select asn, prefix, prefix_length, prefix_max_length "
+    "from rtr_full "
+    "where serial_num = ?",
+
+    // DB_PSTMT_RTR_EXPORT_FULL_VRPS
+    //
+    // The order matches the primary key of rtr_full, so the rows can
+    // be read straight off the index. Uses a server-side cursor, see
+    // stmtUsesCursor().
+    "select asn, prefix, prefix_length, prefix_max_length "
+    "from rtr_full "
+    "where serial_num = ? and length(prefix) = ? "
+    "order by asn, prefix, prefix_length, prefix_max_length",
+
+    // DB_PSTMT_RTR_GET_INCREMENTAL_VRPS
+    "select asn, prefix, prefix_length, prefix_max_length, is_announce "
+    "from rtr_incremental "
+    "where serial_num = ?",
+
+    // DB_PSTMT_RTR_INSERT_FULL_ROW
+    "insert into rtr_full "
+    "(serial_num, asn, prefix, prefix_length, prefix_max_length) "
+    "values " RTR_FULL_VALUES,
+
+    // DB_PSTMT_RTR_INSERT_FULL_BATCH
+    "insert into rtr_full "
+    "(serial_num, asn, prefix, prefix_length, prefix_max_length) "
+    "values " REPEAT_64(RTR_FULL_VALUES),
+
+    // DB_PSTMT_RTR_INSERT_INCREMENTAL_ROW
     "insert into rtr_incremental "
     "(serial_num, is_announce, asn, prefix, prefix_length, prefix_max_length) "
-    "select ?, ?, t1.asn, t1.prefix, t1.prefix_length, t1.prefix_max_length "
-    "from rtr_full as t1 "
-    "left join rtr_full as t2 on "
-    "    t2.serial_num = ? and "
-    "    t2.asn = t1.asn and "
-    "    t2.prefix = t1.prefix and "
-    "    t2.prefix_length = t1.prefix_length and "
-    "    t2.prefix_max_length = t1.prefix_max_length "
-    "where t1.serial_num = ? and t2.serial_num is null",
-
-    // DB_PSTMT_RTR_HAS_CHANGES
-    "select count(*) > 0 from rtr_incremental where serial_num = ?",
+    "values " RTR_INCREMENTAL_VALUES,
+
+    // DB_PSTMT_RTR_INSERT_INCREMENTAL_BATCH
+    "insert into rtr_incremental "
+    "(serial_num, is_announce, asn, prefix, prefix_length, prefix_max_length) "
+    "values " REPEAT_64(RTR_INCREMENTAL_VALUES),
 
     // DB_PSTMT_RTR_INSERT_UPDATE
     "insert into rtr_update "
@@ -203,6 +237,19 @@ void stmtDeleteAll(
 }
 
 
+/**=============================================================================
+ * @ret Whether the statement's results should be read through a read-only
+ *      server-side cursor rather than streamed over the connection.
+------------------------------------------------------------------------------*/
+static bool stmtUsesCursor(
+    int client_type,
+    int qry_num)
+{
+    return client_type == DB_CLIENT_TYPE_RTR &&
+        qry_num == DB_PSTMT_RTR_EXPORT_FULL_VRPS;
+}
+
+
 /**=============================================================================
  * @ret 0 on success, -1 on error.
 ------------------------------------------------------------------------------*/
@@ -222,6 +269,24 @@ static int stmtAdd(
         return -1;
     }
 
+    if (stmtUsesCursor(client_type, qry_num))
+    {
+        unsigned long cursor_type = CURSOR_TYPE_READ_ONLY;
+        unsigned long prefetch_rows = DB_PSTMT_CURSOR_PREFETCH_ROWS;
+
+        if (mysql_stmt_attr_set(stmt, STMT_ATTR_CURSOR_TYPE, &cursor_type) ||
+            mysql_stmt_attr_set(stmt, STMT_ATTR_PREFETCH_ROWS,
+                                &prefetch_rows))
+        {
+            LOG(LOG_ERR, "error setting cursor attributes");
+            LOG(LOG_ERR, "    %u: %s\n", mysql_stmt_errno(stmt),
+                mysql_stmt_error(stmt));
+            mysql_stmt_close(stmt);
+            conn->stmts[client_type][qry_num] = NULL;
+            return -1;
+        }
+    }
+
     if (mysql_stmt_prepare(stmt, qry, strlen(qry)))
     {
         LOG(LOG_ERR, "error preparing statement");
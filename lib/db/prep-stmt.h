@@ -13,6 +13,20 @@ int stmtAddAll(
 void stmtDeleteAll(
     dbconn * conn);
 
+/**
+ * @brief Number of rows inserted by each execution of the
+ *     DB_PSTMT_RTR_INSERT_*_BATCH statements.
+ *
+ * Note: keep in sync with the number of value lists in those statements.
+ */
+#define DB_PSTMT_RTR_INSERT_BATCH_ROWS 64
+
+/**
+ * @brief Number of rows fetched from the server at a time for
+ *     statements that use a server-side cursor.
+ */
+#define DB_PSTMT_CURSOR_PREFETCH_ROWS 4096
+
 // Note: keep in sync with array in implementation file
 enum prep_stmts_rtr {
     DB_PSTMT_RTR_GET_SESSION,
@@ -26,9 +40,14 @@ enum prep_stmts_rtr {
     DB_PSTMT_RTR_DELETE_INCOMPLETE_INCREMENTAL,
     DB_PSTMT_RTR_DELETE_INCOMPLETE_FULL,
     DB_PSTMT_RTR_DETECT_INCONSISTENT_STATE,
-    DB_PSTMT_RTR_INSERT_FULL,
-    DB_PSTMT_RTR_INSERT_INCREMENTAL,
-    DB_PSTMT_RTR_HAS_CHANGES,
+    DB_PSTMT_RTR_GET_CURRENT_VRPS,
+    DB_PSTMT_RTR_GET_FULL_VRPS,
+    DB_PSTMT_RTR_EXPORT_FULL_VRPS,
+    DB_PSTMT_RTR_GET_INCREMENTAL_VRPS,
+    DB_PSTMT_RTR_INSERT_FULL_ROW,
+    DB_PSTMT_RTR_INSERT_FULL_BATCH,
+    DB_PSTMT_RTR_INSERT_INCREMENTAL_ROW,
+    DB_PSTMT_RTR_INSERT_INCREMENTAL_BATCH,
     DB_PSTMT_RTR_INSERT_UPDATE,
     DB_PSTMT_RTR_DELETE_USELESS_FULL,
     DB_PSTMT_RTR_IGNORE_OLD_FULL,
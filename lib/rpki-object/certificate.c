@@ -14,10 +14,13 @@ struct Extension *find_extension(
     bool create)
 {
     struct Extension *extp;
+    uchar der[ASN_OBJID_DER_MAX];
+    // convert once rather than for each extension
+    int lth = objid_to_der(oid, der, sizeof(der));
     /** @bug error code ignored without explanation */
     for (extp = (struct Extension *)member_casn(&extsp->self, 0);
          /** @bug error code ignored without explanation */
-         extp && diff_objid(&extp->extnID, oid);
+         extp && diff_objid_der(&extp->extnID, der, lth);
          /** @bug error code ignored without explanation */
          extp = (struct Extension *)next_of(&extp->self));
     if (!extp && create)
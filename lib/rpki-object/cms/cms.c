@@ -31,7 +31,7 @@ static struct casn *findSID(
     while (extp != NULL)
     {
         /** @bug error code ignored without explanation */
-        if (diff_objid(&extp->extnID, id_subjectKeyIdentifier) == 0)
+        if (DIFF_OBJID_DER(&extp->extnID, id_subjectKeyIdentifier) == 0)
         {
             return (&extp->extnValue.subjectKeyIdentifier);     /* found it */
         }
@@ -0,0 +1,182 @@
+#include "notify.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+
+#include "util/logging.h"
+
+
+static bool make_address(
+    struct sockaddr_un *addr,
+    const char *path)
+{
+    if (strlen(path) >= sizeof(addr->sun_path))
+    {
+        LOG(LOG_ERR, "notification socket path too long: %s", path);
+        return false;
+    }
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+
+    return true;
+}
+
+
+int rtr_notify_listen(
+    const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (!make_address(&addr, path))
+    {
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        ERR_LOG(errno, NULL, "socket()");
+        return -1;
+    }
+
+    if (fcntl(fd, F_SETFL, O_NONBLOCK) != 0)
+    {
+        ERR_LOG(errno, NULL, "fcntl() to make %s nonblocking", path);
+        close(fd);
+        return -1;
+    }
+
+    if (unlink(path) != 0 && errno != ENOENT)
+    {
+        ERR_LOG(errno, NULL, "can't remove stale socket %s", path);
+        close(fd);
+        return -1;
+    }
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        ERR_LOG(errno, NULL, "can't bind %s", path);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+bool rtr_notify_wait(
+    int fd,
+    unsigned int timeout)
+{
+    fd_set read_fds;
+    struct timeval tv;
+    uint32_t buf;
+    bool received = false;
+    int retval;
+
+    FD_ZERO(&read_fds);
+    FD_SET(fd, &read_fds);
+    tv.tv_sec = timeout;
+    tv.tv_usec = 0;
+
+    retval = select(fd + 1, &read_fds, NULL, NULL, &tv);
+    if (retval < 0)
+    {
+        if (errno != EINTR)
+        {
+            ERR_LOG(errno, NULL, "select() on notification socket");
+        }
+        return false;
+    }
+    else if (retval == 0)
+    {
+        return false;
+    }
+
+    while (recv(fd, &buf, sizeof(buf), 0) >= 0)
+    {
+        received = true;
+        LOG(LOG_DEBUG, "got notification for serial number %" PRISERIAL,
+            (serial_number_t)ntohl(buf));
+    }
+
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+        ERR_LOG(errno, NULL, "recv() on notification socket");
+    }
+
+    return received;
+}
+
+
+void rtr_notify_close(
+    int fd,
+    const char *path)
+{
+    if (close(fd) != 0)
+    {
+        ERR_LOG(errno, NULL, "close() notification socket");
+    }
+
+    if (unlink(path) != 0 && errno != ENOENT)
+    {
+        ERR_LOG(errno, NULL, "can't remove %s", path);
+    }
+}
+
+
+bool rtr_notify_send(
+    const char *path,
+    serial_number_t serial)
+{
+    struct sockaddr_un addr;
+    uint32_t buf = htonl(serial);
+    int fd;
+    bool ret = true;
+
+    if (!make_address(&addr, path))
+    {
+        return false;
+    }
+
+    fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        ERR_LOG(errno, NULL, "socket()");
+        return false;
+    }
+
+    if (sendto(fd, &buf, sizeof(buf), MSG_DONTWAIT,
+               (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        if (errno == ENOENT || errno == ECONNREFUSED)
+        {
+            LOG(LOG_INFO, "nothing is listening on %s", path);
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            // The listener already has notifications it hasn't read yet,
+            // so it'll wake up anyway.
+            LOG(LOG_DEBUG, "notification queue for %s is full", path);
+        }
+        else
+        {
+            ERR_LOG(errno, NULL, "can't send notification to %s", path);
+        }
+        ret = false;
+    }
+
+    close(fd);
+
+    return ret;
+}
@@ -0,0 +1,64 @@
+#ifndef _RTR_NOTIFY_H
+#define _RTR_NOTIFY_H
+
+/**
+   Local notifications from rpki-rtr-update to rpki-rtr-daemon.
+
+   The daemon binds a Unix domain datagram socket and waits on it.
+   After rpki-rtr-update commits a new serial number, it sends a
+   datagram containing that serial number (in network byte order) to
+   the socket, so the daemon can pick up the new data immediately
+   instead of waiting for its next poll of the database. Notifications
+   are only hints: the daemon always gets the actual cache state from
+   the database, and still polls occasionally in case a notification
+   is lost.
+*/
+
+#include <stdbool.h>
+
+#include "rpki-rtr/pdu.h"
+
+
+/**
+   @brief Bind a notification socket at @p path, replacing any stale
+       socket that's already there.
+
+   @return The socket's file descriptor, or -1 on error.
+*/
+int rtr_notify_listen(
+    const char *path);
+
+/**
+   @brief Wait up to @p timeout seconds for a notification.
+
+   All notifications that are pending when this returns are consumed,
+   so a burst of notifications results in a single wakeup.
+
+   @return True if at least one notification was received, false on
+       timeout or error.
+*/
+bool rtr_notify_wait(
+    int fd,
+    unsigned int timeout);
+
+/**
+   @brief Close a socket returned by rtr_notify_listen() and remove
+       @p path.
+*/
+void rtr_notify_close(
+    int fd,
+    const char *path);
+
+/**
+   @brief Tell whoever is listening at @p path that @p serial is
+       available.
+
+   It is not an error for nothing to be listening.
+
+   @return True if the notification was sent, false otherwise.
+*/
+bool rtr_notify_send(
+    const char *path,
+    serial_number_t serial);
+
+#endif
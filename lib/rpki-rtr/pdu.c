@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <inttypes.h>
 #include <ctype.h>
+#include <errno.h>
 
 
 // based on RFC 1982, Section 3.2
@@ -25,6 +26,29 @@ bool serial_number_greater(
 #undef SERIAL_BITS
 }
 
+bool parse_serial_number(
+    const char *str,
+    serial_number_t *serial)
+{
+    char *end;
+    unsigned long long v;
+
+    if (*str < '0' || *str > '9')
+    {
+        return false;
+    }
+
+    errno = 0;
+    v = strtoull(str, &end, 10);
+    if (errno != 0 || *end != '\0' || v > UINT32_MAX)
+    {
+        return false;
+    }
+
+    *serial = (serial_number_t)v;
+    return true;
+}
+
 // TODO: switch to uintmax_t instead of uint_fast32_t? 32 should be enough for
 // this protocol version
 // NOTE: this handles converting from network to host byte order
@@ -83,7 +107,7 @@ int parse_pdu(
     } while (false)
 
     EXTRACT_FIELD(pdu->protocolVersion);
-    if (pdu->protocolVersion != RTR_PROTOCOL_VERSION)
+    if (pdu->protocolVersion > RTR_PROTOCOL_VERSION_MAX)
     {
         return PDU_UNSUPPORTED_PROTOCOL_VERSION;
     }
@@ -116,7 +140,9 @@ int parse_pdu(
             pdu->errorCode != ERR_UNSUPPORTED_VERSION &&
             pdu->errorCode != ERR_UNSUPPORTED_TYPE &&
             pdu->errorCode != ERR_UNKNOWN_WITHDRAW &&
-            pdu->errorCode != ERR_DUPLICATE_ANNOUNCE)
+            pdu->errorCode != ERR_DUPLICATE_ANNOUNCE &&
+            (pdu->errorCode != ERR_UNEXPECTED_VERSION ||
+             pdu->protocolVersion < RTR_PROTOCOL_VERSION_1))
         {
             ret = PDU_WARNING;
         }
@@ -130,13 +156,32 @@ int parse_pdu(
     {
     case PDU_SERIAL_NOTIFY:
     case PDU_SERIAL_QUERY:
-    case PDU_END_OF_DATA:
         if (pdu->length != PDU_HEADER_LENGTH + sizeof(pdu->serialNumber))
         {
             return PDU_CORRUPT_DATA;
         }
         EXTRACT_FIELD(pdu->serialNumber);
         return ret;
+    case PDU_END_OF_DATA:
+        if (pdu->protocolVersion == RTR_PROTOCOL_VERSION_0)
+        {
+            if (pdu->length != PDU_HEADER_LENGTH + sizeof(pdu->serialNumber))
+            {
+                return PDU_CORRUPT_DATA;
+            }
+            EXTRACT_FIELD(pdu->serialNumber);
+            return ret;
+        }
+
+        if (pdu->length != PDU_HEADER_LENGTH + sizeof(EndOfDataData))
+        {
+            return PDU_CORRUPT_DATA;
+        }
+        EXTRACT_FIELD(pdu->endOfData.serialNumber);
+        EXTRACT_FIELD(pdu->endOfData.refreshInterval);
+        EXTRACT_FIELD(pdu->endOfData.retryInterval);
+        EXTRACT_FIELD(pdu->endOfData.expireInterval);
+        return ret;
     case PDU_RESET_QUERY:
     case PDU_CACHE_RESPONSE:
     case PDU_CACHE_RESET:
@@ -343,9 +388,13 @@ ssize_t dump_pdu(
                  pdu->pduType == PDU_SERIAL_QUERY ||
                  pdu->pduType == PDU_END_OF_DATA)
         {
-            // These require fixing the order of the serial number
-            *(uint32_t *) (buffer + PDU_HEADER_LENGTH) =
-                htonl(*(uint32_t *) (buffer + PDU_HEADER_LENGTH));
+            // These require fixing the order of the serial number and,
+            // for a version 1 End of Data, the timing intervals after it
+            size_t i;
+            for (i = PDU_HEADER_LENGTH; i + 4 <= offset; i += 4)
+            {
+                *(uint32_t *) (buffer + i) = htonl(*(uint32_t *) (buffer + i));
+            }
         }
     }
 
@@ -360,7 +409,7 @@ static void _fill_pdu_common(
     uint8_t type,
     uint32_t length)
 {
-    pdu->protocolVersion = RTR_PROTOCOL_VERSION;
+    pdu->protocolVersion = RTR_PROTOCOL_VERSION_0;
     pdu->pduType = type;
     pdu->length = length;
 }
@@ -463,6 +512,24 @@ void fill_pdu_end_of_data(
     _fill_pdu_with_serial_number(pdu, PDU_END_OF_DATA, session, serial);
 }
 
+void fill_pdu_end_of_data_v1(
+    PDU * pdu,
+    session_id_t session,
+    serial_number_t serial,
+    uint32_t refresh_interval,
+    uint32_t retry_interval,
+    uint32_t expire_interval)
+{
+    _fill_pdu_common(pdu, PDU_END_OF_DATA,
+                     PDU_HEADER_LENGTH + sizeof(pdu->endOfData));
+    pdu->protocolVersion = RTR_PROTOCOL_VERSION_1;
+    pdu->sessionId = session;
+    pdu->endOfData.serialNumber = serial;
+    pdu->endOfData.refreshInterval = refresh_interval;
+    pdu->endOfData.retryInterval = retry_interval;
+    pdu->endOfData.expireInterval = expire_interval;
+}
+
 void fill_pdu_cache_reset(
     PDU * pdu)
 {
@@ -745,6 +812,9 @@ void pdu_sprint(
         case ERR_DUPLICATE_ANNOUNCE:
             SNPRINTF(" (Duplicate Announce)");
             break;
+        case ERR_UNEXPECTED_VERSION:
+            SNPRINTF(" (Unexpected Version)");
+            break;
         default:
             SNPRINTF(" (unknown error code %" PRIu16 ")", pdu->errorCode);
             break;
@@ -760,8 +830,19 @@ void pdu_sprint(
     {
     case PDU_SERIAL_NOTIFY:
     case PDU_SERIAL_QUERY:
+        SNPRINTF(", serial number = %" PRIu32, pdu->serialNumber);
+        break;
     case PDU_END_OF_DATA:
         SNPRINTF(", serial number = %" PRIu32, pdu->serialNumber);
+        if (pdu->protocolVersion >= RTR_PROTOCOL_VERSION_1)
+        {
+            SNPRINTF(", refresh interval = %" PRIu32,
+                     pdu->endOfData.refreshInterval);
+            SNPRINTF(", retry interval = %" PRIu32,
+                     pdu->endOfData.retryInterval);
+            SNPRINTF(", expire interval = %" PRIu32,
+                     pdu->endOfData.expireInterval);
+        }
         break;
     case PDU_RESET_QUERY:
     case PDU_CACHE_RESPONSE:
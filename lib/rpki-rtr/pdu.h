@@ -27,7 +27,9 @@
 /*****
  * Constants for use in the PDUs
  *****/
-#define RTR_PROTOCOL_VERSION 0
+#define RTR_PROTOCOL_VERSION_0 0     /* RFC 6810 */
+#define RTR_PROTOCOL_VERSION_1 1     /* RFC 8210 */
+#define RTR_PROTOCOL_VERSION_MAX RTR_PROTOCOL_VERSION_1
 #define FLAG_WITHDRAW_ANNOUNCE 0x1
 #define FLAGS_RESERVED (0x2 | 0x4 | 0x8 | 0x10 | 0x20 | 0x40 | 0x80)
 
@@ -42,6 +44,7 @@
 #define ERR_UNSUPPORTED_TYPE 5
 #define ERR_UNKNOWN_WITHDRAW 6
 #define ERR_DUPLICATE_ANNOUNCE 7
+#define ERR_UNEXPECTED_VERSION 8       /* version 1 and later */
 #define ERR_IS_FATAL(code)                                              \
     ((code) != ERR_NO_DATA)
 
@@ -74,6 +77,15 @@ bool serial_number_greater(
     serial_number_t s1,
     serial_number_t s2);
 
+/**
+   @brief Parse a decimal serial number, e.g. from the command line.
+
+   @return True if all of @p str is a serial number, false otherwise.
+*/
+bool parse_serial_number(
+    const char *str,
+    serial_number_t *serial);
+
 
 struct _PDU;
 typedef struct _PDU PDU;
@@ -99,6 +111,31 @@ typedef struct _IP6PrefixData {
     as_number_t asNumber;
 } PACKED_STRUCT IP6PrefixData;
 
+/*****
+ * structure holding the data for a version 1 End of Data PDU
+ *
+ * In version 0, only serialNumber is present.
+ *****/
+typedef struct _EndOfDataData {
+    serial_number_t serialNumber;
+    uint32_t refreshInterval;
+    uint32_t retryInterval;
+    uint32_t expireInterval;
+} PACKED_STRUCT EndOfDataData;
+
+/*****
+ * Timing parameters from RFC 8210, Section 6, in seconds
+ *****/
+#define RTR_REFRESH_INTERVAL_MIN 1
+#define RTR_REFRESH_INTERVAL_MAX 86400
+#define RTR_REFRESH_INTERVAL_DEFAULT 3600
+#define RTR_RETRY_INTERVAL_MIN 1
+#define RTR_RETRY_INTERVAL_MAX 7200
+#define RTR_RETRY_INTERVAL_DEFAULT 600
+#define RTR_EXPIRE_INTERVAL_MIN 600
+#define RTR_EXPIRE_INTERVAL_MAX 172800
+#define RTR_EXPIRE_INTERVAL_DEFAULT 7200
+
 /*****
  * structure holding the data for an error response
  *****/
@@ -125,6 +162,7 @@ struct _PDU {
     uint32_t length;
     union {
         serial_number_t serialNumber;
+        EndOfDataData endOfData;
         IP4PrefixData ip4PrefixData;
         IP6PrefixData ip6PrefixData;
         ErrorData errorData;
@@ -151,6 +189,10 @@ struct _PDU {
 /**
    Attempt to parse as much of buffer as possible into pdu.
 
+   PDUs of any protocol version up to RTR_PROTOCOL_VERSION_MAX are
+   accepted. It's up to the caller to check that the version matches
+   the one negotiated for the session.
+
    NOTE: pdu may contain pointers into buffer after parsing.  Use
    pdu_deepcopy to get a copy that isn't tied to buffer.
 
@@ -174,6 +216,11 @@ ssize_t dump_pdu(
     size_t buflen,
     const PDU * pdu);
 
+/**
+   The fill_pdu_*() functions fill in a protocol version 0 PDU. To send
+   a PDU with a different version, set its protocolVersion afterwards,
+   except for End of Data, which has a separate version 1 function.
+*/
 void fill_pdu_serial_notify(
     PDU * pdu,
     session_id_t session,
@@ -205,6 +252,13 @@ void fill_pdu_end_of_data(
     PDU * pdu,
     session_id_t session,
     serial_number_t serial);
+void fill_pdu_end_of_data_v1(
+    PDU * pdu,
+    session_id_t session,
+    serial_number_t serial,
+    uint32_t refresh_interval,
+    uint32_t retry_interval,
+    uint32_t expire_interval);
 void fill_pdu_cache_reset(
     PDU * pdu);
 
@@ -0,0 +1,758 @@
+#include "rib_dump.h"
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "rpki-rtr/rov.h"
+
+
+#define BGP_ATTR_FLAG_EXTENDED_LENGTH 0x10
+#define BGP_ATTR_TYPE_AS_PATH 2
+#define BGP_AS_PATH_SEGMENT_AS_SEQUENCE 2
+
+// Number of distinct origins per prefix that are remembered to avoid
+// reporting the same route twice. Prefixes with more distinct origins
+// than this don't occur in practice, and if one did, some of its routes
+// would just be reported more than once.
+#define MAX_DISTINCT_ORIGINS 64
+
+
+/**
+   @brief The origins already reported for one prefix.
+*/
+struct origin_set {
+    as_number_t origins[MAX_DISTINCT_ORIGINS];
+    size_t num_origins;
+
+    /** @brief Whether a route without an origin was reported. */
+    bool has_none;
+};
+
+static void origin_set_clear(
+    struct origin_set *set)
+{
+    set->num_origins = 0;
+    set->has_none = false;
+}
+
+/**
+   @brief Add @p route's origin to @p set.
+
+   @return False if it was already there, true otherwise.
+*/
+static bool origin_set_add(
+    struct origin_set *set,
+    const struct rib_route *route)
+{
+    size_t i;
+
+    if (!route->has_origin)
+    {
+        if (set->has_none)
+        {
+            return false;
+        }
+        set->has_none = true;
+        return true;
+    }
+
+    for (i = 0; i < set->num_origins; ++i)
+    {
+        if (set->origins[i] == route->origin)
+        {
+            return false;
+        }
+    }
+
+    if (set->num_origins < MAX_DISTINCT_ORIGINS)
+    {
+        set->origins[set->num_origins++] = route->origin;
+    }
+
+    return true;
+}
+
+static bool same_prefix(
+    const struct rib_route *a,
+    const struct rib_route *b)
+{
+    return a->family_length == b->family_length &&
+        a->prefix_length == b->prefix_length &&
+        memcmp(a->prefix, b->prefix, a->family_length) == 0;
+}
+
+
+bool rib_route_equal(
+    const struct rib_route *a,
+    const struct rib_route *b)
+{
+    return same_prefix(a, b) &&
+        a->has_origin == b->has_origin &&
+        a->origin == b->origin;
+}
+
+bool rib_route_prefix_sprint(
+    const struct rib_route *route,
+    char *buffer,
+    size_t buffer_length)
+{
+    size_t address_length;
+    int ret;
+
+    if (inet_ntop(route->family_length == 4 ? AF_INET : AF_INET6,
+                  route->prefix, buffer, buffer_length) == NULL)
+    {
+        return false;
+    }
+
+    address_length = strlen(buffer);
+    ret = snprintf(buffer + address_length,
+                   buffer_length - address_length, "/%u",
+                   (unsigned)route->prefix_length);
+
+    return ret > 0 && (size_t)ret < buffer_length - address_length;
+}
+
+
+/**
+   @brief Zero the bits of @p route's prefix past its prefix length.
+*/
+static void mask_prefix(
+    struct rib_route *route)
+{
+    size_t i;
+
+    for (i = route->prefix_length; i < (size_t)route->family_length * 8;
+         ++i)
+    {
+        route->prefix[i / 8] &= ~(0x80 >> (i % 8));
+    }
+}
+
+static bool parse_prefix(
+    const char *str,
+    size_t length,
+    struct rib_route *route)
+{
+    char buffer[64];
+    size_t family_length;
+
+    if (length == 0 || length >= sizeof(buffer))
+    {
+        return false;
+    }
+
+    memcpy(buffer, str, length);
+    buffer[length] = '\0';
+
+    if (!rov_parse_prefix(buffer, route->prefix, &family_length,
+                          &route->prefix_length))
+    {
+        return false;
+    }
+
+    route->family_length = family_length;
+    mask_prefix(route);
+
+    return true;
+}
+
+static bool parse_asn(
+    const char *str,
+    size_t length,
+    as_number_t *asn)
+{
+    uint64_t value = 0;
+    size_t i;
+
+    if (length == 0 || length > 10)
+    {
+        return false;
+    }
+
+    for (i = 0; i < length; ++i)
+    {
+        if (str[i] < '0' || str[i] > '9')
+        {
+            return false;
+        }
+        value = value * 10 + (str[i] - '0');
+    }
+
+    if (value > UINT32_MAX)
+    {
+        return false;
+    }
+
+    *asn = (as_number_t)value;
+    return true;
+}
+
+static inline bool is_space(
+    char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**
+   @brief Find the next whitespace-delimited token in [*pos, end).
+
+   @return True if a token was found, in which case *pos is moved past
+       it.
+*/
+static bool next_token(
+    const char **pos,
+    const char *end,
+    const char **token,
+    size_t *token_length)
+{
+    const char *p = *pos;
+
+    while (p < end && is_space(*p))
+    {
+        ++p;
+    }
+
+    if (p == end)
+    {
+        return false;
+    }
+
+    *token = p;
+    while (p < end && !is_space(*p))
+    {
+        ++p;
+    }
+    *token_length = p - *token;
+    *pos = p;
+
+    return true;
+}
+
+/**
+   @brief Set @p route's origin from a text AS path such as
+       "64511 64496" or "64511 {64496,64497}".
+*/
+static bool parse_text_as_path(
+    const char *path,
+    size_t length,
+    struct rib_route *route)
+{
+    const char *pos = path;
+    const char *end = path + length;
+    const char *token;
+    size_t token_length;
+    const char *last = NULL;
+    size_t last_length = 0;
+
+    while (next_token(&pos, end, &token, &token_length))
+    {
+        last = token;
+        last_length = token_length;
+    }
+
+    route->has_origin = false;
+    route->origin = 0;
+
+    if (last == NULL || last[0] == '{' || last[0] == '(' ||
+        last[0] == '[')
+    {
+        // Empty path, or it ends with an AS_SET or a confederation
+        // segment.
+        return true;
+    }
+
+    if (!parse_asn(last, last_length, &route->origin))
+    {
+        return false;
+    }
+    route->has_origin = true;
+
+    return true;
+}
+
+/**
+   @brief Parse a "bgpdump -m" line.
+*/
+static int parse_bgpdump_line(
+    const char *line,
+    size_t length,
+    struct rib_route *route)
+{
+    enum {
+        FIELD_TYPE = 0,
+        FIELD_PREFIX = 5,
+        FIELD_AS_PATH = 6,
+        NUM_FIELDS = 7,
+    };
+    const char *fields[NUM_FIELDS];
+    size_t field_lengths[NUM_FIELDS];
+    const char *end = line + length;
+    const char *p = line;
+    const char *bar = line;
+    size_t num_fields;
+
+    for (num_fields = 0; num_fields < NUM_FIELDS && bar != NULL;
+         ++num_fields)
+    {
+        bar = memchr(p, '|', end - p);
+        fields[num_fields] = p;
+        field_lengths[num_fields] = (bar == NULL ? end : bar) - p;
+        if (bar != NULL)
+        {
+            p = bar + 1;
+        }
+    }
+
+    // Only RIB entries have routes, e.g. skip BGP4MP updates.
+    if (!(field_lengths[FIELD_TYPE] == strlen("TABLE_DUMP2") &&
+          memcmp(fields[FIELD_TYPE], "TABLE_DUMP2",
+                 field_lengths[FIELD_TYPE]) == 0) &&
+        !(field_lengths[FIELD_TYPE] == strlen("TABLE_DUMP") &&
+          memcmp(fields[FIELD_TYPE], "TABLE_DUMP",
+                 field_lengths[FIELD_TYPE]) == 0))
+    {
+        return 0;
+    }
+
+    if (num_fields < NUM_FIELDS)
+    {
+        return -1;
+    }
+
+    if (!parse_prefix(fields[FIELD_PREFIX], field_lengths[FIELD_PREFIX],
+                      route) ||
+        !parse_text_as_path(fields[FIELD_AS_PATH],
+                            field_lengths[FIELD_AS_PATH], route))
+    {
+        return -1;
+    }
+
+    return 1;
+}
+
+int rib_parse_line(
+    const char *line,
+    size_t length,
+    struct rib_route *route)
+{
+    const char *pos = line;
+    const char *end = line + length;
+    const char *prefix;
+    size_t prefix_length;
+    const char *origin;
+    size_t origin_length;
+    const char *extra;
+    size_t extra_length;
+
+    if (!next_token(&pos, end, &prefix, &prefix_length) ||
+        prefix[0] == '#')
+    {
+        return 0;
+    }
+
+    if (memchr(line, '|', length) != NULL)
+    {
+        return parse_bgpdump_line(prefix, end - prefix, route);
+    }
+
+    if (!next_token(&pos, end, &origin, &origin_length) ||
+        next_token(&pos, end, &extra, &extra_length))
+    {
+        return -1;
+    }
+
+    if (origin_length > 2 &&
+        (origin[0] == 'A' || origin[0] == 'a') &&
+        (origin[1] == 'S' || origin[1] == 's'))
+    {
+        origin += 2;
+        origin_length -= 2;
+    }
+
+    if (!parse_prefix(prefix, prefix_length, route) ||
+        !parse_asn(origin, origin_length, &route->origin))
+    {
+        return -1;
+    }
+    route->has_origin = true;
+
+    return 1;
+}
+
+/**
+   @brief Find the start of the line that ends just before @p offset.
+
+   @param offset The start of a line other than the first.
+*/
+static size_t line_before(
+    const char *data,
+    size_t offset)
+{
+    // data[offset - 1] is the newline that ends the line before
+    size_t start = offset - 1;
+
+    while (start > 0 && data[start - 1] != '\n')
+    {
+        --start;
+    }
+
+    return start;
+}
+
+/**
+   @brief Find the first line of the run of routes that the last route
+       before @p offset belongs to.
+
+   A run is the route lines for one prefix, with any other lines
+   between them except routes for another prefix.
+
+   @return The start of the run, or @p offset if there is no route
+       before it.
+*/
+static size_t run_start_before(
+    const char *data,
+    size_t offset)
+{
+    size_t line = offset;
+    size_t line_end;
+    size_t start = offset;
+    struct rib_route route;
+    struct rib_route run_route;
+    bool in_run = false;
+
+    while (line > 0)
+    {
+        line_end = line - 1;
+        line = line_before(data, line);
+
+        if (rib_parse_line(data + line, line_end - line, &route) != 1)
+        {
+            continue;
+        }
+
+        if (in_run && !same_prefix(&route, &run_route))
+        {
+            break;
+        }
+
+        run_route = route;
+        in_run = true;
+        start = line;
+    }
+
+    return start;
+}
+
+bool rib_parse_lines(
+    const char *data,
+    size_t begin,
+    size_t end,
+    rib_route_callback callback,
+    void *arg,
+    uint64_t *unparseable)
+{
+    // Lines from the start of the run that continues into this range
+    // are parsed only to fill in run_prefix and origins.
+    const char *p = data + run_start_before(data, begin);
+    const char *range_begin = data + begin;
+    const char *range_end = data + end;
+    const char *line_end;
+    struct rib_route route;
+    struct rib_route run_prefix;
+    bool in_run = false;
+    struct origin_set origins;
+
+    while (p < range_end)
+    {
+        line_end = memchr(p, '\n', range_end - p);
+        if (line_end == NULL)
+        {
+            line_end = range_end;
+        }
+
+        switch (rib_parse_line(p, line_end - p, &route))
+        {
+            case 1:
+                if (!in_run || !same_prefix(&route, &run_prefix))
+                {
+                    run_prefix = route;
+                    in_run = true;
+                    origin_set_clear(&origins);
+                }
+                if (origin_set_add(&origins, &route) && p >= range_begin &&
+                    !callback(&route, arg))
+                {
+                    return false;
+                }
+                break;
+            case 0:
+                break;
+            default:
+                if (p >= range_begin)
+                {
+                    ++*unparseable;
+                }
+                break;
+        }
+
+        p = line_end + 1;
+    }
+
+    return true;
+}
+
+static inline uint16_t get_uint16(
+    const uint8_t *p)
+{
+    return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static inline uint32_t get_uint32(
+    const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+        ((uint32_t)p[2] << 8) | p[3];
+}
+
+bool rib_is_mrt(
+    const uint8_t *data,
+    size_t length)
+{
+    // The type field is 0 in its high byte, which never happens in a
+    // text dump. Types 12 and 13 are TABLE_DUMP and TABLE_DUMP_V2, 16
+    // and 17 are BGP4MP and BGP4MP_ET.
+    return length >= RIB_MRT_HEADER_LENGTH && data[4] == 0 &&
+        (data[5] == 12 || data[5] == 13 || data[5] == 16 || data[5] == 17);
+}
+
+ssize_t rib_mrt_record_length(
+    const uint8_t *data,
+    size_t length)
+{
+    uint32_t body_length;
+
+    if (length < RIB_MRT_HEADER_LENGTH)
+    {
+        return -1;
+    }
+
+    body_length = get_uint32(data + 8);
+    if (body_length > length - RIB_MRT_HEADER_LENGTH)
+    {
+        return -1;
+    }
+
+    return RIB_MRT_HEADER_LENGTH + (ssize_t)body_length;
+}
+
+/**
+   @brief Set @p route's origin from a BGP AS_PATH attribute with
+       4-byte AS numbers.
+
+   @return True on success, false if the attribute is malformed.
+*/
+static bool parse_mrt_as_path(
+    const uint8_t *path,
+    size_t length,
+    struct rib_route *route)
+{
+    const uint8_t *end = path + length;
+    uint8_t segment_type = 0;
+    uint8_t segment_count = 0;
+
+    while (path < end)
+    {
+        if (end - path < 2)
+        {
+            return false;
+        }
+
+        segment_type = path[0];
+        segment_count = path[1];
+        path += 2;
+
+        if ((size_t)(end - path) < (size_t)segment_count * 4)
+        {
+            return false;
+        }
+        path += (size_t)segment_count * 4;
+    }
+
+    if (segment_type == BGP_AS_PATH_SEGMENT_AS_SEQUENCE &&
+        segment_count > 0)
+    {
+        route->has_origin = true;
+        route->origin = get_uint32(path - 4);
+    }
+    else
+    {
+        route->has_origin = false;
+        route->origin = 0;
+    }
+
+    return true;
+}
+
+/**
+   @brief Set @p route's origin from a list of BGP path attributes.
+
+   @return True on success, false if the attributes are malformed.
+*/
+static bool parse_mrt_attributes(
+    const uint8_t *attributes,
+    size_t length,
+    struct rib_route *route)
+{
+    const uint8_t *p = attributes;
+    const uint8_t *end = attributes + length;
+    uint8_t flags;
+    uint8_t type;
+    size_t value_length;
+
+    route->has_origin = false;
+    route->origin = 0;
+
+    while (p < end)
+    {
+        if (end - p < 3)
+        {
+            return false;
+        }
+
+        flags = p[0];
+        type = p[1];
+        if (flags & BGP_ATTR_FLAG_EXTENDED_LENGTH)
+        {
+            if (end - p < 4)
+            {
+                return false;
+            }
+            value_length = get_uint16(p + 2);
+            p += 4;
+        }
+        else
+        {
+            value_length = p[2];
+            p += 3;
+        }
+
+        if ((size_t)(end - p) < value_length)
+        {
+            return false;
+        }
+
+        if (type == BGP_ATTR_TYPE_AS_PATH)
+        {
+            return parse_mrt_as_path(p, value_length, route);
+        }
+
+        p += value_length;
+    }
+
+    return true;
+}
+
+int rib_mrt_parse_record(
+    const uint8_t *record,
+    size_t length,
+    rib_route_callback callback,
+    void *arg)
+{
+    const uint8_t *p;
+    const uint8_t *end = record + length;
+    struct rib_route route;
+    bool add_path;
+    size_t prefix_bytes;
+    uint16_t num_entries;
+    uint16_t i;
+    size_t attributes_length;
+    struct origin_set origins;
+
+    if (length < RIB_MRT_HEADER_LENGTH ||
+        get_uint16(record + 4) != RIB_MRT_TYPE_TABLE_DUMP_V2)
+    {
+        return 0;
+    }
+
+    memset(&route, 0, sizeof(route));
+
+    switch (get_uint16(record + 6))
+    {
+        case RIB_MRT_SUBTYPE_RIB_IPV4_UNICAST:
+            route.family_length = 4;
+            add_path = false;
+            break;
+        case RIB_MRT_SUBTYPE_RIB_IPV6_UNICAST:
+            route.family_length = 16;
+            add_path = false;
+            break;
+        case RIB_MRT_SUBTYPE_RIB_IPV4_UNICAST_ADDPATH:
+            route.family_length = 4;
+            add_path = true;
+            break;
+        case RIB_MRT_SUBTYPE_RIB_IPV6_UNICAST_ADDPATH:
+            route.family_length = 16;
+            add_path = true;
+            break;
+        default:
+            return 0;
+    }
+
+    p = record + RIB_MRT_HEADER_LENGTH;
+
+    // sequence number (4), prefix length (1)
+    if (end - p < 5)
+    {
+        return -1;
+    }
+    route.prefix_length = p[4];
+    p += 5;
+
+    if (route.prefix_length > route.family_length * 8)
+    {
+        return -1;
+    }
+
+    prefix_bytes = (route.prefix_length + 7) / 8;
+    if ((size_t)(end - p) < prefix_bytes + 2)
+    {
+        return -1;
+    }
+    memcpy(route.prefix, p, prefix_bytes);
+    mask_prefix(&route);
+    p += prefix_bytes;
+
+    num_entries = get_uint16(p);
+    p += 2;
+
+    origin_set_clear(&origins);
+
+    for (i = 0; i < num_entries; ++i)
+    {
+        // peer index (2), originated time (4), path identifier (4, only
+        // with ADD-PATH), attribute length (2)
+        if ((size_t)(end - p) < (add_path ? 12u : 8u))
+        {
+            return -1;
+        }
+        p += add_path ? 10 : 6;
+        attributes_length = get_uint16(p);
+        p += 2;
+
+        if ((size_t)(end - p) < attributes_length ||
+            !parse_mrt_attributes(p, attributes_length, &route))
+        {
+            return -1;
+        }
+        p += attributes_length;
+
+        if (origin_set_add(&origins, &route) && !callback(&route, arg))
+        {
+            return -1;
+        }
+    }
+
+    return 1;
+}
@@ -0,0 +1,171 @@
+#ifndef _RTR_RIB_DUMP_H
+#define _RTR_RIB_DUMP_H
+
+/**
+   Parsing of BGP RIB dumps into (prefix, origin AS) routes, for bulk
+   route origin validation.
+
+   Two kinds of dumps are supported:
+
+   - Text, one route per line. A line is either "<prefix> <origin AS>"
+     or the "bgpdump -m" format, e.g.
+     "TABLE_DUMP2|1467331200|B|192.0.2.1|64496|198.51.100.0/24|64496 64511|IGP|...".
+     Blank lines and lines starting with '#' are ignored.
+
+   - MRT TABLE_DUMP_V2 (RFC 6396), as written by route collectors. Only
+     the RIB_IPV4_UNICAST and RIB_IPV6_UNICAST subtypes and their
+     ADD-PATH variants (RFC 8050) are used, other records are skipped.
+
+   The origin AS of a route is the last AS in its AS_PATH if the last
+   segment is an AS_SEQUENCE, and none otherwise (RFC 6811).
+*/
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "rpki-rtr/pdu.h"
+
+
+#define RIB_MRT_HEADER_LENGTH 12
+
+#define RIB_MRT_TYPE_TABLE_DUMP_V2 13
+
+#define RIB_MRT_SUBTYPE_PEER_INDEX_TABLE 1
+#define RIB_MRT_SUBTYPE_RIB_IPV4_UNICAST 2
+#define RIB_MRT_SUBTYPE_RIB_IPV6_UNICAST 4
+#define RIB_MRT_SUBTYPE_RIB_IPV4_UNICAST_ADDPATH 8
+#define RIB_MRT_SUBTYPE_RIB_IPV6_UNICAST_ADDPATH 10
+
+
+/**
+   @brief A route from a RIB dump.
+*/
+struct rib_route {
+    /** @brief In network byte order, zero past #prefix_length. */
+    uint8_t prefix[16];
+
+    /** @brief 4 for IPv4 or 16 for IPv6. */
+    uint8_t family_length;
+
+    uint8_t prefix_length;
+
+    /**
+       @brief False if the AS_PATH doesn't end with an AS_SEQUENCE, in
+           which case no VRP can match the route.
+    */
+    bool has_origin;
+
+    /** @brief Zero if #has_origin is false. */
+    as_number_t origin;
+};
+
+/**
+   @brief Whether two routes have the same prefix and origin.
+*/
+bool rib_route_equal(
+    const struct rib_route *a,
+    const struct rib_route *b);
+
+/**
+   @brief Format @p route's prefix, e.g. "192.0.2.0/24".
+
+   @return True on success, false if @p buffer is too small.
+*/
+bool rib_route_prefix_sprint(
+    const struct rib_route *route,
+    char *buffer,
+    size_t buffer_length);
+
+
+/**
+   @brief Parse one line of a text dump.
+
+   @param line The line, without the trailing newline. It doesn't need
+       to be nul-terminated.
+   @param length The length of @p line.
+   @return 1 if @p route was filled in, 0 if the line should be
+       skipped, or -1 if the line couldn't be parsed.
+*/
+int rib_parse_line(
+    const char *line,
+    size_t length,
+    struct rib_route *route);
+
+/**
+   @brief Callback for rib_parse_lines() and rib_mrt_parse_record().
+
+   @return True to continue, false to stop.
+*/
+typedef bool (*rib_route_callback)(
+    const struct rib_route *route,
+    void *arg);
+
+/**
+   @brief Call @p callback for every route in the lines of a text dump
+       from @p begin to @p end.
+
+   Like the entries of an MRT record, the consecutive route lines for a
+   prefix, e.g. from different peers, only report each origin once.
+   Blank, comment, and unparseable lines between them don't matter.
+   Lines before @p begin are read back to the start of the prefix's
+   lines, so a dump that is split at line boundaries gives the same
+   routes however it is split.
+
+   @param data The whole dump.
+   @param begin The start of the first line to parse.
+   @param end The end of the range, at the start of a line or the end
+       of the dump.
+   @param unparseable Incremented for each line that couldn't be parsed.
+   @return True if every callback returned true, false otherwise.
+*/
+bool rib_parse_lines(
+    const char *data,
+    size_t begin,
+    size_t end,
+    rib_route_callback callback,
+    void *arg,
+    uint64_t *unparseable);
+
+
+/**
+   @brief Whether @p data looks like the start of an MRT file rather
+       than a text dump.
+*/
+bool rib_is_mrt(
+    const uint8_t *data,
+    size_t length);
+
+/**
+   @brief Get the length of the MRT record at the start of @p data,
+       including its header.
+
+   @return The length, or -1 if @p data is too short to contain the
+       whole record.
+*/
+ssize_t rib_mrt_record_length(
+    const uint8_t *data,
+    size_t length);
+
+/**
+   @brief Call @p callback for every distinct origin of the prefix in
+       an MRT RIB record.
+
+   A RIB record has one prefix and one entry per peer. Peers that agree
+   on the origin only produce one route.
+
+   @param record A complete record, including its header, e.g. as
+       delimited by rib_mrt_record_length().
+   @return 1 if @p record is a supported RIB record and every callback
+       returned true, 0 if @p record is some other kind of record and
+       was skipped, or -1 if @p record is malformed or a callback
+       returned false.
+*/
+int rib_mrt_parse_record(
+    const uint8_t *record,
+    size_t length,
+    rib_route_callback callback,
+    void *arg);
+
+#endif
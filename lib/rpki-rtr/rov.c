@@ -0,0 +1,668 @@
+#include "rov.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define ROV_NO_NODE UINT32_MAX
+
+
+const char *rov_state_name(
+    enum rov_state state)
+{
+    switch (state)
+    {
+        case ROV_VALID:
+            return "valid";
+        case ROV_INVALID:
+            return "invalid";
+        case ROV_NOT_FOUND:
+        default:
+            return "not-found";
+    }
+}
+
+
+/**
+   @return A mask of the @p bits most significant bits, 0 <= @p bits
+       <= 64.
+*/
+static inline uint64_t mask64(
+    unsigned bits)
+{
+    return bits == 0 ? 0 : UINT64_MAX << (64 - bits);
+}
+
+static inline void key_from_prefix(
+    uint64_t key[2],
+    const uint8_t *prefix,
+    size_t family_length)
+{
+    size_t i;
+
+    key[0] = 0;
+    key[1] = 0;
+    for (i = 0; i < family_length; ++i)
+    {
+        key[i / 8] |= (uint64_t)prefix[i] << (56 - 8 * (i % 8));
+    }
+}
+
+static inline void key_mask(
+    uint64_t key[2],
+    unsigned length)
+{
+    if (length <= 64)
+    {
+        key[0] &= mask64(length);
+        key[1] = 0;
+    }
+    else
+    {
+        key[1] &= mask64(length - 64);
+    }
+}
+
+/**
+   @return Whether the first @p length bits of @p a and @p b are equal.
+*/
+static inline bool key_match(
+    const uint64_t a[2],
+    const uint64_t b[2],
+    unsigned length)
+{
+    if (length <= 64)
+    {
+        return ((a[0] ^ b[0]) & mask64(length)) == 0;
+    }
+
+    return a[0] == b[0] && ((a[1] ^ b[1]) & mask64(length - 64)) == 0;
+}
+
+/**
+   @return Bit @p index of @p key, counting from the most significant
+       bit, 0 <= @p index < 128.
+*/
+static inline unsigned key_bit(
+    const uint64_t key[2],
+    unsigned index)
+{
+    if (index < 64)
+    {
+        return (key[0] >> (63 - index)) & 1;
+    }
+
+    return (key[1] >> (127 - index)) & 1;
+}
+
+/**
+   @return The number of leading bits that @p a and @p b have in
+       common, at most @p max.
+*/
+static unsigned key_common_length(
+    const uint64_t a[2],
+    const uint64_t b[2],
+    unsigned max)
+{
+    unsigned common;
+
+    if (a[0] != b[0])
+    {
+        common = __builtin_clzll(a[0] ^ b[0]);
+    }
+    else if (a[1] != b[1])
+    {
+        common = 64 + __builtin_clzll(a[1] ^ b[1]);
+    }
+    else
+    {
+        common = 128;
+    }
+
+    return common < max ? common : max;
+}
+
+
+/**
+   @brief A VRP of one address family, while building a trie.
+*/
+struct rov_build_entry {
+    uint64_t key[2];
+    as_number_t asn;
+    uint8_t prefix_length;
+    uint8_t max_length;
+};
+
+static int rov_build_entry_compare(
+    const void *a_void,
+    const void *b_void)
+{
+    const struct rov_build_entry *a = a_void;
+    const struct rov_build_entry *b = b_void;
+
+    if (a->key[0] != b->key[0])
+    {
+        return a->key[0] < b->key[0] ? -1 : 1;
+    }
+
+    if (a->key[1] != b->key[1])
+    {
+        return a->key[1] < b->key[1] ? -1 : 1;
+    }
+
+    if (a->prefix_length != b->prefix_length)
+    {
+        return a->prefix_length < b->prefix_length ? -1 : 1;
+    }
+
+    if (a->asn != b->asn)
+    {
+        return a->asn < b->asn ? -1 : 1;
+    }
+
+    if (a->max_length != b->max_length)
+    {
+        return a->max_length < b->max_length ? -1 : 1;
+    }
+
+    return 0;
+}
+
+static uint32_t rov_trie_new_node(
+    struct rov_trie *trie,
+    const uint64_t key[2],
+    unsigned length)
+{
+    struct rov_node *node = &trie->nodes[trie->num_nodes];
+
+    node->key[0] = key[0];
+    node->key[1] = key[1];
+    key_mask(node->key, length);
+    node->length = length;
+    node->child[0] = ROV_NO_NODE;
+    node->child[1] = ROV_NO_NODE;
+    node->parent = ROV_NO_NODE;
+    node->entries = 0;
+    node->num_entries = 0;
+
+    return trie->num_nodes++;
+}
+
+/**
+   @brief Find or create the node for a prefix.
+
+   The caller must make sure there's room for two more nodes, so that
+   pointers into trie->nodes stay valid.
+
+   @return The index of the node.
+*/
+static uint32_t rov_trie_insert(
+    struct rov_trie *trie,
+    const uint64_t key[2],
+    unsigned length)
+{
+    uint32_t *link = &trie->root;
+    struct rov_node *node;
+    unsigned common;
+    uint32_t new_index;
+    uint32_t glue_index;
+
+    for (;;)
+    {
+        if (*link == ROV_NO_NODE)
+        {
+            *link = rov_trie_new_node(trie, key, length);
+            return *link;
+        }
+
+        node = &trie->nodes[*link];
+        common = key_common_length(key, node->key,
+                                   length < node->length ?
+                                   length : node->length);
+
+        if (common == node->length)
+        {
+            if (length == node->length)
+            {
+                return *link;
+            }
+
+            link = &node->child[key_bit(key, node->length)];
+            continue;
+        }
+
+        // The new prefix diverges from node's prefix at bit common.
+        new_index = rov_trie_new_node(trie, key, length);
+        if (common == length)
+        {
+            // The new prefix covers node.
+            trie->nodes[new_index].child[key_bit(node->key, length)] =
+                *link;
+            *link = new_index;
+        }
+        else
+        {
+            glue_index = rov_trie_new_node(trie, key, common);
+            trie->nodes[glue_index].child[key_bit(key, common)] =
+                new_index;
+            trie->nodes[glue_index].child[key_bit(node->key, common)] =
+                *link;
+            *link = glue_index;
+        }
+
+        return new_index;
+    }
+}
+
+/**
+   @brief Set rov_node.parent for every node.
+*/
+static void rov_trie_link_parents(
+    struct rov_trie *trie)
+{
+    // Each level of the trie leaves at most one sibling on the stack.
+    uint32_t stack[2 * 129];
+    size_t stack_len = 0;
+    struct rov_node *node;
+    uint32_t parent;
+    uint32_t index;
+    size_t i;
+
+    stack[stack_len++] = trie->root;
+
+    while (stack_len > 0)
+    {
+        index = stack[--stack_len];
+        node = &trie->nodes[index];
+        parent = node->num_entries > 0 ? index : node->parent;
+
+        for (i = 0; i < 2; ++i)
+        {
+            if (node->child[i] != ROV_NO_NODE)
+            {
+                trie->nodes[node->child[i]].parent = parent;
+                stack[stack_len++] = node->child[i];
+            }
+        }
+    }
+}
+
+/**
+   @brief Fill in trie->level, which must have room for
+       2^ROV_LEVEL_BITS entries.
+*/
+static void rov_trie_fill_level(
+    struct rov_trie *trie)
+{
+    const struct rov_node *node;
+    struct rov_level_entry *level;
+    uint64_t key[2];
+    uint32_t index;
+    size_t i;
+
+    for (i = 0; i < ((size_t)1 << ROV_LEVEL_BITS); ++i)
+    {
+        level = &trie->level[i];
+        level->covering = ROV_NO_NODE;
+        level->start = ROV_NO_NODE;
+
+        key[0] = (uint64_t)i << (64 - ROV_LEVEL_BITS);
+        key[1] = 0;
+
+        for (index = trie->root; index != ROV_NO_NODE;
+             index = node->child[key_bit(key, node->length)])
+        {
+            node = &trie->nodes[index];
+
+            if (node->length >= ROV_LEVEL_BITS)
+            {
+                if (key_match(key, node->key, ROV_LEVEL_BITS))
+                {
+                    level->start = index;
+                }
+                break;
+            }
+
+            if (!key_match(key, node->key, node->length))
+            {
+                break;
+            }
+
+            if (node->num_entries > 0)
+            {
+                level->covering = index;
+            }
+        }
+    }
+}
+
+/**
+   @brief Build @p trie from the VRPs in @p vrps with the given family.
+*/
+static bool rov_trie_init(
+    struct rov_trie *trie,
+    const struct vrp *vrps,
+    size_t len,
+    size_t family_length)
+{
+    struct rov_build_entry *build;
+    size_t num_build = 0;
+    size_t num_prefixes = 0;
+    size_t i;
+    size_t j;
+    uint32_t node_index;
+    struct rov_node *node;
+
+    trie->nodes = NULL;
+    trie->num_nodes = 0;
+    trie->root = ROV_NO_NODE;
+    trie->level = NULL;
+    trie->entries = NULL;
+    trie->num_entries = 0;
+
+    for (i = 0; i < len; ++i)
+    {
+        if (vrps[i].family_length == family_length)
+        {
+            ++num_build;
+        }
+    }
+
+    if (num_build == 0)
+    {
+        return true;
+    }
+
+    // Each prefix adds at most two nodes, and node indices must fit
+    // in a uint32_t with ROV_NO_NODE left over.
+    if (num_build >= ROV_NO_NODE / 2)
+    {
+        return false;
+    }
+
+    build = malloc(num_build * sizeof(*build));
+    if (build == NULL)
+    {
+        return false;
+    }
+
+    num_build = 0;
+    for (i = 0; i < len; ++i)
+    {
+        if (vrps[i].family_length != family_length)
+        {
+            continue;
+        }
+
+        key_from_prefix(build[num_build].key, vrps[i].prefix,
+                        family_length);
+        key_mask(build[num_build].key, vrps[i].prefix_length);
+        build[num_build].asn = vrps[i].asn;
+        build[num_build].prefix_length = vrps[i].prefix_length;
+        build[num_build].max_length = vrps[i].max_length;
+        ++num_build;
+    }
+
+    qsort(build, num_build, sizeof(*build), rov_build_entry_compare);
+
+    for (i = 0; i < num_build; ++i)
+    {
+        if (i == 0 ||
+            build[i].prefix_length != build[i - 1].prefix_length ||
+            build[i].key[0] != build[i - 1].key[0] ||
+            build[i].key[1] != build[i - 1].key[1])
+        {
+            ++num_prefixes;
+        }
+    }
+
+    trie->nodes = malloc(2 * num_prefixes * sizeof(*trie->nodes));
+    trie->entries = malloc(num_build * sizeof(*trie->entries));
+    trie->level = malloc(((size_t)1 << ROV_LEVEL_BITS) *
+                         sizeof(*trie->level));
+    if (trie->nodes == NULL || trie->entries == NULL ||
+        trie->level == NULL)
+    {
+        free(build);
+        free(trie->nodes);
+        free(trie->entries);
+        free(trie->level);
+        trie->nodes = NULL;
+        trie->entries = NULL;
+        trie->level = NULL;
+        return false;
+    }
+
+    for (i = 0; i < num_build; i = j)
+    {
+        node_index = rov_trie_insert(trie, build[i].key,
+                                     build[i].prefix_length);
+        node = &trie->nodes[node_index];
+        node->entries = trie->num_entries;
+
+        for (j = i;
+             j < num_build &&
+             build[j].prefix_length == build[i].prefix_length &&
+             build[j].key[0] == build[i].key[0] &&
+             build[j].key[1] == build[i].key[1];
+             ++j)
+        {
+            if (j > i && build[j].asn == build[j - 1].asn &&
+                build[j].max_length == build[j - 1].max_length)
+            {
+                // duplicate
+                continue;
+            }
+
+            trie->entries[trie->num_entries].asn = build[j].asn;
+            trie->entries[trie->num_entries].max_length =
+                build[j].max_length;
+            ++trie->num_entries;
+        }
+
+        node->num_entries = trie->num_entries - node->entries;
+    }
+
+    free(build);
+
+    rov_trie_link_parents(trie);
+    rov_trie_fill_level(trie);
+
+    return true;
+}
+
+static void rov_trie_free(
+    struct rov_trie *trie)
+{
+    free(trie->nodes);
+    free(trie->level);
+    free(trie->entries);
+    trie->nodes = NULL;
+    trie->level = NULL;
+    trie->entries = NULL;
+    trie->num_nodes = 0;
+    trie->num_entries = 0;
+    trie->root = ROV_NO_NODE;
+}
+
+
+bool rov_table_init(
+    struct rov_table *table,
+    const struct vrp *vrps,
+    size_t len)
+{
+    if (!rov_trie_init(&table->ipv4, vrps, len, 4))
+    {
+        return false;
+    }
+
+    if (!rov_trie_init(&table->ipv6, vrps, len, 16))
+    {
+        rov_trie_free(&table->ipv4);
+        return false;
+    }
+
+    return true;
+}
+
+void rov_table_free(
+    struct rov_table *table)
+{
+    rov_trie_free(&table->ipv4);
+    rov_trie_free(&table->ipv6);
+}
+
+size_t rov_table_count(
+    const struct rov_table *table)
+{
+    return table->ipv4.num_entries + table->ipv6.num_entries;
+}
+
+
+/**
+   @return Whether any of @p node's entries match the route.
+*/
+static inline bool rov_node_matches(
+    const struct rov_trie *trie,
+    const struct rov_node *node,
+    uint8_t prefix_length,
+    as_number_t origin)
+{
+    const struct rov_entry *entry = &trie->entries[node->entries];
+    const struct rov_entry *end = entry + node->num_entries;
+
+    for (; entry < end; ++entry)
+    {
+        if (entry->asn == origin && entry->asn != 0 &&
+            prefix_length <= entry->max_length)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+enum rov_state rov_validate(
+    const struct rov_table *table,
+    const uint8_t *prefix,
+    size_t family_length,
+    uint8_t prefix_length,
+    as_number_t origin)
+{
+    const struct rov_trie *trie =
+        family_length == 4 ? &table->ipv4 : &table->ipv6;
+    const struct rov_level_entry *level;
+    const struct rov_node *node;
+    enum rov_state state = ROV_NOT_FOUND;
+    uint64_t key[2];
+    uint32_t index;
+
+    if (trie->level == NULL)
+    {
+        return ROV_NOT_FOUND;
+    }
+
+    key_from_prefix(key, prefix, family_length);
+
+    if (prefix_length >= ROV_LEVEL_BITS)
+    {
+        // Check the VRPs above the level table, then continue from the
+        // level table's starting point.
+        level = &trie->level[key[0] >> (64 - ROV_LEVEL_BITS)];
+        for (index = level->covering; index != ROV_NO_NODE;
+             index = trie->nodes[index].parent)
+        {
+            if (rov_node_matches(trie, &trie->nodes[index],
+                                 prefix_length, origin))
+            {
+                return ROV_VALID;
+            }
+            state = ROV_INVALID;
+        }
+
+        index = level->start;
+    }
+    else
+    {
+        index = trie->root;
+    }
+
+    // Walk down through every node whose prefix covers the route's
+    // prefix, from the least to the most specific.
+    for (; index != ROV_NO_NODE;
+         index = node->child[key_bit(key, node->length)])
+    {
+        node = &trie->nodes[index];
+
+        if (node->length > prefix_length ||
+            !key_match(key, node->key, node->length))
+        {
+            break;
+        }
+
+        if (node->num_entries > 0)
+        {
+            if (rov_node_matches(trie, node, prefix_length, origin))
+            {
+                return ROV_VALID;
+            }
+            state = ROV_INVALID;
+        }
+
+        if (node->length == 128)
+        {
+            break;
+        }
+    }
+
+    return state;
+}
+
+
+bool rov_parse_prefix(
+    const char *str,
+    uint8_t *prefix,
+    size_t *family_length,
+    uint8_t *prefix_length)
+{
+    char address[INET6_ADDRSTRLEN];
+    const char *slash;
+    char *end;
+    unsigned long length;
+    int family;
+
+    slash = strchr(str, '/');
+    if (slash == NULL || (size_t)(slash - str) >= sizeof(address))
+    {
+        return false;
+    }
+
+    memcpy(address, str, slash - str);
+    address[slash - str] = '\0';
+
+    memset(prefix, 0, 16);
+    family = strchr(address, ':') == NULL ? AF_INET : AF_INET6;
+    if (inet_pton(family, address, prefix) != 1)
+    {
+        return false;
+    }
+    *family_length = family == AF_INET ? 4 : 16;
+
+    if (slash[1] < '0' || slash[1] > '9')
+    {
+        return false;
+    }
+
+    errno = 0;
+    length = strtoul(slash + 1, &end, 10);
+    if (errno != 0 || *end != '\0' || length > *family_length * 8)
+    {
+        return false;
+    }
+    *prefix_length = length;
+
+    return true;
+}
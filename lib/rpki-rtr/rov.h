@@ -0,0 +1,181 @@
+#ifndef _RTR_ROV_H
+#define _RTR_ROV_H
+
+/**
+   Route origin validation (RFC 6811) against an in-memory set of VRPs.
+*/
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "rpki-rtr/pdu.h"
+#include "rpki-rtr/vrp.h"
+
+
+/**
+   @brief Validation state of a route, as defined in RFC 6811.
+*/
+enum rov_state {
+    /** @brief No VRP covers the route's prefix. */
+    ROV_NOT_FOUND,
+
+    /**
+       @brief At least one VRP covers the route's prefix and matches
+           its origin AS and prefix length.
+    */
+    ROV_VALID,
+
+    /**
+       @brief At least one VRP covers the route's prefix, but none of
+           them match.
+    */
+    ROV_INVALID,
+};
+
+/**
+   @return "not-found", "valid", or "invalid".
+*/
+const char *rov_state_name(
+    enum rov_state state);
+
+
+/**
+   @brief VRP data for one prefix in a struct rov_trie.
+*/
+struct rov_entry {
+    as_number_t asn;
+    uint8_t max_length;
+};
+
+/**
+   @brief Node of a path-compressed binary trie.
+
+   Prefixes are stored as 128-bit big-endian integers split into two
+   halves, with IPv4 prefixes in the most significant 32 bits. Nodes
+   that were only created to join two branches have no entries.
+*/
+struct rov_node {
+    uint64_t key[2];
+    uint32_t child[2];
+
+    /** @brief Closest ancestor that has entries. */
+    uint32_t parent;
+
+    uint32_t entries;
+    uint32_t num_entries;
+    uint8_t length;
+};
+
+/**
+   @brief Number of leading bits used to index struct rov_trie's
+       #level table.
+*/
+#define ROV_LEVEL_BITS 16
+
+/**
+   @brief Where to start a lookup for all prefixes that are at least
+       ROV_LEVEL_BITS long and start with the same ROV_LEVEL_BITS bits.
+*/
+struct rov_level_entry {
+    /**
+       @brief Most specific node with entries that's shorter than
+           ROV_LEVEL_BITS and covers these prefixes. The rest can be
+           found through rov_node.parent.
+    */
+    uint32_t covering;
+
+    /**
+       @brief First node on the path to these prefixes that's at least
+           ROV_LEVEL_BITS long.
+    */
+    uint32_t start;
+};
+
+/**
+   @brief Trie of all the VRPs of one address family.
+*/
+struct rov_trie {
+    struct rov_node *nodes;
+    size_t num_nodes;
+    uint32_t root;
+
+    /**
+       @brief Table indexed by the first ROV_LEVEL_BITS bits of a
+           prefix, so most lookups skip the top of the trie. NULL if
+           the trie is empty.
+    */
+    struct rov_level_entry *level;
+
+    struct rov_entry *entries;
+    size_t num_entries;
+};
+
+/**
+   @brief An immutable index of VRPs for route origin validation.
+
+   Once initialized, a table can be used by any number of threads at
+   the same time without locking.
+*/
+struct rov_table {
+    struct rov_trie ipv4;
+    struct rov_trie ipv6;
+};
+
+/**
+   @brief Build @p table from @p vrps.
+
+   @p vrps doesn't need to be sorted and may contain duplicates, and it
+   can be freed as soon as this returns.
+
+   @return True on success, false on allocation failure.
+*/
+bool rov_table_init(
+    struct rov_table *table,
+    const struct vrp *vrps,
+    size_t len);
+
+void rov_table_free(
+    struct rov_table *table);
+
+/**
+   @brief Number of VRPs in @p table, after removing duplicates.
+*/
+size_t rov_table_count(
+    const struct rov_table *table);
+
+/**
+   @brief Get the validation state of a route.
+
+   VRPs with origin AS 0 cover prefixes but never match a route (RFC
+   6483).
+
+   @param prefix The route's prefix in network byte order. Bits past
+       @p prefix_length are ignored.
+   @param family_length 4 for IPv4 or 16 for IPv6.
+   @param prefix_length Must be at most @p family_length * 8.
+   @param origin The route's origin AS.
+*/
+enum rov_state rov_validate(
+    const struct rov_table *table,
+    const uint8_t *prefix,
+    size_t family_length,
+    uint8_t prefix_length,
+    as_number_t origin);
+
+/**
+   @brief Parse a prefix such as "192.0.2.0/24" or "2001:db8::/32".
+
+   @param prefix Set to the prefix in network byte order. Must have
+       room for 16 bytes.
+   @param family_length Set to 4 for IPv4 or 16 for IPv6.
+   @param prefix_length Set to the prefix length.
+   @return True on success, false if @p str isn't a valid prefix.
+*/
+bool rov_parse_prefix(
+    const char *str,
+    uint8_t *prefix,
+    size_t *family_length,
+    uint8_t *prefix_length);
+
+#endif
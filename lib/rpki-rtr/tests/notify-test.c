@@ -0,0 +1,65 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "rpki-rtr/notify.h"
+#include "test/unittest.h"
+
+
+static bool test_notify(
+    const char *path)
+{
+    int fd;
+
+    // nothing listening yet
+    TEST_BOOL(rtr_notify_send(path, 1), false);
+
+    fd = rtr_notify_listen(path);
+    TEST_BOOL(fd >= 0, true);
+
+    TEST_BOOL(rtr_notify_wait(fd, 0), false);
+
+    // a burst of notifications is consumed by a single wait
+    TEST_BOOL(rtr_notify_send(path, 2), true);
+    TEST_BOOL(rtr_notify_send(path, 3), true);
+    TEST_BOOL(rtr_notify_wait(fd, 1), true);
+    TEST_BOOL(rtr_notify_wait(fd, 0), false);
+
+    rtr_notify_close(fd, path);
+    TEST_BOOL(access(path, F_OK) == 0, false);
+
+    // a stale socket is replaced
+    fd = rtr_notify_listen(path);
+    TEST_BOOL(fd >= 0, true);
+    close(fd);
+    fd = rtr_notify_listen(path);
+    TEST_BOOL(fd >= 0, true);
+    TEST_BOOL(rtr_notify_send(path, 4), true);
+    TEST_BOOL(rtr_notify_wait(fd, 1), true);
+    rtr_notify_close(fd, path);
+
+    return true;
+}
+
+int main(
+    void)
+{
+    char dir[] = "/tmp/notify-test.XXXXXX";
+    char path[sizeof(dir) + 32];
+    bool ok;
+
+    if (mkdtemp(dir) == NULL)
+    {
+        perror("mkdtemp");
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/notify.sock", dir);
+
+    ok = test_notify(path);
+
+    unlink(path);
+    rmdir(dir);
+
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,157 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "rpki-rtr/pdu.h"
+#include "test/unittest.h"
+
+
+static bool test_end_of_data_v0(
+    void)
+{
+    uint8_t buffer[64];
+    PDU pdu;
+    PDU parsed;
+    ssize_t length;
+
+    static const uint8_t expected[] = {
+        0, PDU_END_OF_DATA, 0x12, 0x34,
+        0, 0, 0, 12,
+        0xde, 0xad, 0xbe, 0xef,
+    };
+
+    fill_pdu_end_of_data(&pdu, 0x1234, 0xdeadbeef);
+    length = dump_pdu(buffer, sizeof(buffer), &pdu);
+    TEST(ssize_t, "%zd", length, ==, (ssize_t)sizeof(expected));
+    TEST_MEMCMP(buffer, ==, expected, sizeof(expected));
+
+    TEST(int, "%d", parse_pdu(buffer, (size_t)length, &parsed), ==,
+         PDU_GOOD);
+    TEST(uint8_t, "%" PRIu8, parsed.protocolVersion, ==,
+         RTR_PROTOCOL_VERSION_0);
+    TEST(session_id_t, "%" PRISESSION, parsed.sessionId, ==, 0x1234);
+    TEST(serial_number_t, "%" PRISERIAL, parsed.serialNumber, ==,
+         0xdeadbeef);
+
+    // a version 0 End of Data doesn't have the timing intervals
+    buffer[7] = 24;
+    TEST(int, "%d", parse_pdu(buffer, sizeof(buffer), &parsed), ==,
+         PDU_CORRUPT_DATA);
+
+    return true;
+}
+
+static bool test_end_of_data_v1(
+    void)
+{
+    uint8_t buffer[64];
+    PDU pdu;
+    PDU parsed;
+    ssize_t length;
+
+    static const uint8_t expected[] = {
+        1, PDU_END_OF_DATA, 0x12, 0x34,
+        0, 0, 0, 24,
+        0xde, 0xad, 0xbe, 0xef,
+        0, 0, 0x0e, 0x10,
+        0, 0, 0x02, 0x58,
+        0, 0, 0x1c, 0x20,
+    };
+
+    fill_pdu_end_of_data_v1(&pdu, 0x1234, 0xdeadbeef, 3600, 600, 7200);
+    length = dump_pdu(buffer, sizeof(buffer), &pdu);
+    TEST(ssize_t, "%zd", length, ==, (ssize_t)sizeof(expected));
+    TEST_MEMCMP(buffer, ==, expected, sizeof(expected));
+
+    // not all there yet
+    TEST(int, "%d", parse_pdu(buffer, 16, &parsed), ==, PDU_TRUNCATED);
+
+    TEST(int, "%d", parse_pdu(buffer, (size_t)length, &parsed), ==,
+         PDU_GOOD);
+    TEST(uint8_t, "%" PRIu8, parsed.protocolVersion, ==,
+         RTR_PROTOCOL_VERSION_1);
+    TEST(session_id_t, "%" PRISESSION, parsed.sessionId, ==, 0x1234);
+    TEST(serial_number_t, "%" PRISERIAL, parsed.serialNumber, ==,
+         0xdeadbeef);
+    TEST(uint32_t, "%" PRIu32, parsed.endOfData.refreshInterval, ==, 3600);
+    TEST(uint32_t, "%" PRIu32, parsed.endOfData.retryInterval, ==, 600);
+    TEST(uint32_t, "%" PRIu32, parsed.endOfData.expireInterval, ==, 7200);
+
+    // a version 1 End of Data must have the timing intervals
+    buffer[7] = 12;
+    TEST(int, "%d", parse_pdu(buffer, 12, &parsed), ==, PDU_CORRUPT_DATA);
+
+    return true;
+}
+
+static bool test_versions(
+    void)
+{
+    uint8_t buffer[64];
+    PDU pdu;
+    PDU parsed;
+    ssize_t length;
+
+    fill_pdu_serial_query(&pdu, 7, 42);
+    pdu.protocolVersion = RTR_PROTOCOL_VERSION_1;
+    length = dump_pdu(buffer, sizeof(buffer), &pdu);
+    TEST(ssize_t, "%zd", length, ==, 12);
+    TEST(int, "%d", parse_pdu(buffer, (size_t)length, &parsed), ==,
+         PDU_GOOD);
+    TEST(uint8_t, "%" PRIu8, parsed.protocolVersion, ==,
+         RTR_PROTOCOL_VERSION_1);
+    TEST(serial_number_t, "%" PRISERIAL, parsed.serialNumber, ==, 42);
+
+    buffer[0] = RTR_PROTOCOL_VERSION_MAX + 1;
+    TEST(int, "%d", parse_pdu(buffer, (size_t)length, &parsed), ==,
+         PDU_UNSUPPORTED_PROTOCOL_VERSION);
+
+    // Unexpected Protocol Version is only defined starting with version 1
+    fill_pdu_error_report(&pdu, ERR_UNEXPECTED_VERSION, 0, NULL, 0, NULL);
+    length = dump_pdu(buffer, sizeof(buffer), &pdu);
+    TEST_BOOL(length > 0, true);
+    TEST(int, "%d", parse_pdu(buffer, (size_t)length, &parsed), ==,
+         PDU_WARNING);
+    buffer[0] = RTR_PROTOCOL_VERSION_1;
+    TEST(int, "%d", parse_pdu(buffer, (size_t)length, &parsed), ==,
+         PDU_GOOD);
+    TEST(error_code_t, "%" PRIu16, parsed.errorCode, ==,
+         ERR_UNEXPECTED_VERSION);
+
+    return true;
+}
+
+static bool test_parse_serial_number(
+    void)
+{
+    serial_number_t serial = 0;
+
+    TEST_BOOL(parse_serial_number("0", &serial), true);
+    TEST(serial_number_t, "%" PRISERIAL, serial, ==, 0);
+    TEST_BOOL(parse_serial_number("4294967295", &serial), true);
+    TEST(serial_number_t, "%" PRISERIAL, serial, ==, 4294967295u);
+
+    TEST_BOOL(parse_serial_number("4294967296", &serial), false);
+    TEST_BOOL(parse_serial_number("", &serial), false);
+    TEST_BOOL(parse_serial_number("-1", &serial), false);
+    TEST_BOOL(parse_serial_number(" 1", &serial), false);
+    TEST_BOOL(parse_serial_number("1x", &serial), false);
+    TEST(serial_number_t, "%" PRISERIAL, serial, ==, 4294967295u);
+
+    return true;
+}
+
+int main(
+    void)
+{
+    if (!test_end_of_data_v0())
+        return -1;
+    if (!test_end_of_data_v1())
+        return -1;
+    if (!test_versions())
+        return -1;
+    if (!test_parse_serial_number())
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,347 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "rpki-rtr/rib_dump.h"
+#include "test/unittest.h"
+
+
+static int parse_line(
+    const char *line,
+    struct rib_route *route)
+{
+    return rib_parse_line(line, strlen(line), route);
+}
+
+static bool test_text(
+    void)
+{
+    struct rib_route route;
+    char buffer[64];
+    static const uint8_t expected6[16] = {0x20, 0x01, 0x0d, 0xb8};
+
+    TEST(int, "%d", parse_line("192.0.2.0/24 64496", &route), ==, 1);
+    TEST(unsigned, "%u", (unsigned)route.family_length, ==, 4);
+    TEST(unsigned, "%u", (unsigned)route.prefix_length, ==, 24);
+    TEST_BOOL(route.has_origin, true);
+    TEST(as_number_t, "%" PRIu32, route.origin, ==, 64496);
+    TEST_BOOL(rib_route_prefix_sprint(&route, buffer, sizeof(buffer)),
+              true);
+    TEST_STR(buffer, ==, "192.0.2.0/24");
+    TEST_BOOL(rib_route_prefix_sprint(&route, buffer, 12), false);
+
+    // host bits are cleared
+    TEST(int, "%d", parse_line("  192.0.2.77/24\tAS64496\r", &route), ==,
+         1);
+    TEST_BOOL(rib_route_prefix_sprint(&route, buffer, sizeof(buffer)),
+              true);
+    TEST_STR(buffer, ==, "192.0.2.0/24");
+    TEST(as_number_t, "%" PRIu32, route.origin, ==, 64496);
+
+    TEST(int, "%d", parse_line("2001:db8::/32 4294967295", &route), ==, 1);
+    TEST(unsigned, "%u", (unsigned)route.family_length, ==, 16);
+    TEST_MEMCMP(route.prefix, ==, expected6, sizeof(expected6));
+    TEST(as_number_t, "%" PRIu32, route.origin, ==, 4294967295u);
+
+    TEST(int, "%d", parse_line("", &route), ==, 0);
+    TEST(int, "%d", parse_line("   ", &route), ==, 0);
+    TEST(int, "%d", parse_line("# comment", &route), ==, 0);
+
+    TEST(int, "%d", parse_line("192.0.2.0/24", &route), ==, -1);
+    TEST(int, "%d", parse_line("192.0.2.0/24 64496 x", &route), ==, -1);
+    TEST(int, "%d", parse_line("192.0.2.0/24 4294967296", &route), ==, -1);
+    TEST(int, "%d", parse_line("192.0.2.0/24 AS", &route), ==, -1);
+    TEST(int, "%d", parse_line("192.0.2.0/33 64496", &route), ==, -1);
+    TEST(int, "%d", parse_line("192.0.2.0 64496", &route), ==, -1);
+
+    return true;
+}
+
+static bool test_bgpdump(
+    void)
+{
+    struct rib_route route;
+
+    TEST(int, "%d",
+         parse_line("TABLE_DUMP2|1467331200|B|192.0.2.1|64511|"
+                    "198.51.100.0/24|64511 64500 64496|IGP|192.0.2.1|0|0|"
+                    "|NAG||", &route), ==, 1);
+    TEST(unsigned, "%u", (unsigned)route.prefix_length, ==, 24);
+    TEST(unsigned, "%u", (unsigned)route.prefix[0], ==, 198);
+    TEST_BOOL(route.has_origin, true);
+    TEST(as_number_t, "%" PRIu32, route.origin, ==, 64496);
+
+    // ends with an AS_SET, so there's no origin
+    TEST(int, "%d",
+         parse_line("TABLE_DUMP2|1467331200|B|192.0.2.1|64511|"
+                    "198.51.100.0/24|64511 {64496,64497}|IGP", &route), ==,
+         1);
+    TEST_BOOL(route.has_origin, false);
+
+    // empty path
+    TEST(int, "%d",
+         parse_line("TABLE_DUMP2|1467331200|B|192.0.2.1|64511|"
+                    "2001:db8::/32||IGP", &route), ==, 1);
+    TEST(unsigned, "%u", (unsigned)route.family_length, ==, 16);
+    TEST_BOOL(route.has_origin, false);
+
+    // the AS path is the last field
+    TEST(int, "%d",
+         parse_line("TABLE_DUMP|1467331200|B|192.0.2.1|64511|"
+                    "198.51.100.0/24|64496", &route), ==, 1);
+    TEST(as_number_t, "%" PRIu32, route.origin, ==, 64496);
+
+    // not a RIB entry
+    TEST(int, "%d",
+         parse_line("BGP4MP|1467331200|A|192.0.2.1|64511|198.51.100.0/24|"
+                    "64511 64496|IGP", &route), ==, 0);
+    TEST(int, "%d", parse_line("BGP4MP|1467331200|STATE", &route), ==, 0);
+
+    TEST(int, "%d",
+         parse_line("TABLE_DUMP2|1467331200|B|192.0.2.1|64511", &route),
+         ==, -1);
+    TEST(int, "%d",
+         parse_line("TABLE_DUMP2|1467331200|B|192.0.2.1|64511|"
+                    "198.51.100.0/24|64511 x|IGP", &route), ==, -1);
+
+    return true;
+}
+
+
+#define MAX_ROUTES 8
+
+struct collected {
+    struct rib_route routes[MAX_ROUTES];
+    size_t num_routes;
+};
+
+static bool collect(
+    const struct rib_route *route,
+    void *arg)
+{
+    struct collected *collected = arg;
+
+    if (collected->num_routes == MAX_ROUTES)
+    {
+        return false;
+    }
+
+    collected->routes[collected->num_routes++] = *route;
+    return true;
+}
+
+/**
+   RIB_IPV4_UNICAST record for 198.51.100.0/22 with four entries: two
+   with origin 64496, one ending with an AS_SET, and one with origin
+   64497.
+*/
+static const uint8_t rib_ipv4[] = {
+    // header: timestamp, type 13, subtype 2, length
+    0x57, 0x76, 0x1b, 0x00, 0, 13, 0, 2, 0, 0, 0, 101,
+    // sequence number, prefix length, prefix, entry count
+    0, 0, 0, 1, 22, 198, 51, 100, 0, 4,
+
+    // peer 0: ORIGIN, AS_PATH 64511 64496
+    0, 0, 0x57, 0x76, 0x1b, 0x00, 0, 17,
+    0x40, 1, 1, 0,
+    0x40, 2, 10, 2, 2, 0, 0, 0xfb, 0xff, 0, 0, 0xfb, 0xf0,
+
+    // peer 1: AS_PATH 64496 with an extended length
+    0, 1, 0x57, 0x76, 0x1b, 0x00, 0, 10,
+    0x50, 2, 0, 6, 2, 1, 0, 0, 0xfb, 0xf0,
+
+    // peer 2: AS_PATH 64511 {64496 64497}
+    0, 2, 0x57, 0x76, 0x1b, 0x00, 0, 19,
+    0x40, 2, 16, 2, 1, 0, 0, 0xfb, 0xff, 1, 2, 0, 0, 0xfb, 0xf0,
+    0, 0, 0xfb, 0xf1,
+
+    // peer 3: AS_PATH 64497, preceded by an unknown attribute
+    0, 3, 0x57, 0x76, 0x1b, 0x00, 0, 13,
+    0xc0, 99, 1, 0xaa,
+    0x40, 2, 6, 2, 1, 0, 0, 0xfb, 0xf1,
+};
+
+/**
+   RIB_IPV6_UNICAST_ADDPATH record for 2001:db8::/32 with one entry.
+*/
+static const uint8_t rib_ipv6_addpath[] = {
+    0x57, 0x76, 0x1b, 0x00, 0, 13, 0, 10, 0, 0, 0, 32,
+    0, 0, 0, 2, 32, 0x20, 0x01, 0x0d, 0xb8, 0, 1,
+    0, 0, 0x57, 0x76, 0x1b, 0x00, 0, 0, 0, 7, 0, 9,
+    0x40, 2, 6, 2, 1, 0, 1, 0, 0,
+};
+
+static const uint8_t peer_index_table[] = {
+    0x57, 0x76, 0x1b, 0x00, 0, 13, 0, 1, 0, 0, 0, 4,
+    0xc0, 0, 2, 1,
+};
+
+static bool test_mrt(
+    void)
+{
+    struct collected collected;
+    uint8_t buffer[sizeof(rib_ipv4)];
+
+    TEST_BOOL(rib_is_mrt(rib_ipv4, sizeof(rib_ipv4)), true);
+    TEST_BOOL(rib_is_mrt((const uint8_t *)"192.0.2.0/24 64496", 18),
+              false);
+    TEST_BOOL(rib_is_mrt(rib_ipv4, 8), false);
+
+    TEST(ssize_t, "%zd", rib_mrt_record_length(rib_ipv4, sizeof(rib_ipv4)),
+         ==, (ssize_t)sizeof(rib_ipv4));
+    TEST(ssize_t, "%zd",
+         rib_mrt_record_length(rib_ipv4, sizeof(rib_ipv4) - 1), ==, -1);
+    TEST(ssize_t, "%zd", rib_mrt_record_length(rib_ipv4, 11), ==, -1);
+
+    memset(&collected, 0, sizeof(collected));
+    TEST(int, "%d",
+         rib_mrt_parse_record(rib_ipv4, sizeof(rib_ipv4), collect,
+                              &collected), ==, 1);
+    TEST(size_t, "%zu", collected.num_routes, ==, 3);
+    TEST(unsigned, "%u", (unsigned)collected.routes[0].prefix_length, ==,
+         22);
+    TEST(unsigned, "%u", (unsigned)collected.routes[0].prefix[2], ==, 100);
+    TEST_BOOL(collected.routes[0].has_origin, true);
+    TEST(as_number_t, "%" PRIu32, collected.routes[0].origin, ==, 64496);
+    TEST_BOOL(collected.routes[1].has_origin, false);
+    TEST_BOOL(collected.routes[2].has_origin, true);
+    TEST(as_number_t, "%" PRIu32, collected.routes[2].origin, ==, 64497);
+
+    memset(&collected, 0, sizeof(collected));
+    TEST(int, "%d",
+         rib_mrt_parse_record(rib_ipv6_addpath, sizeof(rib_ipv6_addpath),
+                              collect, &collected), ==, 1);
+    TEST(size_t, "%zu", collected.num_routes, ==, 1);
+    TEST(unsigned, "%u", (unsigned)collected.routes[0].family_length, ==,
+         16);
+    TEST(unsigned, "%u", (unsigned)collected.routes[0].prefix_length, ==,
+         32);
+    TEST(as_number_t, "%" PRIu32, collected.routes[0].origin, ==, 65536);
+
+    memset(&collected, 0, sizeof(collected));
+    TEST(int, "%d",
+         rib_mrt_parse_record(peer_index_table, sizeof(peer_index_table),
+                              collect, &collected), ==, 0);
+    TEST(size_t, "%zu", collected.num_routes, ==, 0);
+
+    // truncated in the middle of an entry
+    TEST(int, "%d",
+         rib_mrt_parse_record(rib_ipv4, sizeof(rib_ipv4) - 3, collect,
+                              &collected), ==, -1);
+
+    // AS_PATH segment longer than the attribute
+    memcpy(buffer, rib_ipv4, sizeof(buffer));
+    buffer[38] = 3;
+    TEST(int, "%d",
+         rib_mrt_parse_record(buffer, sizeof(buffer), collect, &collected),
+         ==, -1);
+
+    // prefix length too long for IPv4
+    memcpy(buffer, rib_ipv4, sizeof(buffer));
+    buffer[16] = 33;
+    TEST(int, "%d",
+         rib_mrt_parse_record(buffer, sizeof(buffer), collect, &collected),
+         ==, -1);
+
+    return true;
+}
+
+static const char lines[] =
+    "192.0.2.0/24 64496\n"
+    "# comment\n"
+    "192.0.2.0/24 64496\n"
+    "192.0.2.0/24\n"
+    "192.0.2.0/24 64496\n"
+    "198.51.100.0/24 64497\n"
+    "\n"
+    "198.51.100.0/24 64498\n"
+    "198.51.100.0/24 64497\n"
+    "198.51.100.0/24 64498\n"
+    "192.0.2.0/24 64496";
+
+/**
+   Check that parsing @p lines in the ranges that start at @p splits
+   gives the same routes as parsing it whole.
+*/
+static bool check_lines_split(
+    const size_t *splits,
+    size_t num_splits)
+{
+    struct collected collected;
+    uint64_t unparseable = 0;
+    size_t i;
+    size_t end;
+
+    collected.num_routes = 0;
+    for (i = 0; i < num_splits; ++i)
+    {
+        end = i + 1 < num_splits ? splits[i + 1] : strlen(lines);
+        TEST_BOOL(rib_parse_lines(lines, splits[i], end, collect,
+                                  &collected, &unparseable), true);
+    }
+
+    // each origin once per prefix, even when they're interleaved, as
+    // rib_mrt_parse_record() does
+    TEST(size_t, "%zu", collected.num_routes, ==, 4);
+    TEST(unsigned, "%u", (unsigned)collected.routes[0].origin, ==, 64496);
+    TEST(unsigned, "%u", (unsigned)collected.routes[1].origin, ==, 64497);
+    TEST(unsigned, "%u", (unsigned)collected.routes[2].origin, ==, 64498);
+    TEST(unsigned, "%u", (unsigned)collected.routes[3].origin, ==, 64496);
+    TEST_BOOL(rib_route_equal(&collected.routes[0], &collected.routes[3]),
+              true);
+    TEST(uint64_t, "%" PRIu64, unparseable, ==, 1);
+
+    return true;
+}
+
+static bool test_lines(
+    void)
+{
+    size_t line_starts[16];
+    size_t num_lines = 0;
+    size_t splits[2];
+    size_t i;
+
+    line_starts[num_lines++] = 0;
+    for (i = 0; lines[i] != '\0'; ++i)
+    {
+        if (lines[i] == '\n')
+        {
+            line_starts[num_lines++] = i + 1;
+        }
+    }
+
+    // whole
+    if (!check_lines_split(line_starts, 1))
+        return false;
+
+    // two ranges, split at every line
+    splits[0] = 0;
+    for (i = 1; i < num_lines; ++i)
+    {
+        splits[1] = line_starts[i];
+        if (!check_lines_split(splits, 2))
+            return false;
+    }
+
+    // one range per line
+    if (!check_lines_split(line_starts, num_lines))
+        return false;
+
+    return true;
+}
+
+int main(
+    void)
+{
+    if (!test_text())
+        return -1;
+    if (!test_bgpdump())
+        return -1;
+    if (!test_mrt())
+        return -1;
+    if (!test_lines())
+        return -1;
+
+    return 0;
+}
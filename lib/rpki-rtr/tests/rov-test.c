@@ -0,0 +1,350 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rpki-rtr/rov.h"
+#include "test/unittest.h"
+
+
+static bool add_vrp(
+    struct vrp_set *set,
+    as_number_t asn,
+    const char *prefix_str,
+    uint8_t max_length)
+{
+    struct vrp vrp;
+    uint8_t prefix[16];
+    size_t family_length;
+    uint8_t prefix_length;
+
+    return rov_parse_prefix(prefix_str, prefix, &family_length,
+                            &prefix_length) &&
+        vrp_init(&vrp, asn, prefix, family_length, prefix_length,
+                 max_length) &&
+        vrp_set_add(set, &vrp);
+}
+
+static enum rov_state validate(
+    const struct rov_table *table,
+    const char *prefix_str,
+    as_number_t origin)
+{
+    uint8_t prefix[16];
+    size_t family_length;
+    uint8_t prefix_length;
+
+    if (!rov_parse_prefix(prefix_str, prefix, &family_length,
+                          &prefix_length))
+    {
+        return (enum rov_state)-1;
+    }
+
+    return rov_validate(table, prefix, family_length, prefix_length,
+                        origin);
+}
+
+static bool test_parse(
+    void)
+{
+    uint8_t prefix[16];
+    size_t family_length;
+    uint8_t prefix_length;
+    static const uint8_t expected6[16] = {0x20, 0x01, 0x0d, 0xb8};
+
+    TEST_BOOL(rov_parse_prefix("192.0.2.0/24", prefix, &family_length,
+                               &prefix_length), true);
+    TEST(size_t, "%zu", family_length, ==, 4);
+    TEST(unsigned, "%u", (unsigned)prefix_length, ==, 24);
+    TEST(unsigned, "%u", (unsigned)prefix[0], ==, 192);
+    TEST(unsigned, "%u", (unsigned)prefix[2], ==, 2);
+
+    TEST_BOOL(rov_parse_prefix("2001:db8::/32", prefix, &family_length,
+                               &prefix_length), true);
+    TEST(size_t, "%zu", family_length, ==, 16);
+    TEST(unsigned, "%u", (unsigned)prefix_length, ==, 32);
+    TEST_MEMCMP(prefix, ==, expected6, sizeof(expected6));
+
+    TEST_BOOL(rov_parse_prefix("0.0.0.0/0", prefix, &family_length,
+                               &prefix_length), true);
+    TEST_BOOL(rov_parse_prefix("::/128", prefix, &family_length,
+                               &prefix_length), true);
+
+    TEST_BOOL(rov_parse_prefix("192.0.2.0", prefix, &family_length,
+                               &prefix_length), false);
+    TEST_BOOL(rov_parse_prefix("192.0.2.0/33", prefix, &family_length,
+                               &prefix_length), false);
+    TEST_BOOL(rov_parse_prefix("192.0.2.0/", prefix, &family_length,
+                               &prefix_length), false);
+    TEST_BOOL(rov_parse_prefix("192.0.2.0/-1", prefix, &family_length,
+                               &prefix_length), false);
+    TEST_BOOL(rov_parse_prefix("192.0.2.0/24x", prefix, &family_length,
+                               &prefix_length), false);
+    TEST_BOOL(rov_parse_prefix("2001:db8::/129", prefix, &family_length,
+                               &prefix_length), false);
+    TEST_BOOL(rov_parse_prefix("example/8", prefix, &family_length,
+                               &prefix_length), false);
+
+    return true;
+}
+
+static bool test_validate(
+    void)
+{
+    struct vrp_set set;
+    struct rov_table table;
+
+    vrp_set_init(&set);
+
+    TEST_BOOL(add_vrp(&set, 64496, "192.0.2.0/24", 24), true);
+    TEST_BOOL(add_vrp(&set, 64497, "198.51.100.0/22", 24), true);
+    TEST_BOOL(add_vrp(&set, 64498, "198.51.100.0/24", 24), true);
+    TEST_BOOL(add_vrp(&set, 64498, "198.51.100.0/24", 24), true);
+    TEST_BOOL(add_vrp(&set, 0, "203.0.113.0/24", 32), true);
+    TEST_BOOL(add_vrp(&set, 64499, "10.0.0.0/8", 8), true);
+    TEST_BOOL(add_vrp(&set, 64500, "10.1.2.0/24", 32), true);
+    TEST_BOOL(add_vrp(&set, 64496, "2001:db8::/32", 48), true);
+    TEST_BOOL(add_vrp(&set, 64497, "2001:db8:1::/48", 128), true);
+
+    TEST_BOOL(rov_table_init(&table, set.vrps, set.len), true);
+    vrp_set_free(&set);
+
+    TEST(size_t, "%zu", rov_table_count(&table), ==, 8);
+
+    // RFC 6811 examples
+    TEST(int, "%d", validate(&table, "192.0.2.0/24", 64496), ==,
+         ROV_VALID);
+    TEST(int, "%d", validate(&table, "192.0.2.0/24", 64497), ==,
+         ROV_INVALID);
+    TEST(int, "%d", validate(&table, "192.0.2.0/25", 64496), ==,
+         ROV_INVALID);
+    TEST(int, "%d", validate(&table, "192.0.2.0/23", 64496), ==,
+         ROV_NOT_FOUND);
+
+    // more than one covering VRP
+    TEST(int, "%d", validate(&table, "198.51.101.0/24", 64497), ==,
+         ROV_VALID);
+    TEST(int, "%d", validate(&table, "198.51.100.0/24", 64497), ==,
+         ROV_VALID);
+    TEST(int, "%d", validate(&table, "198.51.100.0/24", 64498), ==,
+         ROV_VALID);
+    TEST(int, "%d", validate(&table, "198.51.101.0/24", 64498), ==,
+         ROV_INVALID);
+    TEST(int, "%d", validate(&table, "198.51.100.0/25", 64497), ==,
+         ROV_INVALID);
+
+    // AS 0 never matches
+    TEST(int, "%d", validate(&table, "203.0.113.0/24", 0), ==,
+         ROV_INVALID);
+    TEST(int, "%d", validate(&table, "203.0.113.128/25", 64496), ==,
+         ROV_INVALID);
+
+    // nested VRPs with different origins
+    TEST(int, "%d", validate(&table, "10.0.0.0/8", 64499), ==, ROV_VALID);
+    TEST(int, "%d", validate(&table, "10.1.2.128/25", 64500), ==,
+         ROV_VALID);
+    TEST(int, "%d", validate(&table, "10.1.2.128/25", 64499), ==,
+         ROV_INVALID);
+    TEST(int, "%d", validate(&table, "10.1.3.0/24", 64500), ==,
+         ROV_INVALID);
+
+    // IPv6 is separate from IPv4
+    TEST(int, "%d", validate(&table, "2001:db8:ff00::/40", 64496), ==,
+         ROV_VALID);
+    TEST(int, "%d", validate(&table, "2001:db8:ff00::/49", 64496), ==,
+         ROV_INVALID);
+    TEST(int, "%d", validate(&table, "2001:db8:1::1/128", 64497), ==,
+         ROV_VALID);
+    TEST(int, "%d", validate(&table, "2001:db8:1::1/128", 64496), ==,
+         ROV_INVALID);
+    TEST(int, "%d", validate(&table, "2001:db9::/32", 64496), ==,
+         ROV_NOT_FOUND);
+
+    rov_table_free(&table);
+
+    return true;
+}
+
+static bool test_default_route(
+    void)
+{
+    struct vrp_set set;
+    struct rov_table table;
+
+    vrp_set_init(&set);
+    TEST_BOOL(add_vrp(&set, 64501, "0.0.0.0/0", 0), true);
+    TEST_BOOL(add_vrp(&set, 64496, "192.0.2.0/24", 24), true);
+    TEST_BOOL(rov_table_init(&table, set.vrps, set.len), true);
+    vrp_set_free(&set);
+
+    // a VRP for the default route covers every IPv4 prefix
+    TEST(int, "%d", validate(&table, "0.0.0.0/0", 64501), ==, ROV_VALID);
+    TEST(int, "%d", validate(&table, "100.64.0.0/10", 64501), ==,
+         ROV_INVALID);
+    TEST(int, "%d", validate(&table, "192.0.2.0/24", 64496), ==,
+         ROV_VALID);
+    TEST(int, "%d", validate(&table, "192.0.2.0/23", 64496), ==,
+         ROV_INVALID);
+    TEST(int, "%d", validate(&table, "::/0", 64501), ==, ROV_NOT_FOUND);
+
+    rov_table_free(&table);
+
+    return true;
+}
+
+static bool test_empty(
+    void)
+{
+    struct rov_table table;
+
+    TEST_BOOL(rov_table_init(&table, NULL, 0), true);
+    TEST(size_t, "%zu", rov_table_count(&table), ==, 0);
+    TEST(int, "%d", validate(&table, "192.0.2.0/24", 64496), ==,
+         ROV_NOT_FOUND);
+    TEST(int, "%d", validate(&table, "2001:db8::/32", 64496), ==,
+         ROV_NOT_FOUND);
+    rov_table_free(&table);
+
+    return true;
+}
+
+/**
+   @brief Straightforward implementation of RFC 6811 to compare
+       rov_validate() against.
+*/
+static enum rov_state naive_validate(
+    const struct vrp_set *set,
+    const uint8_t *prefix,
+    size_t family_length,
+    uint8_t prefix_length,
+    as_number_t origin)
+{
+    enum rov_state state = ROV_NOT_FOUND;
+    const struct vrp *vrp;
+    size_t i;
+    size_t bit;
+    bool covers;
+
+    for (i = 0; i < set->len; ++i)
+    {
+        vrp = &set->vrps[i];
+        if (vrp->family_length != family_length ||
+            vrp->prefix_length > prefix_length)
+        {
+            continue;
+        }
+
+        covers = true;
+        for (bit = 0; bit < vrp->prefix_length; ++bit)
+        {
+            if (((prefix[bit / 8] ^ vrp->prefix[bit / 8]) &
+                 (0x80 >> (bit % 8))) != 0)
+            {
+                covers = false;
+                break;
+            }
+        }
+
+        if (!covers)
+        {
+            continue;
+        }
+
+        if (vrp->asn == origin && vrp->asn != 0 &&
+            prefix_length <= vrp->max_length)
+        {
+            return ROV_VALID;
+        }
+
+        state = ROV_INVALID;
+    }
+
+    return state;
+}
+
+static void random_prefix(
+    uint8_t *prefix,
+    size_t family_length,
+    uint8_t prefix_length)
+{
+    size_t i;
+
+    memset(prefix, 0, 16);
+
+    // keep the addresses close together so that VRPs overlap
+    prefix[0] = 10;
+    for (i = 1; i < family_length; ++i)
+    {
+        prefix[i] = i < 3 ? rand() % 4 : rand() % 256;
+    }
+
+    for (i = prefix_length; i < family_length * 8; ++i)
+    {
+        prefix[i / 8] &= ~(0x80 >> (i % 8));
+    }
+}
+
+static bool test_random(
+    void)
+{
+    struct vrp_set set;
+    struct rov_table table;
+    struct vrp vrp;
+    uint8_t prefix[16];
+    size_t family_length;
+    uint8_t prefix_length;
+    uint8_t max_length;
+    as_number_t origin;
+    size_t i;
+
+    srand(6811);
+    vrp_set_init(&set);
+
+    for (i = 0; i < 2000; ++i)
+    {
+        family_length = rand() % 2 ? 4 : 16;
+        prefix_length = 8 + rand() % 21;
+        max_length = prefix_length + rand() % 5;
+        random_prefix(prefix, family_length, prefix_length);
+        TEST_BOOL(vrp_init(&vrp, rand() % 8, prefix, family_length,
+                           prefix_length, max_length), true);
+        TEST_BOOL(vrp_set_add(&set, &vrp), true);
+    }
+
+    TEST_BOOL(rov_table_init(&table, set.vrps, set.len), true);
+
+    for (i = 0; i < 20000; ++i)
+    {
+        family_length = rand() % 2 ? 4 : 16;
+        prefix_length = 4 + rand() % 29;
+        origin = rand() % 8;
+        random_prefix(prefix, family_length, prefix_length);
+        TEST(int, "%d",
+             rov_validate(&table, prefix, family_length, prefix_length,
+                          origin), ==,
+             naive_validate(&set, prefix, family_length, prefix_length,
+                            origin));
+    }
+
+    rov_table_free(&table);
+    vrp_set_free(&set);
+
+    return true;
+}
+
+int main(
+    void)
+{
+    if (!test_parse())
+        return -1;
+    if (!test_validate())
+        return -1;
+    if (!test_default_route())
+        return -1;
+    if (!test_empty())
+        return -1;
+    if (!test_random())
+        return -1;
+
+    return 0;
+}
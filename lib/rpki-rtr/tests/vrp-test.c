@@ -0,0 +1,408 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "rpki-rtr/vrp.h"
+#include "test/unittest.h"
+
+
+static void make_vrp4(
+    struct vrp *vrp,
+    as_number_t asn,
+    uint8_t first_octet,
+    uint8_t prefix_length,
+    uint8_t max_length)
+{
+    uint8_t prefix[4] = {first_octet, 0, 0, 0};
+
+    vrp_init(vrp, asn, prefix, sizeof(prefix), prefix_length, max_length);
+}
+
+static void make_vrp6(
+    struct vrp *vrp,
+    as_number_t asn,
+    uint8_t first_octet,
+    uint8_t prefix_length,
+    uint8_t max_length)
+{
+    uint8_t prefix[16] = {first_octet};
+
+    vrp_init(vrp, asn, prefix, sizeof(prefix), prefix_length, max_length);
+}
+
+static bool test_init(
+    void)
+{
+    struct vrp vrp;
+    uint8_t prefix[16] = {10};
+
+    TEST_BOOL(vrp_init(&vrp, 1, prefix, 4, 8, 24), true);
+    TEST_BOOL(vrp_init(&vrp, 1, prefix, 16, 8, 128), true);
+    TEST_BOOL(vrp_init(&vrp, 1, prefix, 8, 8, 24), false);
+    TEST_BOOL(vrp_init(&vrp, 1, prefix, 4, 8, 33), false);
+    TEST_BOOL(vrp_init(&vrp, 1, prefix, 4, 24, 8), false);
+
+    return true;
+}
+
+static bool test_sort(
+    void)
+{
+    struct vrp_set set;
+    struct vrp vrp;
+    size_t i;
+
+    vrp_set_init(&set);
+
+    make_vrp6(&vrp, 1, 0x20, 16, 16);
+    TEST_BOOL(vrp_set_add(&set, &vrp), true);
+    make_vrp4(&vrp, 2, 10, 8, 8);
+    TEST_BOOL(vrp_set_add(&set, &vrp), true);
+    make_vrp4(&vrp, 1, 11, 8, 24);
+    TEST_BOOL(vrp_set_add(&set, &vrp), true);
+    make_vrp4(&vrp, 1, 11, 8, 16);
+    TEST_BOOL(vrp_set_add(&set, &vrp), true);
+    make_vrp4(&vrp, 2, 10, 8, 8);
+    TEST_BOOL(vrp_set_add(&set, &vrp), true);
+
+    vrp_set_sort(&set);
+
+    TEST(size_t, "%zu", set.len, ==, 4);
+    for (i = 1; i < set.len; ++i)
+    {
+        TEST(int, "%d", vrp_compare(&set.vrps[i - 1], &set.vrps[i]), <, 0);
+    }
+    TEST(unsigned, "%u", (unsigned)set.vrps[0].max_length, ==, 16);
+    TEST(unsigned, "%u", (unsigned)set.vrps[2].asn, ==, 2);
+    TEST(unsigned, "%u", (unsigned)set.vrps[3].family_length, ==, 16);
+
+    vrp_set_free(&set);
+
+    return true;
+}
+
+struct diff_counts {
+    size_t announcements;
+    size_t withdrawals;
+    as_number_t last_announced;
+    as_number_t last_withdrawn;
+};
+
+static bool count_change(
+    const struct vrp *vrp,
+    bool is_announce,
+    void *arg)
+{
+    struct diff_counts *counts = (struct diff_counts *)arg;
+
+    if (is_announce)
+    {
+        ++counts->announcements;
+        counts->last_announced = vrp->asn;
+    }
+    else
+    {
+        ++counts->withdrawals;
+        counts->last_withdrawn = vrp->asn;
+    }
+
+    return true;
+}
+
+static bool stop_change(
+    const struct vrp *vrp,
+    bool is_announce,
+    void *arg)
+{
+    (void)vrp;
+    (void)is_announce;
+    (void)arg;
+
+    return false;
+}
+
+static bool test_diff(
+    void)
+{
+    struct vrp_set old_set;
+    struct vrp_set new_set;
+    struct vrp vrp;
+    struct diff_counts counts = {0, 0, 0, 0};
+    as_number_t asn;
+
+    vrp_set_init(&old_set);
+    vrp_set_init(&new_set);
+
+    // old: AS 0-999, new: AS 500-1499
+    for (asn = 0; asn < 1500; ++asn)
+    {
+        make_vrp4(&vrp, asn, 10, 8, 24);
+        if (asn < 1000)
+        {
+            TEST_BOOL(vrp_set_add(&old_set, &vrp), true);
+        }
+        if (asn >= 500)
+        {
+            TEST_BOOL(vrp_set_add(&new_set, &vrp), true);
+        }
+    }
+    vrp_set_sort(&old_set);
+    vrp_set_sort(&new_set);
+
+    TEST_BOOL(vrp_diff(old_set.vrps, old_set.len, new_set.vrps,
+                       new_set.len, count_change, &counts), true);
+    TEST(size_t, "%zu", counts.announcements, ==, 500);
+    TEST(size_t, "%zu", counts.withdrawals, ==, 500);
+    TEST(unsigned, "%u", (unsigned)counts.last_announced, ==, 1499);
+    TEST(unsigned, "%u", (unsigned)counts.last_withdrawn, ==, 499);
+
+    memset(&counts, 0, sizeof(counts));
+    TEST_BOOL(vrp_diff(new_set.vrps, new_set.len, new_set.vrps,
+                       new_set.len, count_change, &counts), true);
+    TEST(size_t, "%zu", counts.announcements, ==, 0);
+    TEST(size_t, "%zu", counts.withdrawals, ==, 0);
+
+    memset(&counts, 0, sizeof(counts));
+    TEST_BOOL(vrp_diff(NULL, 0, new_set.vrps, new_set.len, count_change,
+                       &counts), true);
+    TEST(size_t, "%zu", counts.announcements, ==, 1000);
+
+    TEST_BOOL(vrp_diff(old_set.vrps, old_set.len, new_set.vrps,
+                       new_set.len, stop_change, NULL), false);
+
+    vrp_set_free(&old_set);
+    vrp_set_free(&new_set);
+
+    return true;
+}
+
+static bool add_vrp4(
+    struct vrp_set *set,
+    as_number_t asn,
+    uint8_t a,
+    uint8_t b,
+    uint8_t c,
+    uint8_t prefix_length,
+    uint8_t max_length)
+{
+    struct vrp vrp;
+    uint8_t prefix[4] = {a, b, c, 0};
+
+    return vrp_init(&vrp, asn, prefix, sizeof(prefix), prefix_length,
+                    max_length) && vrp_set_add(set, &vrp);
+}
+
+static bool test_minimize(
+    void)
+{
+    struct vrp_set set;
+    struct vrp_minimize_stats stats;
+    struct vrp vrp;
+
+    vrp_set_init(&set);
+
+    // implied by 10.0.0.0/22-24 AS 1
+    TEST_BOOL(add_vrp4(&set, 1, 10, 0, 0, 22, 24), true);
+    TEST_BOOL(add_vrp4(&set, 1, 10, 0, 0, 24, 24), true);
+    TEST_BOOL(add_vrp4(&set, 1, 10, 0, 3, 24, 24), true);
+
+    // not implied: longer max length, outside the /22, or another AS
+    TEST_BOOL(add_vrp4(&set, 1, 10, 0, 2, 23, 25), true);
+    TEST_BOOL(add_vrp4(&set, 1, 10, 0, 4, 24, 24), true);
+    TEST_BOOL(add_vrp4(&set, 2, 10, 0, 1, 24, 24), true);
+
+    // implied by 10.0.2.0/23-25 AS 1, even though the /22 isn't enough
+    TEST_BOOL(add_vrp4(&set, 1, 10, 0, 3, 25, 25), true);
+
+    // same prefix, only the largest max length is needed
+    TEST_BOOL(add_vrp4(&set, 3, 192, 168, 0, 16, 16), true);
+    TEST_BOOL(add_vrp4(&set, 3, 192, 168, 0, 16, 20), true);
+    TEST_BOOL(add_vrp4(&set, 3, 192, 168, 0, 16, 18), true);
+
+    // same prefix and AS in another family
+    make_vrp6(&vrp, 1, 0x20, 8, 8);
+    TEST_BOOL(vrp_set_add(&set, &vrp), true);
+    make_vrp6(&vrp, 1, 0x20, 16, 16);
+    TEST_BOOL(vrp_set_add(&set, &vrp), true);
+
+    vrp_set_sort(&set);
+    TEST(size_t, "%zu", set.len, ==, 12);
+
+    vrp_set_minimize(&set, &stats);
+    TEST(size_t, "%zu", stats.removed_ipv4, ==, 5);
+    TEST(size_t, "%zu", stats.removed_ipv6, ==, 0);
+    TEST(size_t, "%zu", set.len, ==, 7);
+
+    TEST(size_t, "%zu", (size_t)set.vrps[0].prefix_length, ==, 22);
+    TEST(size_t, "%zu", (size_t)set.vrps[1].prefix_length, ==, 23);
+    TEST(size_t, "%zu", (size_t)set.vrps[2].prefix[2], ==, 4);
+    TEST(as_number_t, "%" PRIu32, set.vrps[3].asn, ==, 2);
+    TEST(as_number_t, "%" PRIu32, set.vrps[4].asn, ==, 3);
+    TEST(size_t, "%zu", (size_t)set.vrps[4].max_length, ==, 20);
+    TEST(size_t, "%zu", (size_t)set.vrps[5].family_length, ==, 16);
+    TEST(size_t, "%zu", (size_t)set.vrps[6].family_length, ==, 16);
+
+    // minimizing again doesn't change anything
+    vrp_set_minimize(&set, &stats);
+    TEST(size_t, "%zu", stats.removed_ipv4 + stats.removed_ipv6, ==, 0);
+    TEST(size_t, "%zu", set.len, ==, 7);
+
+    vrp_set_free(&set);
+
+    return true;
+}
+
+static bool collect_delta(
+    const struct vrp *vrp,
+    bool is_announce,
+    void *arg)
+{
+    struct vrp_delta *delta = arg;
+
+    return vrp_set_add(
+        is_announce ? &delta->announcements : &delta->withdrawals, vrp);
+}
+
+static bool sets_equal(
+    const struct vrp_set *a,
+    const struct vrp_set *b)
+{
+    size_t i;
+
+    TEST(size_t, "%zu", a->len, ==, b->len);
+    for (i = 0; i < a->len; ++i)
+    {
+        TEST(int, "%d", vrp_compare(&a->vrps[i], &b->vrps[i]), ==, 0);
+    }
+
+    return true;
+}
+
+#define DELTA_UNIVERSE 64
+#define DELTA_STATES 20
+
+/**
+   Random subset of a fixed universe of VRPs.
+*/
+static bool make_state(
+    struct vrp_set *set)
+{
+    struct vrp vrp;
+    int i;
+
+    for (i = 0; i < DELTA_UNIVERSE; ++i)
+    {
+        if (rand() % 2)
+        {
+            continue;
+        }
+
+        if (i % 2)
+        {
+            make_vrp6(&vrp, i / 8, i % 8, 16, 32);
+        }
+        else
+        {
+            make_vrp4(&vrp, i / 8, i % 8, 8, 24);
+        }
+        TEST_BOOL(vrp_set_add(set, &vrp), true);
+    }
+    vrp_set_sort(set);
+
+    return true;
+}
+
+static bool test_delta(
+    void)
+{
+    struct vrp_set states[DELTA_STATES];
+    struct vrp_delta step;
+    struct vrp_delta net;
+    struct vrp_delta squashed;
+    struct vrp_delta expected;
+    struct diff_counts counts = {0, 0, 0, 0};
+    size_t i;
+
+    srand(1);
+
+    vrp_delta_init(&step);
+    vrp_delta_init(&net);
+    vrp_delta_init(&squashed);
+    vrp_delta_init(&expected);
+
+    for (i = 0; i < DELTA_STATES; ++i)
+    {
+        vrp_set_init(&states[i]);
+        if (!make_state(&states[i]))
+            return false;
+    }
+
+    // squashing every step gives the same result as diffing the first
+    // and last states
+    for (i = 1; i < DELTA_STATES; ++i)
+    {
+        vrp_delta_free(&step);
+        TEST_BOOL(vrp_diff(states[i - 1].vrps, states[i - 1].len,
+                           states[i].vrps, states[i].len, collect_delta,
+                           &step), true);
+        TEST_BOOL(vrp_delta_squash(&net, &step, &squashed), true);
+
+        // swap, so net is the result and squashed can be reused
+        vrp_delta_free(&net);
+        net = squashed;
+        vrp_delta_init(&squashed);
+
+        vrp_delta_free(&expected);
+        TEST_BOOL(vrp_diff(states[0].vrps, states[0].len,
+                           states[i].vrps, states[i].len, collect_delta,
+                           &expected), true);
+        if (!sets_equal(&net.announcements, &expected.announcements) ||
+            !sets_equal(&net.withdrawals, &expected.withdrawals))
+            return false;
+    }
+    TEST_BOOL(net.announcements.len + net.withdrawals.len > 0, true);
+
+    // iterating interleaves announcements and withdrawals in order
+    TEST_BOOL(vrp_delta_for_each(&net, count_change, &counts), true);
+    TEST(size_t, "%zu", counts.announcements, ==, net.announcements.len);
+    TEST(size_t, "%zu", counts.withdrawals, ==, net.withdrawals.len);
+    TEST_BOOL(vrp_delta_for_each(&net, stop_change, NULL), false);
+
+    // a delta followed by its inverse cancels out
+    vrp_delta_free(&step);
+    TEST_BOOL(vrp_delta_for_each(&net, collect_delta, &step), true);
+    vrp_delta_invert(&step);
+    TEST(size_t, "%zu", step.announcements.len, ==, counts.withdrawals);
+    TEST(size_t, "%zu", step.withdrawals.len, ==, counts.announcements);
+    TEST_BOOL(vrp_delta_squash(&net, &step, &squashed), true);
+    TEST(size_t, "%zu", squashed.announcements.len, ==, 0);
+    TEST(size_t, "%zu", squashed.withdrawals.len, ==, 0);
+
+    for (i = 0; i < DELTA_STATES; ++i)
+    {
+        vrp_set_free(&states[i]);
+    }
+    vrp_delta_free(&step);
+    vrp_delta_free(&net);
+    vrp_delta_free(&squashed);
+    vrp_delta_free(&expected);
+
+    return true;
+}
+
+int main(
+    void)
+{
+    if (!test_init())
+        return -1;
+    if (!test_sort())
+        return -1;
+    if (!test_diff())
+        return -1;
+    if (!test_minimize())
+        return -1;
+    if (!test_delta())
+        return -1;
+    return 0;
+}
@@ -0,0 +1,242 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rpki-rtr/vrp_file.h"
+#include "test/unittest.h"
+
+
+static bool make_vrps(
+    struct vrp_set *set,
+    as_number_t first_asn,
+    as_number_t last_asn)
+{
+    struct vrp vrp;
+    uint8_t prefix[16] = {10, 1};
+    as_number_t asn;
+
+    for (asn = first_asn; asn <= last_asn; ++asn)
+    {
+        TEST_BOOL(vrp_init(&vrp, asn, prefix, 4, 16, 24), true);
+        TEST_BOOL(vrp_set_add(set, &vrp), true);
+        TEST_BOOL(vrp_init(&vrp, asn, prefix, 16, 32, 48), true);
+        TEST_BOOL(vrp_set_add(set, &vrp), true);
+    }
+    vrp_set_sort(set);
+
+    return true;
+}
+
+static bool test_snapshot(
+    const char *path)
+{
+    struct vrp_set set;
+    struct vrp_file file;
+    struct vrp vrp;
+    bool is_announce;
+    size_t i;
+
+    vrp_set_init(&set);
+    if (!make_vrps(&set, 1, 100))
+        return false;
+
+    TEST_BOOL(vrp_file_write_snapshot(path, 42, 1234, set.vrps, set.len),
+              true);
+    TEST_BOOL(vrp_file_open(&file, path), true);
+
+    TEST(int, "%d", (int)file.type, ==, (int)VRP_FILE_SNAPSHOT);
+    TEST(unsigned, "%u", (unsigned)file.session, ==, 42);
+    TEST(unsigned, "%u", (unsigned)file.serial, ==, 1234);
+    TEST(size_t, "%zu", file.ipv4_count, ==, 100);
+    TEST(size_t, "%zu", file.ipv6_count, ==, 100);
+    TEST(size_t, "%zu", vrp_file_count(&file), ==, set.len);
+
+    for (i = 0; i < set.len; ++i)
+    {
+        vrp_file_get(&file, i, &vrp, &is_announce);
+        TEST_BOOL(is_announce, true);
+        TEST(int, "%d", vrp_compare(&vrp, &set.vrps[i]), ==, 0);
+    }
+
+    vrp_file_close(&file);
+
+    // empty snapshot
+    TEST_BOOL(vrp_file_write_snapshot(path, 42, 1235, NULL, 0), true);
+    TEST_BOOL(vrp_file_open(&file, path), true);
+    TEST(size_t, "%zu", vrp_file_count(&file), ==, 0);
+    vrp_file_close(&file);
+
+    vrp_set_free(&set);
+
+    return true;
+}
+
+static bool test_delta(
+    const char *path)
+{
+    struct vrp_set announcements;
+    struct vrp_set withdrawals;
+    struct vrp_file file;
+    struct vrp vrp;
+    struct vrp previous;
+    bool is_announce;
+    size_t num_announcements = 0;
+    size_t i;
+
+    vrp_set_init(&announcements);
+    vrp_set_init(&withdrawals);
+    if (!make_vrps(&announcements, 1, 10) ||
+        !make_vrps(&withdrawals, 11, 15))
+        return false;
+
+    TEST_BOOL(vrp_file_write_delta(path, 42, 1235, 1234,
+                                   announcements.vrps, announcements.len,
+                                   withdrawals.vrps, withdrawals.len),
+              true);
+    TEST_BOOL(vrp_file_open(&file, path), true);
+
+    TEST(int, "%d", (int)file.type, ==, (int)VRP_FILE_DELTA);
+    TEST(unsigned, "%u", (unsigned)file.serial, ==, 1235);
+    TEST(unsigned, "%u", (unsigned)file.previous_serial, ==, 1234);
+    TEST(size_t, "%zu", file.ipv4_count, ==, 15);
+    TEST(size_t, "%zu", file.ipv6_count, ==, 15);
+
+    for (i = 0; i < vrp_file_count(&file); ++i)
+    {
+        vrp_file_get(&file, i, &vrp, &is_announce);
+        if (i > 0)
+        {
+            TEST(int, "%d", vrp_compare(&previous, &vrp), <, 0);
+        }
+        TEST_BOOL(is_announce, vrp.asn <= 10);
+        if (is_announce)
+        {
+            ++num_announcements;
+        }
+        previous = vrp;
+    }
+    TEST(size_t, "%zu", num_announcements, ==, announcements.len);
+
+    vrp_file_close(&file);
+
+    vrp_set_free(&announcements);
+    vrp_set_free(&withdrawals);
+
+    return true;
+}
+
+static bool read_file(
+    const char *path,
+    uint8_t *buf,
+    size_t buf_len,
+    size_t *len)
+{
+    FILE *fp = fopen(path, "rb");
+
+    TEST_BOOL(fp != NULL, true);
+    *len = fread(buf, 1, buf_len, fp);
+    fclose(fp);
+
+    return true;
+}
+
+static bool test_stream(
+    const char *path)
+{
+    struct vrp_set set;
+    struct vrp_file_writer writer;
+    static uint8_t expected[VRP_FILE_HEADER_LENGTH +
+                            100 * VRP_FILE_IPV4_RECORD_LENGTH +
+                            100 * VRP_FILE_IPV6_RECORD_LENGTH];
+    static uint8_t actual[sizeof(expected) + 1];
+    size_t expected_len;
+    size_t actual_len;
+    size_t i;
+
+    vrp_set_init(&set);
+    if (!make_vrps(&set, 1, 100))
+        return false;
+
+    // a streamed snapshot is identical to one written all at once
+    TEST_BOOL(vrp_file_write_snapshot(path, 42, 1234, set.vrps, set.len),
+              true);
+    if (!read_file(path, expected, sizeof(expected), &expected_len))
+        return false;
+    TEST(size_t, "%zu", expected_len, ==, sizeof(expected));
+
+    TEST_BOOL(vrp_file_stream_open(&writer, path, 42, 1234), true);
+    for (i = 0; i < set.len; ++i)
+    {
+        TEST_BOOL(vrp_file_stream_add(&writer, &set.vrps[i]), true);
+    }
+    TEST_BOOL(vrp_file_stream_close(&writer, true), true);
+    if (!read_file(path, actual, sizeof(actual), &actual_len))
+        return false;
+    TEST(size_t, "%zu", actual_len, ==, expected_len);
+    TEST_MEMCMP(actual, ==, expected, expected_len);
+
+    // out of order, the existing file is left alone
+    TEST_BOOL(vrp_file_stream_open(&writer, path, 42, 1235), true);
+    TEST_BOOL(vrp_file_stream_add(&writer, &set.vrps[1]), true);
+    TEST_BOOL(vrp_file_stream_add(&writer, &set.vrps[0]), false);
+    TEST_BOOL(vrp_file_stream_close(&writer, false), false);
+    if (!read_file(path, actual, sizeof(actual), &actual_len))
+        return false;
+    TEST(size_t, "%zu", actual_len, ==, expected_len);
+    TEST_MEMCMP(actual, ==, expected, expected_len);
+
+    vrp_set_free(&set);
+
+    return true;
+}
+
+static bool test_corrupt(
+    const char *path)
+{
+    struct vrp_file file;
+    FILE *fp;
+    int c;
+
+    // flip one bit in the last record
+    fp = fopen(path, "r+b");
+    TEST_BOOL(fp != NULL, true);
+    TEST(int, "%d", fseek(fp, -1, SEEK_END), ==, 0);
+    c = fgetc(fp);
+    TEST(int, "%d", fseek(fp, -1, SEEK_END), ==, 0);
+    fputc(c ^ 1, fp);
+    fclose(fp);
+
+    TEST_BOOL(vrp_file_open(&file, path), false);
+
+    // truncate the last record
+    TEST(int, "%d", truncate(path, VRP_FILE_HEADER_LENGTH + 1), ==, 0);
+    TEST_BOOL(vrp_file_open(&file, path), false);
+
+    return true;
+}
+
+int main(
+    void)
+{
+    char dir[] = "/tmp/vrp_file-test.XXXXXX";
+    char path[sizeof(dir) + 32];
+    bool ok;
+
+    if (mkdtemp(dir) == NULL)
+    {
+        perror("mkdtemp");
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/test", dir);
+
+    ok = test_snapshot(path) && test_delta(path) && test_stream(path) &&
+        test_corrupt(path);
+
+    unlink(path);
+    rmdir(dir);
+
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,535 @@
+#include "vrp.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+bool vrp_init(
+    struct vrp *vrp,
+    as_number_t asn,
+    const uint8_t *prefix,
+    size_t family_length,
+    uint8_t prefix_length,
+    uint8_t max_length)
+{
+    if (family_length != 4 && family_length != 16)
+    {
+        return false;
+    }
+
+    if (prefix_length > family_length * 8 ||
+        max_length > family_length * 8 ||
+        prefix_length > max_length)
+    {
+        return false;
+    }
+
+    memset(vrp, 0, sizeof(*vrp));
+    vrp->asn = asn;
+    vrp->family_length = family_length;
+    vrp->prefix_length = prefix_length;
+    vrp->max_length = max_length;
+    memcpy(vrp->prefix, prefix, family_length);
+
+    return true;
+}
+
+
+int vrp_compare(
+    const struct vrp *a,
+    const struct vrp *b)
+{
+    int ret;
+
+    if (a->family_length != b->family_length)
+    {
+        return a->family_length < b->family_length ? -1 : 1;
+    }
+
+    if (a->asn != b->asn)
+    {
+        return a->asn < b->asn ? -1 : 1;
+    }
+
+    ret = memcmp(a->prefix, b->prefix, a->family_length);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    if (a->prefix_length != b->prefix_length)
+    {
+        return a->prefix_length < b->prefix_length ? -1 : 1;
+    }
+
+    if (a->max_length != b->max_length)
+    {
+        return a->max_length < b->max_length ? -1 : 1;
+    }
+
+    return 0;
+}
+
+
+static int vrp_qsort_compare(
+    const void *a,
+    const void *b)
+{
+    return vrp_compare((const struct vrp *)a, (const struct vrp *)b);
+}
+
+
+void vrp_set_init(
+    struct vrp_set *set)
+{
+    set->vrps = NULL;
+    set->len = 0;
+    set->capacity = 0;
+}
+
+
+void vrp_set_free(
+    struct vrp_set *set)
+{
+    free(set->vrps);
+    vrp_set_init(set);
+}
+
+
+bool vrp_set_add(
+    struct vrp_set *set,
+    const struct vrp *vrp)
+{
+    if (set->len == set->capacity)
+    {
+        size_t new_capacity = set->capacity ? set->capacity * 2 : 1024;
+        struct vrp *new_vrps;
+
+        if (new_capacity < set->capacity ||
+            new_capacity > SIZE_MAX / sizeof(struct vrp))
+        {
+            return false;
+        }
+
+        new_vrps = realloc(set->vrps, new_capacity * sizeof(struct vrp));
+        if (new_vrps == NULL)
+        {
+            return false;
+        }
+
+        set->vrps = new_vrps;
+        set->capacity = new_capacity;
+    }
+
+    set->vrps[set->len++] = *vrp;
+
+    return true;
+}
+
+
+void vrp_set_sort(
+    struct vrp_set *set)
+{
+    size_t in;
+    size_t out;
+
+    if (set->len == 0)
+    {
+        return;
+    }
+
+    qsort(set->vrps, set->len, sizeof(struct vrp), vrp_qsort_compare);
+
+    for (in = 1, out = 1; in < set->len; ++in)
+    {
+        if (vrp_compare(&set->vrps[out - 1], &set->vrps[in]) != 0)
+        {
+            set->vrps[out++] = set->vrps[in];
+        }
+    }
+
+    set->len = out;
+}
+
+
+/** Whether @p outer and @p inner have the same address family and AS. */
+static bool same_family_and_asn(
+    const struct vrp *outer,
+    const struct vrp *inner)
+{
+    return outer->family_length == inner->family_length &&
+        outer->asn == inner->asn;
+}
+
+/**
+    Whether @p outer's prefix covers @p inner's prefix. Both must have
+    the same address family.
+*/
+static bool prefix_covers(
+    const struct vrp *outer,
+    const struct vrp *inner)
+{
+    size_t full_bytes = outer->prefix_length / 8;
+    unsigned int extra_bits = outer->prefix_length % 8;
+    uint8_t mask;
+
+    if (outer->prefix_length > inner->prefix_length)
+    {
+        return false;
+    }
+
+    if (memcmp(outer->prefix, inner->prefix, full_bytes) != 0)
+    {
+        return false;
+    }
+
+    if (extra_bits == 0)
+    {
+        return true;
+    }
+
+    mask = (uint8_t)(0xff << (8 - extra_bits));
+    return (outer->prefix[full_bytes] & mask) ==
+        (inner->prefix[full_bytes] & mask);
+}
+
+void vrp_set_minimize(
+    struct vrp_set *set,
+    struct vrp_minimize_stats *stats)
+{
+    /*
+     * In vrp_compare() order, a prefix comes right before the prefixes
+     * it covers, so the VRPs with the same family and AS are a preorder
+     * walk of a prefix tree. The stack holds the kept VRPs that cover
+     * the current one, innermost last, along with the largest max
+     * length of any of them. Since each prefix length can only appear
+     * once on the stack, it never holds more than 129 entries.
+     */
+    struct {
+        size_t index;           // into the output part of set->vrps
+        uint8_t max_length;     // largest max length from the bottom up
+    } stack[129];
+    size_t depth = 0;
+    size_t in;
+    size_t out = 0;
+    const struct vrp *vrp;
+    bool redundant;
+
+    if (stats != NULL)
+    {
+        stats->removed_ipv4 = 0;
+        stats->removed_ipv6 = 0;
+    }
+
+    for (in = 0; in < set->len; ++in)
+    {
+        vrp = &set->vrps[in];
+
+        while (depth > 0 &&
+               (!same_family_and_asn(&set->vrps[stack[depth - 1].index],
+                                     vrp) ||
+                !prefix_covers(&set->vrps[stack[depth - 1].index], vrp)))
+        {
+            --depth;
+        }
+
+        if (depth > 0 && stack[depth - 1].max_length >= vrp->max_length)
+        {
+            redundant = true;
+        }
+        else if (in + 1 < set->len &&
+                 same_family_and_asn(vrp, &set->vrps[in + 1]) &&
+                 vrp->prefix_length == set->vrps[in + 1].prefix_length &&
+                 memcmp(vrp->prefix, set->vrps[in + 1].prefix,
+                        vrp->family_length) == 0)
+        {
+            // The next VRP only differs by having a larger max length.
+            redundant = true;
+        }
+        else
+        {
+            redundant = false;
+        }
+
+        if (redundant)
+        {
+            if (stats != NULL)
+            {
+                if (vrp->family_length == 4)
+                {
+                    ++stats->removed_ipv4;
+                }
+                else
+                {
+                    ++stats->removed_ipv6;
+                }
+            }
+            continue;
+        }
+
+        set->vrps[out] = *vrp;
+
+        stack[depth].index = out;
+        stack[depth].max_length = vrp->max_length;
+        if (depth > 0 && stack[depth - 1].max_length > vrp->max_length)
+        {
+            stack[depth].max_length = stack[depth - 1].max_length;
+        }
+        ++depth;
+
+        ++out;
+    }
+
+    set->len = out;
+}
+
+
+bool vrp_diff(
+    const struct vrp *old_vrps,
+    size_t old_len,
+    const struct vrp *new_vrps,
+    size_t new_len,
+    vrp_diff_callback callback,
+    void *arg)
+{
+    size_t old_i = 0;
+    size_t new_i = 0;
+    int cmp;
+
+    while (old_i < old_len || new_i < new_len)
+    {
+        if (old_i == old_len)
+        {
+            cmp = 1;
+        }
+        else if (new_i == new_len)
+        {
+            cmp = -1;
+        }
+        else
+        {
+            cmp = vrp_compare(&old_vrps[old_i], &new_vrps[new_i]);
+        }
+
+        if (cmp < 0)
+        {
+            if (!callback(&old_vrps[old_i++], false, arg))
+            {
+                return false;
+            }
+        }
+        else if (cmp > 0)
+        {
+            if (!callback(&new_vrps[new_i++], true, arg))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            ++old_i;
+            ++new_i;
+        }
+    }
+
+    return true;
+}
+
+
+void vrp_delta_init(
+    struct vrp_delta *delta)
+{
+    vrp_set_init(&delta->announcements);
+    vrp_set_init(&delta->withdrawals);
+}
+
+
+void vrp_delta_free(
+    struct vrp_delta *delta)
+{
+    vrp_set_free(&delta->announcements);
+    vrp_set_free(&delta->withdrawals);
+}
+
+
+void vrp_delta_invert(
+    struct vrp_delta *delta)
+{
+    struct vrp_set tmp = delta->announcements;
+
+    delta->announcements = delta->withdrawals;
+    delta->withdrawals = tmp;
+}
+
+
+/**
+   @brief Iterator over the changes in a struct vrp_delta, in
+       vrp_compare() order.
+*/
+struct delta_iter {
+    const struct vrp_delta *delta;
+    size_t announcement;
+    size_t withdrawal;
+};
+
+static void delta_iter_init(
+    struct delta_iter *iter,
+    const struct vrp_delta *delta)
+{
+    iter->delta = delta;
+    iter->announcement = 0;
+    iter->withdrawal = 0;
+}
+
+/**
+   @brief Get the next change without advancing.
+
+   @return The VRP, or NULL if there are no more changes.
+*/
+static const struct vrp *delta_iter_peek(
+    const struct delta_iter *iter,
+    bool *is_announce)
+{
+    const struct vrp_set *announcements = &iter->delta->announcements;
+    const struct vrp_set *withdrawals = &iter->delta->withdrawals;
+
+    if (iter->announcement < announcements->len &&
+        (iter->withdrawal == withdrawals->len ||
+         vrp_compare(&announcements->vrps[iter->announcement],
+                     &withdrawals->vrps[iter->withdrawal]) < 0))
+    {
+        *is_announce = true;
+        return &announcements->vrps[iter->announcement];
+    }
+    else if (iter->withdrawal < withdrawals->len)
+    {
+        *is_announce = false;
+        return &withdrawals->vrps[iter->withdrawal];
+    }
+
+    return NULL;
+}
+
+static void delta_iter_next(
+    struct delta_iter *iter,
+    bool is_announce)
+{
+    if (is_announce)
+    {
+        ++iter->announcement;
+    }
+    else
+    {
+        ++iter->withdrawal;
+    }
+}
+
+
+bool vrp_delta_for_each(
+    const struct vrp_delta *delta,
+    vrp_diff_callback callback,
+    void *arg)
+{
+    struct delta_iter iter;
+    const struct vrp *vrp;
+    bool is_announce;
+
+    delta_iter_init(&iter, delta);
+
+    while ((vrp = delta_iter_peek(&iter, &is_announce)) != NULL)
+    {
+        if (!callback(vrp, is_announce, arg))
+        {
+            return false;
+        }
+        delta_iter_next(&iter, is_announce);
+    }
+
+    return true;
+}
+
+
+static bool delta_add(
+    struct vrp_delta *delta,
+    const struct vrp *vrp,
+    bool is_announce)
+{
+    return vrp_set_add(
+        is_announce ? &delta->announcements : &delta->withdrawals, vrp);
+}
+
+
+bool vrp_delta_squash(
+    const struct vrp_delta *first,
+    const struct vrp_delta *second,
+    struct vrp_delta *result)
+{
+    struct delta_iter first_iter;
+    struct delta_iter second_iter;
+    const struct vrp *first_vrp;
+    const struct vrp *second_vrp;
+    bool first_is_announce;
+    bool second_is_announce;
+    int cmp;
+
+    vrp_delta_free(result);
+
+    delta_iter_init(&first_iter, first);
+    delta_iter_init(&second_iter, second);
+
+    for (;;)
+    {
+        first_vrp = delta_iter_peek(&first_iter, &first_is_announce);
+        second_vrp = delta_iter_peek(&second_iter, &second_is_announce);
+
+        if (first_vrp == NULL && second_vrp == NULL)
+        {
+            break;
+        }
+        else if (first_vrp == NULL)
+        {
+            cmp = 1;
+        }
+        else if (second_vrp == NULL)
+        {
+            cmp = -1;
+        }
+        else
+        {
+            cmp = vrp_compare(first_vrp, second_vrp);
+        }
+
+        if (cmp < 0)
+        {
+            if (!delta_add(result, first_vrp, first_is_announce))
+            {
+                return false;
+            }
+            delta_iter_next(&first_iter, first_is_announce);
+        }
+        else if (cmp > 0)
+        {
+            if (!delta_add(result, second_vrp, second_is_announce))
+            {
+                return false;
+            }
+            delta_iter_next(&second_iter, second_is_announce);
+        }
+        else
+        {
+            // Announcing and then withdrawing, or the other way
+            // around, leaves the VRP as it was. Doing the same thing
+            // twice can't happen with consistent deltas, but it's
+            // still the same as doing it once.
+            if (first_is_announce == second_is_announce &&
+                !delta_add(result, first_vrp, first_is_announce))
+            {
+                return false;
+            }
+            delta_iter_next(&first_iter, first_is_announce);
+            delta_iter_next(&second_iter, second_is_announce);
+        }
+    }
+
+    return true;
+}
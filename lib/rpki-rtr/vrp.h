@@ -0,0 +1,219 @@
+#ifndef _RTR_VRP_H
+#define _RTR_VRP_H
+
+/**
+   In-memory sets of Validated ROA Payloads (VRPs) and the merge used
+   to compute the changes between two of them.
+*/
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "rpki-rtr/pdu.h"
+
+
+/**
+   @brief A single (prefix, max length, origin AS) tuple.
+
+   All values are in host byte order, except for #prefix which is in
+   network byte order, exactly as stored in the database.
+*/
+struct vrp {
+    as_number_t asn;
+
+    /**
+        @brief Length of #prefix in bytes, either 4 for IPv4 or 16 for
+            IPv6.
+    */
+    uint8_t family_length;
+
+    uint8_t prefix_length;
+
+    uint8_t max_length;
+
+    uint8_t reserved;
+
+    /**
+        @brief The prefix. Only the first #family_length bytes are
+            significant, the rest must be zero.
+    */
+    uint8_t prefix[16];
+};
+
+
+/**
+   @brief Fill in a VRP from database-style values.
+
+   @return True on success, false if the values don't describe a
+       valid VRP.
+*/
+bool vrp_init(
+    struct vrp *vrp,
+    as_number_t asn,
+    const uint8_t *prefix,
+    size_t family_length,
+    uint8_t prefix_length,
+    uint8_t max_length);
+
+/**
+   @brief Total order on VRPs: address family (IPv4 first), then
+       origin AS, prefix, prefix length, and max length.
+
+   Within an address family, this is the same order that the rtr
+   queries use (asn, prefix, prefix_length, prefix_max_length).
+
+   @return Negative, zero, or positive like strcmp().
+*/
+int vrp_compare(
+    const struct vrp *a,
+    const struct vrp *b);
+
+
+/**
+   @brief Growable array of VRPs.
+*/
+struct vrp_set {
+    struct vrp *vrps;
+    size_t len;
+    size_t capacity;
+};
+
+void vrp_set_init(
+    struct vrp_set *set);
+
+void vrp_set_free(
+    struct vrp_set *set);
+
+/**
+   @brief Append a copy of @p vrp to @p set.
+
+   @return True on success, false on allocation failure.
+*/
+bool vrp_set_add(
+    struct vrp_set *set,
+    const struct vrp *vrp);
+
+/**
+   @brief Sort @p set with vrp_compare() and remove duplicates.
+
+   The same VRP can appear in more than one ROA, but it must only be
+   announced once.
+*/
+void vrp_set_sort(
+    struct vrp_set *set);
+
+
+/**
+   @brief Counts of VRPs removed by vrp_set_minimize().
+*/
+struct vrp_minimize_stats {
+    size_t removed_ipv4;
+    size_t removed_ipv6;
+};
+
+/**
+   @brief Remove every VRP that's implied by another VRP in @p set.
+
+   A VRP is implied by another one with the same origin AS whose prefix
+   covers its prefix and whose max length is at least its max length:
+   every route that matches the first VRP also matches the second, so
+   removing the first doesn't change the validation state of any
+   route. For example, 10.0.0.0/24-24 AS 1 is implied by
+   10.0.0.0/22-24 AS 1.
+
+   @p set must be sorted by vrp_set_sort(), and it stays sorted. This
+   takes time linear in the size of @p set and allocates nothing.
+
+   @param stats If not NULL, filled in with the number of VRPs removed.
+*/
+void vrp_set_minimize(
+    struct vrp_set *set,
+    struct vrp_minimize_stats *stats);
+
+
+/**
+   @brief Callback for vrp_diff().
+
+   @param vrp The VRP that changed.
+   @param is_announce True if @p vrp is in the new set only, false if
+       it is in the old set only.
+   @param arg Caller-supplied argument.
+   @return True to continue, false to stop the diff.
+*/
+typedef bool (*vrp_diff_callback)(
+    const struct vrp *vrp,
+    bool is_announce,
+    void *arg);
+
+/**
+   @brief Merge two sorted, duplicate-free arrays of VRPs and call
+       @p callback for every VRP that is in exactly one of them.
+
+   Both arrays must be sorted with vrp_compare(), e.g. by
+   vrp_set_sort(). Changes are reported in vrp_compare() order. This
+   takes time linear in @p old_len + @p new_len and allocates nothing.
+
+   @return True if every callback returned true, false otherwise.
+*/
+bool vrp_diff(
+    const struct vrp *old_vrps,
+    size_t old_len,
+    const struct vrp *new_vrps,
+    size_t new_len,
+    vrp_diff_callback callback,
+    void *arg);
+
+
+/**
+   @brief Changes from one set of VRPs to another, e.g. the contents of
+       rtr_incremental for one serial number.
+
+   Both sets are sorted by vrp_compare(), without duplicates, and
+   disjoint.
+*/
+struct vrp_delta {
+    struct vrp_set announcements;
+    struct vrp_set withdrawals;
+};
+
+void vrp_delta_init(
+    struct vrp_delta *delta);
+
+void vrp_delta_free(
+    struct vrp_delta *delta);
+
+/**
+   @brief Turn the changes from A to B into the changes from B to A.
+*/
+void vrp_delta_invert(
+    struct vrp_delta *delta);
+
+/**
+   @brief Call @p callback for every announcement and withdrawal in
+       @p delta, in vrp_compare() order.
+
+   @return True if every callback returned true, false otherwise.
+*/
+bool vrp_delta_for_each(
+    const struct vrp_delta *delta,
+    vrp_diff_callback callback,
+    void *arg);
+
+/**
+   @brief Compute the net changes of applying @p first and then
+       @p second.
+
+   A VRP that one delta announces and the other withdraws cancels out.
+   This takes time linear in the total size of both deltas.
+
+   @param result Initialized by vrp_delta_init(). Anything already in
+       it is freed. It must not be @p first or @p second.
+   @return True on success, false on allocation failure.
+*/
+bool vrp_delta_squash(
+    const struct vrp_delta *first,
+    const struct vrp_delta *second,
+    struct vrp_delta *result);
+
+#endif
@@ -0,0 +1,728 @@
+#include "vrp_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "util/logging.h"
+
+
+#define HEADER_OFFSET_MAGIC 0
+#define HEADER_OFFSET_VERSION 8
+#define HEADER_OFFSET_HEADER_LENGTH 10
+#define HEADER_OFFSET_SESSION 12
+#define HEADER_OFFSET_SERIAL 16
+#define HEADER_OFFSET_PREVIOUS_SERIAL 20
+#define HEADER_OFFSET_IPV4_COUNT 24
+#define HEADER_OFFSET_IPV6_COUNT 32
+#define HEADER_OFFSET_CHECKSUM 40
+
+#define RECORD_OFFSET_ASN 0
+#define RECORD_OFFSET_PREFIX 4
+
+
+/*****
+ * CRC-32 (the one used by Ethernet, gzip, and PNG)
+ *****/
+
+static uint32_t crc32_table[256];
+
+static pthread_once_t crc32_table_once = PTHREAD_ONCE_INIT;
+
+static void crc32_table_init(
+    void)
+{
+    uint32_t i;
+    uint32_t crc;
+    int bit;
+
+    for (i = 0; i < 256; ++i)
+    {
+        crc = i;
+        for (bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+        crc32_table[i] = crc;
+    }
+}
+
+/**
+   @brief Continue a CRC-32 computation. Start with a @p crc of zero.
+*/
+static uint32_t crc32_update(
+    uint32_t crc,
+    const void *buf,
+    size_t len)
+{
+    const uint8_t *p = buf;
+
+    pthread_once(&crc32_table_once, crc32_table_init);
+
+    crc = ~crc;
+    while (len-- > 0)
+    {
+        crc = crc32_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+
+/*****
+ * Byte order helpers
+ *****/
+
+static void put_uint16(
+    uint8_t *buf,
+    uint16_t value)
+{
+    buf[0] = value >> 8;
+    buf[1] = value;
+}
+
+static void put_uint32(
+    uint8_t *buf,
+    uint32_t value)
+{
+    buf[0] = value >> 24;
+    buf[1] = value >> 16;
+    buf[2] = value >> 8;
+    buf[3] = value;
+}
+
+static void put_uint64(
+    uint8_t *buf,
+    uint64_t value)
+{
+    put_uint32(buf, value >> 32);
+    put_uint32(buf + 4, value);
+}
+
+static uint16_t get_uint16(
+    const uint8_t *buf)
+{
+    return ((uint16_t)buf[0] << 8) | buf[1];
+}
+
+static uint32_t get_uint32(
+    const uint8_t *buf)
+{
+    return ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) |
+        ((uint32_t)buf[2] << 8) | buf[3];
+}
+
+static uint64_t get_uint64(
+    const uint8_t *buf)
+{
+    return ((uint64_t)get_uint32(buf) << 32) | get_uint32(buf + 4);
+}
+
+
+bool vrp_file_path(
+    char *buf,
+    size_t buf_len,
+    const char *dir,
+    enum vrp_file_type type,
+    serial_number_t serial)
+{
+    int ret = snprintf(buf, buf_len, "%s/%" PRISERIAL "%s", dir, serial,
+                       type == VRP_FILE_SNAPSHOT ?
+                       VRP_FILE_SUFFIX_SNAPSHOT : VRP_FILE_SUFFIX_DELTA);
+
+    return ret >= 0 && (size_t)ret < buf_len;
+}
+
+
+/*****
+ * Reading
+ *****/
+
+bool vrp_file_open(
+    struct vrp_file *file,
+    const char *path)
+{
+    int fd;
+    struct stat st;
+    const uint8_t *header;
+    size_t header_length;
+    uint64_t ipv4_count;
+    uint64_t ipv6_count;
+    uint32_t checksum;
+    uint32_t crc;
+    static const uint8_t zero_checksum[4] = {0, 0, 0, 0};
+
+    memset(file, 0, sizeof(*file));
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        ERR_LOG(errno, NULL, "can't open %s", path);
+        return false;
+    }
+
+    if (fstat(fd, &st) != 0)
+    {
+        ERR_LOG(errno, NULL, "can't stat %s", path);
+        close(fd);
+        return false;
+    }
+
+    if (st.st_size < VRP_FILE_HEADER_LENGTH ||
+        (uintmax_t)st.st_size > SIZE_MAX)
+    {
+        LOG(LOG_ERR, "%s: bad file size", path);
+        close(fd);
+        return false;
+    }
+
+    file->map_length = st.st_size;
+    file->map = mmap(NULL, file->map_length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (file->map == MAP_FAILED)
+    {
+        ERR_LOG(errno, NULL, "can't mmap %s", path);
+        file->map = NULL;
+        return false;
+    }
+
+    header = file->map;
+
+    if (memcmp(header + HEADER_OFFSET_MAGIC, VRP_FILE_MAGIC_SNAPSHOT,
+               VRP_FILE_MAGIC_LENGTH) == 0)
+    {
+        file->type = VRP_FILE_SNAPSHOT;
+    }
+    else if (memcmp(header + HEADER_OFFSET_MAGIC, VRP_FILE_MAGIC_DELTA,
+                    VRP_FILE_MAGIC_LENGTH) == 0)
+    {
+        file->type = VRP_FILE_DELTA;
+    }
+    else
+    {
+        LOG(LOG_ERR, "%s: not a VRP snapshot or delta file", path);
+        goto fail;
+    }
+
+    if (get_uint16(header + HEADER_OFFSET_VERSION) != VRP_FILE_VERSION)
+    {
+        LOG(LOG_ERR, "%s: unsupported version %" PRIu16, path,
+            get_uint16(header + HEADER_OFFSET_VERSION));
+        goto fail;
+    }
+
+    header_length = get_uint16(header + HEADER_OFFSET_HEADER_LENGTH);
+    ipv4_count = get_uint64(header + HEADER_OFFSET_IPV4_COUNT);
+    ipv6_count = get_uint64(header + HEADER_OFFSET_IPV6_COUNT);
+    if (header_length < VRP_FILE_HEADER_LENGTH ||
+        header_length > file->map_length ||
+        ipv4_count > (file->map_length - header_length) /
+            VRP_FILE_IPV4_RECORD_LENGTH ||
+        ipv6_count > (file->map_length - header_length -
+                      ipv4_count * VRP_FILE_IPV4_RECORD_LENGTH) /
+            VRP_FILE_IPV6_RECORD_LENGTH ||
+        header_length + ipv4_count * VRP_FILE_IPV4_RECORD_LENGTH +
+            ipv6_count * VRP_FILE_IPV6_RECORD_LENGTH != file->map_length)
+    {
+        LOG(LOG_ERR, "%s: header doesn't match file size", path);
+        goto fail;
+    }
+
+    checksum = get_uint32(header + HEADER_OFFSET_CHECKSUM);
+    crc = crc32_update(0, header, HEADER_OFFSET_CHECKSUM);
+    crc = crc32_update(crc, zero_checksum, sizeof(zero_checksum));
+    crc = crc32_update(crc, header + HEADER_OFFSET_CHECKSUM + 4,
+                       file->map_length - HEADER_OFFSET_CHECKSUM - 4);
+    if (crc != checksum)
+    {
+        LOG(LOG_ERR, "%s: checksum mismatch", path);
+        goto fail;
+    }
+
+    file->session = get_uint16(header + HEADER_OFFSET_SESSION);
+    file->serial = get_uint32(header + HEADER_OFFSET_SERIAL);
+    file->previous_serial =
+        get_uint32(header + HEADER_OFFSET_PREVIOUS_SERIAL);
+    file->ipv4_count = ipv4_count;
+    file->ipv6_count = ipv6_count;
+    file->ipv4_records = header + header_length;
+    file->ipv6_records = file->ipv4_records +
+        ipv4_count * VRP_FILE_IPV4_RECORD_LENGTH;
+
+    return true;
+
+fail:
+    vrp_file_close(file);
+    return false;
+}
+
+void vrp_file_close(
+    struct vrp_file *file)
+{
+    if (file->map != NULL)
+    {
+        munmap(file->map, file->map_length);
+    }
+
+    memset(file, 0, sizeof(*file));
+}
+
+size_t vrp_file_count(
+    const struct vrp_file *file)
+{
+    return file->ipv4_count + file->ipv6_count;
+}
+
+void vrp_file_get(
+    const struct vrp_file *file,
+    size_t index,
+    struct vrp *vrp,
+    bool *is_announce)
+{
+    const uint8_t *record;
+    size_t family_length;
+
+    if (index < file->ipv4_count)
+    {
+        record = file->ipv4_records + index * VRP_FILE_IPV4_RECORD_LENGTH;
+        family_length = 4;
+    }
+    else
+    {
+        record = file->ipv6_records +
+            (index - file->ipv4_count) * VRP_FILE_IPV6_RECORD_LENGTH;
+        family_length = 16;
+    }
+
+    memset(vrp, 0, sizeof(*vrp));
+    vrp->asn = get_uint32(record + RECORD_OFFSET_ASN);
+    vrp->family_length = family_length;
+    memcpy(vrp->prefix, record + RECORD_OFFSET_PREFIX, family_length);
+    vrp->prefix_length = record[RECORD_OFFSET_PREFIX + family_length];
+    vrp->max_length = record[RECORD_OFFSET_PREFIX + family_length + 1];
+
+    if (is_announce != NULL)
+    {
+        *is_announce = (record[RECORD_OFFSET_PREFIX + family_length + 2] &
+                        FLAG_WITHDRAW_ANNOUNCE) != 0;
+    }
+}
+
+bool vrp_file_append_to_set(
+    const struct vrp_file *file,
+    struct vrp_set *set)
+{
+    size_t i;
+    size_t count = vrp_file_count(file);
+    struct vrp vrp;
+
+    for (i = 0; i < count; ++i)
+    {
+        vrp_file_get(file, i, &vrp, NULL);
+        if (!vrp_set_add(set, &vrp))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/*****
+ * Writing
+ *****/
+
+/**
+   @brief Create a temporary file next to @p path and write a header
+       with a zero checksum to it.
+*/
+static bool writer_open(
+    struct vrp_file_writer *writer,
+    const char *path,
+    const char *magic,
+    session_id_t session,
+    serial_number_t serial,
+    serial_number_t previous_serial,
+    size_t ipv4_count,
+    size_t ipv6_count)
+{
+    uint8_t header[VRP_FILE_HEADER_LENGTH];
+    int fd;
+
+    writer->path = path;
+    writer->fp = NULL;
+    writer->crc = 0;
+    writer->ipv4_count = ipv4_count;
+    writer->ipv6_count = ipv6_count;
+
+    writer->tmp_path = malloc(strlen(path) + sizeof(".XXXXXX"));
+    if (writer->tmp_path == NULL)
+    {
+        LOG(LOG_ERR, "out of memory");
+        return false;
+    }
+    strcpy(writer->tmp_path, path);
+    strcat(writer->tmp_path, ".XXXXXX");
+
+    fd = mkstemp(writer->tmp_path);
+    if (fd < 0)
+    {
+        ERR_LOG(errno, NULL, "can't create temporary file for %s", path);
+        free(writer->tmp_path);
+        writer->tmp_path = NULL;
+        return false;
+    }
+
+    // mkstemp() uses mode 0600, but the file is meant to be read by
+    // other programs.
+    if (fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) != 0)
+    {
+        ERR_LOG(errno, NULL, "can't set permissions on %s",
+                writer->tmp_path);
+    }
+
+    writer->fp = fdopen(fd, "wb");
+    if (writer->fp == NULL)
+    {
+        ERR_LOG(errno, NULL, "can't open %s", writer->tmp_path);
+        close(fd);
+        unlink(writer->tmp_path);
+        free(writer->tmp_path);
+        writer->tmp_path = NULL;
+        return false;
+    }
+
+    memset(header, 0, sizeof(header));
+    memcpy(header + HEADER_OFFSET_MAGIC, magic, VRP_FILE_MAGIC_LENGTH);
+    put_uint16(header + HEADER_OFFSET_VERSION, VRP_FILE_VERSION);
+    put_uint16(header + HEADER_OFFSET_HEADER_LENGTH, VRP_FILE_HEADER_LENGTH);
+    put_uint16(header + HEADER_OFFSET_SESSION, session);
+    put_uint32(header + HEADER_OFFSET_SERIAL, serial);
+    put_uint32(header + HEADER_OFFSET_PREVIOUS_SERIAL, previous_serial);
+    put_uint64(header + HEADER_OFFSET_IPV4_COUNT, ipv4_count);
+    put_uint64(header + HEADER_OFFSET_IPV6_COUNT, ipv6_count);
+
+    writer->crc = crc32_update(writer->crc, header, sizeof(header));
+    if (fwrite(header, sizeof(header), 1, writer->fp) != 1)
+    {
+        ERR_LOG(errno, NULL, "can't write to %s", writer->tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+static bool writer_write_vrp(
+    struct vrp_file_writer *writer,
+    const struct vrp *vrp,
+    bool is_announce)
+{
+    uint8_t record[VRP_FILE_IPV6_RECORD_LENGTH];
+    size_t record_length = vrp->family_length == 4 ?
+        VRP_FILE_IPV4_RECORD_LENGTH : VRP_FILE_IPV6_RECORD_LENGTH;
+
+    put_uint32(record + RECORD_OFFSET_ASN, vrp->asn);
+    memcpy(record + RECORD_OFFSET_PREFIX, vrp->prefix, vrp->family_length);
+    record[RECORD_OFFSET_PREFIX + vrp->family_length] = vrp->prefix_length;
+    record[RECORD_OFFSET_PREFIX + vrp->family_length + 1] = vrp->max_length;
+    record[RECORD_OFFSET_PREFIX + vrp->family_length + 2] =
+        is_announce ? FLAG_WITHDRAW_ANNOUNCE : 0;
+    record[RECORD_OFFSET_PREFIX + vrp->family_length + 3] = 0;
+
+    writer->crc = crc32_update(writer->crc, record, record_length);
+    if (fwrite(record, record_length, 1, writer->fp) != 1)
+    {
+        ERR_LOG(errno, NULL, "can't write to %s", writer->tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+   @brief Fill in the checksum, flush everything to disk, and rename
+       the temporary file into place. If @p success is false, just
+       clean up.
+*/
+static bool writer_close(
+    struct vrp_file_writer *writer,
+    bool success)
+{
+    uint8_t checksum[4];
+
+    if (success)
+    {
+        put_uint32(checksum, writer->crc);
+        if (fseek(writer->fp, HEADER_OFFSET_CHECKSUM, SEEK_SET) != 0 ||
+            fwrite(checksum, sizeof(checksum), 1, writer->fp) != 1 ||
+            fflush(writer->fp) != 0 ||
+            fsync(fileno(writer->fp)) != 0)
+        {
+            ERR_LOG(errno, NULL, "can't write to %s", writer->tmp_path);
+            success = false;
+        }
+    }
+
+    if (writer->fp != NULL && fclose(writer->fp) != 0 && success)
+    {
+        ERR_LOG(errno, NULL, "can't close %s", writer->tmp_path);
+        success = false;
+    }
+    writer->fp = NULL;
+
+    if (success && rename(writer->tmp_path, writer->path) != 0)
+    {
+        ERR_LOG(errno, NULL, "can't rename %s to %s", writer->tmp_path,
+                writer->path);
+        success = false;
+    }
+
+    if (!success && writer->tmp_path != NULL)
+    {
+        unlink(writer->tmp_path);
+    }
+
+    free(writer->tmp_path);
+    writer->tmp_path = NULL;
+
+    return success;
+}
+
+/**
+   @brief Count the VRPs of each address family in a sorted array.
+
+   @return False if the array is not grouped by address family.
+*/
+static bool count_families(
+    const struct vrp *vrps,
+    size_t len,
+    size_t *ipv4_count,
+    size_t *ipv6_count)
+{
+    size_t i;
+
+    *ipv4_count = 0;
+    *ipv6_count = 0;
+
+    for (i = 0; i < len; ++i)
+    {
+        if (vrps[i].family_length == 4)
+        {
+            if (*ipv6_count != 0)
+            {
+                return false;
+            }
+            ++*ipv4_count;
+        }
+        else
+        {
+            ++*ipv6_count;
+        }
+    }
+
+    return true;
+}
+
+bool vrp_file_write_snapshot(
+    const char *path,
+    session_id_t session,
+    serial_number_t serial,
+    const struct vrp *vrps,
+    size_t len)
+{
+    struct vrp_file_writer writer;
+    size_t ipv4_count;
+    size_t ipv6_count;
+    size_t i;
+    bool success = true;
+
+    if (!count_families(vrps, len, &ipv4_count, &ipv6_count))
+    {
+        LOG(LOG_ERR, "VRPs for %s aren't sorted", path);
+        return false;
+    }
+
+    if (!writer_open(&writer, path, VRP_FILE_MAGIC_SNAPSHOT, session,
+                     serial, 0, ipv4_count, ipv6_count))
+    {
+        return writer_close(&writer, false);
+    }
+
+    for (i = 0; success && i < len; ++i)
+    {
+        success = writer_write_vrp(&writer, &vrps[i], true);
+    }
+
+    return writer_close(&writer, success);
+}
+
+bool vrp_file_write_delta(
+    const char *path,
+    session_id_t session,
+    serial_number_t serial,
+    serial_number_t previous_serial,
+    const struct vrp *announcements,
+    size_t announcements_len,
+    const struct vrp *withdrawals,
+    size_t withdrawals_len)
+{
+    struct vrp_file_writer writer;
+    size_t announcements_ipv4;
+    size_t announcements_ipv6;
+    size_t withdrawals_ipv4;
+    size_t withdrawals_ipv6;
+    size_t a = 0;
+    size_t w = 0;
+    bool success = true;
+
+    if (!count_families(announcements, announcements_len,
+                        &announcements_ipv4, &announcements_ipv6) ||
+        !count_families(withdrawals, withdrawals_len,
+                        &withdrawals_ipv4, &withdrawals_ipv6))
+    {
+        LOG(LOG_ERR, "VRPs for %s aren't sorted", path);
+        return false;
+    }
+
+    if (!writer_open(&writer, path, VRP_FILE_MAGIC_DELTA, session,
+                     serial, previous_serial,
+                     announcements_ipv4 + withdrawals_ipv4,
+                     announcements_ipv6 + withdrawals_ipv6))
+    {
+        return writer_close(&writer, false);
+    }
+
+    // Merge the two arrays so that each address family's records stay
+    // sorted.
+    while (success && (a < announcements_len || w < withdrawals_len))
+    {
+        if (w == withdrawals_len ||
+            (a < announcements_len &&
+             vrp_compare(&announcements[a], &withdrawals[w]) < 0))
+        {
+            success = writer_write_vrp(&writer, &announcements[a++], true);
+        }
+        else
+        {
+            success = writer_write_vrp(&writer, &withdrawals[w++], false);
+        }
+    }
+
+    return writer_close(&writer, success);
+}
+
+
+/*****
+ * Streaming
+ *****/
+
+bool vrp_file_stream_open(
+    struct vrp_file_writer *writer,
+    const char *path,
+    session_id_t session,
+    serial_number_t serial)
+{
+    // The counts are filled in by vrp_file_stream_close().
+    if (!writer_open(writer, path, VRP_FILE_MAGIC_SNAPSHOT, session, serial,
+                     0, 0, 0))
+    {
+        writer_close(writer, false);
+        return false;
+    }
+
+    return true;
+}
+
+bool vrp_file_stream_add(
+    struct vrp_file_writer *writer,
+    const struct vrp *vrp)
+{
+    if (writer->ipv4_count + writer->ipv6_count != 0 &&
+        vrp_compare(&writer->last, vrp) >= 0)
+    {
+        LOG(LOG_ERR, "VRPs for %s aren't sorted", writer->path);
+        return false;
+    }
+
+    if (!writer_write_vrp(writer, vrp, true))
+    {
+        return false;
+    }
+
+    if (vrp->family_length == 4)
+    {
+        ++writer->ipv4_count;
+    }
+    else
+    {
+        ++writer->ipv6_count;
+    }
+    writer->last = *vrp;
+
+    return true;
+}
+
+/**
+   @brief Compute the CRC-32 of everything written to @p writer so far
+       by reading it back from disk.
+*/
+static bool writer_checksum_file(
+    struct vrp_file_writer *writer)
+{
+    uint8_t buf[65536];
+    int fd = fileno(writer->fp);
+    off_t offset = 0;
+    ssize_t len;
+
+    writer->crc = 0;
+    while ((len = pread(fd, buf, sizeof(buf), offset)) > 0)
+    {
+        writer->crc = crc32_update(writer->crc, buf, len);
+        offset += len;
+    }
+    if (len < 0)
+    {
+        ERR_LOG(errno, NULL, "can't read back %s", writer->tmp_path);
+        return false;
+    }
+
+    return true;
+}
+
+bool vrp_file_stream_close(
+    struct vrp_file_writer *writer,
+    bool success)
+{
+    uint8_t counts[16];
+
+    if (success)
+    {
+        // The header was written with zero counts, and its checksum
+        // covers the counts, so patch them in and compute the checksum
+        // from scratch. The file is still in the page cache, so this
+        // is cheap compared to keeping all the VRPs in memory.
+        put_uint64(counts, writer->ipv4_count);
+        put_uint64(counts + 8, writer->ipv6_count);
+        if (fseek(writer->fp, HEADER_OFFSET_IPV4_COUNT, SEEK_SET) != 0 ||
+            fwrite(counts, sizeof(counts), 1, writer->fp) != 1 ||
+            fflush(writer->fp) != 0)
+        {
+            ERR_LOG(errno, NULL, "can't write to %s", writer->tmp_path);
+            success = false;
+        }
+        else
+        {
+            success = writer_checksum_file(writer);
+        }
+    }
+
+    return writer_close(writer, success);
+}
@@ -0,0 +1,254 @@
+#ifndef _RTR_VRP_FILE_H
+#define _RTR_VRP_FILE_H
+
+/**
+   Compact on-disk format for VRP snapshots and deltas.
+
+   A file is a fixed-size header followed by fixed-width records, all
+   IPv4 records first and then all IPv6 records. Within each address
+   family, records are sorted by vrp_compare(). All multi-byte integers
+   are in network byte order.
+
+   Header (#VRP_FILE_HEADER_LENGTH bytes):
+
+       offset  size  field
+            0     8  magic, #VRP_FILE_MAGIC_SNAPSHOT or #VRP_FILE_MAGIC_DELTA
+            8     2  format version, #VRP_FILE_VERSION
+           10     2  header length
+           12     2  session id
+           14     2  reserved, zero
+           16     4  serial number
+           20     4  previous serial number (deltas only, else zero)
+           24     8  number of IPv4 records
+           32     8  number of IPv6 records
+           40     4  CRC-32 of the entire file, computed with this
+                     field set to zero
+           44    20  reserved, zero
+
+   IPv4 record (#VRP_FILE_IPV4_RECORD_LENGTH bytes):
+
+       asn (4), prefix (4), prefix length (1), max length (1), flags (1),
+       reserved (1)
+
+   IPv6 record (#VRP_FILE_IPV6_RECORD_LENGTH bytes):
+
+       asn (4), prefix (16), prefix length (1), max length (1), flags (1),
+       reserved (1)
+
+   The flags byte has the same meaning as in IPvX Prefix PDUs: it is
+   FLAG_WITHDRAW_ANNOUNCE for an announcement and zero for a
+   withdrawal. Every record in a snapshot is an announcement.
+
+   Files are only ever created by writing to a temporary file in the
+   same directory and renaming it into place, so readers can mmap() a
+   file without worrying about it changing underneath them.
+*/
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "rpki-rtr/pdu.h"
+#include "rpki-rtr/vrp.h"
+
+
+#define VRP_FILE_MAGIC_SNAPSHOT "RPSTIRVS"
+#define VRP_FILE_MAGIC_DELTA "RPSTIRVD"
+#define VRP_FILE_MAGIC_LENGTH 8
+#define VRP_FILE_VERSION 1
+#define VRP_FILE_HEADER_LENGTH 64
+#define VRP_FILE_IPV4_RECORD_LENGTH 12
+#define VRP_FILE_IPV6_RECORD_LENGTH 24
+
+/** File name suffix for snapshots, see vrp_file_path(). */
+#define VRP_FILE_SUFFIX_SNAPSHOT ".vrps"
+/** File name suffix for deltas, see vrp_file_path(). */
+#define VRP_FILE_SUFFIX_DELTA ".delta"
+
+
+enum vrp_file_type {
+    VRP_FILE_SNAPSHOT,
+    VRP_FILE_DELTA,
+};
+
+
+/**
+   @brief A read-only, memory-mapped snapshot or delta file.
+*/
+struct vrp_file {
+    enum vrp_file_type type;
+
+    session_id_t session;
+
+    serial_number_t serial;
+
+    /**
+        @brief Serial number that a delta applies to. Zero for
+            snapshots.
+    */
+    serial_number_t previous_serial;
+
+    size_t ipv4_count;
+
+    size_t ipv6_count;
+
+    /** @brief Start of the IPv4 records within #map. */
+    const uint8_t *ipv4_records;
+
+    /** @brief Start of the IPv6 records within #map. */
+    const uint8_t *ipv6_records;
+
+    void *map;
+
+    size_t map_length;
+};
+
+
+/**
+   @brief State for writing a file. Only use it through the
+       vrp_file_stream_*() functions.
+*/
+struct vrp_file_writer {
+    const char *path;
+    char *tmp_path;
+    FILE *fp;
+    uint32_t crc;
+    size_t ipv4_count;
+    size_t ipv6_count;
+
+    /** @brief Last VRP passed to vrp_file_stream_add(). */
+    struct vrp last;
+};
+
+
+/**
+   @brief Format the path of the snapshot or delta for @p serial in
+       directory @p dir.
+
+   @return True on success, false if @p buf is too small.
+*/
+bool vrp_file_path(
+    char *buf,
+    size_t buf_len,
+    const char *dir,
+    enum vrp_file_type type,
+    serial_number_t serial);
+
+/**
+   @brief Map @p path read-only and validate its header and checksum.
+
+   @return True on success, false on failure. On failure, @p file does
+       not need to be closed.
+*/
+bool vrp_file_open(
+    struct vrp_file *file,
+    const char *path);
+
+/**
+   @brief Unmap a file opened by vrp_file_open().
+*/
+void vrp_file_close(
+    struct vrp_file *file);
+
+/**
+   @return Total number of records in @p file.
+*/
+size_t vrp_file_count(
+    const struct vrp_file *file);
+
+/**
+   @brief Decode the record at @p index, counting IPv4 records first
+       and then IPv6 records.
+
+   @param[out] is_announce Set to whether the record is an
+       announcement. May be NULL.
+*/
+void vrp_file_get(
+    const struct vrp_file *file,
+    size_t index,
+    struct vrp *vrp,
+    bool *is_announce);
+
+/**
+   @brief Append every record of @p file to @p set.
+
+   @return True on success, false on allocation failure.
+*/
+bool vrp_file_append_to_set(
+    const struct vrp_file *file,
+    struct vrp_set *set);
+
+/**
+   @brief Atomically write a snapshot file.
+
+   @param vrps VRPs sorted by vrp_compare(), without duplicates.
+   @return True on success, false on failure.
+*/
+bool vrp_file_write_snapshot(
+    const char *path,
+    session_id_t session,
+    serial_number_t serial,
+    const struct vrp *vrps,
+    size_t len);
+
+/**
+   @brief Atomically write a delta file for the changes from
+       @p previous_serial to @p serial.
+
+   @param announcements VRPs sorted by vrp_compare(), without
+       duplicates.
+   @param withdrawals VRPs sorted by vrp_compare(), without duplicates
+       and disjoint from @p announcements.
+   @return True on success, false on failure.
+*/
+bool vrp_file_write_delta(
+    const char *path,
+    session_id_t session,
+    serial_number_t serial,
+    serial_number_t previous_serial,
+    const struct vrp *announcements,
+    size_t announcements_len,
+    const struct vrp *withdrawals,
+    size_t withdrawals_len);
+
+
+/**
+   @brief Start writing a snapshot one VRP at a time, for when the VRPs
+       are too many to hold in memory at once.
+
+   Nothing appears at @p path until vrp_file_stream_close() succeeds.
+   @p path must stay valid until then.
+
+   @return True on success, false on failure. On failure, @p writer
+       does not need to be closed.
+*/
+bool vrp_file_stream_open(
+    struct vrp_file_writer *writer,
+    const char *path,
+    session_id_t session,
+    serial_number_t serial);
+
+/**
+   @brief Append a VRP to a snapshot started by vrp_file_stream_open().
+
+   @param vrp Must sort after every VRP already added, according to
+       vrp_compare().
+   @return True on success, false on failure.
+*/
+bool vrp_file_stream_add(
+    struct vrp_file_writer *writer,
+    const struct vrp *vrp);
+
+/**
+   @brief Finish a snapshot started by vrp_file_stream_open() and
+       atomically rename it into place. If @p success is false, or
+       anything fails, the temporary file is removed instead.
+
+   @return True if the snapshot was written, false otherwise.
+*/
+bool vrp_file_stream_close(
+    struct vrp_file_writer *writer,
+    bool success);
+
+#endif
@@ -210,11 +210,11 @@ check_cert(
          extp; extp = (struct Extension *)next_of(&extp->self))
     {
         /** @bug error code ignored without explanation */
-        if (isEE && !diff_objid(&extp->extnID, id_basicConstraints) &&
+        if (isEE && !DIFF_OBJID_DER(&extp->extnID, id_basicConstraints) &&
             size_casn(&extp->extnValue.basicConstraints.cA) > 0)
             return ERR_SCM_NOTEE;
         /** @bug error code ignored without explanation */
-        if (!diff_objid(&extp->extnID, id_subjectKeyIdentifier))
+        if (!DIFF_OBJID_DER(&extp->extnID, id_subjectKeyIdentifier))
         {
             uchar *ski;
             ski_lth =
@@ -319,12 +319,14 @@ static struct Attribute *find_unique_attr(
 {
     struct Attribute *attrp,
        *ch_attrp = NULL;
+    uchar der[ASN_OBJID_DER_MAX];
+    int lth = objid_to_der(oidp, der, sizeof(der));
     *found_any = false;
     for (attrp = (struct Attribute *)member_casn(&attrsp->self, 0);
          attrp != NULL; attrp = (struct Attribute *)next_of(&attrp->self))
     {
         /** @bug error code ignored without explanation */
-        if (!diff_objid(&attrp->attrType, oidp))
+        if (!diff_objid_der(&attrp->attrType, der, lth))
         {
             if (*found_any)
             {
@@ -631,13 +633,13 @@ cmsValidate(
         attrp = (struct Attribute *)next_of(&attrp->self))
     {
         /** @bug error code ignored without explanation */
-        if (diff_objid(&attrp->attrType, id_contentTypeAttr) &&
+        if (DIFF_OBJID_DER(&attrp->attrType, id_contentTypeAttr) &&
             /** @bug error code ignored without explanation */
-            diff_objid(&attrp->attrType, id_messageDigestAttr) &&
+            DIFF_OBJID_DER(&attrp->attrType, id_messageDigestAttr) &&
             /** @bug error code ignored without explanation */
-            diff_objid(&attrp->attrType, id_signingTimeAttr) &&
+            DIFF_OBJID_DER(&attrp->attrType, id_signingTimeAttr) &&
             /** @bug error code ignored without explanation */
-            diff_objid(&attrp->attrType, id_binSigningTimeAttr))
+            DIFF_OBJID_DER(&attrp->attrType, id_binSigningTimeAttr))
         {
             return ERR_SCM_INVALSATTR;
         }
@@ -658,7 +660,7 @@ cmsValidate(
          (struct Extension *)member_casn(&certp->toBeSigned.extensions.
                                          self, 0);
          /** @bug error code ignored without explanation */
-         extp && diff_objid(&extp->extnID, id_subjectKeyIdentifier);
+         extp && DIFF_OBJID_DER(&extp->extnID, id_subjectKeyIdentifier);
          /** @bug error code ignored without explanation */
          extp = (struct Extension *)next_of(&extp->self));
     if (!extp
@@ -1088,7 +1090,7 @@ checkIPAddrs(
          (struct Extension *)member_casn(&certp->toBeSigned.extensions.self,
                                          0);
          /** @bug error code ignored without explanation */
-         extp && diff_objid(&extp->extnID, id_pe_ipAddrBlock);
+         extp && DIFF_OBJID_DER(&extp->extnID, id_pe_ipAddrBlock);
          /** @bug error code ignored without explanation */
          extp = (struct Extension *)next_of(&extp->self));
     if (!extp)
@@ -27,14 +27,42 @@
 #include "rpki-asn1/crlv2.h"
 #include "util/stringutils.h"
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+// OpenSSL 1.1.0 added it and deprecated ASN1_STRING_data().
+#define ASN1_STRING_get0_data(x) ((const unsigned char *)ASN1_STRING_data(x))
+#endif
+
 int strict_profile_checks = 0;
 
-#define UTC10    10             // UTC format without seconds
-#define UTC12    12             // UTC format with seconds
-#define GEN14    14             // generalized format without fractions of a
-                                // second
-#define GEN16    16             // generalized format with fractions of a
-                                // second
+err_code ASNTimeToDBTimeBuf(
+    const char *in,
+    size_t lth,
+    int only_gentime,
+    char *out,
+    time_t *clockp)
+{
+    struct casn_time parsed;
+    int type;
+
+    if (in == NULL || lth == 0 || lth > INT_MAX)
+        return ERR_SCM_INVALARG;
+    if ((type = parse_casn_time(in, (int)lth, &parsed)) < 0)
+        return ERR_SCM_INVALDT;
+    // next check that the format matches the year. If the year is < 2050
+    // it should be UTC, otherwise GEN.
+    if (only_gentime)
+    {
+        if (type != ASN_GENTIME)
+            return ERR_SCM_INVALDT;
+    }
+    else if ((parsed.year < 2050) != (type == ASN_UTCTIME))
+        return ERR_SCM_INVALDT;
+    if (out != NULL && format_casn_time(&parsed, out, DBTIME_SIZE) < 0)
+        return ERR_SCM_INVALDT;
+    if (clockp != NULL)
+        *clockp = (time_t)parsed.secs;
+    return 0;
+}
 
 char *ASNTimeToDBTime(
     char *bef,
@@ -44,149 +72,29 @@ char *ASNTimeToDBTime(
     LOG(LOG_DEBUG, "ASNTimeToDBTime(bef=\"%s\", stap=%p, only_gentime=%d)",
         bef, stap, only_gentime);
 
-    int year;
-    int mon;
-    int day;
-    int suf_hour = 0;
-    int hour;
-    int suf_min = 0;
-    int min;
-    int sec;
-    int msec;
-    int cnt;
-    int fmt = 0;
-    char tz = 0;
-    char *ptr;
+    char dbtime[DBTIME_SIZE];
     char *out = NULL;
 
     if (stap == NULL)
     {
         goto done;
     }
-    *stap = 0;
     if (bef == NULL || bef[0] == 0)
     {
         *stap = ERR_SCM_INVALARG;
         goto done;
     }
-    // first find and parse the suffix if any
-    ptr = strpbrk(bef, "+-");
-    if (ptr != NULL)
-    {
-        cnt = sscanf(ptr + 1, "%2d%2d", &suf_hour, &suf_min);
-        if (cnt != 2 || suf_hour < 0 || suf_hour > 24 ||
-            suf_min < 0 || suf_min > 60)
-        {
-            *stap = ERR_SCM_INVALDT;
-            goto done;
-        }
-        if (*ptr == '-')
-        {
-            suf_hour = -suf_hour;
-            suf_min = -suf_min;
-        }
-    }
-    // next, determine how many characters there are before the tz indicator
-    ptr = strchr(bef, 'Z');
-    if (ptr == NULL)
-    {
-        *stap = ERR_SCM_INVALDT;
-        goto done;
-    }
-    fmt = (int)(ptr - bef);
-    switch (fmt)
-    {
-    case UTC10:
-        sec = 0;
-        cnt = sscanf(bef, "%2d%2d%2d%2d%2d%c", &year, &mon, &day,
-                     &hour, &min, &tz);
-        if (cnt != 6)
-        {
-            *stap = ERR_SCM_INVALDT;
-            goto done;
-        }
-        if (year > 49)
-            year += 1900;
-        else
-            year += 2000;
-        break;
-    case UTC12:
-        cnt = sscanf(bef, "%2d%2d%2d%2d%2d%2d%c", &year, &mon, &day,
-                     &hour, &min, &sec, &tz);
-        if (cnt != 7)
-        {
-            *stap = ERR_SCM_INVALDT;
-            goto done;
-        }
-        if (year > 49)
-            year += 1900;
-        else
-            year += 2000;
-        break;
-    case GEN14:
-        cnt = sscanf(bef, "%4d%2d%2d%2d%2d%2d%c", &year, &mon, &day,
-                     &hour, &min, &sec, &tz);
-        if (cnt != 7)
-        {
-            *stap = ERR_SCM_INVALDT;
-            goto done;
-        }
-        break;
-    case GEN16:
-        cnt = sscanf(bef, "%4d%2d%2d%2d%2d%2d.%1d%c", &year, &mon, &day,
-                     &hour, &min, &sec, &msec, &tz);
-        if (cnt != 8)
-        {
-            *stap = ERR_SCM_INVALDT;
-            goto done;
-        }
-        break;
-    default:
-        *stap = ERR_SCM_INVALDT;
-        goto done;
-    }
-    // validate the time with the suffix
-    if (tz != 'Z' || mon < 1 || mon > 12 || day < 1 || day > 31 || hour < 0 ||
-        hour > 23 || min < 0 || min > 59 || sec < 0 || sec > 61)
-        /*
-         * 61 because of leap seconds
-         */
+    *stap = ASNTimeToDBTimeBuf(bef, strlen(bef), only_gentime, dbtime, NULL);
+    if (*stap < 0)
     {
-        *stap = ERR_SCM_INVALDT;
         goto done;
     }
-    // we should adjust the time if there is a suffix, but currently we don't
-    // next check that the format matches the year. If the year is < 2050
-    // it should be UTC, otherwise GEN.
-    if (only_gentime)
-    {
-        if (fmt != GEN14 && fmt != GEN16)
-        {
-            *stap = ERR_SCM_INVALDT;
-            goto done;
-        }
-    }
-    else
-    {
-        if (year < 2050 && (fmt == GEN14 || fmt == GEN16))
-        {
-            *stap = ERR_SCM_INVALDT;
-            goto done;
-        }
-        if (year >= 2050 && (fmt == UTC10 || fmt == UTC12))
-        {
-            *stap = ERR_SCM_INVALDT;
-            goto done;
-        }
-    }
-    out = (char *)calloc(48, sizeof(char));
+    out = strdup(dbtime);
     if (out == NULL)
     {
         *stap = ERR_SCM_NOMEM;
         goto done;
     }
-    xsnprintf(out, 48, "%4d-%02d-%02d %02d:%02d:%02d",
-              year, mon, day, hour, min, sec);
 done:
     LOG(LOG_DEBUG, "ASNTimeToDBTime() returning \"%s\" with error code %s: %s",
         out, stap ? err2name(*stap) : "NULL",
@@ -457,48 +365,54 @@ cf_get_sn(
     return (dptr);
 }
 
-static cf_get cf_get_from;
-char *
-cf_get_from(
-    X509 *x,
-    err_code *stap,
-    int *x509stap)
+/**
+ * @brief
+ *     Convert a time from OpenSSL to a DB time.
+ *
+ * The contents of an ASN.1 time are ASCII, so they are parsed where
+ * they are instead of being converted to UTF-8 first.
+ *
+ * @param[in] missing
+ *     Error code for a missing time.
+ */
+static char *
+asn1_time_to_db(
+    ASN1_TIME *tp,
+    err_code missing,
+    err_code *stap)
 {
-    ASN1_GENERALIZEDTIME *nb4;
-    unsigned char *bef = NULL;
+    char dbtime[DBTIME_SIZE];
     char *dptr;
-    int asn1sta;
 
-    nb4 = X509_get_notBefore(x);
-    if (nb4 == NULL)
+    if (tp == NULL || ASN1_STRING_length(tp) <= 0)
     {
-        *stap = ERR_SCM_NONB4;
+        *stap = missing;
         return (NULL);
     }
-    asn1sta = ASN1_STRING_to_UTF8(&bef, (ASN1_STRING *) nb4);
-    if (asn1sta < 0)            /* error */
-    {
-        *x509stap = asn1sta;
-        *stap = ERR_SCM_X509;
+    *stap = ASNTimeToDBTimeBuf((const char *)ASN1_STRING_get0_data(tp),
+                               ASN1_STRING_length(tp), 0, dbtime, NULL);
+    if (*stap < 0)
         return (NULL);
-    }
-    if (bef == NULL || asn1sta == 0)    /* null string */
-    {
-        *stap = ERR_SCM_NONB4;
-        return (NULL);
-    }
-    *stap = 0;
-    dptr = ASNTimeToDBTime((char *)bef, stap, 0);
-    OPENSSL_free(bef);
+    dptr = strdup(dbtime);
     if (dptr == NULL)
     {
-        if (*stap == 0)
-            *stap = ERR_SCM_NOMEM;
+        *stap = ERR_SCM_NOMEM;
         return (NULL);
     }
     return (dptr);
 }
 
+static cf_get cf_get_from;
+char *
+cf_get_from(
+    X509 *x,
+    err_code *stap,
+    int *x509stap)
+{
+    (void)x509stap;
+    return asn1_time_to_db(X509_get_notBefore(x), ERR_SCM_NONB4, stap);
+}
+
 static cf_get cf_get_to;
 char *
 cf_get_to(
@@ -506,37 +420,8 @@ cf_get_to(
     err_code *stap,
     int *x509stap)
 {
-    ASN1_GENERALIZEDTIME *naf;
-    unsigned char *aft = NULL;
-    char *dptr;
-    int asn1sta;
-
-    naf = X509_get_notAfter(x);
-    if (naf == NULL)
-    {
-        *stap = ERR_SCM_NONAF;
-        return (NULL);
-    }
-    asn1sta = ASN1_STRING_to_UTF8(&aft, (ASN1_STRING *) naf);
-    if (asn1sta < 0)            /* error */
-    {
-        *x509stap = asn1sta;
-        *stap = ERR_SCM_X509;
-        return (NULL);
-    }
-    if (aft == NULL || asn1sta == 0)    /* null string */
-    {
-        *stap = ERR_SCM_NONAF;
-        return (NULL);
-    }
-    dptr = ASNTimeToDBTime((char *)aft, stap, 0);
-    OPENSSL_free(aft);
-    if (dptr == NULL)
-    {
-        *stap = ERR_SCM_NOMEM;
-        return (NULL);
-    }
-    return (dptr);
+    (void)x509stap;
+    return asn1_time_to_db(X509_get_notAfter(x), ERR_SCM_NONAF, stap);
 }
 
 static cf_get cf_get_sig;
@@ -1177,37 +1062,8 @@ crf_get_last(
     err_code *stap,
     int *crlstap)
 {
-    ASN1_GENERALIZEDTIME *nb4;
-    unsigned char *bef = NULL;
-    char *dptr;
-    int asn1sta;
-
-    nb4 = X509_CRL_get_lastUpdate(x);
-    if (nb4 == NULL)
-    {
-        *stap = ERR_SCM_NONB4;
-        return (NULL);
-    }
-    asn1sta = ASN1_STRING_to_UTF8(&bef, (ASN1_STRING *) nb4);
-    if (asn1sta < 0)            /* error */
-    {
-        *crlstap = asn1sta;
-        *stap = ERR_SCM_CRL;
-        return (NULL);
-    }
-    if (bef == NULL || asn1sta == 0)    /* null string */
-    {
-        *stap = ERR_SCM_NONB4;
-        return (NULL);
-    }
-    dptr = ASNTimeToDBTime((char *)bef, stap, 0);
-    OPENSSL_free(bef);
-    if (dptr == NULL)
-    {
-        *stap = ERR_SCM_NOMEM;
-        return (NULL);
-    }
-    return (dptr);
+    (void)crlstap;
+    return asn1_time_to_db(X509_CRL_get_lastUpdate(x), ERR_SCM_NONB4, stap);
 }
 
 static crf_get crf_get_next;
@@ -1217,37 +1073,8 @@ crf_get_next(
     err_code *stap,
     int *crlstap)
 {
-    ASN1_GENERALIZEDTIME *naf;
-    unsigned char *aft = NULL;
-    char *dptr;
-    int asn1sta;
-
-    naf = X509_CRL_get_nextUpdate(x);
-    if (naf == NULL)
-    {
-        *stap = ERR_SCM_NONAF;
-        return (NULL);
-    }
-    asn1sta = ASN1_STRING_to_UTF8(&aft, (ASN1_STRING *) naf);
-    if (asn1sta < 0)            /* error */
-    {
-        *crlstap = asn1sta;
-        *stap = ERR_SCM_CRL;
-        return (NULL);
-    }
-    if (aft == NULL || asn1sta == 0)    /* null string */
-    {
-        *stap = ERR_SCM_NONAF;
-        return (NULL);
-    }
-    dptr = ASNTimeToDBTime((char *)aft, stap, 0);
-    OPENSSL_free(aft);
-    if (dptr == NULL)
-    {
-        // stap already set by ASNTimeToDBTime
-        return (NULL);
-    }
-    return (dptr);
+    (void)crlstap;
+    return asn1_time_to_db(X509_CRL_get_nextUpdate(x), ERR_SCM_NONAF, stap);
 }
 
 static crf_get crf_get_sig;
@@ -2795,7 +2622,7 @@ static int get_cert_type(
     for (; extp; extp = (struct Extension *)next_of(&extp->self))
     {
         /** @bug error code ignored without explanation */
-        if (!diff_objid(&extp->extnID, id_basicConstraints))
+        if (!DIFF_OBJID_DER(&extp->extnID, id_basicConstraints))
             return CA_CERT;
     }
 
@@ -2864,7 +2691,7 @@ rescert_sia_chk(
         for (; adp; adp = (struct AccessDescription *)next_of(&adp->self))
         {
             /** @bug error code ignored without explanation */
-            if (!diff_objid(&adp->accessMethod, id_ad_caRepository) &&
+            if (!DIFF_OBJID_DER(&adp->accessMethod, id_ad_caRepository) &&
                 size_casn((struct casn *)&adp->accessLocation.url))
             {
                 size = vsize_casn((struct casn *)&adp->accessLocation.url);
@@ -2878,7 +2705,7 @@ rescert_sia_chk(
                 uri_repo = NULL;
             }
             /** @bug error code ignored without explanation */
-            else if (!diff_objid(&adp->accessMethod, id_ad_rpkiManifest) &&
+            else if (!DIFF_OBJID_DER(&adp->accessMethod, id_ad_rpkiManifest) &&
                 size_casn((struct casn *)&adp->accessLocation.url))
             {
                 size = vsize_casn((struct casn *)&adp->accessLocation.url);
@@ -2911,7 +2738,7 @@ rescert_sia_chk(
         for (; adp; adp = (struct AccessDescription *)next_of(&adp->self))
         {
             /** @bug error code ignored without explanation */
-            if (!diff_objid(&adp->accessMethod, id_ad_signedObject))
+            if (!DIFF_OBJID_DER(&adp->accessMethod, id_ad_signedObject))
             {
                 if (size_casn((struct casn *)&adp->accessLocation.url))
                 {
@@ -3483,7 +3310,7 @@ rescert_name_chk(
                 (struct AttributeValueAssertion *)member_casn(&rdnp->self,
                                                               set_idx);
             /** @bug error code ignored without explanation */
-            if (!diff_objid(&avap->objid, id_commonName))
+            if (!DIFF_OBJID_DER(&avap->objid, id_commonName))
             {
                 if (commonName)
                 {
@@ -3505,7 +3332,7 @@ rescert_name_chk(
                 }
             }
             /** @bug error code ignored without explanation */
-            else if (!diff_objid(&avap->objid, id_serialNumber))
+            else if (!DIFF_OBJID_DER(&avap->objid, id_serialNumber))
             {
                 if (serialNumber)
                 {
@@ -3901,20 +3728,28 @@ static err_code
 rescert_extensions_chk(
     struct Certificate *certp)
 {
-    static char const *const allowed_extensions[] = {
-        id_basicConstraints,
-        id_subjectKeyIdentifier,
-        id_authKeyId,
-        id_keyUsage,
-        id_extKeyUsage,         // allowed in future BGPSEC EE certs
-        id_cRLDistributionPoints,
-        id_pkix_authorityInfoAccess,
-        id_pe_subjectInfoAccess,
-        id_certificatePolicies,
-        id_pe_ipAddrBlock,
-        id_pe_autonomousSysNum,
-        NULL
+    // the octets of each OID, compared with those of each extension
+#define ALLOWED_EXTENSION(name) \
+    {(const uchar *)name##_der, sizeof(name##_der) - 1}
+    static const struct {
+        const uchar *der;
+        int lth;
+    } allowed_extensions[] = {
+        ALLOWED_EXTENSION(id_basicConstraints),
+        ALLOWED_EXTENSION(id_subjectKeyIdentifier),
+        ALLOWED_EXTENSION(id_authKeyId),
+        ALLOWED_EXTENSION(id_keyUsage),
+        // allowed in future BGPSEC EE certs
+        ALLOWED_EXTENSION(id_extKeyUsage),
+        ALLOWED_EXTENSION(id_cRLDistributionPoints),
+        ALLOWED_EXTENSION(id_pkix_authorityInfoAccess),
+        ALLOWED_EXTENSION(id_pe_subjectInfoAccess),
+        ALLOWED_EXTENSION(id_certificatePolicies),
+        ALLOWED_EXTENSION(id_pe_ipAddrBlock),
+        ALLOWED_EXTENSION(id_pe_autonomousSysNum),
+        {NULL, 0}
     };
+#undef ALLOWED_EXTENSION
 
     // to prevent memory overflows
     static const int max_oid_print_length = 50;
@@ -3929,10 +3764,11 @@ rescert_extensions_chk(
          extp = (struct Extension *)next_of(&extp->self))
     {
         ext_allowed = false;
-        for (i = 0; allowed_extensions[i] != NULL; ++i)
+        for (i = 0; allowed_extensions[i].der != NULL; ++i)
         {
             /** @bug error code ignored without explanation */
-            if (!diff_objid(&extp->extnID, allowed_extensions[i]))
+            if (!diff_objid_der(&extp->extnID, allowed_extensions[i].der,
+                                allowed_extensions[i].lth))
             {
                 ext_allowed = true;
                 break;
@@ -4239,34 +4075,24 @@ static err_code
 cvt_crldate2DB(
     struct ChoiceOfTime *cotp)
 {
-    char *buf = NULL;
+    char buf[32];
     int i = vsize_casn(&cotp->utcTime);
     if (i > 0)                  // utc time
     {
         if (i != 13)
             return ERR_SCM_INVALDT;
-        if (!(buf = (char *)calloc(1, i + 2)))
-            return ERR_SCM_NOMEM;
         read_casn(&cotp->utcTime, (uchar *) buf);
     }
     else                        // generalTime
     {
         i = vsize_casn(&cotp->generalTime);
-        if (i < 15)
+        if (i < 15 || i >= (int)sizeof(buf))
             return ERR_SCM_INVALDT;
-        if (!(buf = (char *)calloc(1, i + 2)))
-            return ERR_SCM_NOMEM;
         read_casn(&cotp->generalTime, (uchar *) buf);
         if (i > 15 && (buf[i - 1] == '0' || buf[i - 1] == '.'))
-        {
-            free(buf);
             return ERR_SCM_INVALDT;
-        }
     }
-    err_code sta = 0;
-    free(ASNTimeToDBTime(buf, &sta, 0));
-    free(buf);
-    return sta;
+    return ASNTimeToDBTimeBuf(buf, i, 0, NULL, NULL);
 }
 
 static err_code
@@ -4454,7 +4280,7 @@ crl_extensions_chk(
          crlextp; crlextp = (struct CRLExtension *)next_of(&crlextp->self))
     {
         /** @bug error code ignored without explanation */
-        if (!diff_objid(&crlextp->extnID, id_authKeyId))
+        if (!DIFF_OBJID_DER(&crlextp->extnID, id_authKeyId))
         {
             i = 0;
             if (read_casn_num(&crlextp->critical, &i) >= 0 && i > 0)
@@ -4472,7 +4298,7 @@ crl_extensions_chk(
             authkeyIdp = &crlextp->extnValue.authKeyId;
         }
         /** @bug error code ignored without explanation */
-        else if (!diff_objid(&crlextp->extnID, id_cRLNumber))
+        else if (!DIFF_OBJID_DER(&crlextp->extnID, id_cRLNumber))
         {
             i = 0;
             if (read_casn_num(&crlextp->critical, &i) >= 0 && i > 0)
@@ -120,30 +120,46 @@ typedef struct _cfx_validator {
 extern void freecf(
     cert_fields *cf);
 
+    // "YYYY-MM-DD HH:MM:SS" and a null
+#define DBTIME_SIZE CASN_TIME_STRING_SIZE
+
+/**
+ * @brief
+ *     Convert a time string in a certificate to a time string that
+ *     will be acceptable to the DB, without allocating memory.
+ *
+ * @param[in] in
+ *     Time to convert, which need not be null-terminated.  It is the
+ *     contents of a UTCTime or GeneralizedTime, as parse_casn_time()
+ *     accepts them: YYMMDDHHMMSSZ or YYMMDDHHMMZ for UTC, where the
+ *     year is 2000+YY if YY <= 49 and 1900+YY otherwise, or
+ *     YYYYMMDDHHMMSSZ or YYYYMMDDHHMMSS.SZ for GENERALIZED.  The date
+ *     and time must exist.  If @p only_gentime is false, UTC must be
+ *     used for dates <= 2049 and GENERALIZED for dates >= 2050.
+ *     Otherwise, GENERALIZED must be used for all dates.
+ * @param[in] lth
+ *     Length of @p in.
+ * @param[out] out
+ *     Buffer of at least DBTIME_SIZE for the DB time, or NULL.
+ * @param[out] clockp
+ *     The time as a time_t, or NULL.
+ * @return
+ *     0 on success, else an error code (e.g. ERR_SCM_INVALDT).
+ */
+extern err_code ASNTimeToDBTimeBuf(
+    const char *in,
+    size_t lth,
+    int only_gentime,
+    char *out,
+    time_t *clockp);
+
 /**
  * @brief
  *     Convert between a time string in a certificate and a time
  *     string that will be acceptable to the DB.
  *
  * @param[in] in
- *     Time to convert.  The time string can be either UTC or
- *     GENERALIZED.  If @p only_gentime is false, UTC is used for
- *     dates <= 2049 and GENERALIZED is used for dates after >= 2050.
- *     Otherwise, GENERALIZED is use for all dates.
- *
- *     The UTC format takes the form YYMMDDHHMMSST, where each of the
- *     fields is as follows: if YY <= 49 the year is 2000+YY otherwise
- *     it is 1900+YY 1 <= MM <= 12 1 <= DD <= 31 0 <= HH <= 24 0 <= MM
- *     <= 60 0 <= SS <= 60 (seconds field is optional) T, is present
- *     and == Z indicates GMT
- *
- *     The GENERALIZED format takes the form YYYYMMDDHHMMSST, where
- *     the year is given in the full four digit form, and all other
- *     fields are the same.  Note that seconds can be given as either
- *     SS or SS.S.
- *
- *     Both fields can have an optional suffix of the form +HHMM or
- *     -HHMM.
+ *     Null-terminated time to convert, as for ASNTimeToDBTimeBuf().
  * @param[out] stap
  *     On success, the value at this "status pointer" is set to 0.  On
  *     failure, it is set to the appropriate error code
@@ -3328,12 +3328,14 @@ struct Extension *get_extension(
     struct Extension *extp = NULL;
     struct Extension *ret = NULL;
     int cnt = 0;
+    uchar der[ASN_OBJID_DER_MAX];
+    int lth = objid_to_der(idp, der, sizeof(der));
 
     for (extp = (struct Extension *)member_casn(&extsp->self, 0);
          extp != NULL; extp = (struct Extension *)next_of(&extp->self))
     {
         /** @bug error code ignored without explanation */
-        if (!diff_objid(&extp->extnID, idp))
+        if (!diff_objid_der(&extp->extnID, der, lth))
         {
             if (!cnt)
                 ret = extp;
@@ -3760,7 +3762,7 @@ extractAndAddCert(
          (struct Extension *)member_casn(&certp->toBeSigned.extensions.self,
                                          0);
          /** @bug error code ignored without explanation */
-         extp && diff_objid(&extp->extnID, id_extKeyUsage);
+         extp && DIFF_OBJID_DER(&extp->extnID, id_extKeyUsage);
          /** @bug error code ignored without explanation */
          extp = (struct Extension *)next_of(&extp->self));
     if (extp)
@@ -4243,8 +4245,8 @@ add_manifest(
     int cert_added = 0;
     int stale;
     struct CMS cms;
-    char *thisUpdate;
-    char *nextUpdate;
+    char thisUpdate[DBTIME_SIZE];
+    char nextUpdate[DBTIME_SIZE];
     char certfilename[PATH_MAX];
     char asn_time[16];          // DER GenTime: strlen("YYYYMMDDhhmmssZ") ==
                                 // 15
@@ -4307,7 +4309,7 @@ add_manifest(
         {
             asn_time[read_len] = '\0';
         }
-        thisUpdate = ASNTimeToDBTime(asn_time, &sta, 1);
+        sta = ASNTimeToDBTimeBuf(asn_time, read_len, 1, thisUpdate, NULL);
         if (sta < 0)
             break;
 
@@ -4328,7 +4330,7 @@ add_manifest(
         {
             asn_time[read_len] = '\0';
         }
-        nextUpdate = ASNTimeToDBTime(asn_time, &sta, 1);
+        sta = ASNTimeToDBTimeBuf(asn_time, read_len, 1, nextUpdate, NULL);
         if (sta < 0)
             break;
 
@@ -4405,8 +4407,6 @@ add_manifest(
         (void)delete_object(scmp, conp, certfilename,
                             outdir, outfull, (unsigned int)0);
     delete_casn(&(cms.self));
-    free(thisUpdate);
-    free(nextUpdate);
 done:
     LOG(LOG_DEBUG, "add_manifest() returning %s: %s",
         err2name(sta), err2string(sta));
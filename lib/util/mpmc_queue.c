@@ -0,0 +1,179 @@
+#include "mpmc_queue.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+
+#define MPMC_CACHE_LINE_SIZE 64
+
+
+/*
+ * This is the bounded queue described by Dmitry Vyukov: each cell has a
+ * sequence number that says whether it's ready for the push or the pop at
+ * a given position. A thread claims a position by advancing push_pos or
+ * pop_pos with a compare-and-swap, and then hands the cell to the other
+ * side by storing the cell's next sequence number.
+ *
+ * For the cell at position pos (modulo the capacity):
+ *   sequence == pos: empty, ready for the push at pos
+ *   sequence == pos + 1: full, ready for the pop at pos
+ *   sequence == pos + capacity: empty, ready for the push at pos + capacity
+ */
+struct _MpmcQueue_Cell {
+    size_t sequence;
+    void *data;
+};
+
+struct _MpmcQueue {
+    struct _MpmcQueue_Cell *buffer;
+    size_t mask;                // capacity - 1, capacity is a power of 2
+    char pad0[MPMC_CACHE_LINE_SIZE - sizeof(void *) - sizeof(size_t)];
+
+    size_t push_pos;
+    char pad1[MPMC_CACHE_LINE_SIZE - sizeof(size_t)];
+
+    size_t pop_pos;
+    char pad2[MPMC_CACHE_LINE_SIZE - sizeof(size_t)];
+};
+
+
+MpmcQueue *MpmcQueue_new(
+    size_t capacity)
+{
+    MpmcQueue *queue;
+    size_t real_capacity = 2;   // the algorithm needs at least 2 cells
+    size_t i;
+
+    while (real_capacity < capacity)
+    {
+        if (real_capacity >
+            SIZE_MAX / 2 / sizeof(struct _MpmcQueue_Cell))
+            return NULL;
+        real_capacity *= 2;
+    }
+
+    queue = (MpmcQueue *) malloc(sizeof(MpmcQueue));
+    if (queue == NULL)
+        return NULL;
+
+    queue->buffer = malloc(real_capacity * sizeof(struct _MpmcQueue_Cell));
+    if (queue->buffer == NULL)
+    {
+        free((void *)queue);
+        return NULL;
+    }
+
+    for (i = 0; i < real_capacity; ++i)
+    {
+        queue->buffer[i].sequence = i;
+    }
+
+    queue->mask = real_capacity - 1;
+    queue->push_pos = 0;
+    queue->pop_pos = 0;
+
+    return queue;
+}
+
+void MpmcQueue_free(
+    MpmcQueue * queue)
+{
+    if (queue == NULL)
+        return;
+
+    free(queue->buffer);
+    free((void *)queue);
+}
+
+bool MpmcQueue_trypush(
+    MpmcQueue * queue,
+    void *data)
+{
+    struct _MpmcQueue_Cell *cell;
+    size_t pos = __atomic_load_n(&queue->push_pos, __ATOMIC_RELAXED);
+    size_t sequence;
+    intptr_t diff;
+
+    while (true)
+    {
+        cell = &queue->buffer[pos & queue->mask];
+        sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        diff = (intptr_t) sequence - (intptr_t) pos;
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&queue->push_pos, &pos, pos + 1,
+                                            true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+                break;
+            // pos now has the current value of push_pos
+        }
+        else if (diff < 0)
+        {
+            // the cell still has the item from a lap ago
+            return false;
+        }
+        else
+        {
+            // another push claimed pos first
+            pos = __atomic_load_n(&queue->push_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    cell->data = data;
+    __atomic_store_n(&cell->sequence, pos + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool MpmcQueue_trypop(
+    MpmcQueue * queue,
+    void **data)
+{
+    struct _MpmcQueue_Cell *cell;
+    size_t pos = __atomic_load_n(&queue->pop_pos, __ATOMIC_RELAXED);
+    size_t sequence;
+    intptr_t diff;
+
+    while (true)
+    {
+        cell = &queue->buffer[pos & queue->mask];
+        sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        diff = (intptr_t) sequence - (intptr_t) (pos + 1);
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&queue->pop_pos, &pos, pos + 1,
+                                            true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+                break;
+            // pos now has the current value of pop_pos
+        }
+        else if (diff < 0)
+        {
+            // nothing has been pushed at pos yet
+            return false;
+        }
+        else
+        {
+            // another pop claimed pos first
+            pos = __atomic_load_n(&queue->pop_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    *data = cell->data;
+    __atomic_store_n(&cell->sequence, pos + queue->mask + 1,
+                     __ATOMIC_RELEASE);
+
+    return true;
+}
+
+size_t MpmcQueue_size(
+    MpmcQueue * queue)
+{
+    size_t pop_pos = __atomic_load_n(&queue->pop_pos, __ATOMIC_ACQUIRE);
+    size_t push_pos = __atomic_load_n(&queue->push_pos, __ATOMIC_ACQUIRE);
+
+    // pop_pos can't pass push_pos, and it's loaded first
+    return push_pos - pop_pos;
+}
@@ -0,0 +1,70 @@
+#ifndef _UTILS_MPMC_QUEUE_H
+#define _UTILS_MPMC_QUEUE_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+/**
+   A bounded, lock-free, multi-producer/multi-consumer FIFO queue.
+
+   Any number of threads may push and pop concurrently. A push or pop
+   never waits for a lock, but it may have to retry if another thread
+   pushed or popped at the same time.
+*/
+struct _MpmcQueue;
+typedef struct _MpmcQueue MpmcQueue;
+
+/**
+   Create a new MpmcQueue that can hold at least @p capacity items.
+
+   @return The new queue, or NULL if there isn't enough memory.
+*/
+MpmcQueue *MpmcQueue_new(
+    size_t capacity);
+
+/**
+   Free an MpmcQueue.
+
+   Notes: The queue must be empty or memory will be leaked.  Moreover,
+   before calling MpmcQueue_free(), the caller must ensure that each
+   thread that holds a reference to this queue has completed all
+   operations related to this queue.
+*/
+void MpmcQueue_free(
+    MpmcQueue * queue);
+
+/**
+   Push data onto the queue.
+
+   @return
+       Whether or not the push was successful.  (It fails if the queue
+       is full.)
+*/
+bool MpmcQueue_trypush(
+    MpmcQueue * queue,
+    void *data);
+
+/**
+   Pop the queue if there's anything on the queue.
+
+   @return
+       Whether or not the pop was successful.
+   @param data
+       Returned data if the pop was successful.
+*/
+bool MpmcQueue_trypop(
+    MpmcQueue * queue,
+    void **data);
+
+/**
+   Return the approximate size of the queue.  The size returned is
+   correct at some point during the time of execution, but
+   size > 0 does not guarantee that MpmcQueue_trypop() will succeed.
+*/
+size_t MpmcQueue_size(
+    MpmcQueue * queue);
+
+
+#endif
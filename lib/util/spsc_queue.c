@@ -0,0 +1,114 @@
+#include "spsc_queue.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+
+#define SPSC_CACHE_LINE_SIZE 64
+
+
+/*
+ * head and tail count every pop and push ever done, and are only reduced
+ * modulo the capacity when indexing buffer. Each is written by only one
+ * thread, and they're on separate cache lines so that the producer and
+ * consumer don't contend for the same line.
+ */
+struct _SpscQueue {
+    void **buffer;
+    size_t mask;                // capacity - 1, capacity is a power of 2
+    char pad0[SPSC_CACHE_LINE_SIZE - sizeof(void **) - sizeof(size_t)];
+
+    size_t head;                // written only by the consumer
+    char pad1[SPSC_CACHE_LINE_SIZE - sizeof(size_t)];
+
+    size_t tail;                // written only by the producer
+    char pad2[SPSC_CACHE_LINE_SIZE - sizeof(size_t)];
+};
+
+
+SpscQueue *SpscQueue_new(
+    size_t capacity)
+{
+    SpscQueue *queue;
+    size_t real_capacity = 1;
+
+    while (real_capacity < capacity)
+    {
+        if (real_capacity > SIZE_MAX / 2 / sizeof(void *))
+            return NULL;
+        real_capacity *= 2;
+    }
+
+    queue = (SpscQueue *) malloc(sizeof(SpscQueue));
+    if (queue == NULL)
+        return NULL;
+
+    queue->buffer = malloc(real_capacity * sizeof(void *));
+    if (queue->buffer == NULL)
+    {
+        free((void *)queue);
+        return NULL;
+    }
+
+    queue->mask = real_capacity - 1;
+    queue->head = 0;
+    queue->tail = 0;
+
+    return queue;
+}
+
+void SpscQueue_free(
+    SpscQueue * queue)
+{
+    if (queue == NULL)
+        return;
+
+    free(queue->buffer);
+    free((void *)queue);
+}
+
+bool SpscQueue_trypush(
+    SpscQueue * queue,
+    void *data)
+{
+    size_t tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+
+    if (tail - head > queue->mask)
+        return false;
+
+    queue->buffer[tail & queue->mask] = data;
+
+    // publish the item to the consumer
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool SpscQueue_trypop(
+    SpscQueue * queue,
+    void **data)
+{
+    size_t head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    size_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+
+    if (head == tail)
+        return false;
+
+    *data = queue->buffer[head & queue->mask];
+
+    // give the slot back to the producer
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+size_t SpscQueue_size(
+    SpscQueue * queue)
+{
+    size_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    size_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+
+    // head is loaded first, so this can't be negative
+    return tail - head;
+}
@@ -0,0 +1,72 @@
+#ifndef _UTILS_SPSC_QUEUE_H
+#define _UTILS_SPSC_QUEUE_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+/**
+   A bounded, lock-free, single-producer/single-consumer queue.
+
+   At most one thread at a time may push, and at most one thread at a
+   time may pop. The pushing (or popping) thread may change over time,
+   as long as the handoff between the old and new thread synchronizes
+   (e.g. through a mutex or a semaphore).
+*/
+struct _SpscQueue;
+typedef struct _SpscQueue SpscQueue;
+
+/**
+   Create a new SpscQueue that can hold at least @p capacity items.
+
+   @return The new queue, or NULL if there isn't enough memory.
+*/
+SpscQueue *SpscQueue_new(
+    size_t capacity);
+
+/**
+   Free an SpscQueue.
+
+   Notes: The queue must be empty or memory will be leaked.  Moreover,
+   before calling SpscQueue_free(), the caller must ensure that each
+   thread that holds a reference to this queue has completed all
+   operations related to this queue.
+*/
+void SpscQueue_free(
+    SpscQueue * queue);
+
+/**
+   Push data onto the queue. This must only be called by the producer.
+
+   @return
+       Whether or not the push was successful.  (It fails if the queue
+       is full.)
+*/
+bool SpscQueue_trypush(
+    SpscQueue * queue,
+    void *data);
+
+/**
+   Pop the queue if there's anything on the queue. This must only be
+   called by the consumer.
+
+   @return
+       Whether or not the pop was successful.
+   @param data
+       Returned data if the pop was successful.
+*/
+bool SpscQueue_trypop(
+    SpscQueue * queue,
+    void **data);
+
+/**
+   Return the approximate size of the queue.  The size returned is
+   correct at some point during the time of execution.  This may be
+   called by any thread.
+*/
+size_t SpscQueue_size(
+    SpscQueue * queue);
+
+
+#endif
@@ -0,0 +1,211 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "util/mpmc_queue.h"
+#include "test/unittest.h"
+
+#define NUM_PRODUCERS 4
+#define NUM_CONSUMERS 4
+#define ITEMS_PER_PRODUCER 250000
+
+
+static bool test_single_thread(
+    void)
+{
+    MpmcQueue *queue = MpmcQueue_new(1000);
+    void *data;
+    uintptr_t i;
+
+    TEST(void *, "%p", (void *)queue, !=, NULL);
+
+    TEST(size_t, "%zu", MpmcQueue_size(queue), ==, 0);
+    TEST_BOOL(MpmcQueue_trypop(queue, &data), false);
+
+    // the capacity is rounded up to 1024
+    for (i = 0; i < 1024; ++i)
+    {
+        TEST_BOOL(MpmcQueue_trypush(queue, (void *)i), true);
+    }
+    TEST_BOOL(MpmcQueue_trypush(queue, (void *)i), false);
+    TEST(size_t, "%zu", MpmcQueue_size(queue), ==, 1024);
+
+    for (i = 0; i < 1000; ++i)
+    {
+        TEST_BOOL(MpmcQueue_trypop(queue, &data), true);
+        TEST(uintptr_t, "%" PRIuPTR, (uintptr_t) data, ==, i);
+    }
+
+    // wrap around
+    for (i = 1024; i < 2024; ++i)
+    {
+        TEST_BOOL(MpmcQueue_trypush(queue, (void *)i), true);
+    }
+    TEST_BOOL(MpmcQueue_trypush(queue, (void *)i), false);
+
+    for (i = 1000; i < 2024; ++i)
+    {
+        TEST_BOOL(MpmcQueue_trypop(queue, &data), true);
+        TEST(uintptr_t, "%" PRIuPTR, (uintptr_t) data, ==, i);
+    }
+    TEST_BOOL(MpmcQueue_trypop(queue, &data), false);
+    TEST(size_t, "%zu", MpmcQueue_size(queue), ==, 0);
+
+    MpmcQueue_free(queue);
+
+    return true;
+}
+
+
+struct thread_args {
+    MpmcQueue *queue;
+    uintptr_t id;
+    unsigned char *seen;        // shared by all consumers, one per item
+    uintptr_t popped;
+};
+
+static void *producer(
+    void *args_voidp)
+{
+    struct thread_args *args = (struct thread_args *)args_voidp;
+    uintptr_t i;
+    uintptr_t item;
+
+    for (i = 0; i < ITEMS_PER_PRODUCER; ++i)
+    {
+        // Items start at 1 so that no item is NULL.
+        item = args->id * ITEMS_PER_PRODUCER + i + 1;
+        while (!MpmcQueue_trypush(args->queue, (void *)item))
+        {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void *consumer(
+    void *args_voidp)
+{
+    struct thread_args *args = (struct thread_args *)args_voidp;
+    uintptr_t last[NUM_PRODUCERS] = { 0 };
+    uintptr_t item;
+    uintptr_t producer_id;
+    void *data;
+
+    args->popped = 0;
+
+    while (true)
+    {
+        if (!MpmcQueue_trypop(args->queue, &data))
+        {
+            sched_yield();
+            continue;
+        }
+
+        item = (uintptr_t) data;
+        if (item == UINTPTR_MAX)
+        {
+            // sentinel from the main thread: no more items
+            break;
+        }
+
+        // each producer's items must come out in the order it pushed them
+        producer_id = (item - 1) / ITEMS_PER_PRODUCER;
+        if (item <= last[producer_id])
+        {
+            args->popped = UINTPTR_MAX;
+            break;
+        }
+        last[producer_id] = item;
+
+        __atomic_add_fetch(&args->seen[item - 1], 1, __ATOMIC_RELAXED);
+        ++args->popped;
+    }
+
+    return NULL;
+}
+
+static bool test_threads(
+    void)
+{
+    MpmcQueue *queue = MpmcQueue_new(256);
+    pthread_t producers[NUM_PRODUCERS];
+    pthread_t consumers[NUM_CONSUMERS];
+    struct thread_args producer_args[NUM_PRODUCERS];
+    struct thread_args consumer_args[NUM_CONSUMERS];
+    unsigned char *seen;
+    uintptr_t total_popped = 0;
+    size_t i;
+
+    TEST(void *, "%p", (void *)queue, !=, NULL);
+
+    seen = calloc(NUM_PRODUCERS * ITEMS_PER_PRODUCER, 1);
+    TEST(void *, "%p", (void *)seen, !=, NULL);
+
+    for (i = 0; i < NUM_CONSUMERS; ++i)
+    {
+        consumer_args[i].queue = queue;
+        consumer_args[i].id = i;
+        consumer_args[i].seen = seen;
+        TEST(int, "%d",
+             pthread_create(&consumers[i], NULL, consumer, &consumer_args[i]),
+             ==, 0);
+    }
+
+    for (i = 0; i < NUM_PRODUCERS; ++i)
+    {
+        producer_args[i].queue = queue;
+        producer_args[i].id = i;
+        producer_args[i].seen = NULL;
+        TEST(int, "%d",
+             pthread_create(&producers[i], NULL, producer, &producer_args[i]),
+             ==, 0);
+    }
+
+    for (i = 0; i < NUM_PRODUCERS; ++i)
+    {
+        TEST(int, "%d", pthread_join(producers[i], NULL), ==, 0);
+    }
+
+    for (i = 0; i < NUM_CONSUMERS; ++i)
+    {
+        while (!MpmcQueue_trypush(queue, (void *)UINTPTR_MAX))
+        {
+            sched_yield();
+        }
+    }
+
+    for (i = 0; i < NUM_CONSUMERS; ++i)
+    {
+        TEST(int, "%d", pthread_join(consumers[i], NULL), ==, 0);
+        TEST(uintptr_t, "%" PRIuPTR, consumer_args[i].popped, !=,
+             UINTPTR_MAX);
+        total_popped += consumer_args[i].popped;
+    }
+
+    TEST(uintptr_t, "%" PRIuPTR, total_popped, ==,
+         NUM_PRODUCERS * ITEMS_PER_PRODUCER);
+    for (i = 0; i < NUM_PRODUCERS * ITEMS_PER_PRODUCER; ++i)
+    {
+        TEST(int, "%d", seen[i], ==, 1);
+    }
+
+    free(seen);
+    MpmcQueue_free(queue);
+
+    return true;
+}
+
+
+int main(
+    void)
+{
+    if (!test_single_thread())
+        return -1;
+    if (!test_threads())
+        return -1;
+    return 0;
+}
@@ -0,0 +1,261 @@
+/*
+ * Micro-benchmark of the containers used to pass work between threads.
+ *
+ * Usage: queue-benchmark [items]
+ *
+ * It times two patterns:
+ *   1 producer, 1 consumer (like db responses to a cxn thread):
+ *       Queue vs. SpscQueue
+ *   4 producers, 4 consumers (like cxn requests to db threads):
+ *       Queue vs. Bag vs. MpmcQueue
+ *
+ * This is not run by "make check" because its results depend on the
+ * machine and its load.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "util/bag.h"
+#include "util/queue.h"
+#include "util/spsc_queue.h"
+#include "util/mpmc_queue.h"
+
+#define DEFAULT_ITEMS 1000000
+#define MAX_THREADS 4
+
+// capacity of the bounded queues
+#define BOUNDED_CAPACITY 1024
+
+
+struct container {
+    const char *name;
+    void *impl;
+    bool (*push)(void *impl, void *data);
+    bool (*pop)(void *impl, void **data);
+};
+
+
+static bool queue_push(
+    void *impl,
+    void *data)
+{
+    return Queue_push((Queue *) impl, data);
+}
+
+static bool queue_pop(
+    void *impl,
+    void **data)
+{
+    return Queue_trypop((Queue *) impl, data);
+}
+
+static bool bag_push(
+    void *impl,
+    void *data)
+{
+    return Bag_add((Bag *) impl, data);
+}
+
+static bool bag_pop(
+    void *impl,
+    void **data)
+{
+    Bag *bag = (Bag *) impl;
+    Bag_iterator it;
+    bool ret = false;
+
+    if (!Bag_start_iteration(bag))
+        return false;
+
+    it = Bag_begin(bag);
+    if (it != Bag_end(bag))
+    {
+        *data = Bag_get(bag, it);
+        Bag_erase(bag, it);
+        ret = true;
+    }
+
+    Bag_stop_iteration(bag);
+
+    return ret;
+}
+
+static bool spsc_push(
+    void *impl,
+    void *data)
+{
+    return SpscQueue_trypush((SpscQueue *) impl, data);
+}
+
+static bool spsc_pop(
+    void *impl,
+    void **data)
+{
+    return SpscQueue_trypop((SpscQueue *) impl, data);
+}
+
+static bool mpmc_push(
+    void *impl,
+    void *data)
+{
+    return MpmcQueue_trypush((MpmcQueue *) impl, data);
+}
+
+static bool mpmc_pop(
+    void *impl,
+    void **data)
+{
+    return MpmcQueue_trypop((MpmcQueue *) impl, data);
+}
+
+
+struct thread_args {
+    const struct container *container;
+    size_t items;
+};
+
+static void *producer(
+    void *args_voidp)
+{
+    const struct thread_args *args = (const struct thread_args *)args_voidp;
+    size_t i;
+
+    for (i = 0; i < args->items; ++i)
+    {
+        // + 1 so that no item is NULL
+        while (!args->container->push(args->container->impl,
+                                      (void *)(uintptr_t) (i + 1)))
+        {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void *consumer(
+    void *args_voidp)
+{
+    const struct thread_args *args = (const struct thread_args *)args_voidp;
+    size_t i;
+    void *data;
+
+    for (i = 0; i < args->items; ++i)
+    {
+        while (!args->container->pop(args->container->impl, &data))
+        {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+
+static double now(
+    void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static bool run(
+    const struct container *container,
+    size_t num_threads,
+    size_t items)
+{
+    pthread_t producers[MAX_THREADS];
+    pthread_t consumers[MAX_THREADS];
+    struct thread_args args;
+    double start;
+    double elapsed;
+    size_t i;
+
+    args.container = container;
+    args.items = items / num_threads;
+
+    start = now();
+
+    for (i = 0; i < num_threads; ++i)
+    {
+        if (pthread_create(&consumers[i], NULL, consumer, &args) != 0 ||
+            pthread_create(&producers[i], NULL, producer, &args) != 0)
+        {
+            fprintf(stderr, "pthread_create() failed\n");
+            return false;
+        }
+    }
+
+    for (i = 0; i < num_threads; ++i)
+    {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+    }
+
+    elapsed = now() - start;
+
+    printf("  %-10s %10.1f ns/item %10.2f Mitems/s\n", container->name,
+           elapsed * 1e9 / (double)(args.items * num_threads),
+           (double)(args.items * num_threads) / elapsed / 1e6);
+
+    return true;
+}
+
+
+int main(
+    int argc,
+    char **argv)
+{
+    size_t items = DEFAULT_ITEMS;
+    struct container queue = { "Queue", NULL, queue_push, queue_pop };
+    struct container bag = { "Bag", NULL, bag_push, bag_pop };
+    struct container spsc = { "SpscQueue", NULL, spsc_push, spsc_pop };
+    struct container mpmc = { "MpmcQueue", NULL, mpmc_push, mpmc_pop };
+    bool ok = true;
+
+    if (argc > 1)
+    {
+        items = strtoul(argv[1], NULL, 10);
+        if (items < MAX_THREADS)
+        {
+            fprintf(stderr, "usage: %s [items]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    queue.impl = Queue_new(true);
+    bag.impl = Bag_new(true);
+    spsc.impl = SpscQueue_new(BOUNDED_CAPACITY);
+    mpmc.impl = MpmcQueue_new(BOUNDED_CAPACITY);
+    if (queue.impl == NULL || bag.impl == NULL || spsc.impl == NULL ||
+        mpmc.impl == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("1 producer, 1 consumer, %zu items:\n", items);
+    ok = ok && run(&queue, 1, items);
+    ok = ok && run(&spsc, 1, items);
+
+    printf("%d producers, %d consumers, %zu items:\n", MAX_THREADS,
+           MAX_THREADS, items);
+    ok = ok && run(&queue, MAX_THREADS, items);
+    ok = ok && run(&bag, MAX_THREADS, items);
+    ok = ok && run(&mpmc, MAX_THREADS, items);
+
+    Queue_free((Queue *) queue.impl);
+    Bag_free((Bag *) bag.impl);
+    SpscQueue_free((SpscQueue *) spsc.impl);
+    MpmcQueue_free((MpmcQueue *) mpmc.impl);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,106 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "util/spsc_queue.h"
+#include "test/unittest.h"
+
+#define THREADED_ITEMS 1000000
+
+
+static bool test_single_thread(
+    void)
+{
+    SpscQueue *queue = SpscQueue_new(5);
+    void *data;
+    uintptr_t i;
+    uintptr_t round;
+
+    TEST(void *, "%p", (void *)queue, !=, NULL);
+
+    TEST(size_t, "%zu", SpscQueue_size(queue), ==, 0);
+    TEST_BOOL(SpscQueue_trypop(queue, &data), false);
+
+    // the capacity is rounded up to 8, and wraps around many times
+    for (round = 0; round < 100; ++round)
+    {
+        for (i = 0; i < 8; ++i)
+        {
+            TEST_BOOL(SpscQueue_trypush(queue, (void *)(round * 8 + i)),
+                      true);
+            TEST(size_t, "%zu", SpscQueue_size(queue), ==, i + 1);
+        }
+        TEST_BOOL(SpscQueue_trypush(queue, (void *)1), false);
+
+        for (i = 0; i < 8; ++i)
+        {
+            TEST_BOOL(SpscQueue_trypop(queue, &data), true);
+            TEST(uintptr_t, "%" PRIuPTR, (uintptr_t) data, ==, round * 8 + i);
+        }
+        TEST_BOOL(SpscQueue_trypop(queue, &data), false);
+        TEST(size_t, "%zu", SpscQueue_size(queue), ==, 0);
+    }
+
+    SpscQueue_free(queue);
+
+    return true;
+}
+
+
+static void *producer(
+    void *queue_voidp)
+{
+    SpscQueue *queue = (SpscQueue *) queue_voidp;
+    uintptr_t i;
+
+    for (i = 0; i < THREADED_ITEMS; ++i)
+    {
+        while (!SpscQueue_trypush(queue, (void *)i))
+        {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static bool test_two_threads(
+    void)
+{
+    SpscQueue *queue = SpscQueue_new(64);
+    pthread_t thread;
+    void *data;
+    uintptr_t i;
+
+    TEST(void *, "%p", (void *)queue, !=, NULL);
+    TEST(int, "%d", pthread_create(&thread, NULL, producer, queue), ==, 0);
+
+    for (i = 0; i < THREADED_ITEMS; ++i)
+    {
+        while (!SpscQueue_trypop(queue, &data))
+        {
+            sched_yield();
+        }
+        TEST(uintptr_t, "%" PRIuPTR, (uintptr_t) data, ==, i);
+    }
+
+    TEST(int, "%d", pthread_join(thread, NULL), ==, 0);
+    TEST_BOOL(SpscQueue_trypop(queue, &data), false);
+
+    SpscQueue_free(queue);
+
+    return true;
+}
+
+
+int main(
+    void)
+{
+    if (!test_single_thread())
+        return -1;
+    if (!test_two_threads())
+        return -1;
+    return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef LIB_UTIL_TIMEUTILS_H
+#define LIB_UTIL_TIMEUTILS_H
+
+/**
+ * @file
+ *
+ * @brief
+ *     Timing utilities
+ */
+
+#include <time.h>
+
+/*
+ * Seconds elapsed on CLOCK_MONOTONIC since start, which was filled in
+ * by clock_gettime(CLOCK_MONOTONIC, ...).
+ */
+double seconds_since(
+    const struct timespec *start);
+
+#endif
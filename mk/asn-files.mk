@@ -1,10 +1,16 @@
-## Handle $(ASN_BUILT_FILES) and $(ASN_SOURCE_FILES).
+## Handle $(ASN_BUILT_FILES), $(ASN_SOURCE_FILES), and $(ASN_TEST_FILES).
 
 
-ASN_C_FILES = $(ASN_BUILT_FILES:.asn=.c) $(ASN_SOURCE_FILES:.asn=.c)
-ASN_H_FILES = $(ASN_BUILT_FILES:.asn=.h) $(ASN_SOURCE_FILES:.asn=.h)
+ASN_C_FILES = \
+	$(ASN_BUILT_FILES:.asn=.c) \
+	$(ASN_SOURCE_FILES:.asn=.c) \
+	$(ASN_TEST_FILES:.asn=.c)
+ASN_H_FILES = \
+	$(ASN_BUILT_FILES:.asn=.h) \
+	$(ASN_SOURCE_FILES:.asn=.h) \
+	$(ASN_TEST_FILES:.asn=.h)
 
-EXTRA_DIST += $(ASN_SOURCE_FILES)
+EXTRA_DIST += $(ASN_SOURCE_FILES) $(ASN_TEST_FILES)
 
 CLEANFILES += \
 	$(ASN_BUILT_FILES) \
@@ -19,7 +25,8 @@ ASN_GENERATION_DEPS = \
 	lib/casn/asn_gen/asn_gen \
 	$(LOG_COMPILER_DEPS) \
 	$(ASN_BUILT_FILES) \
-	$(ASN_SOURCE_FILES)
+	$(ASN_SOURCE_FILES) \
+	$(ASN_TEST_FILES)
 
 # This rule does all the generation work in a temporary directory and only
 # generates one file (.c or .h) at a time. This is a bit wasteful in terms of
@@ -41,17 +48,24 @@ $(ASN_C_FILES) $(ASN_H_FILES): $(ASN_GENERATION_DEPS)
 		try mkdir -p "$$tmpdir/$$dir"; \
 		try cp "$$f" "$$tmpdir/$$dir"; \
 	done; \
-	for f in $(ASN_SOURCE_FILES); do \
+	for f in $(ASN_SOURCE_FILES) $(ASN_TEST_FILES); do \
 		dir=$$(try dirname "$$f") || exit 1; \
 		try mkdir -p "$$tmpdir/$$dir"; \
 		try cp "$(srcdir)/$$f" "$$tmpdir/$$dir"; \
 	done; \
+	asn_gen_flags=; \
+	for f in $(ASN_DIRECT_FILES); do \
+		if test "$$f" = "$(@D)/$${base}.asn"; then \
+			asn_gen_flags=-s; \
+		fi; \
+	done; \
 	try cd "$$tmpdir/$(@D)"; \
 	TEST_LOG_NAME="$(@F)" \
 		TEST_LOG_DIR="$(abs_builddir)/$(@D)" \
 		STRICT_CHECKS=0 \
 		$(LOG_COMPILER) \
-		$(abs_top_builddir)/lib/casn/asn_gen/asn_gen "$${base}.asn" \
+		$(abs_top_builddir)/lib/casn/asn_gen/asn_gen $$asn_gen_flags \
+			"$${base}.asn" \
 		|| fatal "'$(LOG_COMPILER) asn_gen $${base}.asn' failed"; \
 	try cd "$(abs_builddir)"; \
 	try mkdir -p "$(@D)"; \
@@ -20,6 +20,7 @@ lib_casn_asn_gen_asn_gen_SOURCES = \
 	lib/casn/asn_gen/asn_tabulate.c \
 	lib/casn/asn_gen/asn_timedefs.h \
 	lib/casn/asn_gen/casn_constr.c \
+	lib/casn/asn_gen/casn_decoder.c \
 	lib/casn/asn_gen/casn_hdr.c
 
 EXTRA_DIST += doc/asn_gen.1
@@ -42,24 +43,114 @@ lib_casn_libcasn_a_SOURCES = \
 	lib/casn/asn_flags.h \
 	lib/casn/casn.c \
 	lib/casn/casn.h \
+	lib/casn/casn_arena.c \
 	lib/casn/casn_bit.c \
 	lib/casn/casn_bits.c \
 	lib/casn/casn_copy_diff.c \
+	lib/casn/casn_direct.c \
 	lib/casn/casn_dump.c \
 	lib/casn/casn_error.c \
 	lib/casn/casn_file_ops.c \
+	lib/casn/casn_lazy.c \
 	lib/casn/casn_num.c \
 	lib/casn/casn_objid.c \
 	lib/casn/casn_other.c \
 	lib/casn/casn_private.h \
 	lib/casn/casn_real.c \
+	lib/casn/casn_stream.c \
 	lib/casn/casn_time.c
 
 EXTRA_DIST += doc/casn_functions.3
 
+
+lib_casn_tests_libcasntest_a_ASN1 = \
+	lib/casn/tests/casn_fixtures.asn
+
+ASN_TEST_FILES += $(lib_casn_tests_libcasntest_a_ASN1)
+
+# casn_direct-test uses the generated RecDecode().
+ASN_DIRECT_FILES += $(lib_casn_tests_libcasntest_a_ASN1)
+
+check_LIBRARIES += lib/casn/tests/libcasntest.a
+
+LDADD_LIBCASNTEST = \
+	lib/casn/tests/libcasntest.a \
+	$(LDADD_LIBCASN)
+
+lib_casn_tests_libcasntest_a_SOURCES = \
+	lib/casn/tests/casn_test_util.c \
+	lib/casn/tests/casn_test_util.h
+
+nodist_lib_casn_tests_libcasntest_a_SOURCES = \
+	$(lib_casn_tests_libcasntest_a_ASN1:.asn=.c) \
+	$(lib_casn_tests_libcasntest_a_ASN1:.asn=.h)
+
 check_PROGRAMS += lib/casn/tests/readcasnnum-test
 
 lib_casn_tests_readcasnnum_test_LDADD = \
 	$(LDADD_LIBCASN)
 
 TESTS += lib/casn/tests/readcasnnum-test
+
+check_PROGRAMS += lib/casn/tests/casn_buf-test
+
+lib_casn_tests_casn_buf_test_LDADD = \
+	$(LDADD_LIBCASNTEST)
+
+TESTS += lib/casn/tests/casn_buf-test
+
+check_PROGRAMS += lib/casn/tests/casn_arena-test
+
+lib_casn_tests_casn_arena_test_LDADD = \
+	$(LDADD_LIBCASNTEST)
+
+TESTS += lib/casn/tests/casn_arena-test
+
+check_PROGRAMS += lib/casn/tests/casn_thread-test
+
+lib_casn_tests_casn_thread_test_LDADD = \
+	$(LDADD_LIBCASNTEST)
+
+TESTS += lib/casn/tests/casn_thread-test
+
+check_PROGRAMS += lib/casn/tests/casn_stream-test
+
+lib_casn_tests_casn_stream_test_LDADD = \
+	$(LDADD_LIBCASNTEST)
+
+TESTS += lib/casn/tests/casn_stream-test
+
+check_PROGRAMS += lib/casn/tests/casn_lazy-test
+
+lib_casn_tests_casn_lazy_test_LDADD = \
+	$(LDADD_LIBCASNTEST)
+
+TESTS += lib/casn/tests/casn_lazy-test
+
+check_PROGRAMS += lib/casn/tests/casn_direct-test
+
+lib_casn_tests_casn_direct_test_LDADD = \
+	$(LDADD_LIBCASNTEST)
+
+TESTS += lib/casn/tests/casn_direct-test
+
+check_PROGRAMS += lib/casn/tests/casn_objid-test
+
+lib_casn_tests_casn_objid_test_LDADD = \
+	$(LDADD_LIBCASN)
+
+TESTS += lib/casn/tests/casn_objid-test
+
+check_PROGRAMS += lib/casn/tests/casn_time-test
+
+lib_casn_tests_casn_time_test_LDADD = \
+	$(LDADD_LIBCASN)
+
+TESTS += lib/casn/tests/casn_time-test
+
+check_PROGRAMS += lib/casn/tests/casn_file-test
+
+lib_casn_tests_casn_file_test_LDADD = \
+	$(LDADD_LIBCASNTEST)
+
+TESTS += lib/casn/tests/casn_file-test
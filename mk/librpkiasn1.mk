@@ -15,6 +15,10 @@ lib_rpki_asn1_librpkiasn1_a_ASN1 = \
 
 ASN_SOURCE_FILES += $(lib_rpki_asn1_librpkiasn1_a_ASN1)
 
+if ENABLE_CASN_DIRECT
+ASN_DIRECT_FILES += $(lib_rpki_asn1_librpkiasn1_a_ASN1)
+endif
+
 noinst_LIBRARIES += lib/rpki-asn1/librpkiasn1.a
 
 LDADD_LIBRPKIASN1 = \
@@ -36,4 +40,55 @@ tests_subsystem_rpki_asn1_test_casn_random_LDADD = \
 	$(LDADD_LIBRPKIASN1)
 
 
+# Not in TESTS because its results depend on the machine. Run it manually.
+check_PROGRAMS += tests/subsystem/rpki-asn1/casn_arena_benchmark
+
+tests_subsystem_rpki_asn1_casn_arena_benchmark_SOURCES = \
+	tests/subsystem/rpki-asn1/casn_arena_benchmark.c \
+	tests/subsystem/rpki-asn1/benchmark_util.c \
+	tests/subsystem/rpki-asn1/benchmark_util.h
+
+tests_subsystem_rpki_asn1_casn_arena_benchmark_LDADD = \
+	$(LDADD_LIBRPKIASN1)
+
+
+# Not in TESTS because its results depend on the machine. Run it manually.
+# It needs the XxxDecode() functions, so only with --enable-casn-direct.
+if ENABLE_CASN_DIRECT
+check_PROGRAMS += tests/subsystem/rpki-asn1/casn_direct_benchmark
+endif
+
+tests_subsystem_rpki_asn1_casn_direct_benchmark_SOURCES = \
+	tests/subsystem/rpki-asn1/casn_direct_benchmark.c \
+	tests/subsystem/rpki-asn1/benchmark_util.c \
+	tests/subsystem/rpki-asn1/benchmark_util.h
+
+tests_subsystem_rpki_asn1_casn_direct_benchmark_LDADD = \
+	$(LDADD_LIBRPKIASN1)
+
+
+# Not in TESTS because its results depend on the machine. Run it manually.
+check_PROGRAMS += tests/subsystem/rpki-asn1/casn_benchmark
+
+tests_subsystem_rpki_asn1_casn_benchmark_SOURCES = \
+	tests/subsystem/rpki-asn1/casn_benchmark.c \
+	tests/subsystem/rpki-asn1/benchmark_util.c \
+	tests/subsystem/rpki-asn1/benchmark_util.h
+
+tests_subsystem_rpki_asn1_casn_benchmark_LDADD = \
+	$(LDADD_LIBRPKIASN1)
+
+
+# Not in TESTS because its results depend on the machine. Run it manually.
+check_PROGRAMS += tests/subsystem/rpki-asn1/casn_time_benchmark
+
+tests_subsystem_rpki_asn1_casn_time_benchmark_SOURCES = \
+	tests/subsystem/rpki-asn1/casn_time_benchmark.c \
+	tests/subsystem/rpki-asn1/benchmark_util.c \
+	tests/subsystem/rpki-asn1/benchmark_util.h
+
+tests_subsystem_rpki_asn1_casn_time_benchmark_LDADD = \
+	$(LDADD_LIBRPKIASN1)
+
+
 EXTRA_DIST += tests/subsystem/rpki-asn1/test_casn_random_driver.sh
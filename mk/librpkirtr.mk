@@ -4,5 +4,69 @@ LDADD_LIBRPKIRTR = \
 	lib/rpki-rtr/librpkirtr.a
 
 lib_rpki_rtr_librpkirtr_a_SOURCES = \
+	lib/rpki-rtr/notify.c \
+	lib/rpki-rtr/notify.h \
 	lib/rpki-rtr/pdu.c \
-	lib/rpki-rtr/pdu.h
+	lib/rpki-rtr/pdu.h \
+	lib/rpki-rtr/rib_dump.c \
+	lib/rpki-rtr/rib_dump.h \
+	lib/rpki-rtr/rov.c \
+	lib/rpki-rtr/rov.h \
+	lib/rpki-rtr/vrp.c \
+	lib/rpki-rtr/vrp.h \
+	lib/rpki-rtr/vrp_file.c \
+	lib/rpki-rtr/vrp_file.h
+
+
+check_PROGRAMS += lib/rpki-rtr/tests/vrp-test
+
+lib_rpki_rtr_tests_vrp_test_LDADD = \
+	$(LDADD_LIBRPKIRTR) \
+	$(LDADD_LIBUTIL)
+
+TESTS += lib/rpki-rtr/tests/vrp-test
+
+
+check_PROGRAMS += lib/rpki-rtr/tests/vrp_file-test
+
+lib_rpki_rtr_tests_vrp_file_test_LDADD = \
+	$(LDADD_LIBRPKIRTR) \
+	$(LDADD_LIBUTIL)
+
+TESTS += lib/rpki-rtr/tests/vrp_file-test
+
+
+check_PROGRAMS += lib/rpki-rtr/tests/notify-test
+
+lib_rpki_rtr_tests_notify_test_LDADD = \
+	$(LDADD_LIBRPKIRTR) \
+	$(LDADD_LIBUTIL)
+
+TESTS += lib/rpki-rtr/tests/notify-test
+
+
+check_PROGRAMS += lib/rpki-rtr/tests/pdu-test
+
+lib_rpki_rtr_tests_pdu_test_LDADD = \
+	$(LDADD_LIBRPKIRTR) \
+	$(LDADD_LIBUTIL)
+
+TESTS += lib/rpki-rtr/tests/pdu-test
+
+
+check_PROGRAMS += lib/rpki-rtr/tests/rov-test
+
+lib_rpki_rtr_tests_rov_test_LDADD = \
+	$(LDADD_LIBRPKIRTR) \
+	$(LDADD_LIBUTIL)
+
+TESTS += lib/rpki-rtr/tests/rov-test
+
+
+check_PROGRAMS += lib/rpki-rtr/tests/rib_dump-test
+
+lib_rpki_rtr_tests_rib_dump_test_LDADD = \
+	$(LDADD_LIBRPKIRTR) \
+	$(LDADD_LIBUTIL)
+
+TESTS += lib/rpki-rtr/tests/rib_dump-test
@@ -17,14 +17,20 @@ lib_util_libutil_a_SOURCES = \
 	lib/util/logging.c \
 	lib/util/logging.h \
 	lib/util/macros.h \
+	lib/util/mpmc_queue.c \
+	lib/util/mpmc_queue.h \
 	lib/util/path_compat.c \
 	lib/util/path_compat.h \
 	lib/util/queue.c \
 	lib/util/queue.h \
 	lib/util/semaphore_compat.c \
 	lib/util/semaphore_compat.h \
+	lib/util/spsc_queue.c \
+	lib/util/spsc_queue.h \
 	lib/util/stringutils.c \
-	lib/util/stringutils.h
+	lib/util/stringutils.h \
+	lib/util/timeutils.c \
+	lib/util/timeutils.h
 
 
 check_LIBRARIES += lib/util/libutildebug.a
@@ -53,6 +59,29 @@ lib_util_tests_queue_test_LDADD = \
 TESTS += lib/util/tests/queue-test
 
 
+check_PROGRAMS += lib/util/tests/spsc_queue-test
+
+lib_util_tests_spsc_queue_test_LDADD = \
+	lib/util/libutildebug.a
+
+TESTS += lib/util/tests/spsc_queue-test
+
+
+check_PROGRAMS += lib/util/tests/mpmc_queue-test
+
+lib_util_tests_mpmc_queue_test_LDADD = \
+	lib/util/libutildebug.a
+
+TESTS += lib/util/tests/mpmc_queue-test
+
+
+# Not in TESTS because its results depend on the machine. Run it manually.
+check_PROGRAMS += lib/util/tests/queue-benchmark
+
+lib_util_tests_queue_benchmark_LDADD = \
+	lib/util/libutildebug.a
+
+
 check_PROGRAMS += lib/util/tests/stringutils-test
 
 lib_util_tests_stringutils_test_LDADD = \
@@ -12,6 +12,8 @@ bin_rpki_rtr_rpki_rtr_daemon_SOURCES = \
 	bin/rpki-rtr/db.c \
 	bin/rpki-rtr/db.h \
 	bin/rpki-rtr/main.c \
+	bin/rpki-rtr/metrics.c \
+	bin/rpki-rtr/metrics.h \
 	bin/rpki-rtr/semaphores.h \
 	bin/rpki-rtr/signals.c \
 	bin/rpki-rtr/signals.h
@@ -33,6 +35,17 @@ bin_rpki_rtr_rpki_rtr_test_client_LDADD = \
 	$(LDADD_LIBUTIL)
 
 
+pkglibexec_PROGRAMS += bin/rpki-rtr/rpki-rtr-load-test
+PACKAGE_NAME_BINS += rpki-rtr-load-test
+
+bin_rpki_rtr_rpki_rtr_load_test_SOURCES = \
+	bin/rpki-rtr/load-test.c
+
+bin_rpki_rtr_rpki_rtr_load_test_LDADD = \
+	$(LDADD_LIBRPKIRTR) \
+	$(LDADD_LIBUTIL)
+
+
 pkglibexec_PROGRAMS += bin/rpki-rtr/rpki-rtr-update
 PACKAGE_NAME_BINS += rpki-rtr-update
 
@@ -43,6 +56,36 @@ bin_rpki_rtr_rpki_rtr_update_LDADD = \
 	$(LDADD_LIBDB)
 
 
+pkglibexec_PROGRAMS += bin/rpki-rtr/rpki-rtr-validate
+PACKAGE_NAME_BINS += rpki-rtr-validate
+
+bin_rpki_rtr_rpki_rtr_validate_SOURCES = \
+	bin/rpki-rtr/validate.c
+
+bin_rpki_rtr_rpki_rtr_validate_LDADD = \
+	$(LDADD_LIBDB)
+
+
+pkglibexec_PROGRAMS += bin/rpki-rtr/rpki-rtr-diff
+PACKAGE_NAME_BINS += rpki-rtr-diff
+
+bin_rpki_rtr_rpki_rtr_diff_SOURCES = \
+	bin/rpki-rtr/diff.c
+
+bin_rpki_rtr_rpki_rtr_diff_LDADD = \
+	$(LDADD_LIBDB)
+
+
+pkglibexec_PROGRAMS += bin/rpki-rtr/rpki-rtr-export
+PACKAGE_NAME_BINS += rpki-rtr-export
+
+bin_rpki_rtr_rpki_rtr_export_SOURCES = \
+	bin/rpki-rtr/export.c
+
+bin_rpki_rtr_rpki_rtr_export_LDADD = \
+	$(LDADD_LIBDB)
+
+
 pkglibexec_SCRIPTS += bin/rpki-rtr/rpki-rtr-clear
 PACKAGE_NAME_BINS += rpki-rtr-clear
 MK_SUBST_FILES_EXEC += bin/rpki-rtr/rpki-rtr-clear
@@ -92,6 +135,7 @@ EXTRA_DIST += \
 	tests/subsystem/rtr/response.reset_query_first.log.correct \
 	tests/subsystem/rtr/response.reset_query_last.log.correct \
 	tests/subsystem/rtr/response.serial_notify.log.correct \
+	tests/subsystem/rtr/response.serial_notify_during_reset.log.correct \
 	tests/subsystem/rtr/response.serial_queries.log.correct \
 	tests/subsystem/rtr/root.options \
 	tests/subsystem/rtr/test.conf
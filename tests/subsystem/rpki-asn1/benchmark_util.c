@@ -0,0 +1,62 @@
+#include "benchmark_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <rpki-asn1/manifest.h>
+
+#define ID_SHA256 "2.16.840.1.101.3.4.2.1"
+
+
+double now(
+    void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int encode_manifest(
+    size_t entries,
+    uchar **encodedp)
+{
+    struct Manifest manifest;
+    struct FileAndHash *fahp;
+    char name[32];
+    uchar hash[33];
+    size_t i;
+    int lth;
+
+    Manifest(&manifest, 0);
+    write_casn_num(&manifest.manifestNumber, 1);
+    write_casn_time(&manifest.thisUpdate, 1467331200);
+    write_casn_time(&manifest.nextUpdate, 1467417600);
+    write_objid(&manifest.fileHashAlg, ID_SHA256);
+    hash[0] = 0;                // unused bits
+    for (i = 0; i < entries; i++)
+    {
+        fahp = (struct FileAndHash *)inject_casn(&manifest.fileList.self,
+                                                 i);
+        if (fahp == NULL)
+        {
+            delete_casn(&manifest.self);
+            return -1;
+        }
+        snprintf(name, sizeof(name), "%08zx.roa", i);
+        memset(&hash[1], (int)(i & 0xff), sizeof(hash) - 1);
+        write_casn(&fahp->file, (uchar *)name, strlen(name));
+        write_casn(&fahp->hash, hash, sizeof(hash));
+    }
+    lth = size_casn(&manifest.self);
+    if (lth < 0 || (*encodedp = malloc(lth)) == NULL)
+    {
+        delete_casn(&manifest.self);
+        return -1;
+    }
+    encode_casn(&manifest.self, *encodedp);
+    delete_casn(&manifest.self);
+    return lth;
+}
@@ -0,0 +1,28 @@
+/*
+ * Helpers shared by the libcasn benchmarks in this directory.
+ */
+
+#ifndef TESTS_SUBSYSTEM_RPKI_ASN1_BENCHMARK_UTIL_H
+#define TESTS_SUBSYSTEM_RPKI_ASN1_BENCHMARK_UTIL_H
+
+#include <stddef.h>
+
+#include <casn/casn.h>
+
+/*
+ * Seconds on CLOCK_MONOTONIC, for timing a benchmark.
+ */
+double now(
+    void);
+
+/*
+ * Encode a manifest with the given number of file entries into a new
+ * buffer in *encodedp, which the caller frees.
+ *
+ * Returns the length, or -1 on error.
+ */
+int encode_manifest(
+    size_t entries,
+    uchar **encodedp);
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * Benchmark of decoding and freeing a large manifest with the three
+ * ways libcasn can allocate a decoded object's memory:
+ *
+ *   calloc:    every OF member and primitive item gets its own calloc()
+ *              and is freed by delete_casn()
+ *   arena:     the object is bound to a casn_arena and freed by
+ *              casn_arena_reset()
+ *   arena+buf: like arena, but decoded with decode_casn_buf() so that
+ *              primitive items aren't copied at all
+ *
+ * Usage: casn_arena_benchmark [entries [iterations]]
+ *
+ * The allocation counts are the arena's num_allocs. Each of them is
+ * one calloc() in the calloc mode, which makes the same requests.
+ *
+ * This is not run by "make check" because its results depend on the
+ * machine and its load.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <casn/casn.h>
+#include <rpki-asn1/manifest.h>
+
+#include "benchmark_util.h"
+
+#define DEFAULT_ENTRIES 20000
+#define DEFAULT_ITERATIONS 20
+
+
+enum mode {
+    MODE_CALLOC,
+    MODE_ARENA,
+    MODE_ARENA_BUF,
+};
+
+static const char *const mode_names[] = {
+    "calloc",
+    "arena",
+    "arena+buf",
+};
+
+
+static bool run(
+    enum mode mode,
+    uchar *encoded,
+    int lth,
+    size_t iterations)
+{
+    struct Manifest manifest;
+    struct casn_arena arena;
+    struct casn_buf *bufp = NULL;
+    ulong num_allocs = 0;
+    double start;
+    double elapsed;
+    size_t i;
+    int ret;
+
+    casn_arena_init(&arena, 0);
+    if (mode == MODE_ARENA_BUF &&
+        (bufp = casn_buf_new(encoded, lth, NULL)) == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        return false;
+    }
+
+    start = now();
+    for (i = 0; i < iterations; i++)
+    {
+        Manifest(&manifest, 0);
+        if (mode != MODE_CALLOC)
+            casn_arena_bind(&manifest.self, &arena);
+        if (mode == MODE_ARENA_BUF)
+            ret = decode_casn_buf(&manifest.self, bufp);
+        else
+            ret = decode_casn_lth(&manifest.self, encoded, lth);
+        if (ret != lth)
+        {
+            fprintf(stderr, "decoding failed\n");
+            return false;
+        }
+        if (mode == MODE_CALLOC)
+        {
+            delete_casn(&manifest.self);
+        }
+        else
+        {
+            num_allocs = arena.num_allocs;
+            casn_arena_reset(&arena);
+        }
+    }
+    elapsed = now() - start;
+
+    if (mode == MODE_CALLOC)
+    {
+        // count the same decode's requests without timing it
+        Manifest(&manifest, 0);
+        casn_arena_bind(&manifest.self, &arena);
+        decode_casn_lth(&manifest.self, encoded, lth);
+        num_allocs = arena.num_allocs;
+        casn_arena_reset(&arena);
+    }
+
+    printf("  %-10s %10.2f ms/decode %10lu allocations %8lu from malloc()\n",
+           mode_names[mode], elapsed * 1e3 / (double)iterations, num_allocs,
+           mode == MODE_CALLOC ? num_allocs :
+           (arena.num_chunks + iterations - 1) / iterations);
+
+    casn_arena_free(&arena);
+    casn_buf_unref(bufp);
+    return true;
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    size_t entries = DEFAULT_ENTRIES;
+    size_t iterations = DEFAULT_ITERATIONS;
+    uchar *encoded;
+    int lth;
+    bool ok = true;
+
+    if (argc > 1)
+        entries = strtoul(argv[1], NULL, 10);
+    if (argc > 2)
+        iterations = strtoul(argv[2], NULL, 10);
+    if (argc > 3 || iterations == 0)
+    {
+        fprintf(stderr, "usage: %s [entries [iterations]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if ((lth = encode_manifest(entries, &encoded)) < 0)
+    {
+        fprintf(stderr, "encoding failed\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("manifest with %zu entries, %d bytes:\n", entries, lth);
+    ok = ok && run(MODE_CALLOC, encoded, lth, iterations);
+    ok = ok && run(MODE_ARENA, encoded, lth, iterations);
+    ok = ok && run(MODE_ARENA_BUF, encoded, lth, iterations);
+
+    free(encoded);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
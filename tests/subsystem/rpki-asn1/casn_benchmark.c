@@ -0,0 +1,564 @@
+/*
+ * Benchmark of the libcasn calls that validation makes on each object,
+ * over a corpus of real objects:
+ *
+ *   decode:   decode_casn_lth() of the whole object
+ *   encode:   encode_casn() of the decoded object
+ *   size:     size_casn() of the decoded object
+ *   diff:     diff_casn() of two decodings of the object
+ *   read_num: read_casn_num() of each version, serial number, CRL
+ *             entry, manifest number and AS number
+ *   time:     read_casn_time() of each validity, update and
+ *             revocation date
+ *   dump:     dump_size() and dump_casn() of the decoded object
+ *
+ * Usage: casn_benchmark [-n iterations] file-or-directory ...
+ *
+ * Certificates (.cer), CRLs (.crl) and CMS objects (.roa, .mft and
+ * .gbr) are read from the files given and from any directory under
+ * those given, e.g. tests/conformance/output after the conformance
+ * tests have generated it, or var/templates. Objects that don't decode
+ * are left out with a warning.
+ *
+ * Each result is printed on a line of its own as a JSON object, one
+ * per kind of object and operation and one per operation for all the
+ * objects together, so that results can be saved and compared:
+ *
+ *   {"kind": "certificate", "op": "decode", "objects": 5,
+ *    "bytes": 6230, "iterations": 100, "calls": 500,
+ *    "ns_per_call": 41234.5, "mb_per_s": 30.2, "allocs_per_call": 187.0}
+ *
+ * (on one line). bytes is the total size of the objects, and mb_per_s
+ * is how many megabytes of them were processed per second. Allocations
+ * are calls to malloc(), calloc() and realloc(), and are counted only
+ * with the GNU C library; elsewhere allocs_per_call is null.
+ *
+ * This is not run by "make check" because its results depend on the
+ * machine and its load.
+ */
+
+// for nftw()
+#define _XOPEN_SOURCE 700
+
+#include <ftw.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <casn/casn.h>
+#include <rpki-asn1/certificate.h>
+#include <rpki-asn1/cms.h>
+#include <rpki-asn1/crlv2.h>
+#include <rpki-asn1/manifest.h>
+#include <rpki-asn1/roa.h>
+
+#include "benchmark_util.h"
+
+#define DEFAULT_ITERATIONS 100
+#define MAX_OPEN_DIRECTORIES 16
+
+
+#ifdef __GLIBC__
+
+/*
+ * Count allocations by wrapping the GNU C library's allocator. free()
+ * is left as it is.
+ */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+
+static unsigned long num_allocs;
+
+void *malloc(
+    size_t size)
+{
+    num_allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(
+    size_t nmemb,
+    size_t size)
+{
+    num_allocs++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(
+    void *ptr,
+    size_t size)
+{
+    num_allocs++;
+    return __libc_realloc(ptr, size);
+}
+
+#define COUNTING_ALLOCS true
+
+#else
+
+static unsigned long num_allocs;
+
+#define COUNTING_ALLOCS false
+
+#endif
+
+
+enum kind_index {
+    KIND_CERTIFICATE,
+    KIND_CRL,
+    KIND_CMS,
+    NUM_KINDS,
+};
+
+/*
+ * The generated functions for the type of each kind of object, cast so
+ * that they can be called the same way.
+ */
+struct kind {
+    const char *name;
+    size_t size;
+    void (*constructor)(void *, ushort);
+};
+
+static const struct kind kinds[NUM_KINDS] = {
+    {"certificate", sizeof(struct Certificate),
+     (void (*)(void *, ushort))Certificate},
+    {"CRL", sizeof(struct CertificateRevocationList),
+     (void (*)(void *, ushort))CertificateRevocationList},
+    {"CMS", sizeof(struct CMS),
+     (void (*)(void *, ushort))CMS},
+};
+
+struct items {
+    struct casn **casnpp;
+    size_t num;
+};
+
+struct object {
+    int kind;
+    uchar *encoded;
+    int lth;
+    struct casn *casnp;         // decoded
+    struct casn *copyp;         // decoded again, for diff_casn()
+    uchar *reencoded;           // for encode_casn()
+    char *dump;                 // for dump_casn()
+    struct items nums;          // for read_casn_num()
+    struct items times;         // for read_casn_time()
+};
+
+struct corpus {
+    struct object *objects;
+    size_t num;
+};
+
+
+static int kind_of(
+    const char *filename)
+{
+    const char *suffix = strrchr(filename, '.');
+
+    if (suffix == NULL)
+        return -1;
+    if (strcmp(suffix, ".cer") == 0)
+        return KIND_CERTIFICATE;
+    if (strcmp(suffix, ".crl") == 0)
+        return KIND_CRL;
+    if (strcmp(suffix, ".roa") == 0 || strcmp(suffix, ".mft") == 0 ||
+        strcmp(suffix, ".gbr") == 0)
+        return KIND_CMS;
+    return -1;
+}
+
+static int read_file(
+    const char *filename,
+    uchar **encodedp)
+{
+    FILE *fp;
+    long lth;
+
+    if ((fp = fopen(filename, "rb")) == NULL)
+        return -1;
+    if (fseek(fp, 0, SEEK_END) != 0 || (lth = ftell(fp)) <= 0 ||
+        fseek(fp, 0, SEEK_SET) != 0 || (*encodedp = malloc(lth)) == NULL)
+    {
+        fclose(fp);
+        return -1;
+    }
+    if (fread(*encodedp, 1, lth, fp) != (size_t)lth)
+    {
+        free(*encodedp);
+        lth = -1;
+    }
+    fclose(fp);
+    return (int)lth;
+}
+
+static bool add_item(
+    struct items *itemsp,
+    struct casn *casnp)
+{
+    struct casn **casnpp;
+
+    casnpp = realloc(itemsp->casnpp,
+                     (itemsp->num + 1) * sizeof(*itemsp->casnpp));
+    if (casnpp == NULL)
+        return false;
+    casnpp[itemsp->num++] = casnp;
+    itemsp->casnpp = casnpp;
+    return true;
+}
+
+static bool add_certificate_items(
+    struct object *objp,
+    struct Certificate *certp)
+{
+    struct CertificateToBeSigned *tbsp = &certp->toBeSigned;
+
+    return add_item(&objp->nums, &tbsp->version.self) &&
+        add_item(&objp->nums, &tbsp->serialNumber) &&
+        add_item(&objp->times, &tbsp->validity.notBefore.self) &&
+        add_item(&objp->times, &tbsp->validity.notAfter.self);
+}
+
+static bool add_crl_items(
+    struct object *objp,
+    struct CertificateRevocationList *crlp)
+{
+    struct CertificateRevocationListToBeSigned *tbsp = &crlp->toBeSigned;
+    struct CRLEntry *entryp;
+
+    if (!add_item(&objp->nums, &tbsp->version.self) ||
+        !add_item(&objp->times, &tbsp->lastUpdate.self) ||
+        !add_item(&objp->times, &tbsp->nextUpdate.self))
+        return false;
+    for (entryp = (struct CRLEntry *)member_casn(
+             &tbsp->revokedCertificates.self, 0);
+         entryp != NULL;
+         entryp = (struct CRLEntry *)next_of(&entryp->self))
+    {
+        if (!add_item(&objp->nums, &entryp->userCertificate) ||
+            !add_item(&objp->times, &entryp->revocationDate.self))
+            return false;
+    }
+    return true;
+}
+
+static bool add_cms_items(
+    struct object *objp,
+    struct CMS *cmsp)
+{
+    struct SignedData *sdp = &cmsp->content.signedData;
+    struct EncapsulatedContentInfo *ecip = &sdp->encapContentInfo;
+    struct Certificate *certp;
+
+    if (!add_item(&objp->nums, &sdp->version.self))
+        return false;
+    certp = (struct Certificate *)member_casn(&sdp->certificates.self, 0);
+    if (certp != NULL && !add_certificate_items(objp, certp))
+        return false;
+    if (DIFF_OBJID_DER(&ecip->eContentType, id_roa_pki_manifest) == 0)
+        return add_item(&objp->nums, &ecip->eContent.manifest.manifestNumber)
+            && add_item(&objp->times, &ecip->eContent.manifest.thisUpdate)
+            && add_item(&objp->times, &ecip->eContent.manifest.nextUpdate);
+    if (DIFF_OBJID_DER(&ecip->eContentType, id_routeOriginAttestation) == 0)
+        return add_item(&objp->nums, &ecip->eContent.roa.asID);
+    return true;
+}
+
+/**
+    Decode the object in encoded twice and get it ready for the
+    operations. On failure, nothing is kept.
+*/
+static bool add_object(
+    struct corpus *corpusp,
+    int kind,
+    uchar *encoded,
+    int lth)
+{
+    struct object *objp;
+    bool ok;
+
+    objp = realloc(corpusp->objects,
+                   (corpusp->num + 1) * sizeof(*corpusp->objects));
+    if (objp == NULL)
+        return false;
+    corpusp->objects = objp;
+    objp = &corpusp->objects[corpusp->num];
+    memset(objp, 0, sizeof(*objp));
+    objp->kind = kind;
+    objp->encoded = encoded;
+    objp->lth = lth;
+    if ((objp->casnp = calloc(1, kinds[kind].size)) == NULL ||
+        (objp->copyp = calloc(1, kinds[kind].size)) == NULL)
+    {
+        free(objp->casnp);
+        return false;
+    }
+    kinds[kind].constructor(objp->casnp, 0);
+    kinds[kind].constructor(objp->copyp, 0);
+    ok = decode_casn_lth(objp->casnp, encoded, lth) > 0 &&
+        decode_casn_lth(objp->copyp, encoded, lth) > 0 &&
+        (objp->reencoded = malloc(size_casn(objp->casnp))) != NULL &&
+        (objp->dump = malloc(dump_size(objp->casnp) + 1)) != NULL;
+    if (ok && kind == KIND_CERTIFICATE)
+        ok = add_certificate_items(objp, (void *)objp->casnp);
+    else if (ok && kind == KIND_CRL)
+        ok = add_crl_items(objp, (void *)objp->casnp);
+    else if (ok && kind == KIND_CMS)
+        ok = add_cms_items(objp, (void *)objp->casnp);
+    if (!ok)
+    {
+        delete_casn(objp->casnp);
+        delete_casn(objp->copyp);
+        free(objp->casnp);
+        free(objp->copyp);
+        free(objp->reencoded);
+        free(objp->dump);
+        free(objp->nums.casnpp);
+        free(objp->times.casnpp);
+        return false;
+    }
+    corpusp->num++;
+    return true;
+}
+
+// what nftw() adds the objects it finds to
+static struct corpus corpus;
+
+static int load_file(
+    const char *filename,
+    const struct stat *sb,
+    int typeflag,
+    struct FTW *ftwbuf)
+{
+    uchar *encoded;
+    int lth;
+    int kind;
+
+    (void)sb;
+    // anything else in a directory is skipped
+    if (typeflag != FTW_F ||
+        ((kind = kind_of(filename)) < 0 && ftwbuf->level > 0))
+        return 0;
+    if (kind < 0)
+    {
+        fprintf(stderr, "%s: unknown kind of object\n", filename);
+        return -1;
+    }
+    if ((lth = read_file(filename, &encoded)) < 0)
+    {
+        fprintf(stderr, "%s: can't read it\n", filename);
+        return -1;
+    }
+    if (!add_object(&corpus, kind, encoded, lth))
+    {
+        fprintf(stderr, "%s: can't decode it, leaving it out\n",
+                filename);
+        free(encoded);
+    }
+    return 0;
+}
+
+
+static long op_decode(
+    struct object *objp)
+{
+    decode_casn_lth(objp->casnp, objp->encoded, objp->lth);
+    return 1;
+}
+
+static long op_encode(
+    struct object *objp)
+{
+    encode_casn(objp->casnp, objp->reencoded);
+    return 1;
+}
+
+static long op_size(
+    struct object *objp)
+{
+    size_casn(objp->casnp);
+    return 1;
+}
+
+static long op_diff(
+    struct object *objp)
+{
+    diff_casn(objp->casnp, objp->copyp);
+    return 1;
+}
+
+static long op_read_num(
+    struct object *objp)
+{
+    long val;
+    size_t i;
+
+    for (i = 0; i < objp->nums.num; i++)
+        read_casn_num(objp->nums.casnpp[i], &val);
+    return objp->nums.num;
+}
+
+static long op_time(
+    struct object *objp)
+{
+    int64_t val;
+    size_t i;
+
+    for (i = 0; i < objp->times.num; i++)
+        read_casn_time(objp->times.casnpp[i], &val);
+    return objp->times.num;
+}
+
+static long op_dump(
+    struct object *objp)
+{
+    dump_size(objp->casnp);
+    dump_casn(objp->casnp, objp->dump);
+    return 1;
+}
+
+static const struct op {
+    const char *name;
+    long (*run)(struct object *);
+} ops[] = {
+    {"decode", op_decode},
+    {"encode", op_encode},
+    {"size", op_size},
+    {"diff", op_diff},
+    {"read_num", op_read_num},
+    {"time", op_time},
+    {"dump", op_dump},
+};
+
+
+struct result {
+    size_t objects;
+    long bytes;
+    long calls;
+    unsigned long allocs;
+    double seconds;
+};
+
+/**
+    Run opp on each object of kind, or of every kind if kind is
+    negative, iterations times.
+*/
+static void measure(
+    const struct op *opp,
+    struct corpus *corpusp,
+    int kind,
+    size_t iterations,
+    struct result *resultp)
+{
+    struct object *objp;
+    unsigned long allocs;
+    double start;
+    size_t iteration;
+    size_t i;
+
+    memset(resultp, 0, sizeof(*resultp));
+    for (i = 0; i < corpusp->num; i++)
+    {
+        if (kind < 0 || corpusp->objects[i].kind == kind)
+        {
+            resultp->objects++;
+            resultp->bytes += corpusp->objects[i].lth;
+        }
+    }
+    allocs = num_allocs;
+    start = now();
+    for (iteration = 0; iteration < iterations; iteration++)
+    {
+        for (i = 0; i < corpusp->num; i++)
+        {
+            objp = &corpusp->objects[i];
+            if (kind < 0 || objp->kind == kind)
+                resultp->calls += opp->run(objp);
+        }
+    }
+    resultp->seconds = now() - start;
+    resultp->allocs = num_allocs - allocs;
+}
+
+static void report(
+    const struct op *opp,
+    const char *kind_name,
+    size_t iterations,
+    const struct result *resultp)
+{
+    printf("{\"kind\": \"%s\", \"op\": \"%s\", \"objects\": %zu, "
+           "\"bytes\": %ld, \"iterations\": %zu, \"calls\": %ld, "
+           "\"ns_per_call\": %.1f, \"mb_per_s\": %.2f, ",
+           kind_name, opp->name, resultp->objects, resultp->bytes,
+           iterations, resultp->calls,
+           resultp->seconds * 1e9 / (double)resultp->calls,
+           (double)resultp->bytes * (double)iterations / resultp->seconds
+           / 1e6);
+    if (COUNTING_ALLOCS)
+        printf("\"allocs_per_call\": %.1f}\n",
+               (double)resultp->allocs / (double)resultp->calls);
+    else
+        printf("\"allocs_per_call\": null}\n");
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    struct result result;
+    size_t iterations = DEFAULT_ITERATIONS;
+    size_t op;
+    int kind;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:")) != -1)
+    {
+        switch (c)
+        {
+        case 'n':
+            iterations = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            iterations = 0;
+            break;
+        }
+    }
+    if (iterations == 0 || optind == argc)
+    {
+        fprintf(stderr, "usage: %s [-n iterations] file-or-directory ...\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (; optind < argc; optind++)
+    {
+        if (nftw(argv[optind], load_file, MAX_OPEN_DIRECTORIES, 0) != 0)
+            return EXIT_FAILURE;
+    }
+    if (corpus.num == 0)
+    {
+        fprintf(stderr, "no objects to use\n");
+        return EXIT_FAILURE;
+    }
+
+    for (op = 0; op < sizeof(ops) / sizeof(ops[0]); op++)
+    {
+        for (kind = 0; kind < NUM_KINDS; kind++)
+        {
+            measure(&ops[op], &corpus, kind, iterations, &result);
+            if (result.calls > 0)
+                report(&ops[op], kinds[kind].name, iterations, &result);
+        }
+        measure(&ops[op], &corpus, -1, iterations, &result);
+        if (result.calls > 0)
+            report(&ops[op], "all", iterations, &result);
+    }
+
+    return EXIT_SUCCESS;
+}
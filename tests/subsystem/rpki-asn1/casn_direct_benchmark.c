@@ -0,0 +1,257 @@
+/*
+ * Benchmark of decoding with decode_casn_lth() and with the decoders
+ * that asn_gen -s generates, e.g. CertificateDecode():
+ *
+ *   generic:   decode_casn_lth(), where _match_casn() works out from
+ *              the struct casns which item may come next
+ *   generated: XxxDecode(), which knows the order and tags of the
+ *              members of each SEQUENCE and OF
+ *
+ * Usage: casn_direct_benchmark [-n iterations] [file ...]
+ *
+ * Each file is decoded as a certificate, CRL or CMS object according
+ * to its suffix (.cer, .crl, or .roa, .mft and .gbr). Without files, a
+ * generated manifest is used. Both decoders must give the same result.
+ *
+ * This is not run by "make check" because its results depend on the
+ * machine and its load. It is only built after ./configure
+ * --enable-casn-direct, which generates librpkiasn1 with asn_gen -s.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <casn/casn.h>
+#include <rpki-asn1/certificate.h>
+#include <rpki-asn1/cms.h>
+#include <rpki-asn1/crlv2.h>
+#include <rpki-asn1/manifest.h>
+
+#include "benchmark_util.h"
+
+#define DEFAULT_ITERATIONS 200
+#define MANIFEST_ENTRIES 20000
+
+
+/*
+ * The generated functions for the type of each kind of object, cast so
+ * that they can be called the same way.
+ */
+struct kind {
+    const char *name;
+    size_t size;
+    void (*constructor)(void *, ushort);
+    int (*decode)(void *, uchar *, int);
+};
+
+static const struct kind kinds[] = {
+    {"certificate", sizeof(struct Certificate),
+     (void (*)(void *, ushort))Certificate,
+     (int (*)(void *, uchar *, int))CertificateDecode},
+    {"CRL", sizeof(struct CertificateRevocationList),
+     (void (*)(void *, ushort))CertificateRevocationList,
+     (int (*)(void *, uchar *, int))CertificateRevocationListDecode},
+    {"CMS", sizeof(struct CMS),
+     (void (*)(void *, ushort))CMS,
+     (int (*)(void *, uchar *, int))CMSDecode},
+    {"manifest", sizeof(struct Manifest),
+     (void (*)(void *, ushort))Manifest,
+     (int (*)(void *, uchar *, int))ManifestDecode},
+};
+
+enum kind_index {
+    KIND_CERTIFICATE,
+    KIND_CRL,
+    KIND_CMS,
+    KIND_MANIFEST,
+};
+
+
+static int read_file(
+    const char *filename,
+    uchar **encodedp)
+{
+    FILE *fp;
+    long lth;
+
+    if ((fp = fopen(filename, "rb")) == NULL)
+        return -1;
+    if (fseek(fp, 0, SEEK_END) != 0 || (lth = ftell(fp)) <= 0 ||
+        fseek(fp, 0, SEEK_SET) != 0 || (*encodedp = malloc(lth)) == NULL)
+    {
+        fclose(fp);
+        return -1;
+    }
+    if (fread(*encodedp, 1, lth, fp) != (size_t)lth)
+    {
+        free(*encodedp);
+        lth = -1;
+    }
+    fclose(fp);
+    return (int)lth;
+}
+
+static int kind_of(
+    const char *filename)
+{
+    const char *suffix = strrchr(filename, '.');
+
+    if (suffix == NULL)
+        return -1;
+    if (strcmp(suffix, ".cer") == 0)
+        return KIND_CERTIFICATE;
+    if (strcmp(suffix, ".crl") == 0)
+        return KIND_CRL;
+    if (strcmp(suffix, ".roa") == 0 || strcmp(suffix, ".mft") == 0 ||
+        strcmp(suffix, ".gbr") == 0)
+        return KIND_CMS;
+    return -1;
+}
+
+/**
+    Decode encoded with both decoders, check that they agree, and return
+    the seconds per decode of each in elapsed[].
+*/
+static bool run(
+    const struct kind *kindp,
+    uchar *encoded,
+    int lth,
+    size_t iterations,
+    double elapsed[2])
+{
+    struct casn *casnp;
+    struct casn *checkp;
+    double start;
+    size_t i;
+    int generated;
+    int ret;
+    bool ok = true;
+
+    if ((casnp = calloc(1, kindp->size)) == NULL ||
+        (checkp = calloc(1, kindp->size)) == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        return false;
+    }
+
+    kindp->constructor(casnp, 0);
+    kindp->constructor(checkp, 0);
+    ret = decode_casn_lth(casnp, encoded, lth);
+    if (kindp->decode(checkp, encoded, lth) != ret)
+        ok = false;
+    else if (ret > 0 && diff_casn(casnp, checkp) != 0)
+        ok = false;
+    delete_casn(casnp);
+    delete_casn(checkp);
+    free(checkp);
+    if (!ok)
+    {
+        fprintf(stderr, "the decoders disagree\n");
+        free(casnp);
+        return false;
+    }
+
+    // decoding clears what was decoded before, so the object is
+    // constructed only once, which would otherwise take most of the time
+    for (generated = 0; generated < 2; generated++)
+    {
+        kindp->constructor(casnp, 0);
+        start = now();
+        for (i = 0; i < iterations; i++)
+        {
+            if (generated)
+                kindp->decode(casnp, encoded, lth);
+            else
+                decode_casn_lth(casnp, encoded, lth);
+        }
+        elapsed[generated] = (now() - start) / (double)iterations;
+        delete_casn(casnp);
+    }
+
+    free(casnp);
+    return true;
+}
+
+static bool report(
+    const char *what,
+    const struct kind *kindp,
+    uchar *encoded,
+    int lth,
+    size_t iterations)
+{
+    double elapsed[2];
+
+    if (!run(kindp, encoded, lth, iterations, elapsed))
+        return false;
+    printf("%s (%s, %d bytes):\n", what, kindp->name, lth);
+    printf("  %-10s %10.3f ms/decode %10.1f MB/s\n", "generic",
+           elapsed[0] * 1e3, (double)lth / elapsed[0] / 1e6);
+    printf("  %-10s %10.3f ms/decode %10.1f MB/s %6.2fx\n", "generated",
+           elapsed[1] * 1e3, (double)lth / elapsed[1] / 1e6,
+           elapsed[0] / elapsed[1]);
+    return true;
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    size_t iterations = DEFAULT_ITERATIONS;
+    uchar *encoded;
+    int lth;
+    int kind;
+    int c;
+    bool ok = true;
+
+    while ((c = getopt(argc, argv, "n:")) != -1)
+    {
+        switch (c)
+        {
+        case 'n':
+            iterations = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            iterations = 0;
+            break;
+        }
+    }
+    if (iterations == 0)
+    {
+        fprintf(stderr, "usage: %s [-n iterations] [file ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (optind == argc)
+    {
+        if ((lth = encode_manifest(MANIFEST_ENTRIES, &encoded)) < 0)
+        {
+            fprintf(stderr, "encoding failed\n");
+            return EXIT_FAILURE;
+        }
+        ok = report("generated manifest", &kinds[KIND_MANIFEST], encoded,
+                    lth, iterations / 20 + 1);
+        free(encoded);
+    }
+
+    for (; ok && optind < argc; optind++)
+    {
+        if ((kind = kind_of(argv[optind])) < 0)
+        {
+            fprintf(stderr, "%s: unknown kind of object\n", argv[optind]);
+            return EXIT_FAILURE;
+        }
+        if ((lth = read_file(argv[optind], &encoded)) < 0)
+        {
+            fprintf(stderr, "%s: can't read it\n", argv[optind]);
+            return EXIT_FAILURE;
+        }
+        ok = report(argv[optind], &kinds[kind], encoded, lth, iterations);
+        free(encoded);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
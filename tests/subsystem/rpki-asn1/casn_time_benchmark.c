@@ -0,0 +1,216 @@
+/*
+ * Benchmark of converting UTCTime and GeneralizedTime contents to a DB
+ * DATETIME string and a time_t:
+ *
+ *   sscanf:  what ASNTimeToDBTime() did before parse_casn_time(),
+ *            sscanf() of the fields, then calloc() and snprintf() of
+ *            the DB time, and timegm() for a time_t
+ *   parse:   parse_casn_time() and format_casn_time() into a buffer on
+ *            the stack
+ *   casn:    read_casn_time() of a decoded casn, for the time_t only
+ *
+ * Usage: casn_time_benchmark [-n iterations]
+ *
+ * This is not run by "make check" because its results depend on the
+ * machine and its load.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <casn/casn.h>
+
+#include "benchmark_util.h"
+
+#define DEFAULT_ITERATIONS 1000000
+
+
+static const char *const times[] = {
+    "160701000000Z",
+    "491231235959Z",
+    "20160701000000Z",
+    "20500101000000Z",
+};
+
+#define NUM_TIMES (sizeof(times) / sizeof(times[0]))
+
+
+/**
+    The old way, for the two DER forms only.
+*/
+static char *sscanf_time(
+    const char *in,
+    time_t *clockp)
+{
+    struct tm tm;
+    int year;
+    int mon;
+    int day;
+    int hour;
+    int min;
+    int sec;
+    char tz;
+    char *out;
+
+    memset(&tm, 0, sizeof(tm));
+    if (strchr(in, 'Z') - in == 12)
+    {
+        if (sscanf(in, "%2d%2d%2d%2d%2d%2d%c", &year, &mon, &day, &hour,
+                   &min, &sec, &tz) != 7)
+            return NULL;
+        year += (year > 49) ? 1900 : 2000;
+    }
+    else if (sscanf(in, "%4d%2d%2d%2d%2d%2d%c", &year, &mon, &day, &hour,
+                    &min, &sec, &tz) != 7)
+        return NULL;
+    if (tz != 'Z' || mon < 1 || mon > 12 || day < 1 || day > 31 ||
+        hour < 0 || hour > 23 || min < 0 || min > 59 || sec < 0 || sec > 61)
+        return NULL;
+    if ((out = calloc(48, sizeof(char))) == NULL)
+        return NULL;
+    snprintf(out, 48, "%4d-%02d-%02d %02d:%02d:%02d", year, mon, day, hour,
+             min, sec);
+    tm.tm_year = year - 1900;
+    tm.tm_mon = mon - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = hour;
+    tm.tm_min = min;
+    tm.tm_sec = sec;
+    *clockp = timegm(&tm);
+    return out;
+}
+
+/**
+    Check that every way gives the same results for every time.
+*/
+static bool check(
+    struct casn casns[])
+{
+    struct casn_time parsed;
+    char dbtime[CASN_TIME_STRING_SIZE];
+    char *old;
+    time_t clock;
+    int64_t val;
+    size_t i;
+
+    for (i = 0; i < NUM_TIMES; i++)
+    {
+        if ((old = sscanf_time(times[i], &clock)) == NULL ||
+            parse_casn_time(times[i], strlen(times[i]), &parsed) < 0 ||
+            format_casn_time(&parsed, dbtime, sizeof(dbtime)) < 0 ||
+            strcmp(old, dbtime) != 0 || (int64_t)clock != parsed.secs ||
+            read_casn_time(&casns[i], &val) <= 0 || val != parsed.secs)
+        {
+            fprintf(stderr, "%s: the conversions disagree\n", times[i]);
+            free(old);
+            return false;
+        }
+        free(old);
+    }
+    return true;
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+    struct casn casns[NUM_TIMES];
+    struct casn_time parsed;
+    char dbtime[CASN_TIME_STRING_SIZE];
+    size_t lths[NUM_TIMES];
+    size_t iterations = DEFAULT_ITERATIONS;
+    size_t i;
+    size_t j;
+    double start;
+    double elapsed[3];
+    time_t clock;
+    int64_t val;
+    int64_t sum = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:")) != -1)
+    {
+        switch (c)
+        {
+        case 'n':
+            iterations = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            iterations = 0;
+            break;
+        }
+    }
+    if (iterations == 0 || optind != argc)
+    {
+        fprintf(stderr, "usage: %s [-n iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < NUM_TIMES; i++)
+    {
+        lths[i] = strlen(times[i]);
+        simple_constructor(&casns[i], 0,
+                           (lths[i] == 13) ? ASN_UTCTIME : ASN_GENTIME);
+        write_casn(&casns[i], (uchar *)times[i], lths[i]);
+    }
+    if (!check(casns))
+        return EXIT_FAILURE;
+
+    start = now();
+    for (i = 0; i < iterations; i++)
+    {
+        for (j = 0; j < NUM_TIMES; j++)
+        {
+            char *out = sscanf_time(times[j], &clock);
+
+            sum += clock + out[0];
+            free(out);
+        }
+    }
+    elapsed[0] = now() - start;
+
+    start = now();
+    for (i = 0; i < iterations; i++)
+    {
+        for (j = 0; j < NUM_TIMES; j++)
+        {
+            parse_casn_time(times[j], lths[j], &parsed);
+            format_casn_time(&parsed, dbtime, sizeof(dbtime));
+            sum += parsed.secs + dbtime[0];
+        }
+    }
+    elapsed[1] = now() - start;
+
+    start = now();
+    for (i = 0; i < iterations; i++)
+    {
+        for (j = 0; j < NUM_TIMES; j++)
+        {
+            read_casn_time(&casns[j], &val);
+            sum += val;
+        }
+    }
+    elapsed[2] = now() - start;
+
+    for (i = 0; i < NUM_TIMES; i++)
+        delete_casn(&casns[i]);
+
+    // sum is printed only so that the loops aren't optimized away
+    printf("%zu conversions each (checksum %lld):\n",
+           iterations * NUM_TIMES, (long long)sum);
+    printf("  %-8s %8.1f ns/conversion\n", "sscanf",
+           elapsed[0] * 1e9 / (double)(iterations * NUM_TIMES));
+    printf("  %-8s %8.1f ns/conversion %6.2fx\n", "parse",
+           elapsed[1] * 1e9 / (double)(iterations * NUM_TIMES),
+           elapsed[0] / elapsed[1]);
+    printf("  %-8s %8.1f ns/conversion %6.2fx\n", "casn",
+           elapsed[2] * 1e9 / (double)(iterations * NUM_TIMES),
+           elapsed[0] / elapsed[2]);
+    return EXIT_SUCCESS;
+}